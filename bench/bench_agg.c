@@ -0,0 +1,187 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_service.h"
+#include "schc_demo_app/services/sensor_agg.h"
+#include "schc_demo_app/services/sensor_service.h"
+
+/*
+ * Bytes on air per measurement when K measurements share one packet.
+ * Each batch goes through the real pipeline (payload, IPv6/UDP header,
+ * SCHC compression); on air is the ahoi header plus the SCHC packet.
+ * Two sources: measure(), whose readings are independent uniform draws,
+ * and a slowly drifting sensor, closer to real water readings. Every batch
+ * is decoded again and checked against the quantization bound.
+ */
+
+#define NB_SAMPLES 12000
+#define L2_HDR_ON_AIR 6
+#define MTU 128
+#define PKT_CAP 256
+
+static ipv6_udp_tpl_t tpl;
+static sensor_data_t samples[NB_SAMPLES];
+static size_t budget;
+static size_t bound_errors;
+
+static uint64_t rng = 0x2545f4914f6cdd1dull;
+static double uniform(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (double) (rng >> 11) * 0x1.0p-53;
+}
+
+static void drifting(void) {
+    double t = 10.0, ph = 7.5, bat = 100.0;
+    for (size_t i = 0; i < NB_SAMPLES; i++) {
+        t += (uniform() - 0.5) * 0.1;
+        ph += (uniform() - 0.5) * 0.04;
+        bat -= uniform() < 0.01 ? 1.0 : 0.0;
+        if (bat < 0.0) bat = 100.0;
+        samples[i].temp = (float) t;
+        samples[i].pH = (float) ph;
+        samples[i].bat = (uint8_t) bat;
+    }
+}
+
+static size_t compress(pktbuf_t* pb) {
+    if (ipv6_udp_tpl_push(&tpl, pb) != 0 || schc_service_compress_pkt(pb) != SCHC_OK) exit(EXIT_FAILURE);
+    if (pb->len > MTU) exit(EXIT_FAILURE);
+    return pb->len;
+}
+
+/* One measurement per packet, sensor_data_t as is */
+static double raw_per_sample(void) {
+    uint8_t storage[PKT_CAP];
+    size_t on_air = 0;
+    for (size_t i = 0; i < NB_SAMPLES; i++) {
+        pktbuf_t pb;
+        pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+        memcpy(pktbuf_put(&pb, sizeof(sensor_data_t)), &samples[i], sizeof(sensor_data_t));
+        on_air += L2_HDR_ON_AIR + compress(&pb);
+    }
+    return (double) on_air / NB_SAMPLES;
+}
+
+static void check_batch(const sensor_data_t* in, const uint8_t* payload, const size_t len, const size_t n) {
+    sensor_data_t out[SENSOR_AGG_MAX_SAMPLES];
+    size_t count;
+    if (sensor_agg_decode(payload, len, out, SENSOR_AGG_MAX_SAMPLES, &count) != SENSOR_AGG_OK || count != n) {
+        bound_errors += n;
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (fabsf(out[i].temp - in[i].temp) > 0.0051f || fabsf(out[i].pH - in[i].pH) > 0.0051f ||
+            out[i].bat != in[i].bat) {
+            bound_errors++;
+        }
+    }
+}
+
+static sensor_agg_t agg;
+static size_t on_air;
+static size_t packets;
+static size_t first;        // index of the first sample of the current batch
+static uint64_t elapsed;
+
+static void flush(void) {
+    uint8_t storage[PKT_CAP];
+    pktbuf_t pb;
+    pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+    const size_t n = agg.count;
+    const uint64_t t0 = monotonic_now_ns();
+    if (sensor_agg_flush(&agg, &pb) != SENSOR_AGG_OK) exit(EXIT_FAILURE);
+    elapsed += monotonic_now_ns() - t0;
+    check_batch(&samples[first], pktbuf_data(&pb), pb.len, n);
+    on_air += L2_HDR_ON_AIR + compress(&pb);
+    packets++;
+    first += n;
+}
+
+static sensor_agg_status add(const size_t i) {
+    const uint64_t t0 = monotonic_now_ns();
+    const sensor_agg_status st = sensor_agg_add(&agg, &samples[i], 0);
+    elapsed += monotonic_now_ns() - t0;
+    return st;
+}
+
+/* Same flow as the application, without the deadline: every batch closes on K or on the budget */
+static double batched_per_sample(const uint32_t k, double* samples_per_pkt, uint64_t* ns) {
+    sensor_agg_init(&agg, k, budget);
+    on_air = 0;
+    packets = 0;
+    first = 0;
+    elapsed = 0;
+
+    for (size_t i = 0; i < NB_SAMPLES; i++) {
+        sensor_agg_status st = add(i);
+        if (st == SENSOR_AGG_FULL) {
+            flush();
+            st = add(i);
+        }
+        if (st == SENSOR_AGG_READY) flush();
+        else if (st != SENSOR_AGG_OK) exit(EXIT_FAILURE);
+    }
+    if (agg.count) flush();
+
+    *samples_per_pkt = (double) NB_SAMPLES / (double) packets;
+    *ns = elapsed;
+    return (double) on_air / NB_SAMPLES;
+}
+
+static void report(const char* source) {
+    const double raw = raw_per_sample();
+    printf("%s\n", source);
+    printf("  %-8s %10s %14s %10s %12s\n", "K", "samples/pkt", "bytes on air", "vs raw", "ns/sample");
+    printf("  %-8s %10.1f %14.2f %9.0f%% %12s\n", "raw", 1.0, raw, 100.0, "-");
+
+    static const uint32_t ks[] = { 1, 2, 4, 8, 16, 32, 64, SENSOR_AGG_MAX_SAMPLES };
+    for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); i++) {
+        double per_pkt;
+        uint64_t ns;
+        const double b = batched_per_sample(ks[i], &per_pkt, &ns);
+        char k[16];
+        snprintf(k, sizeof(k), "%u", ks[i]);
+        printf("  %-8s %10.1f %14.2f %9.0f%% %12.1f\n", ks[i] == SENSOR_AGG_MAX_SAMPLES ? "max" : k, per_pkt, b,
+               100.0 * b / raw, (double) ns / NB_SAMPLES);
+    }
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, schc_service_dev_ip(), 16);
+    memcpy(cfg.dst_ip, schc_service_app_ip(), 16);
+    cfg.src_port = schc_service_dev_port();
+    cfg.dst_port = schc_service_app_port();
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+    if (ipv6_udp_tpl_init(&tpl, &cfg, schc_service_flow_label()) != 0) return EXIT_FAILURE;
+
+    // Same budget as the application: what is left of the MTU after the compressed headers
+    uint8_t storage[PKT_CAP];
+    pktbuf_t pb;
+    pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+    pktbuf_put(&pb, 1 + SENSOR_CODEC_SIZE(1));
+    budget = MTU - (compress(&pb) - (1 + SENSOR_CODEC_SIZE(1)));
+    printf("MTU %d, payload budget %zu bytes, ahoi header %d bytes\n", MTU, budget, L2_HDR_ON_AIR);
+
+    rng_set_seed(42);
+    for (size_t i = 0; i < NB_SAMPLES; i++) measure(&samples[i]);
+    report("measure(): independent uniform readings");
+
+    drifting();
+    report("drifting sensor");
+
+    printf("samples outside the quantization bound: %zu\n", bound_errors);
+    zlog_fini();
+    return bound_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+
+#define PKT_CAP 2048
+#define VERIFY_CASES 10000
+
+static uint8_t payload[PKT_CAP];
+static uint8_t out_ref[PKT_CAP];
+static uint8_t out_tpl[PKT_CAP];
+
+static void random_cfg(ipv6_udp_cfg_t* cfg) {
+    for (size_t i = 0; i < 16; i++) {
+        cfg->src_ip[i] = (uint8_t) rand();
+        cfg->dst_ip[i] = (uint8_t) rand();
+    }
+    cfg->src_port = (uint16_t) rand();
+    cfg->dst_port = (uint16_t) rand();
+    cfg->traffic_class = (uint8_t) rand();
+    cfg->next_header = 17;
+    cfg->hop_limit = (uint8_t) rand();
+}
+
+/* The prepared header must reproduce build_ipv6_udp_packet byte for byte */
+static int verify(void) {
+    for (int c = 0; c < VERIFY_CASES; c++) {
+        ipv6_udp_cfg_t cfg;
+        random_cfg(&cfg);
+        const uint32_t flow_lbl = (uint32_t) rand();
+        const size_t len = (size_t) rand() % (PKT_CAP - 48);
+
+        ipv6_udp_tpl_t tpl;
+        size_t ref_len = 0;
+        size_t tpl_len = 0;
+        if (ipv6_udp_tpl_init(&tpl, &cfg, flow_lbl) != 0 ||
+            build_ipv6_udp_packet(&cfg, flow_lbl, payload, len, out_ref, PKT_CAP, &ref_len) != 0 ||
+            ipv6_udp_tpl_build(&tpl, payload, len, out_tpl, PKT_CAP, &tpl_len) != 0) {
+            fprintf(stderr, "build failed for len=%zu\n", len);
+            return -1;
+        }
+        if (ref_len != tpl_len || memcmp(out_ref, out_tpl, ref_len) != 0) {
+            fprintf(stderr, "prepared header differs for len=%zu\n", len);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    static const size_t sizes[] = { 9, 64, 1452 };
+    const uint64_t iterations = 2000000;
+
+    srand(42);
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t) rand();
+    if (verify() != 0) return EXIT_FAILURE;
+
+    ipv6_udp_cfg_t cfg;
+    random_cfg(&cfg);
+    ipv6_udp_tpl_t tpl;
+    ipv6_udp_tpl_init(&tpl, &cfg, 0);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        const size_t len = sizes[s];
+        size_t out_len;
+        char name[64];
+
+        uint64_t t0 = monotonic_now_ns();
+        for (uint64_t i = 0; i < iterations; i++) {
+            build_ipv6_udp_packet(&cfg, 0, payload, len, out_ref, PKT_CAP, &out_len);
+        }
+        snprintf(name, sizeof(name), "build_ipv6_udp_packet %zu B", len);
+        bench_report(name, monotonic_now_ns() - t0, iterations);
+
+        t0 = monotonic_now_ns();
+        for (uint64_t i = 0; i < iterations; i++) {
+            ipv6_udp_tpl_build(&tpl, payload, len, out_tpl, PKT_CAP, &out_len);
+        }
+        snprintf(name, sizeof(name), "ipv6_udp_tpl_build %zu B", len);
+        bench_report(name, monotonic_now_ns() - t0, iterations);
+    }
+
+    return EXIT_SUCCESS;
+}
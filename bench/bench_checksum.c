@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/net/inet_checksum.h"
+
+#define MAX_LEN 65536
+#define MAX_OFFSET 64
+#define VERIFY_CASES 20000
+
+static uint8_t buf[MAX_LEN + MAX_OFFSET];
+
+/* Every kernel must agree with the reference over random lengths, alignments and seeds */
+static int verify(const inet_csum_fn_t ref, const inet_csum_fn_t fn, const char* name) {
+    for (int c = 0; c < VERIFY_CASES; c++) {
+        const size_t off = (size_t) rand() % MAX_OFFSET;
+        const size_t len = c < 256 ? (size_t) c : (size_t) rand() % (c & 1 ? 2048 : MAX_LEN);
+        const uint32_t seed = (uint32_t) rand() & 0x3FFFFu;
+        const uint32_t want = ref(buf + off, len, seed);
+        const uint32_t got = fn(buf + off, len, seed);
+        /* 0x0000 and 0xFFFF are the same value in one's complement */
+        if (want != got && !(want % 0xFFFFu == 0 && got % 0xFFFFu == 0)) {
+            fprintf(stderr, "%s: len=%zu off=%zu seed=%u: want %04x got %04x\n",
+                    name, len, off, seed, want, got);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    static const size_t sizes[] = { 13, 64, 256, 1500, 9000, 65535 };
+
+    srand(42);
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t) rand();
+
+    const inet_csum_fn_t ref = inet_csum_get_impl(INET_CSUM_REF);
+
+    for (inet_csum_impl_t impl = 0; impl < INET_CSUM_IMPL_COUNT; impl++) {
+        const inet_csum_fn_t fn = inet_csum_get_impl(impl);
+        if (!fn) {
+            printf("%-8s not available\n", inet_csum_impl_name(impl));
+            continue;
+        }
+        if (verify(ref, fn, inet_csum_impl_name(impl)) != 0) return EXIT_FAILURE;
+
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            const size_t len = sizes[s];
+            const uint64_t iterations = (64ull << 20) / len;
+            volatile uint32_t sink = 0;
+
+            const uint64_t t0 = monotonic_now_ns();
+            for (uint64_t i = 0; i < iterations; i++) {
+                sink += fn(buf + (i & 7u), len, 0);
+            }
+            const uint64_t elapsed = monotonic_now_ns() - t0;
+
+            char name[64];
+            snprintf(name, sizeof(name), "csum %s %zu B", inet_csum_impl_name(impl), len);
+            bench_report(name, elapsed, iterations);
+            printf("%-40s %10.2f GB/s\n", "", (double) (iterations * len) / (double) elapsed);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
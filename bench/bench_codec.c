@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/services/sensor_codec.h"
+#include "schc_demo_app/services/sensor_service.h"
+
+/*
+ * Bit-packed sensor codec: size against the raw struct, then encode/decode
+ * cost one sample at a time and in blocks. The size and error bounds are
+ * checked by test/check_sensor_codec.c.
+ */
+
+#define ROUNDS 200000
+
+static double field_max(const sensor_field_t* f) {
+    return f->min + (double) ((1u << f->bits) - 1) * f->step;
+}
+
+static void sizes(void) {
+    const size_t raw = sizeof(sensor_data_t);
+    const size_t packed = SENSOR_CODEC_SIZE(1);
+    printf("%-6s %10s %10s %6s %5s\n", "field", "min", "max", "step", "bits");
+    for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+        const sensor_field_t* f = &sensor_codec_fields[i];
+        printf("%-6s %10.2f %10.2f %6.2f %5u\n", f->name, f->min, field_max(f), f->step, f->bits);
+    }
+    printf("%d bits per sample: %zu bytes vs %zu raw (-%.0f%%), 16 samples: %zu bytes vs %zu\n", SENSOR_CODEC_BITS,
+           packed, raw, 100.0 * (1.0 - (double) packed / (double) raw), SENSOR_CODEC_SIZE(16), 16 * raw);
+}
+
+static void cost(void) {
+    static sensor_data_t in[16 * 64];
+    static sensor_data_t out[16 * 64];
+    static uint8_t buf[SENSOR_CODEC_SIZE(16 * 64)];
+    rng_set_seed(42);
+    for (size_t i = 0; i < sizeof(in) / sizeof(in[0]); i++) measure(&in[i]);
+
+    uint64_t sum = 0;
+    uint64_t t0 = monotonic_now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        sensor_codec_encode(&in[r & 1023], 1, buf, sizeof(buf));
+        sum += buf[0];
+    }
+    bench_report("encode 1 sample", monotonic_now_ns() - t0, ROUNDS);
+
+    t0 = monotonic_now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        sensor_codec_decode(buf, SENSOR_CODEC_SIZE(1), out, 1);
+        sum += out[0].bat;
+    }
+    bench_report("decode 1 sample", monotonic_now_ns() - t0, ROUNDS);
+
+    const size_t n = sizeof(in) / sizeof(in[0]);
+    t0 = monotonic_now_ns();
+    for (int r = 0; r < ROUNDS / 1000; r++) {
+        sum += sensor_codec_encode(in, n, buf, sizeof(buf));
+    }
+    bench_report("encode, blocks of 1024 (per sample)", monotonic_now_ns() - t0, (uint64_t) (ROUNDS / 1000) * n);
+
+    t0 = monotonic_now_ns();
+    for (int r = 0; r < ROUNDS / 1000; r++) {
+        sensor_codec_decode(buf, SENSOR_CODEC_SIZE(n), out, n);
+        sum += out[r].bat;
+    }
+    bench_report("decode, blocks of 1024 (per sample)", monotonic_now_ns() - t0, (uint64_t) (ROUNDS / 1000) * n);
+    printf("(checksum %llu)\n", (unsigned long long) sum);
+}
+
+int main(void) {
+    sizes();
+    cost();
+    return EXIT_SUCCESS;
+}
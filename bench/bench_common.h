@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "schc_demo_app/utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_CYCLES 1
+#else
+#define BENCH_HAVE_CYCLES 0
+#endif
+
+/**
+ * Time stamp counter: reference cycles at the nominal frequency, not core
+ * cycles, so frequency scaling shows up as extra cycles. 0 where there is no
+ * counter (BENCH_HAVE_CYCLES is 0).
+ */
+static inline uint64_t bench_cycles(void) {
+#if BENCH_HAVE_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline void bench_report(const char* name, const uint64_t elapsed_ns, const uint64_t iterations) {
+    const double ns_per_op = (double) elapsed_ns / (double) iterations;
+    printf("%-40s %10.1f ns/op %12.0f op/s\n", name, ns_per_op, 1e9 / ns_per_op);
+}
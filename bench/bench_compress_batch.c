@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_service.h"
+
+#define NB_PACKETS 4096
+#define PAYLOAD_LEN 9
+#define PKT_CAP 128
+#define ROUNDS 200
+
+static uint8_t packets[NB_PACKETS][PKT_CAP];
+static uint8_t compressed[NB_PACKETS][PKT_CAP];
+static schc_cspan_t in_spans[NB_PACKETS];
+static schc_span_t out_spans[NB_PACKETS];
+static schc_status_t status[NB_PACKETS];
+static size_t out_bits[NB_PACKETS];
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, schc_service_dev_ip(), 16);
+    memcpy(cfg.dst_ip, schc_service_app_ip(), 16);
+    cfg.src_port = schc_service_dev_port();
+    cfg.dst_port = schc_service_app_port();
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+
+    srand(42);
+    for (size_t i = 0; i < NB_PACKETS; i++) {
+        uint8_t payload[PAYLOAD_LEN];
+        for (size_t j = 0; j < PAYLOAD_LEN; j++) payload[j] = (uint8_t) rand();
+
+        size_t len = 0;
+        if (build_ipv6_udp_packet(&cfg, schc_service_flow_label(), payload, sizeof(payload),
+                                  packets[i], PKT_CAP, &len) != 0) {
+            return EXIT_FAILURE;
+        }
+        in_spans[i] = (schc_cspan_t){ packets[i], len };
+        out_spans[i] = (schc_span_t){ compressed[i], PKT_CAP };
+    }
+
+    uint64_t t0 = monotonic_now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < NB_PACKETS; i++) {
+            size_t out_len;
+            if (schc_service_compress(in_spans[i].data, in_spans[i].len,
+                                      out_spans[i].data, out_spans[i].len, &out_len) != SCHC_OK) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    const uint64_t loop_ns = monotonic_now_ns() - t0;
+
+    t0 = monotonic_now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        if (schc_service_compress_batch(in_spans, out_spans, NB_PACKETS, status, out_bits) != NB_PACKETS) {
+            return EXIT_FAILURE;
+        }
+    }
+    const uint64_t batch_ns = monotonic_now_ns() - t0;
+
+    bench_report("schc_service_compress (loop)", loop_ns, (uint64_t) ROUNDS * NB_PACKETS);
+    bench_report("schc_service_compress_batch", batch_ns, (uint64_t) ROUNDS * NB_PACKETS);
+    printf("speedup: %.2fx\n", (double) loop_ns / (double) batch_ns);
+
+    zlog_fini();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_frag.h"
+#include "schc_demo_app/services/schc_service.h"
+
+/*
+ * SCHC fragmentation over a lossy link.
+ * An application buffer of D bytes is delivered either as one IPv6/UDP
+ * packet, compressed then fragmented (No-ACK or ACK-on-Error), or as
+ * independent unfragmented packets, each filling the ahoi MTU. Frames are
+ * lost at random in both directions. Goodput is the application bytes that
+ * arrive intact per second of airtime (ahoi header + payload at LINK_BPS);
+ * time spent waiting for a retransmission timer is not airtime and is not
+ * counted. Every reassembled packet is decompressed and compared with the
+ * original. Then the CPU cost of emitting and reassembling fragments.
+ */
+
+#define MTU 128
+#define L2_HDR_ON_AIR 6
+#define LINK_BPS 1000.0
+#define TRIALS 200
+#define CPU_ROUNDS 2000
+#define PKT_CAP (PKTBUF_HEADROOM + 32768)
+
+static ipv6_udp_tpl_t tpl;
+static uint8_t app_data[16384];
+
+static uint8_t pkt_storage[PKT_CAP];
+static uint8_t ipv6_copy[PKT_CAP];
+static size_t ipv6_len;
+static uint8_t reasm[SCHC_FRAG_MAX_PACKET(MTU)];
+static uint8_t rebuilt[PKT_CAP];
+
+static uint64_t rng = 0x9e3779b97f4a7c15ull;
+static uint64_t rnd(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static double loss;
+static int lost(void) {
+    return (double) (rnd() >> 11) * 0x1.0p-53 < loss;
+}
+
+static double airtime_s;
+static size_t frames_on_air;
+static void on_air(const size_t len) {
+    airtime_s += (double) (L2_HDR_ON_AIR + len) * 8.0 / LINK_BPS;
+    frames_on_air++;
+}
+
+/* IPv6/UDP packet carrying app_data[0..len), compressed in place; returns the SCHC packet */
+static const uint8_t* build_schc(const size_t len, pktbuf_t* pb) {
+    pktbuf_init(pb, pkt_storage, sizeof(pkt_storage), PKTBUF_HEADROOM);
+    memcpy(pktbuf_put(pb, len), app_data, len);
+    if (ipv6_udp_tpl_push(&tpl, pb) != 0) exit(EXIT_FAILURE);
+    ipv6_len = pb->len;
+    memcpy(ipv6_copy, pktbuf_data(pb), pb->len);
+    if (schc_service_compress_pkt(pb) != SCHC_OK) exit(EXIT_FAILURE);
+    return pktbuf_data(pb);
+}
+
+/* ------------------------------------------------------------ */
+/* Fragmented transfer                                          */
+/* ------------------------------------------------------------ */
+
+static schc_frag_receiver_t rx;
+static uint8_t ack_buf[SCHC_FRAG_ACK_MAX_SIZE];
+static size_t ack_len;          // ACK that made it back to the sender, 0: none
+static int delivered;
+static size_t mismatches;
+
+static schc_frag_status channel_emit(const schc_frag_t* frag, void* ctx) {
+    (void) ctx;
+    uint8_t frame[MTU];
+    memcpy(frame, frag->hdr, frag->hdr_len);
+    memcpy(frame + frag->hdr_len, frag->tile, frag->tile_len);
+    const size_t len = frag->hdr_len + frag->tile_len;
+    on_air(len);
+    if (lost()) return SCHC_FRAG_OK;
+
+    size_t pkt_len;
+    uint8_t ack[SCHC_FRAG_ACK_MAX_SIZE];
+    size_t alen;
+    if (schc_frag_receiver_input(&rx, frame, len, &pkt_len, ack, &alen) == SCHC_FRAG_DONE) {
+        size_t out_len = 0;
+        if (schc_service_decompress(reasm, pkt_len, rebuilt, sizeof(rebuilt), &out_len) == SCHC_OK &&
+            out_len == ipv6_len && memcmp(rebuilt, ipv6_copy, out_len) == 0) {
+            delivered = 1;
+        } else {
+            mismatches++;
+        }
+    }
+    if (alen) {
+        on_air(alen);
+        if (!lost()) {
+            memcpy(ack_buf, ack, alen);
+            ack_len = alen;
+        }
+    }
+    return SCHC_FRAG_OK;
+}
+
+static size_t send_fragmented(const schc_frag_mode mode, const size_t len) {
+    pktbuf_t pb;
+    const uint8_t* schc = build_schc(len, &pb);
+
+    static uint8_t dtag = 0;
+    schc_frag_sender_t s;
+    if (schc_frag_sender_start(&s, mode, dtag++, schc, pb.len, MTU, channel_emit, NULL) != SCHC_OK) {
+        exit(EXIT_FAILURE);
+    }
+
+    delivered = 0;
+    ack_len = 0;
+    for (;;) {
+        const schc_frag_status st = schc_frag_sender_poll(&s);
+        if (st != SCHC_FRAG_OK) break;
+        if (ack_len) {
+            ack_len = 0;
+            schc_frag_sender_on_ack(&s, ack_buf, sizeof(ack_buf));
+        } else {
+            schc_frag_sender_on_timeout(&s);
+        }
+    }
+    return delivered ? len : 0;
+}
+
+/* ------------------------------------------------------------ */
+/* Unfragmented packets                                         */
+/* ------------------------------------------------------------ */
+
+static size_t chunk_size;   // application bytes per packet so that the SCHC packet fills the MTU
+
+static size_t send_unfragmented(const size_t len) {
+    size_t got = 0;
+    for (size_t off = 0; off < len; off += chunk_size) {
+        const size_t n = len - off < chunk_size ? len - off : chunk_size;
+        pktbuf_t pb;
+        build_schc(n, &pb);
+        on_air(pb.len);
+        if (!lost()) got += n;
+    }
+    return got;
+}
+
+static void goodput(const char* name, const size_t len) {
+    printf("%-22s %6zu B:", name, len);
+    static const double losses[] = { 0.0, 0.01, 0.05, 0.10 };
+    for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        loss = losses[l];
+        airtime_s = 0.0;
+        frames_on_air = 0;
+        size_t bytes = 0;
+        for (int t = 0; t < TRIALS; t++) {
+            if (strcmp(name, "unfragmented") == 0) {
+                bytes += send_unfragmented(len);
+            } else {
+                bytes += send_fragmented(strcmp(name, "No-ACK") == 0 ? SCHC_FRAG_NO_ACK : SCHC_FRAG_ACK_ON_ERROR, len);
+            }
+        }
+        printf("  %4.0f%% loss %6.1f B/s (%4.1f%%)", loss * 100, (double) bytes / airtime_s,
+               100.0 * (double) bytes * 8.0 / airtime_s / LINK_BPS);
+    }
+    printf("\n");
+}
+
+/* ------------------------------------------------------------ */
+/* CPU cost                                                     */
+/* ------------------------------------------------------------ */
+
+static uint8_t frames[256][MTU];
+static size_t frame_lens[256];
+static size_t nb_frames;
+
+static schc_frag_status collect_emit(const schc_frag_t* frag, void* ctx) {
+    (void) ctx;
+    if (nb_frames == 256) return SCHC_FRAG_KO;
+    memcpy(frames[nb_frames], frag->hdr, frag->hdr_len);
+    memcpy(frames[nb_frames] + frag->hdr_len, frag->tile, frag->tile_len);
+    frame_lens[nb_frames++] = frag->hdr_len + frag->tile_len;
+    return SCHC_FRAG_OK;
+}
+
+static uint64_t emit_sum;
+static schc_frag_status count_emit(const schc_frag_t* frag, void* ctx) {
+    (void) ctx;
+    emit_sum += frag->hdr[2] + frag->tile_len + (frag->tile_len ? frag->tile[0] : 0);
+    return SCHC_FRAG_OK;
+}
+
+static void cpu_cost(const schc_frag_mode mode, const char* name) {
+    pktbuf_t pb;
+    const uint8_t* schc = build_schc(8000, &pb);
+    schc_frag_sender_t s;
+
+    uint64_t t0 = monotonic_now_ns();
+    uint64_t fragments = 0;
+    for (int r = 0; r < CPU_ROUNDS; r++) {
+        schc_frag_sender_start(&s, mode, (uint8_t) r, schc, pb.len, MTU, count_emit, NULL);
+        schc_frag_sender_poll(&s);
+        fragments += s.stats.fragments;
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "%s emit (per fragment)", name);
+    bench_report(label, monotonic_now_ns() - t0, fragments);
+
+    nb_frames = 0;
+    schc_frag_sender_start(&s, mode, 0, schc, pb.len, MTU, collect_emit, NULL);
+    schc_frag_sender_poll(&s);
+
+    t0 = monotonic_now_ns();
+    size_t ok = 0;
+    for (int r = 0; r < CPU_ROUNDS; r++) {
+        for (size_t i = 0; i < nb_frames; i++) {
+            frames[i][1] = (uint8_t) r;     // new DTag: a new session every round
+            size_t pkt_len;
+            uint8_t ack[SCHC_FRAG_ACK_MAX_SIZE];
+            size_t alen;
+            if (schc_frag_receiver_input(&rx, frames[i], frame_lens[i], &pkt_len, ack, &alen) == SCHC_FRAG_DONE) ok++;
+        }
+    }
+    snprintf(label, sizeof(label), "%s reassemble (per fragment)", name);
+    bench_report(label, monotonic_now_ns() - t0, (uint64_t) CPU_ROUNDS * nb_frames);
+    if (ok != CPU_ROUNDS) printf("  reassembly failed: %zu/%d\n", ok, CPU_ROUNDS);
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, schc_service_dev_ip(), 16);
+    memcpy(cfg.dst_ip, schc_service_app_ip(), 16);
+    cfg.src_port = schc_service_dev_port();
+    cfg.dst_port = schc_service_app_port();
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+    if (ipv6_udp_tpl_init(&tpl, &cfg, schc_service_flow_label()) != 0) return EXIT_FAILURE;
+
+    for (size_t i = 0; i < sizeof(app_data); i++) app_data[i] = (uint8_t) rnd();
+    schc_frag_receiver_init(&rx, reasm, sizeof(reasm), MTU);
+
+    pktbuf_t pb;
+    build_schc(16, &pb);
+    chunk_size = MTU - (pb.len - 16);
+    printf("MTU %d, SCHC header %zu bytes, %zu application bytes per unfragmented packet, link %.0f bit/s\n",
+           MTU, pb.len - 16, chunk_size, LINK_BPS);
+
+    static const size_t sizes[] = { 500, 2000, 8000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        goodput("unfragmented", sizes[i]);
+        goodput("No-ACK", sizes[i]);
+        goodput("ACK-on-Error", sizes[i]);
+    }
+    printf("reassembled packets not matching the original: %zu\n", mismatches);
+
+    cpu_cost(SCHC_FRAG_NO_ACK, "No-ACK");
+    cpu_cost(SCHC_FRAG_ACK_ON_ERROR, "ACK-on-Error");
+    printf("(checksum %llu)\n", (unsigned long long) emit_sum);
+
+    zlog_fini();
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
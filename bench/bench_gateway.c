@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/gw_service.h"
+#include "schc_demo_app/services/schc_service.h"
+
+/*
+ * Gateway load test. A synthetic generator plays NB_DEVICES devices, each
+ * with its own address and SCHC context as in the simulator, and writes
+ * their compressed uplink frames in the loopback wire framing. The main
+ * thread then acts as the gateway reader, feeding the frames through
+ * gw_submit() to 1, 2 and 4 workers, with no output and with sendmmsg() to
+ * a datagram socket. Reports frames/s and packets/s per core (worker CPU).
+ * First, every rebuilt packet is checked against what the device built.
+ *
+ * Then the same frames go over loopback UDP, one datagram each, sent with
+ * sendmmsg() by another thread: once to a reader thread feeding the workers
+ * through gw_submit(), once to per-worker sockets from gw_open_shards().
+ * Frames the kernel dropped (socket buffer full) are reported, not retried.
+ * Before that, a paced run checks that the kernel steers every frame to the
+ * worker gw_submit() would have picked.
+ */
+
+#define NB_DEVICES 200
+#define NB_FRAMES 200000
+#define PASSES 5
+#define PAYLOAD_LEN 12
+#define QUEUE_DEPTH 4096
+#define PKT_LEN (48 + PAYLOAD_LEN)
+#define SHARD_CHECK_FRAMES 8192
+#define SHARD_CHECK_WORKERS 4
+#define UDP_RCVBUF (8 * 1024 * 1024)
+
+static uint8_t* wire;           // every frame, back to back
+static size_t wire_len;
+static uint8_t* originals;      // IPv6 packet of each frame, PKT_LEN bytes each
+static struct iovec frames[NB_FRAMES];  // each frame in wire, one datagram each
+
+static void put_be32(uint8_t* p, const uint32_t v) {
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+static int generate(void) {
+    ipv6_udp_cfg_t net = {0};
+    memcpy(net.dst_ip, schc_service_app_ip(), 16);
+    net.src_port = schc_service_dev_port();
+    net.dst_port = schc_service_app_port();
+    net.next_header = 17;
+    net.hop_limit = schc_service_hop_limit();
+
+    schc_dev_ctx_t* ctx[NB_DEVICES];
+    ipv6_udp_tpl_t tpl[NB_DEVICES];
+    for (uint32_t d = 0; d < NB_DEVICES; d++) {
+        uint8_t iid[8] = {0};
+        put_be32(iid + 4, d + 1);
+        ctx[d] = schc_service_dev_ctx_new(iid);
+        if (!ctx[d]) return -1;
+        memcpy(net.src_ip, schc_service_dev_ctx_ip(ctx[d]), 16);
+        if (ipv6_udp_tpl_init(&tpl[d], &net, schc_service_flow_label()) != 0) return -1;
+    }
+
+    wire = malloc((size_t) NB_FRAMES * (GW_WIRE_HDR_LEN + PKT_LEN));
+    originals = malloc((size_t) NB_FRAMES * PKT_LEN);
+    if (!wire || !originals) return -1;
+
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    static uint8_t storage[PKTBUF_HEADROOM + 256];
+    for (uint32_t i = 0; i < NB_FRAMES; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        const uint32_t d = (uint32_t) (rng % NB_DEVICES);
+
+        pktbuf_t pb;
+        pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+        uint8_t* payload = pktbuf_put(&pb, PAYLOAD_LEN);
+        put_be32(payload, d + 1);
+        put_be32(payload + 4, i);
+        put_be32(payload + 8, (uint32_t) (rng >> 32));
+        if (ipv6_udp_tpl_push(&tpl[d], &pb) != 0) return -1;
+        memcpy(originals + (size_t) i * PKT_LEN, pktbuf_data(&pb), PKT_LEN);
+        if (schc_service_compress_pkt_dev(ctx[d], &pb) != SCHC_OK) return -1;
+
+        uint8_t* f = wire + wire_len;
+        f[0] = (uint8_t) (pb.len >> 8);
+        f[1] = (uint8_t) pb.len;
+        f[2] = (uint8_t) (d + 1);
+        f[3] = 0xff;
+        f[4] = 0x00;
+        f[5] = 0x00;
+        f[6] = (uint8_t) i;
+        memcpy(f + GW_WIRE_HDR_LEN, pktbuf_data(&pb), pb.len);
+        frames[i].iov_base = f;
+        frames[i].iov_len = GW_WIRE_HDR_LEN + pb.len;
+        wire_len += GW_WIRE_HDR_LEN + pb.len;
+    }
+
+    for (uint32_t d = 0; d < NB_DEVICES; d++) schc_service_dev_ctx_free(ctx[d]);
+    return 0;
+}
+
+// The gateway reader loop, fed from memory
+static void feed(void) {
+    size_t off = 0, n = 0;
+    while (off < wire_len) {
+        l2_frame_meta_t meta;
+        const uint8_t* payload;
+        size_t len;
+        const long used = gw_parse_frame(wire + off, wire_len - off, &meta, &payload, &len);
+        if (used <= 0) exit(EXIT_FAILURE);
+        while (gw_submit(&meta, payload, len) == GW_FULL) sched_yield();
+        off += (size_t) used;
+        if (++n % GW_BATCH == 0) gw_kick();
+    }
+    gw_kick();
+}
+
+static int cmp_pkt(const void* a, const void* b) {
+    return memcmp(a, b, PKT_LEN);
+}
+
+// Rebuild every frame into a file and compare the packets, in any order, with the originals
+static int check_rebuilt(void) {
+    FILE* f = tmpfile();
+    if (!f) return 0;
+    const gw_config_t cfg = { 4, QUEUE_DEPTH, fileno(f), true, NULL };
+    if (gw_start(&cfg) != GW_OK) return 0;
+    feed();
+    gw_stop();
+
+    gw_stats_t st;
+    gw_get_stats(&st);
+    uint8_t* rebuilt = malloc((size_t) NB_FRAMES * PKT_LEN);
+    rewind(f);
+    const size_t got = rebuilt ? fread(rebuilt, 1, (size_t) NB_FRAMES * PKT_LEN + 1, f) : 0;
+    fclose(f);
+
+    int ok = rebuilt && st.total.packets == NB_FRAMES && st.total.failed == 0 && st.total.sent == NB_FRAMES &&
+             got == (size_t) NB_FRAMES * PKT_LEN;
+    if (ok) {
+        qsort(rebuilt, NB_FRAMES, PKT_LEN, cmp_pkt);
+        qsort(originals, NB_FRAMES, PKT_LEN, cmp_pkt);
+        ok = memcmp(rebuilt, originals, (size_t) NB_FRAMES * PKT_LEN) == 0;
+    }
+    printf("rebuilt %llu of %u packets, %llu failed, %zu bytes written: %s\n",
+           (unsigned long long) st.total.packets, NB_FRAMES, (unsigned long long) st.total.failed, got,
+           ok ? "all identical" : "MISMATCH");
+    free(rebuilt);
+    return ok;
+}
+
+static atomic_bool draining;
+
+static void* drain(void* arg) {
+    const int fd = *(const int*) arg;
+    static uint8_t bufs[GW_BATCH][GW_MAX_PACKET];
+    struct iovec iov[GW_BATCH];
+    struct mmsghdr msgs[GW_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t i = 0; i < GW_BATCH; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = sizeof(bufs[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (;;) {
+        if (recvmmsg(fd, msgs, GW_BATCH, MSG_DONTWAIT, NULL) > 0) continue;
+        if (!atomic_load(&draining)) break;
+        sched_yield();
+    }
+    return NULL;
+}
+
+static void run(const uint32_t nb_workers, const bool datagrams) {
+    int sv[2] = { -1, -1 };
+    pthread_t drainer;
+    if (datagrams) {
+        if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) != 0) exit(EXIT_FAILURE);
+        atomic_store(&draining, true);
+        pthread_create(&drainer, NULL, drain, &sv[1]);
+    }
+
+    const gw_config_t cfg = { nb_workers, QUEUE_DEPTH, sv[0], false, NULL };
+    if (gw_start(&cfg) != GW_OK) exit(EXIT_FAILURE);
+    const uint64_t t0 = monotonic_now_ns();
+    for (int p = 0; p < PASSES; p++) feed();
+    gw_stop();
+    const uint64_t elapsed = monotonic_now_ns() - t0;
+
+    if (datagrams) {
+        atomic_store(&draining, false);
+        pthread_join(drainer, NULL);
+        close(sv[0]);
+        close(sv[1]);
+    }
+
+    gw_stats_t st;
+    gw_get_stats(&st);
+    const double cpu_s = (double) st.total.cpu_ns / 1e9;
+    char name[64];
+    snprintf(name, sizeof(name), "%u worker%s, %s", nb_workers, nb_workers > 1 ? "s" : "",
+             datagrams ? "sendmmsg" : "no output");
+    printf("%-28s %10.0f frames/s %10.0f packets/s per core  %5.1f per batch  %llu failed, %llu not sent\n",
+           name, (double) st.total.frames * 1e9 / (double) elapsed,
+           cpu_s > 0 ? (double) st.total.packets / cpu_s : 0.0,
+           st.total.batches ? (double) st.total.packets / (double) st.total.batches : 0.0,
+           (unsigned long long) st.total.failed, (unsigned long long) st.total.send_failed);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Loopback UDP input                                                        */
+/* ------------------------------------------------------------------------ */
+
+typedef struct {
+    int fd;                 // connected to the gateway port
+    uint32_t nb;            // frames to send
+    bool paced;             // wait after each batch until the gateway took it
+    uint64_t sent;
+} sender_t;
+
+static atomic_bool sending;
+
+static uint64_t frames_in(void) {
+    gw_stats_t st;
+    gw_get_stats(&st);
+    return st.total.frames;
+}
+
+static void* send_frames(void* arg) {
+    sender_t* s = arg;
+    struct mmsghdr msgs[GW_BATCH];
+    for (uint32_t i = 0; i < s->nb; i += GW_BATCH) {
+        const uint32_t n = s->nb - i < GW_BATCH ? s->nb - i : GW_BATCH;
+        memset(msgs, 0, sizeof(msgs));
+        for (uint32_t j = 0; j < n; j++) {
+            msgs[j].msg_hdr.msg_iov = &frames[i + j];
+            msgs[j].msg_hdr.msg_iovlen = 1;
+        }
+        const int r = sendmmsg(s->fd, msgs, n, 0);
+        if (r > 0) s->sent += (uint64_t) r;
+        if (s->paced) {
+            while (frames_in() < s->sent) sched_yield();
+        } else {
+            sched_yield();
+        }
+    }
+    atomic_store(&sending, false);
+    return NULL;
+}
+
+// The gateway reader loop of schc-gateway for datagram input
+static void* read_frames(void* arg) {
+    const int fd = *(const int*) arg;
+    static uint8_t bufs[GW_BATCH][GW_WIRE_HDR_LEN + GW_MAX_FRAME + 1];
+    struct iovec iov[GW_BATCH];
+    struct mmsghdr msgs[GW_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t i = 0; i < GW_BATCH; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = sizeof(bufs[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (;;) {
+        const int n = recvmmsg(fd, msgs, GW_BATCH, MSG_DONTWAIT, NULL);
+        if (n <= 0) {
+            if (!atomic_load(&sending)) break;
+            sched_yield();
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            l2_frame_meta_t meta;
+            const uint8_t* payload;
+            size_t len;
+            if (!msgs[i].msg_len ||
+                gw_parse_frame(bufs[i], msgs[i].msg_len, &meta, &payload, &len) != (long) msgs[i].msg_len) {
+                continue;
+            }
+            while (gw_submit(&meta, payload, len) == GW_FULL) sched_yield();
+        }
+        gw_kick();
+    }
+    return NULL;
+}
+
+// nb_sockets sockets sharing one loopback port; the sender is connected to it
+static int open_udp(const uint32_t nb_sockets, int* fds, int* sender_fd) {
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (gw_open_shards((const struct sockaddr*) &sa, sizeof(sa), nb_sockets, fds) != 0) return -1;
+
+    socklen_t sa_len = sizeof(sa);
+    const int rcvbuf = UDP_RCVBUF;
+    for (uint32_t i = 0; i < nb_sockets; i++) {
+        // Above rmem_max only with CAP_NET_ADMIN; the plain option caps it
+        if (setsockopt(fds[i], SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) != 0) {
+            setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        }
+    }
+    *sender_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (*sender_fd == -1 || getsockname(fds[0], (struct sockaddr*) &sa, &sa_len) != 0 ||
+        connect(*sender_fd, (const struct sockaddr*) &sa, sa_len) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void close_udp(const uint32_t nb_sockets, const int* fds, const int sender_fd) {
+    for (uint32_t i = 0; i < nb_sockets; i++) close(fds[i]);
+    if (sender_fd != -1) close(sender_fd);
+}
+
+// Send nb frames to nb_workers workers, fed by a reader thread or each reading its own socket
+static uint64_t run_udp(const uint32_t nb_workers, const bool sharded, const uint32_t nb, const bool paced) {
+    int fds[4];             // up to SHARD_CHECK_WORKERS and the largest run
+    int sender_fd = -1;
+    const uint32_t nb_sockets = sharded ? nb_workers : 1;
+    if (open_udp(nb_sockets, fds, &sender_fd) != 0) {
+        perror("loopback UDP setup");
+        exit(EXIT_FAILURE);
+    }
+
+    const gw_config_t cfg = { nb_workers, QUEUE_DEPTH, -1, false, sharded ? fds : NULL };
+    if (gw_start(&cfg) != GW_OK) exit(EXIT_FAILURE);
+    sender_t sender = { sender_fd, nb, paced, 0 };
+    pthread_t sender_thread, reader_thread;
+    atomic_store(&sending, true);
+
+    const uint64_t t0 = monotonic_now_ns();
+    pthread_create(&sender_thread, NULL, send_frames, &sender);
+    if (!sharded) pthread_create(&reader_thread, NULL, read_frames, &fds[0]);
+    pthread_join(sender_thread, NULL);
+    if (!sharded) pthread_join(reader_thread, NULL);
+    gw_stop();
+    const uint64_t elapsed = monotonic_now_ns() - t0;
+    close_udp(nb_sockets, fds, sender_fd);
+
+    gw_stats_t st;
+    gw_get_stats(&st);
+    if (!paced) {
+        char name[64];
+        snprintf(name, sizeof(name), "udp, %u worker%s, %s", nb_workers, nb_workers > 1 ? "s" : "",
+                 sharded ? "sharded" : "reader");
+        printf("%-28s %10.0f frames/s %10llu sent %10llu dropped  %llu failed\n",
+               name, (double) st.total.frames * 1e9 / (double) elapsed, (unsigned long long) sender.sent,
+               (unsigned long long) (sender.sent - st.total.frames), (unsigned long long) st.total.failed);
+    }
+    return sender.sent;
+}
+
+// Every frame reaches worker (src % n), the one gw_submit() picks
+static int check_sharding(void) {
+    uint64_t expected[SHARD_CHECK_WORKERS] = {0};
+    for (uint32_t i = 0; i < SHARD_CHECK_FRAMES; i++) {
+        expected[((const uint8_t*) frames[i].iov_base)[2] % SHARD_CHECK_WORKERS]++;
+    }
+
+    const uint64_t sent = run_udp(SHARD_CHECK_WORKERS, true, SHARD_CHECK_FRAMES, true);
+    int ok = sent == SHARD_CHECK_FRAMES;
+    printf("sharding over %u sockets, %llu frames:", SHARD_CHECK_WORKERS, (unsigned long long) sent);
+    for (uint32_t i = 0; i < SHARD_CHECK_WORKERS; i++) {
+        gw_worker_stats_t w;
+        gw_get_worker_stats(i, &w);
+        ok = ok && w.frames == expected[i] && w.failed == 0;
+        printf(" %llu/%llu", (unsigned long long) w.frames, (unsigned long long) expected[i]);
+    }
+    printf(": %s\n", ok ? "each on its worker" : "MISMATCH");
+    return ok;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK || generate() != 0) {
+        fprintf(stderr, "generator setup failed\n");
+        return EXIT_FAILURE;
+    }
+    printf("%u devices, %u frames, %zu wire bytes\n", NB_DEVICES, NB_FRAMES, wire_len);
+
+    const int ok = check_rebuilt();
+
+    const uint32_t nb_workers[] = { 1, 2, 4 };
+    for (size_t i = 0; i < sizeof(nb_workers) / sizeof(nb_workers[0]); i++) {
+        run(nb_workers[i], false);
+        run(nb_workers[i], true);
+    }
+
+    // The workers only scale with the cores to run them; on one core sharding saves the handoff, no more
+    printf("%ld CPUs online\n", sysconf(_SC_NPROCESSORS_ONLN));
+    const int sharding_ok = check_sharding();
+    for (size_t i = 0; i < sizeof(nb_workers) / sizeof(nb_workers[0]); i++) {
+        run_udp(nb_workers[i], false, NB_FRAMES, false);
+        run_udp(nb_workers[i], true, NB_FRAMES, false);
+    }
+
+    free(wire);
+    free(originals);
+    logger_fini();
+    return ok && sharding_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/l2/l2.h"
+#include "schc_demo_app/l2/l2_tx.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_service.h"
+#include "schc_demo_app/services/sensor_service.h"
+
+/*
+ * End-to-end build -> compress -> L2 TX queue -> loopback link, at full rate.
+ * usage: bench-l2-loop [packets] [link spec, e.g. "bitrate=1000000,latency_ms=5,jitter_ms=1,loss=0.01"]
+ */
+
+#define DEFAULT_PACKETS 200000
+#define TX_DEPTH 256
+
+static uint64_t* latencies;
+static size_t nb_latencies;
+
+static void drain(void) {
+    static l2_loop_frame_t f;
+    while (l2_loop_recv(&f)) {
+        latencies[nb_latencies++] = f.deliver_ns - f.sent_ns;
+    }
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    const uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const double p) {
+    if (!nb_latencies) return 0.0;
+    size_t i = (size_t) (p * (double) (nb_latencies - 1) + 0.5);
+    return (double) latencies[i] / 1000.0;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_PACKETS;
+
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    l2_link_model_t link = { 0, 0, 0, 0, 1 };
+    if (argc > 2 && l2_loop_parse_link(argv[2], &link) != 0) return EXIT_FAILURE;
+    l2_loop_set_target("mem");
+    l2_loop_set_link(&link);
+    if (l2_init() != L2_INIT_OK) return EXIT_FAILURE;
+    if (l2_tx_start(TX_DEPTH, L2_TX_BLOCK, NULL, NULL) != L2_TX_OK) return EXIT_FAILURE;
+
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, schc_service_dev_ip(), 16);
+    memcpy(cfg.dst_ip, schc_service_app_ip(), 16);
+    cfg.src_port = schc_service_dev_port();
+    cfg.dst_port = schc_service_app_port();
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+    ipv6_udp_tpl_t tpl;
+    if (ipv6_udp_tpl_init(&tpl, &cfg, schc_service_flow_label()) != 0) return EXIT_FAILURE;
+
+    latencies = malloc(count * sizeof(*latencies));
+    if (!latencies) return EXIT_FAILURE;
+
+    rng_set_seed(42);
+    const uint64_t t0 = monotonic_now_ns();
+    for (size_t seq = 0; seq < count; seq++) {
+        l2_tx_frame_t* frame = l2_tx_acquire();
+        frame->meta.stamp_ns = monotonic_now_ns();
+        pktbuf_t* pb = &frame->pb;
+
+        (void) measure((sensor_data_t*) pktbuf_put(pb, sizeof(sensor_data_t)));
+        if (ipv6_udp_tpl_push(&tpl, pb) != 0 || schc_service_compress_pkt(pb) != SCHC_OK) {
+            return EXIT_FAILURE;
+        }
+
+        frame->meta.dst = 0xff;
+        frame->meta.seq = (uint32_t) seq;
+        l2_tx_commit(frame);
+        drain();
+    }
+    const uint64_t submit_ns = monotonic_now_ns() - t0;
+
+    l2_tx_stop();
+    l2_loop_fini();
+    drain();
+    const uint64_t total_ns = monotonic_now_ns() - t0;
+
+    l2_tx_stats_t tx;
+    l2_loop_stats_t st;
+    l2_tx_get_stats(&tx);
+    l2_loop_get_stats(&st);
+
+    qsort(latencies, nb_latencies, sizeof(*latencies), cmp_u64);
+
+    bench_report("pipeline submit", submit_ns, count);
+    bench_report("pipeline end to end", total_ns, count);
+    printf("link: sent %llu, lost %llu, delivered %llu, overruns %llu, %.1f B/frame\n",
+           (unsigned long long) st.sent, (unsigned long long) st.lost,
+           (unsigned long long) st.delivered, (unsigned long long) st.overruns,
+           st.delivered ? (double) st.bytes / (double) st.delivered : 0.0);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           percentile_us(0.50), percentile_us(0.90), percentile_us(0.99),
+           percentile_us(0.999), percentile_us(1.0));
+
+    free(latencies);
+    zlog_fini();
+    return tx.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/l2/l2_rx.h"
+
+/*
+ * Downlink parser throughput.
+ * A synthetic ahoi serial stream (stuffed frames, line noise between them,
+ * frames cut short by a new DLE STX) is parsed at full speed and compared
+ * with the 115200 baud line rate. The parser's correctness on such streams
+ * is checked by test/check_l2_rx.c.
+ */
+
+#define NB_FRAMES 20000
+#define ABORT_EVERY 97
+#define FOOTER_SIZE 5
+#define RING_SIZE 4096
+#define ROUNDS 20
+#define LINE_RATE_BPS (115200.0 / 10.0)    // 8N1: 10 bit times per byte
+
+static uint8_t* stream;
+static size_t stream_len;
+
+static uint32_t rng = 12345;
+static uint32_t rnd(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void put_stuffed(const uint8_t b) {
+    if (b == 0x10) stream[stream_len++] = 0x10;
+    stream[stream_len++] = b;
+}
+
+// dle_heavy: every payload byte is DLE, the worst case for stuffing
+static void build_stream(const int dle_heavy) {
+    stream_len = 0;
+
+    for (size_t i = 0; i < NB_FRAMES; i++) {
+        // Line noise, never containing DLE
+        for (uint32_t n = rnd() % 8; n; n--) stream[stream_len++] = (uint8_t) (0x20 + rnd() % 0x60);
+
+        if (i % ABORT_EVERY == ABORT_EVERY - 1) {
+            stream[stream_len++] = 0x10;
+            stream[stream_len++] = 0x02;
+            for (uint32_t n = 1 + rnd() % 20; n; n--) stream[stream_len++] = (uint8_t) (0x20 + rnd() % 0x60);
+        }
+
+        const uint8_t len = (uint8_t) (rnd() % 129);
+        const size_t footer_len = i % 2 ? FOOTER_SIZE : 0;
+        const uint8_t hdr[L2_RX_HDR_SIZE] = {
+            (uint8_t) rnd(), (uint8_t) (i % 3 ? rnd() : 0x10), (uint8_t) rnd(), (uint8_t) rnd(), (uint8_t) i, len
+        };
+
+        stream[stream_len++] = 0x10;
+        stream[stream_len++] = 0x02;
+        for (size_t k = 0; k < L2_RX_HDR_SIZE; k++) put_stuffed(hdr[k]);
+        for (size_t k = 0; k < len + footer_len; k++) {
+            put_stuffed(dle_heavy ? 0x10 : (uint8_t) (rnd() % 4 ? rnd() : 0x10));
+        }
+        stream[stream_len++] = 0x10;
+        stream[stream_len++] = 0x03;
+    }
+}
+
+static uint64_t sink_sum;
+static void count_frame(const l2_rx_frame_t* f, void* ctx) {
+    (void) ctx;
+    sink_sum += f->len + f->payload[0];
+}
+
+static int throughput(const char* name) {
+    if (l2_rx_init(RING_SIZE, count_frame, NULL) != L2_RX_OK) return -1;
+
+    const uint64_t t0 = monotonic_now_ns();
+    for (int r = 0; r < ROUNDS; r++) l2_rx_feed(stream, stream_len);
+    const uint64_t ns = monotonic_now_ns() - t0;
+
+    l2_rx_stats_t st;
+    l2_rx_get_stats(&st);
+    l2_rx_fini();
+
+    bench_report(name, ns, st.frames);
+    const double bytes_per_s = (double) st.bytes * 1e9 / (double) ns;
+    printf("  %.1f MB/s, %.0fx the 115200 baud line rate\n", bytes_per_s / 1e6, bytes_per_s / LINE_RATE_BPS);
+    return st.frames == (uint64_t) ROUNDS * NB_FRAMES ? 0 : -1;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+
+    stream = malloc((size_t) NB_FRAMES * (2 * (L2_RX_HDR_SIZE + 255 + FOOTER_SIZE) + 64));
+    if (!stream) return EXIT_FAILURE;
+
+    int rc = EXIT_SUCCESS;
+
+    build_stream(0);
+    printf("random payloads, 25%% DLE bytes\n");
+    if (throughput("parse (per frame)") != 0) rc = EXIT_FAILURE;
+
+    build_stream(1);
+    printf("DLE-only payloads\n");
+    if (throughput("parse (per frame)") != 0) rc = EXIT_FAILURE;
+
+    printf("(checksum %llu)\n", (unsigned long long) sink_sum);
+    free(stream);
+    zlog_fini();
+    return rc;
+}
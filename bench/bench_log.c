@@ -0,0 +1,165 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/async_log.h"
+#include "schc_demo_app/logger_helper.h"
+
+/*
+ * Per-call cost of a packet path log message, zlog directly vs the async log,
+ * on one thread and on several. The async calls are timed in bursts that the
+ * writer drains during the pause that follows (the threads share one burst),
+ * so that they measure enqueueing and not dropping.
+ * Then checks that the writer's text matches snprintf, that a flood is
+ * accounted for (written + dropped + direct == calls) and that alog_fini()
+ * leaves nothing queued.
+ * Run with stderr redirected: both variants end up in zlog's output.
+ */
+
+#define LOG_DEPTH 1024
+#define BURST 512
+#define NB_BURSTS 200
+#define NB_THREADS 4
+#define FLOOD 100000
+
+static uint64_t nb_emitted = 0;
+
+static void pause_for_writer(void) {
+    const struct timespec ts = { 0, 3000000 };
+    nanosleep(&ts, NULL);
+}
+
+static uint64_t direct_calls(const uint32_t nb, const uint32_t burst) {
+    uint64_t elapsed = 0;
+    for (uint32_t b = 0; b < nb / burst; b++) {
+        const uint64_t t0 = monotonic_now_ns();
+        for (uint32_t i = 0; i < burst; i++) {
+            zlog_info(ok_cat, "Packet %u sent in %llu fragments (%llu retransmitted)", i, 3ull, 0ull);
+        }
+        elapsed += monotonic_now_ns() - t0;
+    }
+    return elapsed;
+}
+
+static uint64_t async_calls(const uint32_t nb, const uint32_t burst) {
+    uint64_t elapsed = 0;
+    for (uint32_t b = 0; b < nb / burst; b++) {
+        const uint64_t t0 = monotonic_now_ns();
+        for (uint32_t i = 0; i < burst; i++) {
+            ALOG_INFO(ok_cat, "Packet %u sent in %llu fragments (%llu retransmitted)", i, 3ull, 0ull);
+        }
+        elapsed += monotonic_now_ns() - t0;
+        pause_for_writer();
+    }
+    return elapsed;
+}
+
+typedef struct {
+    bool async;
+    uint64_t elapsed_ns;
+} worker_arg_t;
+
+static void* worker(void* arg) {
+    worker_arg_t* w = arg;
+    const uint32_t burst = BURST / NB_THREADS;
+    w->elapsed_ns = w->async ? async_calls(burst * NB_BURSTS, burst) : direct_calls(burst * NB_BURSTS, burst);
+    return NULL;
+}
+
+static void run_threads(const char* name, const bool async) {
+    pthread_t th[NB_THREADS];
+    worker_arg_t args[NB_THREADS];
+    for (size_t t = 0; t < NB_THREADS; t++) {
+        args[t] = (worker_arg_t) { async, 0 };
+        pthread_create(&th[t], NULL, worker, &args[t]);
+    }
+    uint64_t elapsed = 0;
+    for (size_t t = 0; t < NB_THREADS; t++) {
+        pthread_join(th[t], NULL);
+        elapsed += args[t].elapsed_ns;
+    }
+    if (async) nb_emitted += BURST * NB_BURSTS;
+    bench_report(name, elapsed, BURST * NB_BURSTS);
+}
+
+static int same_text(const char* fmt, const char* got, const char* want) {
+    if (strcmp(got, want) == 0) return 1;
+    printf("format \"%s\": got \"%s\", want \"%s\"\n", fmt, got, want);
+    return 0;
+}
+
+#define CHECK_FORMAT(...)                                                                  \
+    do {                                                                                   \
+        static const alog_site_t site_ = {                                                 \
+            &ok_cat, ZLOG_LEVEL_INFO, ALOG_FMT(__VA_ARGS__, 0), __FILE__, __func__, __LINE__ \
+        };                                                                                 \
+        char got_[256], want_[256];                                                        \
+        alog_format(&site_, ALOG_CAT(ALOG_PACK_, ALOG_NARGS(__VA_ARGS__))(__VA_ARGS__),    \
+                    got_, sizeof(got_));                                                   \
+        snprintf(want_, sizeof(want_), __VA_ARGS__);                                       \
+        ok &= same_text(site_.fmt, got_, want_);                                           \
+    } while (0)
+
+static int check_formats(void) {
+    int ok = 1;
+    const char* name = "l2-loop";
+    const size_t len = 1234;
+    const unsigned seq = 4000000000u;
+    CHECK_FORMAT("Sensing data...");
+    CHECK_FORMAT("Packet %u sent in %llu fragments (%llu retransmitted)", seq, 12ull, 1ull);
+    CHECK_FORMAT("Fragmenting packet %u (%zu bytes)", seq, len);
+    CHECK_FORMAT("SCHC compress failed: %d", -3);
+    CHECK_FORMAT("%5d|%-5d|%05d|%+d", 42, 42, -42, 7);
+    CHECK_FORMAT("%x %X %#x %o", 0xBEEFu, 0xBEEFu, 255u, 8u);
+    CHECK_FORMAT("%.1f %8.3f %e %g", 21.25, -3.14159, 1e-7, 0.5f);
+    CHECK_FORMAT("%s on %s, %c, 100%%", name, "port", 'x');
+    CHECK_FORMAT("%-12s|%.3s|%hu %ld %lld", name, name, (unsigned short) 65535, -5L, -9000000000ll);
+    CHECK_FORMAT("Downlink frame from %u to %u, type %u, seq %u, %zu bytes",
+                 (uint8_t) 3, (uint8_t) 255, (uint8_t) 0x7C, (uint8_t) 9, len);
+    return ok;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+
+    int ok = check_formats();
+
+    // Not started yet: logged synchronously
+    for (int i = 0; i < 10; i++) ALOG_INFO(ok_cat, "Before init %d", i);
+    nb_emitted += 10;
+
+    if (alog_init(LOG_DEPTH) != ALOG_INIT_OK) return EXIT_FAILURE;
+
+    bench_report("zlog_info, 1 thread", direct_calls(BURST * NB_BURSTS, BURST), BURST * NB_BURSTS);
+    bench_report("ALOG_INFO, 1 thread", async_calls(BURST * NB_BURSTS, BURST), BURST * NB_BURSTS);
+    nb_emitted += BURST * NB_BURSTS;
+    run_threads("zlog_info, 4 threads", false);
+    run_threads("ALOG_INFO, 4 threads", true);
+
+    alog_stats_t st;
+    alog_get_stats(&st);
+    printf("timed runs: %llu records dropped\n", (unsigned long long) st.dropped);
+
+    // Far more than a ring holds, without a pause: the excess is dropped and counted
+    uint64_t t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < FLOOD; i++) ALOG_INFO(ok_cat, "Flood %u", i);
+    bench_report("ALOG_INFO, ring full", monotonic_now_ns() - t0, FLOOD);
+    nb_emitted += FLOOD;
+
+    alog_fini();
+    for (int i = 0; i < 10; i++) ALOG_INFO(ok_cat, "After fini %d", i);
+    nb_emitted += 10;
+
+    alog_get_stats(&st);
+    printf("calls %llu: written %llu, dropped %llu, direct %llu\n", (unsigned long long) nb_emitted,
+           (unsigned long long) st.written, (unsigned long long) st.dropped, (unsigned long long) st.direct);
+    ok &= st.written + st.dropped + st.direct == nb_emitted && st.dropped > 0 && st.direct == 20;
+
+    printf("%s\n", ok ? "async log: OK" : "async log: MISMATCH");
+    logger_fini();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,373 @@
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/l2/l2.h"
+#include "schc_demo_app/l2/l2_rx.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_service.h"
+#include "schc_demo_app/services/sensor_codec.h"
+#include "schc_demo_app/services/sensor_service.h"
+
+/*
+ * Per-stage and end-to-end cost of the uplink pipeline:
+ * measure -> codec -> IPv6/UDP -> SCHC -> L2, plus the downlink deframer.
+ * Every stage runs on its own over a fixed set of inputs, then the whole
+ * chain runs the way sense_and_send() does it. Inputs come from fixed seeds,
+ * so two runs process the same bytes. Each figure is the median of RUNS runs.
+ *
+ * usage: bench-pipeline [packets] [--json <file>]
+ */
+
+#define DEFAULT_PACKETS 200000
+#define RUNS 5
+#define SEED 42
+#define NB_INPUTS 1024      // power of two, small enough to stay in cache
+#define PKT_CAP 256
+#define RX_RING_SIZE 4096
+#define MAX_STAGES 16
+#define L2_BURST 512        // frames in flight on the loop link, below its delay line depth
+
+typedef struct {
+    const char* name;
+    double bytes;           // bytes the stage reads per packet
+    double ns;              // per packet
+    double cycles;          // per packet, 0 without a cycle counter
+} stage_result_t;
+
+// Runs the stage n times and returns the number of bytes it processed, 0 on failure
+typedef size_t (*stage_fn)(size_t n);
+
+static stage_result_t results[MAX_STAGES];
+static size_t nb_results;
+
+static ipv6_udp_cfg_t cfg;
+static ipv6_udp_tpl_t tpl;
+
+static sensor_data_t samples[NB_INPUTS];
+static uint8_t payloads[NB_INPUTS][SENSOR_CODEC_SIZE(1)];
+static uint8_t packets[NB_INPUTS][PKT_CAP];
+static size_t packet_lens[NB_INPUTS];
+static uint8_t compressed[NB_INPUTS][PKT_CAP];
+static size_t compressed_lens[NB_INPUTS];
+static uint8_t* rx_stream;              // NB_INPUTS stuffed ahoi frames back to back
+static size_t rx_offsets[NB_INPUTS + 1];
+
+static volatile uint64_t sink;
+static uint64_t rx_frames;
+static uint64_t l2_sent;
+static uint64_t l2_delivered;
+
+static void drain(void) {
+    static l2_loop_frame_t f;
+    while (l2_loop_recv(&f)) {
+        sink += f.len;
+        l2_delivered++;
+    }
+}
+
+// Count each sent frame; every L2_BURST frames, let the delivery thread catch up so none is dropped
+static void l2_sent_one(void) {
+    if (++l2_sent % L2_BURST) return;
+    for (drain(); l2_delivered != l2_sent; drain()) sched_yield();
+}
+
+static void count_frame(const l2_rx_frame_t* f, void* ctx) {
+    (void) ctx;
+    rx_frames++;
+    sink += f->len;
+}
+
+static size_t stage_measure(const size_t n) {
+    rng_set_seed(SEED);
+    for (size_t i = 0; i < n; i++) {
+        if (measure(&samples[i % NB_INPUTS]) != measure_status_ok) return 0;
+    }
+    return n * sizeof(sensor_data_t);
+}
+
+static size_t stage_encode(const size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const size_t k = i % NB_INPUTS;
+        if (!sensor_codec_encode(&samples[k], 1, payloads[k], sizeof(payloads[k]))) return 0;
+    }
+    return n * sizeof(sensor_data_t);
+}
+
+static size_t stage_build(const size_t n) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        const size_t k = i % NB_INPUTS;
+        if (build_ipv6_udp_packet(&cfg, schc_service_flow_label(), payloads[k], sizeof(payloads[k]),
+                                  packets[k], PKT_CAP, &packet_lens[k]) != 0) {
+            return 0;
+        }
+        bytes += packet_lens[k];
+    }
+    return bytes;
+}
+
+static size_t stage_tpl_push(const size_t n) {
+    static uint8_t storage[PKT_CAP];
+    pktbuf_t pb;
+    pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        pktbuf_reset(&pb, PKTBUF_HEADROOM);
+        memcpy(pktbuf_put(&pb, sizeof(payloads[0])), payloads[i % NB_INPUTS], sizeof(payloads[0]));
+        if (ipv6_udp_tpl_push(&tpl, &pb) != 0) return 0;
+        bytes += pb.len;
+    }
+    return bytes;
+}
+
+static size_t stage_checksum(const size_t n) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        const size_t k = i % NB_INPUTS;
+        sink += ipv6_udp_checksum(packets[k], packet_lens[k]);
+        bytes += packet_lens[k];
+    }
+    return bytes;
+}
+
+static size_t stage_compress(const size_t n) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        const size_t k = i % NB_INPUTS;
+        if (schc_service_compress(packets[k], packet_lens[k], compressed[k], PKT_CAP,
+                                  &compressed_lens[k]) != SCHC_OK) {
+            return 0;
+        }
+        bytes += packet_lens[k];
+    }
+    return bytes;
+}
+
+static size_t stage_l2_xmit(const size_t n) {
+    static uint8_t storage[PKT_CAP];
+    pktbuf_t pb;
+    l2_frame_meta_t meta = { .dst = 0xff };
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        const size_t k = i % NB_INPUTS;
+        // The loop backend only reads pb, no need to rebuild it
+        pktbuf_init(&pb, storage, sizeof(storage), 0);
+        memcpy(pktbuf_put(&pb, compressed_lens[k]), compressed[k], compressed_lens[k]);
+        meta.seq = (uint32_t) i;
+        if (l2_xmit(&meta, &pb) != L2_SEND_OK) return 0;
+        l2_sent_one();
+        bytes += compressed_lens[k];
+    }
+    return bytes;
+}
+
+static size_t stage_l2_rx(const size_t n) {
+    const uint64_t before = rx_frames;
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        const size_t k = i % NB_INPUTS;
+        const size_t len = rx_offsets[k + 1] - rx_offsets[k];
+        if (l2_rx_feed(rx_stream + rx_offsets[k], len) != len) return 0;
+        bytes += len;
+    }
+    return rx_frames - before == n ? bytes : 0;
+}
+
+static size_t stage_end_to_end(const size_t n) {
+    static uint8_t storage[PKT_CAP];
+    pktbuf_t pb;
+    pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+    l2_frame_meta_t meta = { .dst = 0xff };
+    size_t bytes = 0;
+    rng_set_seed(SEED);
+    for (size_t i = 0; i < n; i++) {
+        pktbuf_reset(&pb, PKTBUF_HEADROOM);
+        meta.seq = (uint32_t) i;
+        meta.stamp_ns = monotonic_now_ns();
+
+        sensor_data_t sample;
+        (void) measure(&sample);
+        sensor_codec_encode(&sample, 1, pktbuf_put(&pb, SENSOR_CODEC_SIZE(1)), SENSOR_CODEC_SIZE(1));
+        if (ipv6_udp_tpl_push(&tpl, &pb) != 0) return 0;
+        bytes += pb.len;
+        if (schc_service_compress_pkt(&pb) != SCHC_OK || l2_xmit(&meta, &pb) != L2_SEND_OK) return 0;
+        l2_sent_one();
+    }
+    return bytes;
+}
+
+static int cmp_ns(const void* a, const void* b) {
+    const double x = ((const stage_result_t*) a)->ns, y = ((const stage_result_t*) b)->ns;
+    return x < y ? -1 : x > y;
+}
+
+static int run_stage(const char* name, const stage_fn fn, const size_t n) {
+    stage_result_t runs[RUNS];
+
+    // Warm up caches and branch predictors on a tenth of the work
+    if (!fn(n / 10 + 1)) return -1;
+
+    for (size_t r = 0; r < RUNS; r++) {
+        const uint64_t c0 = bench_cycles();
+        const uint64_t t0 = monotonic_now_ns();
+        const size_t bytes = fn(n);
+        const uint64_t elapsed_ns = monotonic_now_ns() - t0;
+        const uint64_t elapsed_cycles = bench_cycles() - c0;
+        if (!bytes) {
+            fprintf(stderr, "%s failed\n", name);
+            return -1;
+        }
+        runs[r].bytes = (double) bytes / (double) n;
+        runs[r].ns = (double) elapsed_ns / (double) n;
+        runs[r].cycles = (double) elapsed_cycles / (double) n;
+    }
+    qsort(runs, RUNS, sizeof(runs[0]), cmp_ns);
+
+    stage_result_t* res = &results[nb_results++];
+    *res = runs[RUNS / 2];
+    res->name = name;
+    if (BENCH_HAVE_CYCLES) {
+        printf("%-24s %10.1f ns/pkt %12.0f pkt/s %8.1f B/pkt %8.2f cycles/B\n",
+               name, res->ns, 1e9 / res->ns, res->bytes, res->cycles / res->bytes);
+    } else {
+        printf("%-24s %10.1f ns/pkt %12.0f pkt/s %8.1f B/pkt\n", name, res->ns, 1e9 / res->ns, res->bytes);
+    }
+    return 0;
+}
+
+static void put_stuffed(uint8_t* out, size_t* len, const uint8_t b) {
+    if (b == 0x10) out[(*len)++] = 0x10;
+    out[(*len)++] = b;
+}
+
+// Inputs for the stages that do not produce their own: a first pass of the pipeline
+static int prepare_inputs(void) {
+    if (!stage_measure(NB_INPUTS) || !stage_encode(NB_INPUTS) || !stage_build(NB_INPUTS) ||
+        !stage_compress(NB_INPUTS)) {
+        return -1;
+    }
+
+    // The template path must produce the packets the builder does
+    uint8_t pkt[PKT_CAP];
+    size_t pkt_len;
+    for (size_t k = 0; k < NB_INPUTS; k++) {
+        if (ipv6_udp_tpl_build(&tpl, payloads[k], sizeof(payloads[k]), pkt, sizeof(pkt), &pkt_len) != 0 ||
+            pkt_len != packet_lens[k] || memcmp(pkt, packets[k], pkt_len) != 0) {
+            fprintf(stderr, "template and builder disagree on packet %zu\n", k);
+            return -1;
+        }
+    }
+
+    // Downlink frames carrying the compressed packets, as the modem would send them
+    rx_stream = malloc(NB_INPUTS * 2 * (4 + L2_RX_HDR_SIZE + PKT_CAP));
+    if (!rx_stream) return -1;
+    size_t len = 0;
+    for (size_t k = 0; k < NB_INPUTS; k++) {
+        rx_offsets[k] = len;
+        const uint8_t hdr[L2_RX_HDR_SIZE] = { 0x01, 0xff, 0x00, 0x00, (uint8_t) k, (uint8_t) compressed_lens[k] };
+        rx_stream[len++] = 0x10;
+        rx_stream[len++] = 0x02;
+        for (size_t i = 0; i < L2_RX_HDR_SIZE; i++) put_stuffed(rx_stream, &len, hdr[i]);
+        for (size_t i = 0; i < compressed_lens[k]; i++) put_stuffed(rx_stream, &len, compressed[k][i]);
+        rx_stream[len++] = 0x10;
+        rx_stream[len++] = 0x03;
+    }
+    rx_offsets[NB_INPUTS] = len;
+    return 0;
+}
+
+static void json_stage(FILE* f, const stage_result_t* r, const int last) {
+    fprintf(f, "    {\"name\": \"%s\", \"bytes_per_packet\": %.1f, \"ns_per_packet\": %.2f, "
+               "\"packets_per_s\": %.0f, ", r->name, r->bytes, r->ns, 1e9 / r->ns);
+    if (BENCH_HAVE_CYCLES) {
+        fprintf(f, "\"cycles_per_packet\": %.1f, \"cycles_per_byte\": %.3f}", r->cycles, r->cycles / r->bytes);
+    } else {
+        fprintf(f, "\"cycles_per_packet\": null, \"cycles_per_byte\": null}");
+    }
+    fprintf(f, "%s\n", last ? "" : ",");
+}
+
+static int write_json(const char* path, const size_t count) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "%s: cannot write\n", path);
+        return -1;
+    }
+    fprintf(f, "{\n  \"bench\": \"pipeline\",\n  \"packets\": %zu,\n  \"runs\": %d,\n  \"seed\": %d,\n",
+            count, RUNS, SEED);
+    fprintf(f, "  \"cycle_counter\": %s,\n", BENCH_HAVE_CYCLES ? "\"tsc\"" : "null");
+#ifdef __VERSION__
+    fprintf(f, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    fprintf(f, "  \"stages\": [\n");
+    for (size_t i = 0; i < nb_results; i++) json_stage(f, &results[i], i + 1 == nb_results);
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = DEFAULT_PACKETS;
+    const char* json_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            count = strtoul(argv[i], NULL, 10);
+        }
+    }
+    if (!count) {
+        fprintf(stderr, "Usage: %s [packets] [--json <file>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    // Ideal link: the L2 stage measures framing and hand-off, not air time
+    const l2_link_model_t link = { 0, 0, 0, 0, SEED };
+    l2_loop_set_target("mem");
+    l2_loop_set_link(&link);
+    if (l2_init() != L2_INIT_OK) return EXIT_FAILURE;
+    if (l2_rx_init(RX_RING_SIZE, count_frame, NULL) != L2_RX_OK) return EXIT_FAILURE;
+
+    memcpy(cfg.src_ip, schc_service_dev_ip(), 16);
+    memcpy(cfg.dst_ip, schc_service_app_ip(), 16);
+    cfg.src_port = schc_service_dev_port();
+    cfg.dst_port = schc_service_app_port();
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+    if (ipv6_udp_tpl_init(&tpl, &cfg, schc_service_flow_label()) != 0) return EXIT_FAILURE;
+    if (prepare_inputs() != 0) return EXIT_FAILURE;
+
+    int rc = run_stage("measure", stage_measure, count) ||
+                   run_stage("sensor_codec_encode", stage_encode, count) ||
+                   run_stage("build_ipv6_udp_packet", stage_build, count) ||
+                   run_stage("ipv6_udp_tpl_push", stage_tpl_push, count) ||
+                   run_stage("ipv6_udp_checksum", stage_checksum, count) ||
+                   run_stage("schc_service_compress", stage_compress, count) ||
+                   run_stage("l2_xmit (loop)", stage_l2_xmit, count) ||
+                   run_stage("l2_rx_feed", stage_l2_rx, count) ||
+                   run_stage("end to end", stage_end_to_end, count);
+
+    l2_rx_fini();
+    l2_loop_fini();
+    drain();
+
+    l2_loop_stats_t st;
+    l2_loop_get_stats(&st);
+    if (!rc && (st.overruns || l2_delivered != l2_sent)) {
+        fprintf(stderr, "loop link: %llu sent, %llu delivered, %llu overruns\n", (unsigned long long) l2_sent,
+                (unsigned long long) l2_delivered, (unsigned long long) st.overruns);
+        rc = -1;
+    }
+    free(rx_stream);
+    zlog_fini();
+
+    if (rc) return EXIT_FAILURE;
+    if (json_path && write_json(json_path, count) != 0) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
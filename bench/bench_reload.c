@@ -0,0 +1,249 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <schc_sdk/schccomp.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_rule_engine.h"
+#include "schc_demo_app/services/schc_service.h"
+
+/*
+ * Rule reloads under load.
+ * Two rule sets cover the same NB_RULES flows: A matches every field and
+ * uses rule IDs from 30, B sends the device port as residue and uses rule
+ * IDs from 160. Both are saved as rule images. COMPRESSORS threads
+ * compress the packets in a loop with schc_service_compress() and
+ * schc_service_compress_pkt() while the main thread swaps A and B in as
+ * fast as it can, alternating schc_service_reload_rules() with an image
+ * and schc_service_set_rules(). Every output must be exactly what A or B
+ * alone produce for that packet; anything else means a compressor saw a
+ * half-built or freed set. Compression throughput is measured with and
+ * without the reloads.
+ */
+
+#define NB_RULES 64
+#define NB_FIELDS 14
+#define NB_PACKETS 1024
+#define PKT_CAP 128
+#define COMPRESSORS 4
+#define RUN_MS 2000
+#define DEFAULT_RULE_ID 150
+
+static const uint8_t ipv6_version = 0x60;
+static const uint8_t ipv6_tc = 0;
+static const uint8_t ipv6_fl[] = {0, 0, 0};
+static const uint8_t ipv6_nh = 17;
+static const uint8_t ipv6_hl = 255;
+
+static uint8_t dev_ips[NB_RULES][16];
+static uint8_t app_ips[NB_RULES][16];
+static uint8_t dev_ports[NB_RULES][2];
+static uint8_t app_ports[NB_RULES][2];
+static schc_field_desc_t fields[2][NB_RULES][NB_FIELDS];
+static schc_rule_desc_t rules[2][NB_RULES];
+
+static uint8_t packets[NB_PACKETS][PKT_CAP];
+static size_t packet_lens[NB_PACKETS];
+static uint8_t expected[2][NB_PACKETS][PKT_CAP];
+static size_t expected_lens[2][NB_PACKETS];
+
+static atomic_bool stop = false;
+static _Atomic uint64_t mismatches = 0;
+
+typedef struct {
+    pthread_t thread;
+    size_t first;           /* packet the thread starts at */
+    uint64_t packets;
+    uint64_t ns;
+    uint64_t seen[2];
+} compressor_t;
+
+static void make_rules(const size_t set) {
+    for (size_t i = 0; i < NB_RULES; i++) {
+        memcpy(dev_ips[i], schc_service_dev_ip(), 16);
+        dev_ips[i][15] = (uint8_t) (i + 1);
+        memcpy(app_ips[i], schc_service_app_ip(), 16);
+        app_ips[i][15] = (uint8_t) (2 + i % 8);
+        const uint16_t aport = (uint16_t) (schc_service_app_port() + i % 16);
+        dev_ports[i][0] = (uint8_t) (schc_service_dev_port() >> 8);
+        dev_ports[i][1] = (uint8_t) schc_service_dev_port();
+        app_ports[i][0] = (uint8_t) (aport >> 8);
+        app_ports[i][1] = (uint8_t) aport;
+
+        const schc_field_desc_t f[NB_FIELDS] = {
+            { FID_IPV6_VERSION,        4,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_version, 0 },
+            { FID_IPV6_TRAFFIC_CLASS,  8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_tc, 0 },
+            { FID_IPV6_FLOW_LABEL,     20, MO_IGNORE, CDA_NOT_SENT,         ipv6_fl, 0 },
+            { FID_IPV6_PAYLOAD_LENGTH, 16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+            { FID_IPV6_NEXT_HEADER,    8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_nh, 0 },
+            { FID_IPV6_HOP_LIMIT,      8,  MO_IGNORE, CDA_NOT_SENT,         &ipv6_hl, 0 },
+            { FID_IPV6_PREFIX_DEV,     64, MO_EQUAL,  CDA_NOT_SENT,         dev_ips[i], 0 },
+            { FID_IPV6_IID_DEV,        64, MO_EQUAL,  CDA_NOT_SENT,         dev_ips[i] + 8, 0 },
+            { FID_IPV6_PREFIX_APP,     64, MO_EQUAL,  CDA_NOT_SENT,         app_ips[i], 0 },
+            { FID_IPV6_IID_APP,        64, MO_EQUAL,  CDA_NOT_SENT,         app_ips[i] + 8, 0 },
+            set ? (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 }
+                : (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_EQUAL, CDA_NOT_SENT, dev_ports[i], 0 },
+            { FID_UDP_PORT_APP,        16, MO_EQUAL,  CDA_NOT_SENT,         app_ports[i], 0 },
+            { FID_UDP_LENGTH,          16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+            { FID_UDP_CHECKSUM,        16, MO_IGNORE, CDA_COMPUTE_CHECKSUM, NULL, 0 },
+        };
+        memcpy(fields[set][i], f, sizeof(f));
+        rules[set][i] = (schc_rule_desc_t){ (uint16_t) ((set ? 160 : 30) + i), NB_FIELDS, fields[set][i] };
+    }
+}
+
+static void make_packets(void) {
+    for (size_t p = 0; p < NB_PACKETS; p++) {
+        const size_t i = p * 37 % NB_RULES;
+        ipv6_udp_cfg_t cfg = {0};
+        memcpy(cfg.src_ip, dev_ips[i], 16);
+        memcpy(cfg.dst_ip, app_ips[i], 16);
+        cfg.src_port = (uint16_t) (dev_ports[i][0] << 8 | dev_ports[i][1]);
+        cfg.dst_port = (uint16_t) (app_ports[i][0] << 8 | app_ports[i][1]);
+        cfg.next_header = 17;
+        cfg.hop_limit = 255;
+        // One packet in eight is from an unknown device: the no-compression rule, same in A and B
+        if (p % 8 == 7) cfg.src_ip[8] ^= 0x40;
+        const uint8_t payload[6] = { (uint8_t) p, (uint8_t) (p >> 8), 1, 2, 3, 4 };
+        if (build_ipv6_udp_packet(&cfg, 0, payload, sizeof(payload), packets[p], PKT_CAP, &packet_lens[p]) != 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static int matches(const size_t p, const uint8_t* out, const size_t len, compressor_t* c) {
+    for (size_t s = 0; s < 2; s++) {
+        if (len == expected_lens[s][p] && memcmp(out, expected[s][p], len) == 0) {
+            c->seen[s]++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* compressor(void* arg) {
+    compressor_t* c = arg;
+    uint8_t out[PKT_CAP];
+    uint8_t storage[PKTBUF_HEADROOM + PKT_CAP];
+    size_t p = c->first;
+
+    const uint64_t t0 = monotonic_now_ns();
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        for (int k = 0; k < 64; k++, p = (p + 1) % NB_PACKETS) {
+            size_t len;
+            if (k & 1) {
+                pktbuf_t pb;
+                pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+                memcpy(pktbuf_put(&pb, packet_lens[p]), packets[p], packet_lens[p]);
+                if (schc_service_compress_pkt(&pb) != SCHC_OK || !matches(p, pktbuf_data(&pb), pb.len, c)) {
+                    atomic_fetch_add(&mismatches, 1);
+                }
+            } else if (schc_service_compress(packets[p], packet_lens[p], out, sizeof(out), &len) != SCHC_OK ||
+                       !matches(p, out, len, c)) {
+                atomic_fetch_add(&mismatches, 1);
+            }
+            c->packets++;
+        }
+    }
+    c->ns = monotonic_now_ns() - t0;
+    return NULL;
+}
+
+/* Runs the compressors for RUN_MS while the main thread reloads or not; returns packets/s, all threads */
+static double run(const char* images[2], const int reload, uint64_t* reloads, compressor_t cs[COMPRESSORS]) {
+    atomic_store(&stop, false);
+    memset(cs, 0, COMPRESSORS * sizeof(*cs));
+    for (size_t t = 0; t < COMPRESSORS; t++) {
+        cs[t].first = t * NB_PACKETS / COMPRESSORS;
+        if (pthread_create(&cs[t].thread, NULL, compressor, &cs[t]) != 0) exit(EXIT_FAILURE);
+    }
+
+    *reloads = 0;
+    const uint64_t end = monotonic_now_ns() + RUN_MS * 1000000ull;
+    while (monotonic_now_ns() < end) {
+        if (!reload) {
+            usleep(1000);
+            continue;
+        }
+        const size_t s = *reloads & 1;
+        const schc_status_t st = *reloads & 2
+                                 ? schc_service_set_rules(rules[s], NB_RULES, 8, DEFAULT_RULE_ID)
+                                 : schc_service_reload_rules(images[s]);
+        if (st != SCHC_OK) exit(EXIT_FAILURE);
+        ++*reloads;
+    }
+    atomic_store(&stop, true);
+
+    uint64_t packets = 0, ns = 0;
+    for (size_t t = 0; t < COMPRESSORS; t++) {
+        pthread_join(cs[t].thread, NULL);
+        packets += cs[t].packets;
+        if (cs[t].ns > ns) ns = cs[t].ns;
+    }
+    return (double) packets * 1e9 / (double) ns;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    char image_a[] = "/tmp/bench-reload-a-XXXXXX";
+    char image_b[] = "/tmp/bench-reload-b-XXXXXX";
+    const int fa = mkstemp(image_a), fb = mkstemp(image_b);
+    if (fa < 0 || fb < 0) return EXIT_FAILURE;
+    close(fa);
+    close(fb);
+    const char* images[2] = { image_a, image_b };
+
+    make_rules(0);
+    make_packets();
+    make_rules(1);
+    for (size_t s = 0; s < 2; s++) {
+        schc_engine_t eng;
+        if (schc_engine_compile(&eng, rules[s], NB_RULES, 8, DEFAULT_RULE_ID) != SCHC_ENGINE_OK ||
+            schc_engine_save(&eng, images[s]) != SCHC_ENGINE_OK) {
+            return EXIT_FAILURE;
+        }
+        schc_engine_free(&eng);
+
+        // Reference outputs, one set at a time
+        if (schc_service_reload_rules(images[s]) != SCHC_OK) return EXIT_FAILURE;
+        for (size_t p = 0; p < NB_PACKETS; p++) {
+            if (schc_service_compress(packets[p], packet_lens[p], expected[s][p], PKT_CAP,
+                                      &expected_lens[s][p]) != SCHC_OK) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    compressor_t cs[COMPRESSORS];
+    uint64_t reloads;
+    const double quiet_rate = run(images, 0, &reloads, cs);
+    const double busy_rate = run(images, 1, &reloads, cs);
+    uint64_t seen[2] = {0, 0};
+    for (size_t t = 0; t < COMPRESSORS; t++) {
+        seen[0] += cs[t].seen[0];
+        seen[1] += cs[t].seen[1];
+    }
+
+    printf("%d compressor threads, %d rules, %d ms per run\n", COMPRESSORS, NB_RULES, RUN_MS);
+    printf("compress without reloads:   %8.2f Mpackets/s\n", quiet_rate / 1e6);
+    printf("compress during reloads:    %8.2f Mpackets/s\n", busy_rate / 1e6);
+    printf("reloads:                    %8llu (%.1f us each)\n", (unsigned long long) reloads,
+           (double) RUN_MS * 1000.0 / (double) reloads);
+    printf("outputs from set A / set B: %llu / %llu\n", (unsigned long long) seen[0], (unsigned long long) seen[1]);
+
+    schc_service_set_rule_file(NULL);
+    unlink(image_a);
+    unlink(image_b);
+    const uint64_t bad = atomic_load(&mismatches);
+    printf("packets matching neither set: %llu\n", (unsigned long long) bad);
+    zlog_fini();
+    return bad || !seen[0] || !seen[1] ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/rng.h"
+#include "schc_demo_app/utils.h"
+#include "schc_demo_app/services/sensor_service.h"
+
+/*
+ * Random numbers: cost per draw of rng.h against the rand()-based code it
+ * replaced, kept below as reference, on one thread and on THREADS threads
+ * at once. The statistical checks are in test/check_rng.c.
+ */
+
+#define FILL_BLOCK 1024
+#define ROUNDS (1u << 23)
+#define THREADS 4
+
+/* ------------------------------------------------------------------------ */
+/* Before rng.h: gaussian_random() and measure() on rand()                  */
+/* ------------------------------------------------------------------------ */
+
+static double ref_gaussian(const double mean, const double stddev) {
+    double u1, u2;
+    do {
+        u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+        u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    } while (u1 <= 0.0 || u2 <= 0.0);
+    const double mag = sqrt(-2.0 * log(u1));
+    return mean + mag * cos(2.0 * M_PI * u2) * stddev;
+}
+
+static void ref_measure(sensor_data_t* data) {
+    data->temp = 5.0f + (float) rand() / (float) RAND_MAX * 10.0f;
+    if ((rand() % 100) < 95) {
+        data->pH = 6.5f + (float) rand() / (float) RAND_MAX * 2.0f;
+    } else {
+        data->pH = (float) rand() / (float) RAND_MAX * 14.0f;
+    }
+    data->bat = (uint8_t) (rand() % 101);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Cost                                                                     */
+/* ------------------------------------------------------------------------ */
+
+static volatile double sink;
+
+typedef struct {
+    int old;
+    uint32_t n;
+    double sum;
+} worker_arg_t;
+
+static void* gaussian_worker(void* arg) {
+    worker_arg_t* w = arg;
+    double sum = 0.0;
+    for (uint32_t i = 0; i < w->n; i++) sum += w->old ? ref_gaussian(0.0, 1.0) : gaussian_random(0.0, 1.0);
+    w->sum = sum;
+    return NULL;
+}
+
+static uint64_t threaded(const int old) {
+    pthread_t t[THREADS];
+    worker_arg_t w[THREADS];
+    const uint64_t t0 = monotonic_now_ns();
+    for (int i = 0; i < THREADS; i++) {
+        w[i] = (worker_arg_t){ old, ROUNDS / THREADS, 0.0 };
+        pthread_create(&t[i], NULL, gaussian_worker, &w[i]);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(t[i], NULL);
+        sink += w[i].sum;
+    }
+    return monotonic_now_ns() - t0;
+}
+
+static void cost(void) {
+    static double block[FILL_BLOCK];
+    uint64_t sum = 0;
+    double dsum = 0.0;
+    rng_t* rng = rng_local();
+
+    uint64_t t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) sum += (uint64_t) rand();
+    const uint64_t t_rand = monotonic_now_ns() - t0;
+    bench_report("rand() (31 bits)", t_rand, ROUNDS);
+
+    unsigned int seed = 1;
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) sum += (uint64_t) rand_r(&seed);
+    bench_report("rand_r() (31 bits)", monotonic_now_ns() - t0, ROUNDS);
+
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) sum += rng_next(rng);
+    const uint64_t t_next = monotonic_now_ns() - t0;
+    bench_report("rng_next() (64 bits)", t_next, ROUNDS);
+
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) sum += rng_next(rng_local());
+    bench_report("rng_next(rng_local())", monotonic_now_ns() - t0, ROUNDS);
+
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) sum += rng_below(rng, 101);
+    bench_report("rng_below(101)", monotonic_now_ns() - t0, ROUNDS);
+
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) dsum += ref_gaussian(0.0, 1.0);
+    const uint64_t t_bm = monotonic_now_ns() - t0;
+    bench_report("Box-Muller on rand() (before)", t_bm, ROUNDS);
+
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) dsum += gaussian_random(0.0, 1.0);
+    const uint64_t t_gauss = monotonic_now_ns() - t0;
+    bench_report("gaussian_random()", t_gauss, ROUNDS);
+
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) dsum += rng_normal(rng);
+    bench_report("rng_normal()", monotonic_now_ns() - t0, ROUNDS);
+
+    t0 = monotonic_now_ns();
+    for (uint32_t r = 0; r < ROUNDS / FILL_BLOCK; r++) {
+        rng_fill_normal(rng, block, FILL_BLOCK, 0.0, 1.0);
+        dsum += block[r % FILL_BLOCK];
+    }
+    const uint64_t t_fill = monotonic_now_ns() - t0;
+    bench_report("rng_fill_normal(), blocks of 1024", t_fill, ROUNDS);
+
+    sensor_data_t d;
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS / 4; i++) {
+        ref_measure(&d);
+        sum += d.bat;
+    }
+    const uint64_t t_ref_measure = monotonic_now_ns() - t0;
+    bench_report("measure() on rand() (before)", t_ref_measure, ROUNDS / 4);
+
+    t0 = monotonic_now_ns();
+    for (uint32_t i = 0; i < ROUNDS / 4; i++) {
+        measure(&d);
+        sum += d.bat;
+    }
+    const uint64_t t_measure = monotonic_now_ns() - t0;
+    bench_report("measure()", t_measure, ROUNDS / 4);
+
+    const uint64_t t_bm_mt = threaded(1);
+    bench_report("Box-Muller on rand(), 4 threads (before)", t_bm_mt, ROUNDS);
+    const uint64_t t_gauss_mt = threaded(0);
+    bench_report("gaussian_random(), 4 threads", t_gauss_mt, ROUNDS);
+
+    printf("speed-up: draw %.1fx, normal %.1fx (bulk %.1fx), measure %.1fx, normal on %d threads %.1fx\n",
+           (double) t_rand / (double) t_next, (double) t_bm / (double) t_gauss, (double) t_bm / (double) t_fill,
+           (double) t_ref_measure / (double) t_measure, THREADS, (double) t_bm_mt / (double) t_gauss_mt);
+    printf("(checksum %llu %.3f)\n", (unsigned long long) sum, dsum + sink);
+}
+
+int main(void) {
+    cost();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_frag.h"
+#include "schc_demo_app/services/schc_rule_engine.h"
+#include "schc_demo_app/services/schc_rule_json.h"
+#include "schc_demo_app/services/schc_service.h"
+
+/*
+ * Startup cost of a large rule set.
+ * A rule set of N rules is written as RFC 9363 JSON (one flow per rule, as
+ * in bench_rules.c, with 16-bit rule IDs), then brought up three ways:
+ *   - image:   schc_service_init() mapping the image built by the rule
+ *              compiler, which is what the application does;
+ *   - json:    reading, parsing and compiling the JSON at startup;
+ *   - compile: schc_service_set_rules() from descriptors already in memory.
+ * Startup times are the median of REPEATS runs with the files in the page
+ * cache. The offline steps (parse, compile + save) are timed once. Then
+ * every packet is compressed with the mapped image and with the engine
+ * compiled from the JSON, and the two outputs must be identical.
+ */
+
+#define REPEATS 9
+#define NB_PACKETS 4096
+#define PKT_CAP 128
+#define DEFAULT_RULE_ID 150
+
+static uint8_t packets[NB_PACKETS][PKT_CAP];
+static size_t packet_lens[NB_PACKETS];
+static uint8_t out_image[PKT_CAP];
+static uint8_t out_json[PKT_CAP];
+
+static uint64_t rng = 0xbb67ae8584caa73bull;
+static uint64_t rnd(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/* 16-bit IDs from 0x100 up, none starting like a fragment */
+static uint16_t rule_id(const size_t i) {
+    uint16_t id = (uint16_t) (0x100 + i);
+    if (id >> 8 >= SCHC_FRAG_NOACK_RULE_ID) id = (uint16_t) (id + 0x200);
+    return id;
+}
+
+static void flow(const size_t i, uint8_t dev_ip[16], uint8_t app_ip[16], uint16_t* dport, uint16_t* aport) {
+    memcpy(dev_ip, schc_service_dev_ip(), 16);
+    dev_ip[13] = (uint8_t) ((i + 1) >> 16);
+    dev_ip[14] = (uint8_t) ((i + 1) >> 8);
+    dev_ip[15] = (uint8_t) (i + 1);
+    memcpy(app_ip, schc_service_app_ip(), 16);
+    app_ip[15] = (uint8_t) (2 + i % 8);
+    *dport = schc_service_dev_port();
+    *aport = (uint16_t) (schc_service_app_port() + i % 16);
+}
+
+static void b64(const uint8_t* in, const size_t len, char* out) {
+    static const char abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        const uint32_t v = (uint32_t) in[i] << 16 | (i + 1 < len ? (uint32_t) in[i + 1] << 8 : 0) |
+                           (i + 2 < len ? in[i + 2] : 0);
+        out[o++] = abc[v >> 18 & 63];
+        out[o++] = abc[v >> 12 & 63];
+        out[o++] = i + 1 < len ? abc[v >> 6 & 63] : '=';
+        out[o++] = i + 2 < len ? abc[v & 63] : '=';
+    }
+    out[o] = '\0';
+}
+
+static void entry(FILE* f, const char* fid, const unsigned len, const char* mo, const char* cda,
+                  const uint8_t* tv, const size_t tv_len, const int last) {
+    fprintf(f, "{\"field-id\":\"ietf-schc:%s\",\"field-length\":%u,\"field-position\":1,"
+               "\"direction-indicator\":\"ietf-schc:di-bidirectional\",", fid, len);
+    if (tv) {
+        char enc[16];
+        b64(tv, tv_len, enc);
+        fprintf(f, "\"target-value\":[{\"index\":0,\"value\":\"%s\"}],", enc);
+    }
+    fprintf(f, "\"matching-operator\":\"ietf-schc:%s\",\"comp-decomp-action\":\"ietf-schc:%s\"}%s",
+            mo, cda, last ? "" : ",");
+}
+
+static void write_json(const char* path, const size_t nb_rules) {
+    FILE* f = fopen(path, "w");
+    if (!f) exit(EXIT_FAILURE);
+    static const uint8_t version = 6, zero = 0, nh = 17, hl = 255;
+    fprintf(f, "{\"ietf-schc:schc\":{\"rule\":[\n");
+    for (size_t i = 0; i < nb_rules; i++) {
+        uint8_t dev_ip[16], app_ip[16];
+        uint16_t dport, aport;
+        flow(i, dev_ip, app_ip, &dport, &aport);
+        const uint8_t dp[2] = { (uint8_t) (dport >> 8), (uint8_t) dport };
+        const uint8_t ap[2] = { (uint8_t) (aport >> 8), (uint8_t) aport };
+        const int port_sent = i % 4 == 3;
+
+        fprintf(f, "{\"rule-id-value\":%u,\"rule-id-length\":16,"
+                   "\"rule-nature\":\"ietf-schc:nature-compression\",\"entry\":[", rule_id(i));
+        entry(f, "fid-ipv6-version", 4, "mo-equal", "cda-not-sent", &version, 1, 0);
+        entry(f, "fid-ipv6-trafficclass", 8, "mo-equal", "cda-not-sent", &zero, 1, 0);
+        entry(f, "fid-ipv6-flowlabel", 20, "mo-ignore", "cda-not-sent", &zero, 1, 0);
+        entry(f, "fid-ipv6-payload-length", 16, "mo-ignore", "cda-compute", NULL, 0, 0);
+        entry(f, "fid-ipv6-nextheader", 8, "mo-equal", "cda-not-sent", &nh, 1, 0);
+        entry(f, "fid-ipv6-hoplimit", 8, "mo-ignore", "cda-not-sent", &hl, 1, 0);
+        entry(f, "fid-ipv6-devprefix", 64, "mo-equal", "cda-not-sent", dev_ip, 8, 0);
+        entry(f, "fid-ipv6-deviid", 64, "mo-equal", "cda-not-sent", dev_ip + 8, 8, 0);
+        entry(f, "fid-ipv6-appprefix", 64, "mo-equal", "cda-not-sent", app_ip, 8, 0);
+        entry(f, "fid-ipv6-appiid", 64, "mo-equal", "cda-not-sent", app_ip + 8, 8, 0);
+        if (port_sent) entry(f, "fid-udp-dev-port", 16, "mo-ignore", "cda-value-sent", NULL, 0, 0);
+        else entry(f, "fid-udp-dev-port", 16, "mo-equal", "cda-not-sent", dp, 2, 0);
+        entry(f, "fid-udp-app-port", 16, "mo-equal", "cda-not-sent", ap, 2, 0);
+        entry(f, "fid-udp-length", 16, "mo-ignore", "cda-compute", NULL, 0, 0);
+        entry(f, "fid-udp-checksum", 16, "mo-ignore", "cda-compute", NULL, 0, 1);
+        fprintf(f, "]},\n");
+    }
+    fprintf(f, "{\"rule-id-value\":%u,\"rule-id-length\":16,"
+               "\"rule-nature\":\"ietf-schc:nature-no-compression\"}\n]}}\n", DEFAULT_RULE_ID);
+    if (fclose(f) != 0) exit(EXIT_FAILURE);
+}
+
+static void make_packets(const size_t nb_rules) {
+    for (size_t p = 0; p < NB_PACKETS; p++) {
+        const size_t i = p * 7919 % nb_rules;
+        ipv6_udp_cfg_t cfg = {0};
+        uint16_t dport, aport;
+        flow(i, cfg.src_ip, cfg.dst_ip, &dport, &aport);
+        cfg.src_port = i % 4 == 3 ? (uint16_t) rnd() : dport;
+        cfg.dst_port = aport;
+        cfg.next_header = 17;
+        cfg.hop_limit = 255;
+        // Every 16th packet is from an unknown device and takes the no-compression rule
+        if (p % 16 == 15) cfg.src_ip[12] ^= 0x80;
+        const uint8_t payload[4] = { (uint8_t) rnd(), (uint8_t) rnd(), (uint8_t) rnd(), (uint8_t) rnd() };
+        if (build_ipv6_udp_packet(&cfg, 0, payload, sizeof(payload), packets[p], PKT_CAP, &packet_lens[p]) != 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static char* read_file(const char* path, size_t* len) {
+    FILE* f = fopen(path, "rb");
+    if (!f || fseek(f, 0, SEEK_END) != 0) exit(EXIT_FAILURE);
+    *len = (size_t) ftell(f);
+    rewind(f);
+    char* buf = malloc(*len);
+    if (!buf || fread(buf, 1, *len, f) != *len) exit(EXIT_FAILURE);
+    fclose(f);
+    return buf;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    const uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+static double median_ms(uint64_t* ns) {
+    qsort(ns, REPEATS, sizeof(*ns), cmp_u64);
+    return (double) ns[REPEATS / 2] / 1e6;
+}
+
+static size_t errors;
+
+static void run(const size_t nb_rules, const char* json_path, const char* image_path) {
+    write_json(json_path, nb_rules);
+    make_packets(nb_rules);
+
+    // Offline: what schc-rulec does
+    size_t json_len;
+    char* json = read_file(json_path, &json_len);
+    schc_rule_set_t set;
+    uint64_t t0 = monotonic_now_ns();
+    if (schc_rule_json_parse(json, json_len, &set, NULL, NULL, 0) != SCHC_RULE_JSON_OK) exit(EXIT_FAILURE);
+    const double parse_ms = (double) (monotonic_now_ns() - t0) / 1e6;
+    free(json);
+    schc_engine_t compiled;
+    t0 = monotonic_now_ns();
+    if (schc_engine_compile(&compiled, set.rules, set.nb_rules, set.rule_id_bits, set.default_rule_id) !=
+        SCHC_ENGINE_OK ||
+        schc_engine_save(&compiled, image_path) != SCHC_ENGINE_OK) {
+        exit(EXIT_FAILURE);
+    }
+    const double save_ms = (double) (monotonic_now_ns() - t0) / 1e6;
+
+    uint64_t image_ns[REPEATS], json_ns[REPEATS], compile_ns[REPEATS];
+    for (int r = 0; r < REPEATS; r++) {
+        t0 = monotonic_now_ns();
+        if (schc_service_set_rule_file(image_path) != SCHC_OK || schc_service_init() != SCHC_OK) exit(EXIT_FAILURE);
+        image_ns[r] = monotonic_now_ns() - t0;
+
+        t0 = monotonic_now_ns();
+        schc_rule_set_t s;
+        schc_engine_t eng;
+        char* j = read_file(json_path, &json_len);
+        if (schc_rule_json_parse(j, json_len, &s, NULL, NULL, 0) != SCHC_RULE_JSON_OK ||
+            schc_engine_compile(&eng, s.rules, s.nb_rules, s.rule_id_bits, s.default_rule_id) != SCHC_ENGINE_OK) {
+            exit(EXIT_FAILURE);
+        }
+        json_ns[r] = monotonic_now_ns() - t0;
+        free(j);
+        schc_engine_free(&eng);
+        schc_rule_set_free(&s);
+
+        t0 = monotonic_now_ns();
+        if (schc_service_set_rules(set.rules, set.nb_rules, set.rule_id_bits, set.default_rule_id) != SCHC_OK) {
+            exit(EXIT_FAILURE);
+        }
+        compile_ns[r] = monotonic_now_ns() - t0;
+    }
+
+    // The mapped image must compress exactly like the engine compiled from the JSON
+    if (schc_service_init() != SCHC_OK) exit(EXIT_FAILURE);
+    size_t compressed = 0;
+    for (size_t p = 0; p < NB_PACKETS; p++) {
+        size_t len, bits;
+        const schc_status_t st = schc_service_compress(packets[p], packet_lens[p], out_image, PKT_CAP, &len);
+        const schc_engine_status est = schc_engine_compress(&compiled, packets[p], packet_lens[p], out_json,
+                                                            PKT_CAP, &bits);
+        if (est == SCHC_ENGINE_OK) {
+            compressed++;
+            if (st != SCHC_OK || len != (bits + 7) / 8 || memcmp(out_image, out_json, len) != 0) errors++;
+        } else if (est != SCHC_ENGINE_NO_MATCH || st != SCHC_OK || len != packet_lens[p] + 2) {
+            errors++;
+        }
+    }
+    if (compressed != NB_PACKETS - NB_PACKETS / 16) errors++;
+
+    FILE* f = fopen(image_path, "rb");
+    fseek(f, 0, SEEK_END);
+    const long image_len = ftell(f);
+    fclose(f);
+    printf("%6zu %9.1f %9.1f %10.1f %10.1f %11.3f %10.1f %10.1f\n", nb_rules, (double) json_len / 1e6,
+           (double) image_len / 1e6, parse_ms, save_ms, median_ms(image_ns), median_ms(json_ns),
+           median_ms(compile_ns));
+
+    schc_engine_free(&compiled);
+    schc_rule_set_free(&set);
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    char json_path[] = "/tmp/bench-rules-XXXXXX";
+    char image_path[] = "/tmp/bench-image-XXXXXX";
+    const int jfd = mkstemp(json_path), ifd = mkstemp(image_path);
+    if (jfd < 0 || ifd < 0) return EXIT_FAILURE;
+    close(jfd);
+    close(ifd);
+
+    printf("%6s %9s %9s %10s %10s %11s %10s %10s\n", "rules", "json MB", "image MB", "parse ms", "save ms",
+           "image ms", "json ms", "compile ms");
+    static const size_t sizes[] = { 100, 1000, 10000, 30000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) run(sizes[i], json_path, image_path);
+    printf("(image: startup mapping the compiled image; json: parse + compile at startup;"
+           " compile: from descriptors in memory)\n");
+
+    schc_service_set_rule_file(NULL);
+    unlink(json_path);
+    unlink(image_path);
+    printf("packets compressed differently from the JSON rules: %zu\n", errors);
+    zlog_fini();
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
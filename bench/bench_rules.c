@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <schc_sdk/schccomp.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_rule_engine.h"
+#include "schc_demo_app/services/schc_service.h"
+
+/*
+ * Compression latency against the size of the rule set.
+ * Rule i matches one flow: its own device IID, one of 8 application
+ * servers and one of 16 application ports. Every fourth rule sends the
+ * device port as residue instead of matching it, so the set has two masks.
+ * Packets visit the flows in a scattered order, so that with more than a
+ * few dozen rules the per-thread signature cache mostly misses and the
+ * rule index does the work. A linear scan over the same compiled rules is
+ * timed for reference. Every packet is checked for the rule ID of its flow
+ * and decompressed back to the original.
+ * The index must keep lookups nearly flat: from 10 rules up, compress and
+ * select may cost at most BOUND times their cost at 10 rules (best of
+ * REPEATS timings), where a linear scan grows with the rule count.
+ */
+
+#define MAX_RULES 1000
+#define NB_FIELDS 14
+#define NB_PACKETS 4096
+#define PAYLOAD_LEN 4
+#define PKT_CAP 128
+#define ROUNDS 100
+#define DEFAULT_RULE_ID 150
+#define REPEATS 3
+#define BOUND_FROM 10
+#define BOUND 4.0
+
+static const uint8_t ipv6_version = 0x60;
+static const uint8_t ipv6_tc = 0;
+static const uint8_t ipv6_fl[] = {0, 0, 0};
+static const uint8_t ipv6_nh = 17;
+static const uint8_t ipv6_hl = 255;
+
+static uint8_t dev_ips[MAX_RULES][16];
+static uint8_t app_ips[MAX_RULES][16];
+static uint8_t dev_ports[MAX_RULES][2];
+static uint8_t app_ports[MAX_RULES][2];
+static schc_field_desc_t fields[MAX_RULES][NB_FIELDS];
+static schc_rule_desc_t rules[MAX_RULES];
+
+static uint8_t packets[NB_PACKETS][PKT_CAP];
+static size_t packet_lens[NB_PACKETS];
+static size_t packet_flow[NB_PACKETS];
+static uint8_t out[PKT_CAP];
+static uint8_t rebuilt[PKT_CAP];
+
+static uint64_t rng = 0x6a09e667f3bcc909ull;
+static uint64_t rnd(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static void make_rule(const size_t i, const uint8_t rule_id_bits) {
+    memcpy(dev_ips[i], schc_service_dev_ip(), 16);
+    dev_ips[i][14] = (uint8_t) ((i + 1) >> 8);
+    dev_ips[i][15] = (uint8_t) (i + 1);
+    memcpy(app_ips[i], schc_service_app_ip(), 16);
+    app_ips[i][15] = (uint8_t) (2 + i % 8);
+    const uint16_t dport = schc_service_dev_port();
+    const uint16_t aport = (uint16_t) (schc_service_app_port() + i % 16);
+    dev_ports[i][0] = (uint8_t) (dport >> 8);
+    dev_ports[i][1] = (uint8_t) dport;
+    app_ports[i][0] = (uint8_t) (aport >> 8);
+    app_ports[i][1] = (uint8_t) aport;
+
+    const int port_sent = i % 4 == 3;
+    const schc_field_desc_t f[NB_FIELDS] = {
+        { FID_IPV6_VERSION,        4,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_version, 0 },
+        { FID_IPV6_TRAFFIC_CLASS,  8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_tc, 0 },
+        { FID_IPV6_FLOW_LABEL,     20, MO_IGNORE, CDA_NOT_SENT,         ipv6_fl, 0 },
+        { FID_IPV6_PAYLOAD_LENGTH, 16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+        { FID_IPV6_NEXT_HEADER,    8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_nh, 0 },
+        { FID_IPV6_HOP_LIMIT,      8,  MO_IGNORE, CDA_NOT_SENT,         &ipv6_hl, 0 },
+        { FID_IPV6_PREFIX_DEV,     64, MO_EQUAL,  CDA_NOT_SENT,         dev_ips[i], 0 },
+        { FID_IPV6_IID_DEV,        64, MO_EQUAL,  CDA_NOT_SENT,         dev_ips[i] + 8, 0 },
+        { FID_IPV6_PREFIX_APP,     64, MO_EQUAL,  CDA_NOT_SENT,         app_ips[i], 0 },
+        { FID_IPV6_IID_APP,        64, MO_EQUAL,  CDA_NOT_SENT,         app_ips[i] + 8, 0 },
+        port_sent ? (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 }
+                  : (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_EQUAL, CDA_NOT_SENT, dev_ports[i], 0 },
+        { FID_UDP_PORT_APP,        16, MO_EQUAL,  CDA_NOT_SENT,         app_ports[i], 0 },
+        { FID_UDP_LENGTH,          16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+        { FID_UDP_CHECKSUM,        16, MO_IGNORE, CDA_COMPUTE_CHECKSUM, NULL, 0 },
+    };
+    memcpy(fields[i], f, sizeof(f));
+
+    // 8-bit IDs from 30 up, skipping the no-compression rule; 16-bit IDs from 0x100 up
+    uint16_t id = rule_id_bits == 8 ? (uint16_t) (30 + i) : (uint16_t) (0x100 + i);
+    if (rule_id_bits == 8 && id >= DEFAULT_RULE_ID) id++;
+    rules[i] = (schc_rule_desc_t){ id, NB_FIELDS, fields[i] };
+}
+
+static void make_packets(const size_t nb_rules) {
+    for (size_t p = 0; p < NB_PACKETS; p++) {
+        const size_t i = p * 7919 % nb_rules;
+        ipv6_udp_cfg_t cfg = {0};
+        memcpy(cfg.src_ip, dev_ips[i], 16);
+        memcpy(cfg.dst_ip, app_ips[i], 16);
+        cfg.src_port = i % 4 == 3 ? (uint16_t) rnd() : (uint16_t) (dev_ports[i][0] << 8 | dev_ports[i][1]);
+        cfg.dst_port = (uint16_t) (app_ports[i][0] << 8 | app_ports[i][1]);
+        cfg.next_header = 17;
+        cfg.hop_limit = 255;
+
+        uint8_t payload[PAYLOAD_LEN];
+        for (size_t j = 0; j < PAYLOAD_LEN; j++) payload[j] = (uint8_t) rnd();
+        if (build_ipv6_udp_packet(&cfg, 0, payload, sizeof(payload), packets[p], PKT_CAP, &packet_lens[p]) != 0) {
+            exit(EXIT_FAILURE);
+        }
+        packet_flow[p] = i;
+    }
+}
+
+/* Reference: first matching rule by a walk over every compiled rule */
+static int32_t linear_select(const schc_engine_t* eng, const uint8_t* hdr) {
+    uint64_t h[SCHC_HDR_WORDS];
+    memcpy(h, hdr, SCHC_HDR_LEN);
+    for (size_t r = 0; r < eng->nb_rules; r++) {
+        uint64_t diff = 0;
+        for (size_t w = 0; w < SCHC_HDR_WORDS; w++) diff |= (h[w] & eng->rules[r].mask[w]) ^ eng->rules[r].value[w];
+        if (!diff) return (int32_t) r;
+    }
+    return -1;
+}
+
+static size_t errors;
+
+static void run(const size_t nb_rules, double* compress_ns, double* select_ns) {
+    const uint8_t rule_id_bits = nb_rules + 30 < 256 ? 8 : 16;
+    for (size_t i = 0; i < nb_rules; i++) make_rule(i, rule_id_bits);
+    make_packets(nb_rules);
+    if (schc_service_set_rules(rules, nb_rules, rule_id_bits, DEFAULT_RULE_ID) != SCHC_OK) exit(EXIT_FAILURE);
+
+    // Correctness first: right rule, and the packet comes back
+    for (size_t p = 0; p < NB_PACKETS; p++) {
+        size_t len, back_len;
+        if (schc_service_compress(packets[p], packet_lens[p], out, sizeof(out), &len) != SCHC_OK) exit(EXIT_FAILURE);
+        const uint16_t id = rule_id_bits == 16 ? (uint16_t) (out[0] << 8 | out[1]) : out[0];
+        if (id != rules[packet_flow[p]].rule_id ||
+            schc_service_decompress(out, len, rebuilt, sizeof(rebuilt), &back_len) != SCHC_OK ||
+            back_len != packet_lens[p] || memcmp(rebuilt, packets[p], back_len) != 0) {
+            errors++;
+        }
+    }
+
+    for (int k = 0; k < REPEATS; k++) {
+        const uint64_t t0 = monotonic_now_ns();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (size_t p = 0; p < NB_PACKETS; p++) {
+                size_t len;
+                schc_service_compress(packets[p], packet_lens[p], out, sizeof(out), &len);
+            }
+        }
+        const double ns = (double) (monotonic_now_ns() - t0) / ((double) ROUNDS * NB_PACKETS);
+        if (k == 0 || ns < *compress_ns) *compress_ns = ns;
+    }
+
+    schc_engine_t eng;
+    if (schc_engine_compile(&eng, rules, nb_rules, rule_id_bits, DEFAULT_RULE_ID) != SCHC_ENGINE_OK) exit(EXIT_FAILURE);
+    int64_t sum = 0;
+    for (int k = 0; k < REPEATS; k++) {
+        const uint64_t t0 = monotonic_now_ns();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (size_t p = 0; p < NB_PACKETS; p++) sum += schc_engine_select(&eng, packets[p]);
+        }
+        const double ns = (double) (monotonic_now_ns() - t0) / ((double) ROUNDS * NB_PACKETS);
+        if (k == 0 || ns < *select_ns) *select_ns = ns;
+    }
+
+    uint64_t t0 = monotonic_now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t p = 0; p < NB_PACKETS; p++) sum -= REPEATS * linear_select(&eng, packets[p]);
+    }
+    const double linear_ns = (double) (monotonic_now_ns() - t0) / ((double) ROUNDS * NB_PACKETS);
+    if (sum != 0) errors++;     // both selectors must agree on every packet
+
+    printf("%6zu %6zu %8u %14.1f %12.1f %12.1f\n", nb_rules, eng.nb_groups, rule_id_bits, *compress_ns, *select_ns,
+           linear_ns);
+    schc_engine_free(&eng);
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    printf("%6s %6s %8s %14s %12s %12s\n", "rules", "masks", "id bits", "compress ns", "select ns", "linear ns");
+    static const size_t sizes[] = { 1, 10, 50, 100, 200, 500, 1000 };
+    double compress_ns[sizeof(sizes) / sizeof(sizes[0])];
+    double select_ns[sizeof(sizes) / sizeof(sizes[0])];
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) run(sizes[i], &compress_ns[i], &select_ns[i]);
+
+    // Growth against BOUND_FROM rules, where the signature cache already misses
+    size_t base = 0;
+    while (sizes[base] < BOUND_FROM) base++;
+    size_t over_bound = 0;
+    for (size_t i = base + 1; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        const double c = compress_ns[i] / compress_ns[base], s = select_ns[i] / select_ns[base];
+        if (c > BOUND || s > BOUND) {
+            printf("%zu rules: compress x%.1f, select x%.1f the cost at %zu rules, bound x%.1f\n", sizes[i], c, s,
+                   sizes[base], BOUND);
+            over_bound++;
+        }
+    }
+
+    printf("packets with a wrong rule or not rebuilt: %zu\n", errors);
+    printf("rule counts over the lookup bound: %zu\n", over_bound);
+    zlog_fini();
+    return errors || over_bound ? EXIT_FAILURE : EXIT_SUCCESS;
+}
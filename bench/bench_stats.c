@@ -0,0 +1,122 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/stats.h"
+
+/*
+ * Stats check and recording cost.
+ * Several threads record log-uniform latencies (100 ns to 10 ms) while the
+ * main thread keeps formatting reports; afterwards every counter must hold
+ * the exact total and each percentile must be within the histogram's
+ * resolution of the exact one, computed by sorting all recorded values.
+ */
+
+#define NB_THREADS 4
+#define PER_THREAD 500000
+#define SINGLE_OPS 10000000
+
+static uint64_t* values;
+static atomic_bool done = false;
+
+static uint64_t rnd(uint64_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static void* recorder(void* arg) {
+    const size_t t = (size_t) arg;
+    uint64_t s = 0x9E3779B97F4A7C15ull * (t + 1);
+    uint64_t* v = values + t * PER_THREAD;
+    for (size_t i = 0; i < PER_THREAD; i++) {
+        const double u = (double) (rnd(&s) >> 11) / 9007199254740992.0;
+        v[i] = (uint64_t) (100.0 * pow(1e5, u));
+        stats_record(STAT_COMPRESS, v[i]);
+        stats_count(STAT_PKT_COMPRESSED, 1);
+        stats_count(STAT_BYTES_IN, 52);
+    }
+    return NULL;
+}
+
+static void* reporter(void* arg) {
+    size_t* nb_reports = arg;
+    char report[2048];
+    while (!atomic_load(&done)) {
+        stats_format(report, sizeof(report), NULL);
+        (*nb_reports)++;
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    const uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+static int check_percentile(const char* name, const uint64_t got, const double p) {
+    const size_t n = (size_t) NB_THREADS * PER_THREAD;
+    const uint64_t exact = values[(size_t) (p * (double) (n - 1))];
+    const double err = fabs((double) got - (double) exact) / (double) exact;
+    printf("%-6s exact %9llu ns  histogram %9llu ns  error %.2f%%\n", name,
+           (unsigned long long) exact, (unsigned long long) got, 100.0 * err);
+    return err <= 1.0 / 32.0;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+
+    values = malloc((size_t) NB_THREADS * PER_THREAD * sizeof(*values));
+    if (!values) return EXIT_FAILURE;
+
+    pthread_t th[NB_THREADS];
+    for (size_t t = 0; t < NB_THREADS; t++) pthread_create(&th[t], NULL, recorder, (void*) t);
+
+    // Reports taken during recording must not disturb it
+    pthread_t reader;
+    size_t nb_reports = 0;
+    pthread_create(&reader, NULL, reporter, &nb_reports);
+
+    for (size_t t = 0; t < NB_THREADS; t++) pthread_join(th[t], NULL);
+    atomic_store(&done, true);
+    pthread_join(reader, NULL);
+    printf("%zu reports taken while recording\n", nb_reports);
+
+    const uint64_t total = (uint64_t) NB_THREADS * PER_THREAD;
+    stat_hist_summary_t s;
+    stats_get_hist(STAT_COMPRESS, &s);
+    qsort(values, total, sizeof(*values), cmp_u64);
+
+    int ok = stats_get_counter(STAT_PKT_COMPRESSED) == total && stats_get_counter(STAT_BYTES_IN) == 52 * total &&
+             s.count == total && s.max == values[total - 1];
+    ok &= check_percentile("p50", s.p50, 0.50);
+    ok &= check_percentile("p90", s.p90, 0.90);
+    ok &= check_percentile("p99", s.p99, 0.99);
+    ok &= check_percentile("p99.9", s.p999, 0.999);
+
+    uint64_t t0 = monotonic_now_ns();
+    for (uint64_t i = 0; i < SINGLE_OPS; i++) stats_count(STAT_PKT_BUILT, 1);
+    bench_report("stats_count", monotonic_now_ns() - t0, SINGLE_OPS);
+
+    t0 = monotonic_now_ns();
+    for (uint64_t i = 0; i < SINGLE_OPS; i++) stats_record(STAT_BUILD, 1000 + (i & 0xFFFF));
+    bench_report("stats_record", monotonic_now_ns() - t0, SINGLE_OPS);
+
+    char report[2048];
+    t0 = monotonic_now_ns();
+    stats_format(report, sizeof(report), NULL);
+    bench_report("stats_format", monotonic_now_ns() - t0, 1);
+
+    printf("%s", report);
+    printf("%s\n", ok ? "stats: OK" : "stats: MISMATCH");
+    free(values);
+    zlog_fini();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/pkt_trace.h"
+#include "schc_demo_app/services/schc_service.h"
+#include "schc_demo_app/services/sensor_service.h"
+
+/*
+ * Per-packet cost of build + compress with the packet trace off, with the
+ * legacy printf hex dump, and with the asynchronous trace at each level.
+ * Trace output goes to /dev/null so only the producer side is measured.
+ */
+
+#define NB_PACKETS 200000
+#define PKT_CAP 256
+#define TRACE_DEPTH 4096
+
+static FILE* sink;
+static ipv6_udp_tpl_t tpl;
+
+/* What main.c did before the trace facility existed */
+static void legacy_dump_hex(const char* label, const uint8_t* buf, const size_t len) {
+    fprintf(sink, "\n=== %s (len=%zu) ===\n", label, len);
+    for (size_t i = 0; i < len; i++) {
+        fprintf(sink, "%02x ", buf[i]);
+        if ((i + 1) % 16 == 0) fprintf(sink, "\n");
+    }
+    if (len % 16 != 0) fprintf(sink, "\n");
+}
+
+static uint64_t run(const int legacy) {
+    static uint8_t storage[PKT_CAP];
+    pktbuf_t pb;
+
+    const uint64_t t0 = monotonic_now_ns();
+    for (uint32_t seq = 0; seq < NB_PACKETS; seq++) {
+        pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+        (void) measure((sensor_data_t*) pktbuf_put(&pb, sizeof(sensor_data_t)));
+        if (ipv6_udp_tpl_push(&tpl, &pb) != 0) exit(EXIT_FAILURE);
+
+        if (legacy) legacy_dump_hex("IPv6+UDP packet BEFORE SCHC", pktbuf_data(&pb), pb.len);
+        PKT_TRACE(PKT_TRACE_HEX, "IPv6+UDP packet BEFORE SCHC", seq, pktbuf_data(&pb), pb.len);
+
+        if (schc_service_compress_pkt(&pb) != SCHC_OK) exit(EXIT_FAILURE);
+
+        if (legacy) legacy_dump_hex("SCHC packet AFTER compression", pktbuf_data(&pb), pb.len);
+        PKT_TRACE(PKT_TRACE_HEX, "SCHC packet AFTER compression", seq, pktbuf_data(&pb), pb.len);
+        PKT_TRACE(PKT_TRACE_SUMMARY, "L2 TX", seq, pktbuf_data(&pb), pb.len);
+    }
+    return monotonic_now_ns() - t0;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, schc_service_dev_ip(), 16);
+    memcpy(cfg.dst_ip, schc_service_app_ip(), 16);
+    cfg.src_port = schc_service_dev_port();
+    cfg.dst_port = schc_service_app_port();
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+    if (ipv6_udp_tpl_init(&tpl, &cfg, schc_service_flow_label()) != 0) return EXIT_FAILURE;
+
+    sink = fopen("/dev/null", "w");
+    if (!sink || pkt_trace_init("/dev/null", TRACE_DEPTH) != PKT_TRACE_INIT_OK) return EXIT_FAILURE;
+
+    rng_set_seed(42);
+    printf("PKT_TRACE_LEVEL=%d (compile time)\n", PKT_TRACE_LEVEL);
+
+    pkt_trace_set_level(PKT_TRACE_OFF);
+    bench_report("trace off", run(0), NB_PACKETS);
+
+    bench_report("legacy printf hex dump", run(1), NB_PACKETS);
+
+    pkt_trace_stats_t st;
+    for (int level = PKT_TRACE_SUMMARY; level <= PKT_TRACE_HEX; level++) {
+        pkt_trace_stats_t before;
+        pkt_trace_get_stats(&before);
+        pkt_trace_set_level(level);
+        const uint64_t ns = run(0);
+        pkt_trace_set_level(PKT_TRACE_OFF);
+        pkt_trace_get_stats(&st);
+
+        char name[64];
+        snprintf(name, sizeof(name), "async trace level %d", level);
+        bench_report(name, ns, NB_PACKETS);
+        printf("  records dropped (ring full): %llu\n", (unsigned long long) (st.dropped - before.dropped));
+    }
+
+    pkt_trace_fini();
+    pkt_trace_get_stats(&st);
+    printf("records written: %llu\n", (unsigned long long) st.written);
+
+    fclose(sink);
+    zlog_fini();
+    return EXIT_SUCCESS;
+}
@@ -1,2 +1,6 @@
-set(EXT "ahoi" CACHE STRING "Extension type") # ahoi
-set(LOG_CONFIG_FILE "${PROJECT_SOURCE_DIR}/config/log.conf" CACHE STRING "Config file for zlog")
\ No newline at end of file
+set(EXT "ahoi" CACHE STRING "Extension type") # ahoi | loop
+set(LOG_CONFIG_FILE "${PROJECT_SOURCE_DIR}/config/log.conf" CACHE STRING "Config file for zlog")
+set(SCHC_RULES_JSON "${PROJECT_SOURCE_DIR}/config/schc_rules.json" CACHE STRING "Rule set compiled into schc_rules.bin at build time")
+set(SCHC_FAST_PATH_VERIFY OFF CACHE BOOL "Cross-check every compiled-rule compression against the SDK")
+set(PKT_TRACE_LEVEL 2 CACHE STRING "Highest packet trace level compiled in: 0 off, 1 summary, 2 hex")
+set(BUILD_BENCH OFF CACHE BOOL "Build the benchmark executables")
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zlog.h>
+
+/*
+ * Asynchronous logging for the packet path.
+ *
+ * ALOG_INFO(ok_cat, "Sent %u", seq) and friends copy a fixed-size binary
+ * record (call site, time stamp, arguments) into the calling thread's own
+ * single-producer ring and return; no lock, no formatting, no I/O. A
+ * background thread merges the rings in time stamp order, formats the
+ * records and writes them through zlog with the original file, function and
+ * line. When a ring is full the record is dropped and counted; the writer
+ * reports the drops through the "error" category.
+ *
+ * Records are formatted later: the zlog time stamp is the write time, up to
+ * a millisecond after the call. Arguments are captured by value; strings are
+ * copied into the record (ALOG_STR_BYTES in total, longer ones are cut).
+ * At most ALOG_MAX_ARGS arguments; '*' widths are not supported; pointers
+ * other than char* must be passed as void*.
+ *
+ * Before alog_init() and after alog_fini(), and on threads beyond
+ * ALOG_MAX_THREADS, the calls log synchronously, so nothing is lost.
+ * alog_fini() writes every queued record; it also runs at exit.
+ */
+
+#define ALOG_MAX_ARGS 6
+#define ALOG_STR_BYTES 56
+#define ALOG_MAX_THREADS 64
+
+typedef enum {
+    ALOG_INIT_OK, ALOG_INIT_KO
+} alog_status;
+
+typedef enum {
+    ALOG_ARG_INT, ALOG_ARG_DBL, ALOG_ARG_STR, ALOG_ARG_PTR
+} alog_arg_type;
+
+typedef struct {
+    alog_arg_type type;
+    union {
+        long long i;
+        double d;
+        const char* s;
+        const void* p;
+    };
+} alog_arg_t;
+
+// One per call site; its address identifies the format
+typedef struct {
+    zlog_category_t* const* cat;
+    int level;
+    const char* fmt;
+    const char* file;
+    const char* func;
+    long line;
+} alog_site_t;
+
+typedef struct {
+    uint64_t written;
+    uint64_t dropped;       // ring full
+    uint64_t direct;        // logged synchronously
+} alog_stats_t;
+
+/** Start the writer; depth (records per thread) must be a power of two. */
+alog_status alog_init(size_t depth);
+
+/** Write out every queued record and stop the writer. */
+void alog_fini(void);
+
+void alog_get_stats(alog_stats_t* stats);
+
+void alog_emit(const alog_site_t* site, size_t nargs, const alog_arg_t* args);
+
+/** The text the writer would log for this call, truncated to cap - 1; returns its length. */
+size_t alog_format(const alog_site_t* site, size_t nargs, const alog_arg_t* args, char* out, size_t cap);
+
+static inline alog_arg_t alog_arg_int(const long long v) {
+    return (alog_arg_t) { .type = ALOG_ARG_INT, .i = v };
+}
+
+static inline alog_arg_t alog_arg_dbl(const double v) {
+    return (alog_arg_t) { .type = ALOG_ARG_DBL, .d = v };
+}
+
+static inline alog_arg_t alog_arg_str(const char* v) {
+    return (alog_arg_t) { .type = ALOG_ARG_STR, .s = v };
+}
+
+static inline alog_arg_t alog_arg_ptr(const void* v) {
+    return (alog_arg_t) { .type = ALOG_ARG_PTR, .p = v };
+}
+
+#define ALOG_ARG(x) _Generic((x),                                           \
+        char*: alog_arg_str, const char*: alog_arg_str,                     \
+        float: alog_arg_dbl, double: alog_arg_dbl,                          \
+        void*: alog_arg_ptr, const void*: alog_arg_ptr,                     \
+        default: alog_arg_int)(x)
+
+#define ALOG_NARGS_(_1, _2, _3, _4, _5, _6, _7, N, ...) N
+#define ALOG_NARGS(...) ALOG_NARGS_(__VA_ARGS__, 7, 6, 5, 4, 3, 2, 1, 0)
+#define ALOG_CAT_(a, b) a##b
+#define ALOG_CAT(a, b) ALOG_CAT_(a, b)
+#define ALOG_FMT(fmt, ...) fmt
+
+// Argument count and array for the format and its arguments
+#define ALOG_PACK_1(f) 0, NULL
+#define ALOG_PACK_2(f, a) 1, (const alog_arg_t[]) { ALOG_ARG(a) }
+#define ALOG_PACK_3(f, a, b) 2, (const alog_arg_t[]) { ALOG_ARG(a), ALOG_ARG(b) }
+#define ALOG_PACK_4(f, a, b, c) 3, (const alog_arg_t[]) { ALOG_ARG(a), ALOG_ARG(b), ALOG_ARG(c) }
+#define ALOG_PACK_5(f, a, b, c, d) 4, (const alog_arg_t[]) { ALOG_ARG(a), ALOG_ARG(b), ALOG_ARG(c), ALOG_ARG(d) }
+#define ALOG_PACK_6(f, a, b, c, d, e) 5, (const alog_arg_t[]) {                 \
+        ALOG_ARG(a), ALOG_ARG(b), ALOG_ARG(c), ALOG_ARG(d), ALOG_ARG(e) }
+#define ALOG_PACK_7(f, a, b, c, d, e, g) 6, (const alog_arg_t[]) {              \
+        ALOG_ARG(a), ALOG_ARG(b), ALOG_ARG(c), ALOG_ARG(d), ALOG_ARG(e), ALOG_ARG(g) }
+
+#define ALOG(level, cat, ...)                                                   \
+    do {                                                                        \
+        static const alog_site_t alog_site_ = {                                 \
+            &(cat), (level), ALOG_FMT(__VA_ARGS__, 0), __FILE__, __func__, __LINE__ \
+        };                                                                      \
+        alog_emit(&alog_site_, ALOG_CAT(ALOG_PACK_, ALOG_NARGS(__VA_ARGS__))(__VA_ARGS__)); \
+    } while (0)
+
+#define ALOG_ERROR(cat, ...) ALOG(ZLOG_LEVEL_ERROR, cat, __VA_ARGS__)
+#define ALOG_WARN(cat, ...) ALOG(ZLOG_LEVEL_WARN, cat, __VA_ARGS__)
+#define ALOG_INFO(cat, ...) ALOG(ZLOG_LEVEL_INFO, cat, __VA_ARGS__)
+#define ALOG_DEBUG(cat, ...) ALOG(ZLOG_LEVEL_DEBUG, cat, __VA_ARGS__)
@@ -7,6 +7,29 @@ typedef enum {
     CLI_PARSE_OK, CLI_PARSE_KO
 } cli_parse_status;
 
+typedef struct {
+    uint8_t id;
+    uint8_t* key_buf;    // caller-provided, key_size bytes
+    size_t key_size;
+    char* port;          // serial port, or the loopback target ("mem", "pty", "unix:<path>")
+    char* link;          // loopback link model, see l2_loop_parse_link()
+    char* rules;         // SCHC rule image built by schc-rulec, NULL: built-in rule
+    char* control;       // UNIX datagram socket taking "reload [<image>]", NULL: none
+    char* pcap;          // pcapng file capturing every packet stage, NULL: none (see pcap_writer.h)
+    char* miss_rules;    // profile the rule misses and write the derived rule set here, NULL: none (see schc_profiler.h)
+    int32_t baud;
+    uint32_t roundtrip;  // > 0: compress/decompress this many packets offline and exit
+    int32_t trace;       // run-time packet trace level, see pkt_trace.h
+    uint32_t devices;    // > 0: simulate this many devices (see sim_service.h)
+    uint32_t workers;    // simulation worker threads
+    uint32_t duration;   // simulation length in seconds
+    uint32_t batch;      // measurements per packet, 0 or 1: one packet each (see sensor_agg.h)
+    double batch_delay_ms;  // longest a measurement waits for its batch, 0: default
+    uint8_t frag_ack;    // fragment oversized packets in ACK-on-Error mode instead of No-ACK
+    uint8_t raw_payload; // send sensor_data_t as is instead of bit-packed (see sensor_codec.h)
+    double interval_ms;  // mean wake-up interval of each simulated device, 0: default
+} cli_args_t;
+
 void print_usage(const char* prog_name);
 
-cli_parse_status parse_cli_arguments(int32_t argc, char* const * argv, uint8_t* id, uint8_t* key_buf, size_t key_size, char** port_ptr, int32_t* baud);
\ No newline at end of file
+cli_parse_status parse_cli_arguments(int32_t argc, char* const * argv, cli_args_t* args);
\ No newline at end of file
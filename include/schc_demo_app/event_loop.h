@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Single-threaded event loop on epoll.
+// Subsystems register file descriptors (L2 RX, TX completions, signals...)
+// and timers; every callback runs on the thread that calls ev_loop_run().
+// Timers use timerfd with absolute CLOCK_MONOTONIC deadlines, so time spent
+// in callbacks never shifts the next wake-up.
+
+#define EV_MAX_HANDLERS 32
+
+typedef enum {
+    EV_OK, EV_KO
+} ev_status;
+
+typedef struct ev_timer ev_timer_t;
+
+typedef void (*ev_fd_cb)(int fd, uint32_t events, void* ctx);
+
+/** late_ns: how long after its deadline the timer callback started. */
+typedef void (*ev_timer_cb)(ev_timer_t* timer, uint64_t late_ns, void* ctx);
+
+typedef struct {
+    uint64_t fires;
+    uint64_t missed;        // expirations folded into a later one (periodic timers)
+    uint64_t late_max_ns;
+    double late_mean_ns;
+    double late_stddev_ns;
+} ev_timer_stats_t;
+
+ev_status ev_loop_init(void);
+
+void ev_loop_fini(void);
+
+/** Dispatch events until ev_loop_stop(). */
+ev_status ev_loop_run(void);
+
+/** Safe from any thread and from callbacks. */
+void ev_loop_stop(void);
+
+/** events: EPOLLIN / EPOLLOUT / ... */
+ev_status ev_loop_add_fd(int fd, uint32_t events, ev_fd_cb cb, void* ctx);
+
+ev_status ev_loop_del_fd(int fd);
+
+ev_timer_t* ev_timer_new(ev_timer_cb cb, void* ctx);
+
+void ev_timer_free(ev_timer_t* timer);
+
+/**
+ * Fire at the absolute CLOCK_MONOTONIC time deadline_ns, then every period_ns
+ * after it (0: once). Re-arming from the callback with deadline + interval
+ * gives drift-free irregular schedules.
+ */
+ev_status ev_timer_arm(ev_timer_t* timer, uint64_t deadline_ns, uint64_t period_ns);
+
+/** Deadline of the current or last expiration. */
+uint64_t ev_timer_deadline(const ev_timer_t* timer);
+
+void ev_timer_get_stats(const ev_timer_t* timer, ev_timer_stats_t* stats);
+
+uint64_t ev_now_ns(void);
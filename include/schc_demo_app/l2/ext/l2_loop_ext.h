@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Loopback backend for load testing without a modem.
+// Frames go through a simulated link and are delivered to an in-memory
+// ring, a pseudo-terminal or a UNIX datagram socket.
+//
+// On the pty and the socket every frame is written as
+// [len_hi][len_lo][src][dst][type][flags][seq] followed by len payload bytes.
+
+#define L2_LOOP_MTU 255
+
+typedef enum {
+    L2_LOOP_MEM, L2_LOOP_PTY, L2_LOOP_UNIX
+} l2_loop_sink;
+
+typedef struct {
+    uint32_t bitrate_bps;   // 0: no serialization delay
+    uint32_t latency_us;    // propagation delay
+    uint32_t jitter_us;     // extra delay, uniform in [0, jitter_us]
+    uint32_t loss_ppm;      // frame loss probability, parts per million
+    uint64_t seed;
+} l2_link_model_t;
+
+typedef struct {
+    l2_frame_meta_t meta;
+    uint64_t sent_ns;       // meta.stamp_ns, or the l2_xmit() time when unset
+    uint64_t deliver_ns;
+    uint16_t len;
+    uint8_t data[L2_LOOP_MTU];
+} l2_loop_frame_t;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t lost;          // dropped by the link model
+    uint64_t delivered;
+    uint64_t overruns;      // dropped because the delay line or the sink was full
+    uint64_t bytes;         // payload bytes delivered
+} l2_loop_stats_t;
+
+/** "mem", "pty" or "unix:<path>". Must be called before l2_init(). */
+int l2_loop_set_target(const char* spec);
+
+void l2_loop_set_link(const l2_link_model_t* model);
+
+/**
+ * Parse "bitrate=<bps>,latency_ms=<ms>,jitter_ms=<ms>,loss=<0..1>,seed=<n>".
+ * Keys are optional; missing ones keep the value already in model.
+ */
+int l2_loop_parse_link(const char* spec, l2_link_model_t* model);
+
+/** Pop one delivered frame from the in-memory sink. Returns 0 when empty. */
+int l2_loop_recv(l2_loop_frame_t* out);
+
+void l2_loop_get_stats(l2_loop_stats_t* stats);
+
+/** Deliver the frames still in flight, then release the sink. */
+void l2_loop_fini(void);
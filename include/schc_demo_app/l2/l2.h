@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "../net/pktbuf.h"
+
 // send down traffic
 // accept traffic
 
@@ -22,10 +24,30 @@ uint32_t* l2_get_id();
 
 uint8_t* l2_get_id_byte();
 
-void l2_send_prepare(const void* params);
-
-l2_send_status l2_send_run(const uint8_t* payload, size_t size);
+/** Nonblocking descriptor the backend receives on (see l2_rx.h); -1 if it has none. */
+int l2_get_fd(void);
+
+// Per-frame L2 header fields; each frame carries its own copy
+typedef struct {
+    uint32_t src;       // 0: this node's id; set per device by the simulator
+    uint32_t dst;
+    uint32_t seq;
+    uint8_t type;
+    uint8_t flags;
+    uint64_t stamp_ns;  // CLOCK_MONOTONIC time the frame was built, 0 if unknown
+} l2_frame_meta_t;
+
+/*
+ * Synchronously transmit one frame, implemented by the selected backend.
+ * pb's headroom may be used for framing. Only the L2 TX writer thread
+ * (l2_tx.h) should call this.
+ */
+l2_send_status l2_xmit(const l2_frame_meta_t* meta, pktbuf_t* pb);
 
 #ifdef L2_AHOI_EXT
 #include "ext/l2_ahoi_ext.h"
 #endif
+
+#ifdef L2_LOOP_EXT
+#include "ext/l2_loop_ext.h"
+#endif
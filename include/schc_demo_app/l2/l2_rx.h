@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "l2.h"
+
+// Downlink receive path.
+// Bytes read from the backend descriptor land in a ring buffer mapped twice
+// back to back, so any span of it is contiguous in memory. Frames use the
+// ahoi serial framing, DLE STX <header> <payload> [footer] DLE ETX, with DLE
+// doubled inside the frame. The parser removes the stuffing in place as bytes
+// arrive, keeps its state across partial reads, and hands each complete frame
+// to the dispatch callback as a view into the ring.
+
+#define L2_RX_HDR_SIZE 6        // src dst type flags seq len
+#define L2_RX_MAX_FRAME 320     // header + 255 payload bytes + modem footer, unstuffed
+
+typedef enum {
+    L2_RX_OK, L2_RX_KO
+} l2_rx_status;
+
+typedef struct {
+    l2_frame_meta_t meta;       // stamp_ns: time the closing DLE ETX was parsed
+    const uint8_t* payload;     // points into the ring
+    size_t len;
+    const uint8_t* footer;      // trailing bytes after the payload (modem reception info)
+    size_t footer_len;
+} l2_rx_frame_t;
+
+/**
+ * Runs on the thread calling l2_rx_poll() / l2_rx_feed(). The frame and the
+ * bytes it points to are only valid until the callback returns.
+ */
+typedef void (*l2_rx_cb)(const l2_rx_frame_t* frame, void* ctx);
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t frames;
+    uint64_t discarded;     // bytes outside any frame
+    uint64_t aborted;       // frame interrupted by a new DLE STX or an invalid escape
+    uint64_t malformed;     // shorter than its header says
+    uint64_t oversize;      // longer than L2_RX_MAX_FRAME
+    uint64_t overflows;     // descriptor readable while the ring was full
+} l2_rx_stats_t;
+
+/** capacity is rounded up to a multiple of the page size. */
+l2_rx_status l2_rx_init(size_t capacity, l2_rx_cb cb, void* ctx);
+
+void l2_rx_fini(void);
+
+/**
+ * Read everything available on the nonblocking descriptor fd and dispatch the
+ * frames it completes. Returns L2_RX_KO on end of file or a read error.
+ */
+l2_rx_status l2_rx_poll(int fd);
+
+/** Same as l2_rx_poll() with bytes from memory; returns how many were accepted. */
+size_t l2_rx_feed(const uint8_t* data, size_t len);
+
+void l2_rx_get_stats(l2_rx_stats_t* stats);
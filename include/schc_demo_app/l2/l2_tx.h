@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "l2.h"
+
+// Asynchronous L2 transmit queue.
+// Producers fill frames in place inside bounded single-producer /
+// single-consumer rings, one lane per producer thread; a dedicated writer
+// thread drains the lanes in turn through l2_xmit(). The caller never blocks
+// on the serial write, and producers never contend with each other.
+
+#define L2_TX_FRAME_CAP 256
+
+typedef enum {
+    L2_TX_OK, L2_TX_KO
+} l2_tx_status;
+
+typedef enum {
+    L2_TX_BLOCK,        // l2_tx_acquire() waits for a free slot
+    L2_TX_DROP_NEWEST   // l2_tx_acquire() returns NULL and counts a drop
+} l2_tx_policy;
+
+typedef struct {
+    l2_frame_meta_t meta;
+    pktbuf_t pb;        // reset with PKTBUF_HEADROOM by l2_tx_acquire()
+    void* user;         // passed back to the completion callback
+    l2_send_status status;  // result of l2_xmit(), set before the callback
+    uint64_t xmit_start_ns; // CLOCK_MONOTONIC around l2_xmit(), set before the callback
+    uint64_t xmit_end_ns;
+    uint8_t* storage;   // L2_TX_FRAME_CAP bytes, pb's; see l2_tx_take_buffer()
+} l2_tx_frame_t;
+
+typedef struct {
+    uint64_t enqueued;
+    uint64_t sent;
+    uint64_t failed;
+    uint64_t dropped;
+} l2_tx_stats_t;
+
+// Runs once the frame has been handed to the backend: on the writer thread,
+// or in l2_tx_dispatch_completions() when completions are deferred
+typedef void (*l2_tx_done_cb)(const l2_tx_frame_t* frame, l2_send_status status, void* ctx);
+
+/**
+ * Number of producer lanes, 1 by default. Lane 0 is the one l2_tx_acquire()
+ * fills; each lane must only ever be filled by one thread at a time.
+ * Call before l2_tx_start().
+ */
+l2_tx_status l2_tx_set_lanes(size_t nb_lanes);
+
+/** depth, the frames of each lane, must be a power of two. */
+l2_tx_status l2_tx_start(size_t depth, l2_tx_policy policy, l2_tx_done_cb cb, void* ctx);
+
+/** Drain the frames already committed and join the writer thread. */
+void l2_tx_stop(void);
+
+/**
+ * Next free frame, or NULL (drop policy, queue full).
+ * The frame is not queued until l2_tx_commit(); not committing it simply
+ * leaves it free for the next acquire.
+ */
+l2_tx_frame_t* l2_tx_acquire(void);
+
+/** Same as l2_tx_acquire() on another lane; NULL if there is no such lane. */
+l2_tx_frame_t* l2_tx_acquire_lane(size_t lane);
+
+void l2_tx_commit(l2_tx_frame_t* frame);
+
+/**
+ * Keep the packet of an acquired frame where it was built instead of
+ * committing the frame: returns the frame's buffer, which frame->pb points
+ * into and which stays untouched until l2_tx_give_back_buffer(). The slot
+ * goes on with a spare buffer, so the frame is left uncommitted. Only one
+ * buffer can be out at a time; NULL if one already is. l2_tx_stop() frees
+ * it either way.
+ */
+uint8_t* l2_tx_take_buffer(l2_tx_frame_t* frame);
+
+void l2_tx_give_back_buffer(uint8_t* buffer);
+
+/** Free slots of lane 0; from its producer thread, that many acquires succeed without waiting. */
+size_t l2_tx_available(void);
+
+void l2_tx_get_stats(l2_tx_stats_t* stats);
+
+/**
+ * Run completion callbacks on the caller's thread instead of the writer's.
+ * Call before l2_tx_start(). Returns an eventfd that becomes readable when
+ * completions are pending; the caller then runs l2_tx_dispatch_completions().
+ * A slot is only reused once its completion has been dispatched, so with
+ * L2_TX_BLOCK the dispatching thread must not be the one acquiring frames.
+ */
+int l2_tx_defer_completions(void);
+
+/** Run the pending completion callbacks; returns how many ran. */
+size_t l2_tx_dispatch_completions(void);
@@ -11,5 +11,9 @@ extern zlog_category_t* tx_cat;
 extern zlog_category_t* rx_cat;
 extern zlog_category_t* ok_cat;
 extern zlog_category_t* error_cat;
+extern zlog_category_t* trace_cat;
 
-logger_status logger_init();
\ No newline at end of file
+logger_status logger_init();
+
+/** Flush the asynchronous log (async_log.h), then zlog_fini(). */
+void logger_fini(void);
\ No newline at end of file
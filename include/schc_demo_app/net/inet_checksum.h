@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Internet (RFC 1071) one's-complement sum kernels.
+ *
+ * All kernels return the sum of buf[0..len) added to `sum`, folded to 16 bits
+ * and expressed as a big-endian word value (as if every word had been read
+ * with (p[0] << 8) | p[1]). An odd trailing byte is padded with zero.
+ * Complement the final value to get a checksum.
+ */
+
+typedef uint32_t (*inet_csum_fn_t)(const uint8_t* buf, size_t len, uint32_t sum);
+
+typedef enum {
+    INET_CSUM_REF,     // one 16-bit word per step, the original builder loop
+    INET_CSUM_WORD64,  // 64-bit words with end-around carry
+    INET_CSUM_SSE2,
+    INET_CSUM_AVX2,
+    INET_CSUM_NEON,
+    INET_CSUM_IMPL_COUNT
+} inet_csum_impl_t;
+
+/** Best kernel for the running CPU, selected once at first call. */
+uint32_t inet_csum_partial(const uint8_t* buf, size_t len, uint32_t sum);
+
+/** A specific kernel, or NULL if it is not built or not supported by this CPU. */
+inet_csum_fn_t inet_csum_get_impl(inet_csum_impl_t impl);
+
+const char* inet_csum_impl_name(inet_csum_impl_t impl);
+
+static inline uint32_t inet_csum_fold(uint64_t sum) {
+    while (sum >> 16) sum = (sum & 0xFFFFu) + (sum >> 16);
+    return (uint32_t) sum;
+}
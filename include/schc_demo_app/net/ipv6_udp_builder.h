@@ -3,6 +3,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "pktbuf.h"
+
 typedef struct {
     uint8_t src_ip[16];
     uint8_t dst_ip[16];
@@ -29,3 +31,39 @@ int build_ipv6_udp_packet(const ipv6_udp_cfg_t *cfg,
                           const uint8_t *payload, size_t payload_len,
                           uint8_t *out, size_t out_cap,
                           size_t *out_len);
+
+/**
+ * Prepared IPv6 + UDP header for a fixed ipv6_udp_cfg_t and flow label.
+ * Holds the 48 header bytes with zero length/checksum fields and the
+ * one's-complement sum of everything that never changes between packets
+ * (pseudo-header addresses and next header, UDP ports).
+ */
+typedef struct {
+    uint8_t hdr[48];
+    uint32_t partial_sum;
+} ipv6_udp_tpl_t;
+
+int ipv6_udp_tpl_init(ipv6_udp_tpl_t *tpl,
+                      const ipv6_udp_cfg_t *cfg,
+                      uint32_t flow_lbl);
+
+/**
+ * Same output as build_ipv6_udp_packet() for the cfg/flow label the template
+ * was prepared with; only the length fields and payload sum are computed.
+ */
+int ipv6_udp_tpl_build(const ipv6_udp_tpl_t *tpl,
+                       const uint8_t *payload, size_t payload_len,
+                       uint8_t *out, size_t out_cap,
+                       size_t *out_len);
+
+/**
+ * Prepend the prepared header in front of the payload already in pb.
+ * Needs IPv6(40) + UDP(8) bytes of headroom; the payload is not moved.
+ */
+int ipv6_udp_tpl_push(const ipv6_udp_tpl_t *tpl, pktbuf_t *pb);
+
+/**
+ * UDP checksum of a complete IPv6(40) + UDP(8) + payload packet,
+ * with the checksum field treated as zero.
+ */
+uint16_t ipv6_udp_checksum(const uint8_t *pkt, size_t pkt_len);
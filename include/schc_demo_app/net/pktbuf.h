@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Packet buffer with headroom.
+ * The payload is written once; every layer below prepends its header in
+ * front of it (push) or strips bytes from the front (pull) without moving
+ * the payload. Any stage that has to move payload bytes anyway bumps
+ * `copies`, so the pipeline can check it stays at zero.
+ */
+
+#define PKTBUF_HEADROOM 64
+
+typedef struct {
+    uint8_t* base;
+    size_t cap;
+    size_t head;      // offset of the first valid byte
+    size_t len;       // number of valid bytes
+    uint32_t copies;  // payload copies since the last reset
+} pktbuf_t;
+
+static inline void pktbuf_init(pktbuf_t* pb, uint8_t* storage, const size_t cap, const size_t headroom) {
+    pb->base = storage;
+    pb->cap = cap;
+    pb->head = headroom < cap ? headroom : cap;
+    pb->len = 0;
+    pb->copies = 0;
+}
+
+static inline void pktbuf_reset(pktbuf_t* pb, const size_t headroom) {
+    pktbuf_init(pb, pb->base, pb->cap, headroom);
+}
+
+static inline uint8_t* pktbuf_data(const pktbuf_t* pb) {
+    return pb->base + pb->head;
+}
+
+static inline size_t pktbuf_headroom(const pktbuf_t* pb) {
+    return pb->head;
+}
+
+static inline size_t pktbuf_tailroom(const pktbuf_t* pb) {
+    return pb->cap - pb->head - pb->len;
+}
+
+/** Reserve n bytes at the tail; returns where to write them or NULL. */
+static inline uint8_t* pktbuf_put(pktbuf_t* pb, const size_t n) {
+    if (n > pktbuf_tailroom(pb)) return NULL;
+    uint8_t* p = pktbuf_data(pb) + pb->len;
+    pb->len += n;
+    return p;
+}
+
+/** Prepend n bytes; returns the new start of data or NULL. */
+static inline uint8_t* pktbuf_push(pktbuf_t* pb, const size_t n) {
+    if (n > pb->head) return NULL;
+    pb->head -= n;
+    pb->len += n;
+    return pktbuf_data(pb);
+}
+
+/** Strip n bytes from the front; returns the new start of data or NULL. */
+static inline uint8_t* pktbuf_pull(pktbuf_t* pb, const size_t n) {
+    if (n > pb->len) return NULL;
+    pb->head += n;
+    pb->len -= n;
+    return pktbuf_data(pb);
+}
+
+/** Drop bytes at the tail so that len becomes n. */
+static inline void pktbuf_trim(pktbuf_t* pb, const size_t n) {
+    if (n < pb->len) pb->len = n;
+}
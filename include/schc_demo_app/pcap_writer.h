@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Packet capture to a pcapng file.
+ *
+ * PCAP_CAPTURE() copies the packet into a preallocated lock-free ring and
+ * returns; a background thread writes the records through a large stdio
+ * buffer. When the ring is full the record is dropped and counted, the
+ * caller never waits. Disabled, a call site costs one relaxed load.
+ *
+ * Each stage is its own pcapng interface: "ipv6" carries the uncompressed
+ * IPv6/UDP packets (LINKTYPE_IPV6), the others SCHC packets and frames.
+ * SCHC has no link type of its own: they use LINKTYPE_USER0, which
+ * Wireshark can map to a dissector. Time stamps are in nanoseconds.
+ * Packets longer than PCAP_WRITER_SNAPLEN are truncated.
+ */
+
+#define PCAP_WRITER_SNAPLEN 512
+
+#define PCAP_LINKTYPE_IPV6 229
+#define PCAP_LINKTYPE_USER0 147
+
+typedef enum {
+    PCAP_STAGE_IPV6,        // IPv6/UDP packet before compression
+    PCAP_STAGE_SCHC,        // SCHC packet after compression
+    PCAP_STAGE_FRAGMENT,    // SCHC fragment
+    PCAP_STAGE_L2_RX,       // downlink frame payload
+    PCAP_NB_STAGES
+} pcap_stage;
+
+typedef enum {
+    PCAP_WRITER_INIT_OK, PCAP_WRITER_INIT_KO
+} pcap_writer_status;
+
+typedef struct {
+    uint64_t written;
+    uint64_t dropped;
+} pcap_writer_stats_t;
+
+extern int pcap_writer_on;
+
+/** Create path and start the writer. depth must be a power of two. */
+pcap_writer_status pcap_writer_init(const char* path, size_t depth);
+
+/** Write out every queued record, close the file and stop the writer. */
+void pcap_writer_fini(void);
+
+void pcap_writer_get_stats(pcap_writer_stats_t* stats);
+
+void pcap_writer_emit(pcap_stage stage, const uint8_t* buf, size_t len);
+
+#define PCAP_CAPTURE(stage, buf, len)                                               \
+    do {                                                                            \
+        if (__atomic_load_n(&pcap_writer_on, __ATOMIC_RELAXED)) {                   \
+            pcap_writer_emit((stage), (buf), (len));                                \
+        }                                                                           \
+    } while (0)
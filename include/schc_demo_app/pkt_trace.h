@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Packet trace.
+ *
+ * PKT_TRACE() copies at most PKT_TRACE_MAX_BYTES of the packet into a
+ * preallocated lock-free ring and returns; a background thread formats the
+ * records and writes them to a trace file or to the zlog "trace" category.
+ * When the ring is full the record is dropped and counted, the caller never
+ * waits.
+ *
+ * Levels are filtered twice: at compile time with PKT_TRACE_LEVEL (0 removes
+ * every call site) and at run time with pkt_trace_set_level(), which costs one
+ * relaxed load and a branch per call site.
+ */
+
+#ifndef PKT_TRACE_LEVEL
+#define PKT_TRACE_LEVEL 2
+#endif
+
+#define PKT_TRACE_OFF 0
+#define PKT_TRACE_SUMMARY 1   // label, seq, length
+#define PKT_TRACE_HEX 2       // summary plus a hex dump
+
+#define PKT_TRACE_MAX_BYTES 256
+
+typedef enum {
+    PKT_TRACE_INIT_OK, PKT_TRACE_INIT_KO
+} pkt_trace_status;
+
+typedef struct {
+    uint64_t written;
+    uint64_t dropped;
+} pkt_trace_stats_t;
+
+extern int pkt_trace_level;
+
+/**
+ * Start the trace writer. path NULL: log through the "trace" zlog category,
+ * otherwise append to that file. depth must be a power of two.
+ */
+pkt_trace_status pkt_trace_init(const char* path, size_t depth);
+
+/** Write out every queued record and stop the writer. */
+void pkt_trace_fini(void);
+
+void pkt_trace_set_level(int level);
+
+void pkt_trace_get_stats(pkt_trace_stats_t* stats);
+
+/** label must outlive the writer: pass a string literal. */
+void pkt_trace_emit(int level, const char* label, uint32_t seq, const uint8_t* buf, size_t len);
+
+#if PKT_TRACE_LEVEL > 0
+#define PKT_TRACE(level, label, seq, buf, len)                                      \
+    do {                                                                            \
+        if ((level) <= PKT_TRACE_LEVEL &&                                           \
+            (level) <= __atomic_load_n(&pkt_trace_level, __ATOMIC_RELAXED)) {       \
+            pkt_trace_emit((level), (label), (seq), (buf), (len));                  \
+        }                                                                           \
+    } while (0)
+#else
+#define PKT_TRACE(level, label, seq, buf, len) do {} while (0)
+#endif
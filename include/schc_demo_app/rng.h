@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Pseudo-random numbers for the simulation, the sensors and the link model.
+ *
+ * Each generator is a xoshiro256++ state owned by one thread: drawing takes
+ * no lock and a few cycles, unlike rand(), which goes through a libc lock
+ * and only returns 31 bits. Generators are seeded explicitly: (seed, stream)
+ * pairs give independent sequences, so one seed can hand a stream to each
+ * worker or device and a run replays identically.
+ *
+ * Code without a generator of its own uses rng_local(), the calling thread's:
+ * the thread that called rng_set_seed() draws stream 0 of that seed, every
+ * other thread the next stream on its first draw.
+ *
+ * Normal deviates come from a 128-layer ziggurat: one 64-bit draw and a
+ * multiply in 98.8% of cases, no log, sqrt or cos.
+ */
+
+typedef struct {
+    uint64_t s[4];
+} rng_t;
+
+/** Seed rng with stream 0 of seed. Every generator is seeded before its first draw. */
+void rng_seed(rng_t* rng, uint64_t seed);
+
+/** Seed rng with one of the independent streams of seed. */
+void rng_seed_stream(rng_t* rng, uint64_t seed, uint64_t stream);
+
+/** The calling thread's generator. */
+rng_t* rng_local(void);
+
+/** Reseed the calling thread's generator and the threads that have not drawn yet. */
+void rng_set_seed(uint64_t seed);
+
+static inline uint64_t rng_rotl(const uint64_t x, const int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(rng_t* rng) {
+    uint64_t* s = rng->s;
+    const uint64_t result = rng_rotl(s[0] + s[3], 23) + s[0];
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+/** Uniform in [0, n), without modulo bias (Lemire). 0 if n is 0. */
+static inline uint64_t rng_below(rng_t* rng, const uint64_t n) {
+    unsigned __int128 m = (unsigned __int128) rng_next(rng) * n;
+    if ((uint64_t) m < n) {
+        const uint64_t threshold = -n % n;
+        while ((uint64_t) m < threshold) m = (unsigned __int128) rng_next(rng) * n;
+    }
+    return (uint64_t) (m >> 64);
+}
+
+/** Uniform in [0, 1), 53 bits. */
+static inline double rng_uniform(rng_t* rng) {
+    return (double) (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+/** Uniform in [0, 1), 24 bits. */
+static inline float rng_uniform_f(rng_t* rng) {
+    return (float) (rng_next(rng) >> 40) * 0x1.0p-24f;
+}
+
+/** Standard normal deviate. */
+double rng_normal(rng_t* rng);
+
+/** Bulk draws: out[0..n) as n calls would fill it, with the state kept in registers. */
+void rng_fill_u64(rng_t* rng, uint64_t* out, size_t n);
+
+void rng_fill_uniform(rng_t* rng, double* out, size_t n);
+
+/** Normal deviates with the given mean and standard deviation. */
+void rng_fill_normal(rng_t* rng, double* out, size_t n, double mean, double stddev);
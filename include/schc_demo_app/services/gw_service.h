@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "../l2/l2.h"
+
+// Gateway side: SCHC uplink frames in, rebuilt IPv6/UDP packets out.
+// Frames are sharded by L2 source ID over a pool of workers, so a device
+// always lands on the same worker. Each worker owns the decompression
+// contexts of its devices (built from the SCHC service rules on first use)
+// and sends the rebuilt packets in batches, one sendmmsg() or writev() per
+// batch.
+//
+// Frames reach the workers one of two ways:
+// - one reader thread calls gw_submit(), which copies each frame into the
+//   queue of its worker. Works for any input (stream, pipe, socket), but the
+//   reader is serial: past one worker, adding workers only adds handoffs,
+//   and throughput stays at what that one thread can read and copy.
+// - for UDP input, gw_open_shards() gives each worker its own socket on the
+//   same port, and the kernel steers each datagram by its L2 source ID.
+//   Nothing is shared between workers, so they scale with the cores.
+
+// Frames use the loopback backend framing (l2_loop_ext.h):
+// [len_hi][len_lo][src][dst][type][flags][seq] followed by len payload bytes
+#define GW_WIRE_HDR_LEN 7
+#define GW_MAX_FRAME 255
+#define GW_MAX_PACKET 512   // rebuilt IPv6/UDP packet
+#define GW_BATCH 32
+
+typedef enum {
+    GW_OK, GW_FULL, GW_KO
+} gw_status;
+
+typedef struct {
+    uint32_t nb_workers;
+    size_t queue_depth;     // frames per worker, a power of two
+    int out_fd;             // -1: decompress and count only
+    bool out_stream;        // out_fd is a byte stream (writev), else a connected datagram socket (sendmmsg)
+    const int* in_fds;      // one socket per worker from gw_open_shards(), NULL: frames come from gw_submit()
+} gw_config_t;
+
+typedef struct {
+    uint64_t frames;        // taken from the queue
+    uint64_t packets;       // decompressed
+    uint64_t failed;        // unknown rule, fragment, or malformed
+    uint64_t sent;          // handed to out_fd
+    uint64_t send_failed;
+    uint64_t bytes_in;      // SCHC bytes
+    uint64_t bytes_out;     // IPv6 bytes
+    uint64_t batches;
+    uint64_t cpu_ns;        // worker thread CPU time
+} gw_worker_stats_t;
+
+typedef struct {
+    uint64_t queue_full;    // gw_submit() calls that found the queue full
+    uint32_t nb_workers;
+    gw_worker_stats_t total;
+} gw_stats_t;
+
+/**
+ * Parse one frame at buf[0..len). Returns the bytes it takes (header and
+ * payload), 0 if buf holds only part of it, or -1 if the length is invalid.
+ * payload points into buf.
+ */
+long gw_parse_frame(const uint8_t* buf, size_t len, l2_frame_meta_t* meta, const uint8_t** payload,
+                    size_t* payload_len);
+
+/**
+ * Open nb non-blocking UDP sockets bound to sa with SO_REUSEPORT, and steer
+ * each datagram (one frame) to fds[L2 source ID % nb], as gw_submit() shards.
+ * Port 0 picks one port for all. Returns 0, or -1 with errno set and no
+ * socket left open. The caller closes them after gw_stop().
+ */
+int gw_open_shards(const struct sockaddr* sa, socklen_t sa_len, uint32_t nb, int* fds);
+
+/** Start the workers. schc_service_init() must have succeeded. */
+gw_status gw_start(const gw_config_t* cfg);
+
+/**
+ * Queue a frame for the worker of meta->src; the payload is copied.
+ * Single producer: call from one thread only. Returns GW_FULL when that
+ * worker's queue is full; the caller retries or drops the frame. GW_KO when
+ * the workers read their own sockets.
+ */
+gw_status gw_submit(const l2_frame_meta_t* meta, const uint8_t* payload, size_t len);
+
+/** Wake the workers that got frames since the last call, once per input batch. */
+void gw_kick(void);
+
+/** Process every queued frame (or what is left in the worker sockets), flush the output and stop the workers. */
+void gw_stop(void);
+
+void gw_get_stats(gw_stats_t* stats);
+
+/** Counters of worker i; cpu_ns is read from its thread CPU clock while it runs. */
+void gw_get_worker_stats(uint32_t i, gw_worker_stats_t* stats);
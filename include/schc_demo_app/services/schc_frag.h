@@ -0,0 +1,156 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "schc_service.h"
+
+// SCHC fragmentation (RFC 8724) for SCHC packets larger than the L2 MTU.
+//
+// Profile, byte aligned so that tiles are never shifted:
+//   fragment  RuleID (8) | DTag (8) | W (2) FCN (6) | [RCS (32)] | tile
+//   ACK       RuleID (8) | DTag (8) | W (2) C (1) 0 (5) | [bitmap (64)]
+// Tiles are MTU - 3 bytes, one per fragment, so a fragment always fills the
+// MTU. A window holds 63 tiles (FCN 62..0); FCN 63 marks the All-1 fragment,
+// which carries the RCS, a CRC32 of the whole SCHC packet.
+//
+// No-ACK: W and FCN are 0 in regular fragments; the All-1 carries the last
+// tile and the receiver appends tiles in arrival order.
+// ACK-on-Error: every tile goes in a regular fragment numbered by W/FCN and
+// the All-1 carries the RCS only. The receiver answers each All-1 with an
+// ACK: C = 1 once the RCS matches, otherwise the bitmap of the first window
+// with missing tiles. The sender resends those tiles then the All-1, which
+// doubles as the ACK request.
+//
+// The sender only keeps a pointer to the packet: each fragment is handed to
+// the emit callback as a header plus a view of the tile inside the packet.
+// The receiver writes tiles straight to their place in a buffer provided by
+// the caller.
+
+#define SCHC_FRAG_NOACK_RULE_ID 20
+#define SCHC_FRAG_ACK_RULE_ID 21
+
+#define SCHC_FRAG_HDR_SIZE 3
+#define SCHC_FRAG_RCS_SIZE 4
+#define SCHC_FRAG_ACK_MAX_SIZE (SCHC_FRAG_HDR_SIZE + 8)
+#define SCHC_FRAG_WINDOW_SIZE 63
+#define SCHC_FRAG_MAX_WINDOWS 4
+#define SCHC_FRAG_MAX_ACK_REQ 4     // All-1 sent this many times without success: abort
+
+/** Largest SCHC packet that can be fragmented for a given MTU. */
+#define SCHC_FRAG_MAX_PACKET(mtu) ((size_t) SCHC_FRAG_MAX_WINDOWS * SCHC_FRAG_WINDOW_SIZE * ((mtu) - SCHC_FRAG_HDR_SIZE))
+
+typedef enum {
+    SCHC_FRAG_NO_ACK,
+    SCHC_FRAG_ACK_ON_ERROR
+} schc_frag_mode;
+
+typedef enum {
+    SCHC_FRAG_OK,       // in progress
+    SCHC_FRAG_DONE,     // sender: all sent (No-ACK) or acknowledged; receiver: packet complete
+    SCHC_FRAG_KO        // aborted, integrity check failed, or not a fragment of this session
+} schc_frag_status;
+
+typedef struct {
+    uint8_t hdr[SCHC_FRAG_HDR_SIZE + SCHC_FRAG_RCS_SIZE];
+    size_t hdr_len;
+    const uint8_t* tile;    // inside the packet given to schc_frag_sender_start()
+    size_t tile_len;
+} schc_frag_t;
+
+/** Return SCHC_FRAG_KO when the fragment cannot be queued now; it is offered again on the next poll. */
+typedef schc_frag_status (*schc_frag_emit_fn)(const schc_frag_t* frag, void* ctx);
+
+typedef enum {
+    SCHC_FRAG_IDLE,
+    SCHC_FRAG_SENDING,      // fragments left to emit
+    SCHC_FRAG_WAIT_ACK,     // ACK-on-Error: All-1 sent, the caller runs the retransmission timer
+    SCHC_FRAG_SENT,
+    SCHC_FRAG_ABORTED
+} schc_frag_state;
+
+typedef struct {
+    uint64_t fragments;
+    uint64_t retransmitted;
+    uint64_t ack_requests;
+} schc_frag_sender_stats_t;
+
+// Fields are private; the struct is public so that it can be allocated statically
+typedef struct {
+    schc_frag_state state;
+    schc_frag_mode mode;
+    uint8_t rule_id;
+    uint8_t dtag;
+    const uint8_t* pkt;
+    size_t len;
+    size_t tile_size;
+    uint32_t nb_tiles;          // regular fragments
+    size_t all1_off;            // start of the tile carried by the All-1 (len: none)
+    uint32_t rcs;
+    uint32_t next;              // next tile of the first pass
+    uint8_t retx_window;
+    uint64_t retx_bitmap;       // tiles of retx_window still to resend, bit i = tile i of the window
+    uint8_t all1_pending;
+    uint8_t abort_pending;
+    uint8_t ack_reqs;
+    schc_frag_emit_fn emit;
+    void* ctx;
+    schc_frag_sender_stats_t stats;
+} schc_frag_sender_t;
+
+/**
+ * Start sending pkt, which must stay untouched until the session ends.
+ * Returns SCHC_BUF_TOO_SMALL if pkt does not fit in the windows of this MTU.
+ * Nothing is emitted until schc_frag_sender_poll().
+ */
+schc_status_t schc_frag_sender_start(schc_frag_sender_t* s, schc_frag_mode mode, uint8_t dtag,
+                                     const uint8_t* pkt, size_t len, size_t mtu,
+                                     schc_frag_emit_fn emit, void* ctx);
+
+/** Emit pending fragments until done or until emit refuses one. */
+schc_frag_status schc_frag_sender_poll(schc_frag_sender_t* s);
+
+/** Handle an ACK received on the downlink; poll afterwards. */
+schc_frag_status schc_frag_sender_on_ack(schc_frag_sender_t* s, const uint8_t* ack, size_t len);
+
+/** No ACK in time: request one again, or abort after SCHC_FRAG_MAX_ACK_REQ tries; poll afterwards. */
+schc_frag_status schc_frag_sender_on_timeout(schc_frag_sender_t* s);
+
+typedef struct {
+    uint64_t packets;
+    uint64_t fragments;
+    uint64_t rcs_failures;
+    uint64_t aborted;
+} schc_frag_receiver_stats_t;
+
+// Fields are private
+typedef struct {
+    uint8_t* buf;
+    size_t cap;
+    size_t tile_size;
+    uint8_t active;
+    uint8_t complete;           // ACK-on-Error: answer a repeated All-1 with C = 1 again
+    uint8_t rule_id;
+    uint8_t dtag;
+    size_t len;                 // No-ACK: bytes appended; ACK-on-Error: end of the highest tile
+    uint64_t bitmap[SCHC_FRAG_MAX_WINDOWS];
+    schc_frag_receiver_stats_t stats;
+} schc_frag_receiver_t;
+
+/** Tiles are written into buf (cap bytes); mtu must match the sender's. */
+void schc_frag_receiver_init(schc_frag_receiver_t* r, uint8_t* buf, size_t cap, size_t mtu);
+
+/**
+ * Feed one fragment. On SCHC_FRAG_DONE the SCHC packet is in the buffer,
+ * *pkt_len bytes long, until the next call. If *ack_len is non-zero on
+ * return, ack (SCHC_FRAG_ACK_MAX_SIZE bytes) holds an ACK to send back.
+ */
+schc_frag_status schc_frag_receiver_input(schc_frag_receiver_t* r, const uint8_t* frag, size_t len,
+                                          size_t* pkt_len, uint8_t* ack, size_t* ack_len);
+
+/** True if the first byte of an L2 payload is a fragmentation rule ID. */
+static inline int schc_frag_is_fragment(const uint8_t* data, const size_t len) {
+    return len >= SCHC_FRAG_HDR_SIZE && (data[0] == SCHC_FRAG_NOACK_RULE_ID || data[0] == SCHC_FRAG_ACK_RULE_ID);
+}
+
+uint32_t schc_frag_crc32(const uint8_t* data, size_t len);
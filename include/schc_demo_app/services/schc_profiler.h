@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "schc_rule_engine.h"
+
+/*
+ * Rule miss profiler.
+ *
+ * Every packet sent with the no-compression rule is a miss. A miss is
+ * counted under its signature: the rule it came closest to (fewest fields
+ * differing) and the set of header fields that differ from it. Every
+ * sample_every-th miss of a thread also goes into a fixed-size reservoir of
+ * headers, an unbiased sample of all misses, from which the per-field
+ * value histograms are built and candidate rules are derived.
+ *
+ * For each signature, a candidate rule picks for every field the cheapest
+ * action that covers the sampled traffic: equal/not-sent for a constant,
+ * MSB/LSB for values sharing leading bits, mapping-sent for a few values,
+ * compute for consistent lengths and checksums, value-sent otherwise. The
+ * compiled rules match on mask and value only, so a mapping-sent field is
+ * expanded into one rule per value: the rule ID carries the mapping index.
+ * Savings are measured on the samples and scaled to the signature's count.
+ *
+ * Disabled, a miss costs one relaxed load. Enabled, counting takes a few
+ * atomic operations and a compare against each rule; sampling takes a lock.
+ */
+
+#define SCHC_PROFILER_RESERVOIR 4096   /* sampled headers kept */
+#define SCHC_PROFILER_SIGNATURES 128
+#define SCHC_PROFILER_MAX_CANDIDATES 8
+#define SCHC_PROFILER_MAX_MAPPING 4     /* values of a mapping-sent field */
+#define SCHC_PROFILER_TOP_VALUES 8      /* per field in the histograms */
+
+typedef enum {
+    SCHC_PROFILER_OK, SCHC_PROFILER_KO
+} schc_profiler_status;
+
+typedef struct {
+    uint64_t misses;
+    uint64_t sampled;           /* misses offered to the reservoir */
+    uint64_t other;             /* misses whose signature did not fit in the table */
+    size_t nb_signatures;
+} schc_profiler_stats_t;
+
+typedef struct {
+    uint16_t rule_id;           /* closest rule, the default rule ID if there were none */
+    uint16_t fields;            /* bit i: schc_hdr_fields[i] differs from that rule */
+    uint64_t count;
+} schc_miss_signature_t;
+
+typedef struct {
+    uint64_t value;             /* right-aligned; prefixes and IIDs in full */
+    uint32_t count;             /* in the reservoir */
+} schc_value_count_t;
+
+typedef struct {
+    schc_rule_desc_t rules[SCHC_PROFILER_MAX_MAPPING];  /* one per mapped value */
+    schc_field_desc_t fields[SCHC_PROFILER_MAX_MAPPING][SCHC_NB_HDR_FIELDS];
+    uint8_t tvs[SCHC_PROFILER_MAX_MAPPING][SCHC_NB_HDR_FIELDS][8];
+    uint8_t nb_rules;
+    uint16_t residue_bits;      /* sent per packet, rule ID excluded */
+    int8_t mapped_field;        /* index in schc_hdr_fields of the mapping-sent field, -1: none */
+    schc_miss_signature_t signature;
+    double coverage;            /* share of the signature's samples it compresses */
+    uint64_t bytes_saved;       /* estimate over the signature's misses */
+} schc_rule_candidate_t;
+
+extern int schc_profiler_on;
+
+/** Clear everything and count the misses from now on. sample_every >= 1. */
+schc_profiler_status schc_profiler_start(uint32_t sample_every);
+
+/** Stop counting; what was recorded stays available. */
+void schc_profiler_stop(void);
+
+/** A miss of the packet pkt[0..len) against the rules of eng. */
+void schc_profiler_miss(const schc_engine_t* eng, const uint8_t* pkt, size_t len);
+
+#define SCHC_PROFILE_MISS(eng, pkt, len)                                            \
+    do {                                                                            \
+        if (__atomic_load_n(&schc_profiler_on, __ATOMIC_RELAXED)) {                 \
+            schc_profiler_miss((eng), (pkt), (len));                                \
+        }                                                                           \
+    } while (0)
+
+void schc_profiler_get_stats(schc_profiler_stats_t* stats);
+
+/** Signatures by decreasing count; returns how many were written. */
+size_t schc_profiler_signatures(schc_miss_signature_t* out, size_t cap);
+
+/** Most frequent sampled values of schc_hdr_fields[field], by decreasing count. */
+size_t schc_profiler_histogram(size_t field, schc_value_count_t* out, size_t cap);
+
+/**
+ * Derive candidate rules from the samples, by decreasing estimated savings.
+ * Rule IDs are the first free ones of eng (rule_id_bits wide), past the
+ * fragmentation and no-compression rule IDs.
+ */
+size_t schc_profiler_derive(const schc_engine_t* eng, schc_rule_candidate_t* out, size_t cap);
+
+/** Log the signatures, the histograms of the fields that missed, and the candidates. */
+void schc_profiler_report(const schc_engine_t* eng);
+
+/**
+ * Write the rules of eng followed by the candidates as an RFC 9363 JSON rule
+ * set: schc-rulec compiles it into an image for schc-demo-app -S.
+ */
+schc_profiler_status schc_profiler_write_rules(const schc_engine_t* eng, const char* path);
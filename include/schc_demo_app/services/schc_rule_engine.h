@@ -0,0 +1,189 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compiled-rule fast path for IPv6/UDP SCHC compression.
+// Rules are flattened at init into a mask/value image of the 48-byte header,
+// so matching a packet is a handful of 64-bit compares instead of a walk over
+// every field of every rule.
+// Rules with the same mask (same matched fields, different target values)
+// share a hash table keyed by the masked header, so selecting a rule costs
+// one probe per distinct mask however many rules the set has.
+// The work per lookup is constant, the memory it touches is not: past the
+// 64 headers of the signature cache every lookup probes the tables, and past
+// a few hundred rules (216 bytes each) the probed rule is no longer in L1.
+// bench-rules measures select at 1000 rules 2.5 times its cost at 10,
+// where a linear scan costs 100 times more.
+
+#define SCHC_HDR_LEN 48           /* IPv6(40) + UDP(8) */
+#define SCHC_HDR_WORDS (SCHC_HDR_LEN / 8)
+#define SCHC_MAX_RULE_FIELDS 16
+#define SCHC_RULE_ID_MAX_BITS 16  /* rule IDs are 8 or 16 bits, sent big endian */
+
+/* One field of a rule, in the same terms as the SDK's rule_field_t. */
+typedef struct {
+    uint8_t fid;        /* field_id_t */
+    uint16_t len;       /* field length in bits */
+    uint8_t mo;         /* matching_operator_t */
+    uint8_t cda;        /* cda_t */
+    const uint8_t* tv;  /* MSB-first target value, NULL if the field has none */
+    uint8_t msb_len;    /* MO_MSB: leading bits matched against tv; CDA_LSB sends the others */
+} schc_field_desc_t;
+
+typedef struct {
+    uint16_t rule_id;
+    uint8_t nb_fields;
+    const schc_field_desc_t* fields;
+} schc_rule_desc_t;
+
+typedef struct {
+    uint16_t bit_off;   /* offset of the field inside the header */
+    uint16_t bit_len;
+} schc_residue_t;
+
+/* Where each uplink field sits in the header (the device is the source) */
+typedef struct {
+    uint8_t fid;
+    uint16_t bit_off;
+    uint16_t bit_len;
+} schc_field_layout_t;
+
+#define SCHC_NB_HDR_FIELDS 14
+
+/* Every field of the IPv6/UDP header, in header order */
+extern const schc_field_layout_t schc_hdr_fields[SCHC_NB_HDR_FIELDS];
+
+/* Fields the decompressor recomputes instead of taking from the rule */
+#define SCHC_COMPUTE_IPV6_LEN  0x01u
+#define SCHC_COMPUTE_UDP_LEN   0x02u
+#define SCHC_COMPUTE_UDP_CSUM  0x04u
+
+typedef struct {
+    uint64_t mask[SCHC_HDR_WORDS];
+    uint64_t value[SCHC_HDR_WORDS];
+    uint8_t rebuild[SCHC_HDR_LEN];  /* header template: every not-sent target value in place */
+    uint16_t rule_id;
+    uint8_t nb_residues;
+    uint8_t compute;                /* SCHC_COMPUTE_* */
+    uint16_t residue_bits;
+    schc_residue_t residues[SCHC_MAX_RULE_FIELDS];
+} schc_compiled_rule_t;
+
+/* Rules sharing one mask: open-addressing table of rule index + 1, 0 = empty */
+typedef struct {
+    uint64_t mask[SCHC_HDR_WORDS];
+    uint32_t slot_off;                 /* the group's table in slots */
+    uint32_t slot_mask;                /* table size - 1, a power of two minus one */
+    uint32_t first;                    /* lowest rule index in the group */
+    uint32_t reserved;
+} schc_rule_group_t;
+
+/*
+ * Compiled rules, index and rule ID table are flat arrays without pointers,
+ * so an engine can be saved to a rule image and mapped back as is.
+ */
+typedef struct {
+    schc_compiled_rule_t* rules;
+    size_t nb_rules;
+    schc_rule_group_t* groups;         /* by first rule index */
+    size_t nb_groups;
+    uint32_t* slots;                   /* every group's table, one allocation */
+    size_t nb_slots;
+    uint64_t sig_mask[SCHC_HDR_WORDS]; /* union of all rule masks: the header signature */
+    int32_t* by_id;                    /* rule ID -> index in rules, -1 if unknown; 2^rule_id_bits entries */
+    uint32_t generation;
+    uint16_t default_rule_id;
+    uint8_t rule_id_bits;
+    void* image;                       /* mapped rule image the arrays point into, NULL if allocated */
+    size_t image_len;
+} schc_engine_t;
+
+typedef enum {
+    SCHC_ENGINE_OK,
+    SCHC_ENGINE_NO_MATCH,
+    SCHC_ENGINE_BUF_TOO_SMALL,
+    SCHC_ENGINE_UNSUPPORTED,
+    SCHC_ENGINE_UNKNOWN_RULE,
+    SCHC_ENGINE_KO
+} schc_engine_status;
+
+/**
+ * Flatten rule descriptors into a compiled engine.
+ * Rules are in priority order: when several match, the first one is used.
+ * rule_id_bits is 8 or 16, and every rule ID must fit in it.
+ * Returns SCHC_ENGINE_UNSUPPORTED if any field uses an MO/CDA the fast path
+ * cannot reproduce bit-exactly; the caller should then stay on the SDK path.
+ */
+schc_engine_status schc_engine_compile(schc_engine_t* eng,
+                                       const schc_rule_desc_t* rules, size_t nb_rules,
+                                       uint8_t rule_id_bits, uint16_t default_rule_id);
+
+void schc_engine_free(schc_engine_t* eng);
+
+/**
+ * Describe compiled rule idx as rule descriptors again, one field per header
+ * field: rd->fields points to fields, whose target values point into tvs.
+ * Recompiling the description gives the same rule, so rules from an image
+ * can be written back out (see schc_rule_json_write()).
+ */
+schc_engine_status schc_engine_describe(const schc_engine_t* eng, size_t idx, schc_rule_desc_t* rd,
+                                        schc_field_desc_t fields[SCHC_NB_HDR_FIELDS],
+                                        uint8_t tvs[SCHC_NB_HDR_FIELDS][8]);
+
+/**
+ * Write a compiled engine to path as a rule image.
+ * The image is native-endian and tied to this build's struct layout: build
+ * it with the rule compiler of the same version as the application.
+ */
+schc_engine_status schc_engine_save(const schc_engine_t* eng, const char* path);
+
+/**
+ * Map a rule image read-only and use it in place: nothing is copied or
+ * allocated, the engine arrays point into the mapping. The image is checked
+ * before use; schc_engine_free() unmaps it.
+ */
+schc_engine_status schc_engine_load(schc_engine_t* eng, const char* path);
+
+/**
+ * Select the rule for a header, consulting the per-thread signature cache,
+ * then the per-mask hash tables.
+ * Returns the rule index or -1 if no rule matches.
+ */
+int32_t schc_engine_select(const schc_engine_t* eng, const uint8_t* hdr);
+
+/**
+ * Compress in[0..in_len) with the compiled rules.
+ * On success writes rule ID + residue + payload to out and the length in bits
+ * to out_bits. Returns SCHC_ENGINE_NO_MATCH when the caller must fall back to
+ * the default (no-compression) rule.
+ */
+schc_engine_status schc_engine_compress(const schc_engine_t* eng,
+                                        const uint8_t* in, size_t in_len,
+                                        uint8_t* out, size_t out_cap,
+                                        size_t* out_bits);
+
+/**
+ * Compress the packet at pkt[0..len) in place.
+ * The SCHC packet starts at pkt + *out_off and is *out_bits long. When the
+ * rule ID and residue end on a byte boundary the payload is left where it is;
+ * otherwise it is shifted down and *moved is set.
+ */
+schc_engine_status schc_engine_compress_inplace(const schc_engine_t* eng,
+                                                uint8_t* pkt, size_t len,
+                                                size_t* out_off, size_t* out_bits,
+                                                int* moved);
+
+/**
+ * Rebuild the IPv6/UDP packet carried by a SCHC packet of in_len bytes.
+ * The header and payload are written straight into out; lengths and the UDP
+ * checksum are recomputed where the rule says so. Packets sent with the
+ * default rule are returned as they were before compression.
+ */
+schc_engine_status schc_engine_decompress(const schc_engine_t* eng,
+                                          const uint8_t* in, size_t in_len,
+                                          uint8_t* out, size_t out_cap,
+                                          size_t* out_len);
+
+/** Rule ID a SCHC packet starts with, read as schc_engine_decompress() does; -1 if in_len is too short. */
+int32_t schc_engine_rule_id(const schc_engine_t* eng, const uint8_t* in, size_t in_len);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "schc_rule_engine.h"
+
+// Reader for SCHC rule sets written in the JSON encoding of the RFC 9363
+// data model ("ietf-schc:schc" -> "rule" -> "entry"). Only what the
+// IPv6/UDP compressor can use is read: compression rules of the uplink
+// direction, their fields, MOs, CDAs and first target value. The result is
+// a set of rule descriptors ready for schc_engine_compile().
+// Used offline by the rule compiler; the application maps the compiled image.
+// The writer emits the same subset, so a derived rule set (see
+// schc_profiler.h) goes back through the rule compiler unchanged.
+
+typedef struct {
+    schc_rule_desc_t* rules;    /* in file order, which is the priority order */
+    size_t nb_rules;
+    uint8_t rule_id_bits;       /* 8 or 16, the largest rule-id-length in the file */
+    uint16_t default_rule_id;   /* the no-compression rule */
+    void* storage;              /* fields and target values the rules point into */
+} schc_rule_set_t;
+
+typedef enum {
+    SCHC_RULE_JSON_OK,
+    SCHC_RULE_JSON_SYNTAX,      /* not JSON */
+    SCHC_RULE_JSON_INVALID,     /* JSON, but not a rule set this compressor can use */
+    SCHC_RULE_JSON_NO_MEM
+} schc_rule_json_status;
+
+/**
+ * Parse json[0..len) into set. On error *err_line is the line the parser
+ * stopped at and err_msg (if not NULL, err_cap bytes) says why.
+ */
+schc_rule_json_status schc_rule_json_parse(const char* json, size_t len, schc_rule_set_t* set,
+                                           size_t* err_line, char* err_msg, size_t err_cap);
+
+void schc_rule_set_free(schc_rule_set_t* set);
+
+/**
+ * Write set as RFC 9363 JSON: its rules in order, then the no-compression
+ * rule. Fields are written with their target value and, for mo-msb, the
+ * number of bits matched. storage is not used.
+ */
+schc_rule_json_status schc_rule_json_write(FILE* f, const schc_rule_set_t* set);
@@ -2,6 +2,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "../net/pktbuf.h"
+#include "schc_rule_engine.h"
+
 typedef enum {
     SCHC_OK = 0,
     SCHC_ERR = 1,
@@ -9,12 +12,139 @@ typedef enum {
     SCHC_MODE_NOT_AVAILABLE = 3
 } schc_status_t;
 
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+} schc_cspan_t;
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+} schc_span_t;
+
 schc_status_t schc_service_init();
 
+/**
+ * Use the rule image at path (built by schc-rulec) instead of the built-in
+ * rule from the next schc_service_init() on. The image is mapped and used
+ * in place; path is copied. NULL goes back to the built-in rule.
+ */
+schc_status_t schc_service_set_rule_file(const char* path);
+
+/**
+ * Replace the rules while other threads compress: map the rule image at
+ * path (NULL: the current rule image, or the built-in rule if there is none)
+ * and swap it in. Calls in progress finish with the rules they started
+ * with, none of them waits; the old rules are freed once they are done.
+ * On failure the current rules stay.
+ */
+schc_status_t schc_service_reload_rules(const char* path);
+
+/**
+ * Replace the built-in rule with rules[0..nb_rules), in priority order.
+ * Rule IDs take rule_id_bits (8 or 16) bits on air; none may start like a
+ * fragmentation rule ID. The rules are compiled, the descriptors are not
+ * kept. Swapped in like schc_service_reload_rules().
+ */
+schc_status_t schc_service_set_rules(const schc_rule_desc_t* rules, size_t nb_rules,
+                                     uint8_t rule_id_bits, uint16_t default_rule_id);
+
 schc_status_t schc_service_compress(const uint8_t* in, size_t in_len,
                                     uint8_t* out, size_t out_cap,
                                     size_t* out_len);
 
+/**
+ * Compress the IPv6/UDP packet held by pb in place.
+ * On return pb holds the SCHC packet: the rule ID and residue overwrite the
+ * tail of the header, and the no-compression rule ID is pushed into the
+ * headroom, so the payload is not copied in either case.
+ */
+schc_status_t schc_service_compress_pkt(pktbuf_t* pb);
+
+/**
+ * Compress count packets in one call.
+ * in[i] is compressed into out[i] (out[i].len is its capacity); status[i] and
+ * out_bits[i] receive the per-packet result. Nothing is logged per packet.
+ * Returns the number of packets compressed successfully.
+ */
+size_t schc_service_compress_batch(const schc_cspan_t* in, const schc_span_t* out,
+                                   size_t count,
+                                   schc_status_t* status, size_t* out_bits);
+
+/**
+ * Differential check of the compiled rules against the SDK on one packet:
+ * in is compressed by the fast path, into a buffer and in place, and by the
+ * SDK, and the statuses and emitted bits must be the same. Returns SCHC_OK
+ * if they are, SCHC_ERR on any difference (logged), and
+ * SCHC_MODE_NOT_AVAILABLE when the current rules are not the SDK's (only
+ * the built-in rule is). Nothing is counted.
+ */
+schc_status_t schc_service_check_fast_path(const uint8_t* in, size_t in_len);
+
+typedef struct {
+    uint64_t compressed;    // with a compression rule or the no-compression rule
+    uint64_t no_comp;       // of those, sent with the no-compression rule
+    uint64_t failed;
+} schc_service_stats_t;
+
+/**
+ * Totals of schc_service_compress(), _compress_pkt() and _compress_batch()
+ * over every thread. Each thread counts in its own slot; nothing is shared
+ * on the compression path.
+ */
+void schc_service_get_stats(schc_service_stats_t* stats);
+
+/**
+ * Rebuild the IPv6/UDP packet from a SCHC packet of in_len bytes using the
+ * same rule set as compression. The header and payload are written directly
+ * into out; no intermediate buffer is used. Safe to call from several threads.
+ */
+schc_status_t schc_service_decompress(const uint8_t* in, size_t in_len,
+                                      uint8_t* out, size_t out_cap,
+                                      size_t* out_len);
+
+/**
+ * Profile the packets sent with the no-compression rule from now on (see
+ * schc_profiler.h), sampling one miss in sample_every; 0 stops profiling.
+ * Starting again clears the profile.
+ */
+schc_status_t schc_service_profile_misses(uint32_t sample_every);
+
+/**
+ * Log the miss profile and the candidate rules derived from it for the
+ * current rules. With rules_out, also write the current rules followed by
+ * the candidates there, as a JSON rule set for schc-rulec.
+ */
+schc_status_t schc_service_profile_report(const char* rules_out);
+
+/* ------------------------------------------------------------ */
+/* Per-device contexts                                          */
+/* ------------------------------------------------------------ */
+
+/*
+ * A device's own copy of the compiled rules: same rule set, but the device
+ * prefix/IID target values are this device's address. Lets one process act
+ * as many devices; compressing with a context never logs.
+ */
+typedef struct schc_dev_ctx schc_dev_ctx_t;
+
+/** The device address is the service prefix followed by dev_iid. */
+schc_dev_ctx_t* schc_service_dev_ctx_new(const uint8_t dev_iid[8]);
+
+void schc_service_dev_ctx_free(schc_dev_ctx_t* ctx);
+
+const uint8_t* schc_service_dev_ctx_ip(const schc_dev_ctx_t* ctx);
+
+/** Same as schc_service_compress_pkt() with the device's rules. */
+schc_status_t schc_service_compress_pkt_dev(const schc_dev_ctx_t* ctx, pktbuf_t* pb);
+
+/**
+ * Same as schc_service_decompress() with the device's rules: the elided
+ * device address is rebuilt as the device's own. Never logs.
+ */
+schc_status_t schc_service_decompress_dev(const schc_dev_ctx_t* ctx, const uint8_t* in, size_t in_len,
+                                          uint8_t* out, size_t out_cap, size_t* out_len);
+
 /* ------------------------------------------------------------ */
 /* Rule context getters                                         */
 /* ------------------------------------------------------------ */
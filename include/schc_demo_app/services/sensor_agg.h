@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sensor_codec.h"
+#include "sensor_service.h"
+#include "../net/pktbuf.h"
+
+// Aggregation of several measurements into one UDP payload.
+// Samples are quantized with the sensor codec (see sensor_codec.h) as they
+// come in; the payload is then written once, with whichever encoding is
+// smaller for that batch:
+//   byte 0   bit 7: delta encoding, bits 0-6: number of samples
+//   packed   every sample bit-packed, SENSOR_CODEC_SIZE(count) bytes
+//   delta    first sample packed, then per sample and per field the zigzag
+//            LEB128 varint of the difference with the previous sample
+// The batch never grows past the byte budget given at init, so that the
+// compressed packet still fits in one L2 frame.
+
+#define SENSOR_AGG_MAX_SAMPLES 127
+
+typedef enum {
+    SENSOR_AGG_OK,      // added
+    SENSOR_AGG_READY,   // added, and the batch has max_samples: flush it
+    SENSOR_AGG_FULL,    // not added, it would not fit: flush then add again
+    SENSOR_AGG_KO
+} sensor_agg_status;
+
+typedef struct {
+    sensor_code_t samples[SENSOR_AGG_MAX_SAMPLES];
+    uint32_t count;
+    uint32_t max_samples;
+    size_t max_len;
+    size_t packed_len;  // payload size of the batch in each encoding
+    size_t delta_len;
+    uint64_t first_ns;  // time the first sample of the batch was added
+} sensor_agg_t;
+
+/** max_len: payload byte budget, at least one packed sample plus the count byte. */
+void sensor_agg_init(sensor_agg_t* agg, uint32_t max_samples, size_t max_len);
+
+sensor_agg_status sensor_agg_add(sensor_agg_t* agg, const sensor_data_t* data, uint64_t now_ns);
+
+/** Drop the current batch. */
+void sensor_agg_reset(sensor_agg_t* agg);
+
+/** Size the payload of the current batch has when flushed. */
+size_t sensor_agg_len(const sensor_agg_t* agg);
+
+/** Write the batch as the payload of pb and start a new one. */
+sensor_agg_status sensor_agg_flush(sensor_agg_t* agg, pktbuf_t* pb);
+
+/** Decode a batch payload into at most cap samples; *count receives how many. */
+sensor_agg_status sensor_agg_decode(const uint8_t* payload, size_t len, sensor_data_t* out, size_t cap, size_t* count);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sensor_service.h"
+
+// Bit-packed encoding of sensor_data_t.
+// Each field is described once in SENSOR_CODEC_SCHEMA: the value is clamped
+// to [min, min + (2^bits - 1) * step] and sent as the number of steps above
+// min, on exactly bits bits. Fields follow each other MSB first with no
+// padding, and so do consecutive samples; only the last byte is padded
+// with zeros. Inside the range a decoded value is within step / 2 of the
+// measured one.
+//
+//   field  min     step   bits  range
+//   temp   -10.00  0.01   13    -10.00 .. 71.91 degree C
+//   pH       0.00  0.01   11      0.00 .. 20.47
+//   bat      0     1       7      0    .. 127 %
+//
+// 31 bits per sample: 4 bytes instead of the 9 of the raw struct.
+
+typedef enum {
+    SENSOR_FIELD_FLOAT,
+    SENSOR_FIELD_U8
+} sensor_field_type;
+
+//      name  type                min     step   bits
+#define SENSOR_CODEC_SCHEMA(X) \
+    X(temp, SENSOR_FIELD_FLOAT, -10.0, 0.01, 13) \
+    X(pH,   SENSOR_FIELD_FLOAT,   0.0, 0.01, 11) \
+    X(bat,  SENSOR_FIELD_U8,      0.0, 1.0,   7)
+
+#define SENSOR_CODEC_FIELD_COUNT_(name, type, min, step, bits) + 1
+#define SENSOR_CODEC_FIELD_BITS_(name, type, min, step, bits) + (bits)
+
+#define SENSOR_CODEC_NB_FIELDS (0 SENSOR_CODEC_SCHEMA(SENSOR_CODEC_FIELD_COUNT_))
+#define SENSOR_CODEC_BITS (0 SENSOR_CODEC_SCHEMA(SENSOR_CODEC_FIELD_BITS_))
+/** Bytes taken by n packed samples. */
+#define SENSOR_CODEC_SIZE(n) (((size_t) (n) * SENSOR_CODEC_BITS + 7) / 8)
+
+typedef enum {
+    SENSOR_CODEC_OK, SENSOR_CODEC_KO
+} sensor_codec_status;
+
+typedef struct {
+    const char* name;
+    sensor_field_type type;
+    size_t offset;          // in sensor_data_t
+    double min;
+    double step;
+    uint8_t bits;
+} sensor_field_t;
+
+/** The schema above as a table, in wire order. */
+extern const sensor_field_t sensor_codec_fields[SENSOR_CODEC_NB_FIELDS];
+
+/** A quantized sample: per field, the number of steps above min. */
+typedef struct {
+    uint32_t v[SENSOR_CODEC_NB_FIELDS];
+} sensor_code_t;
+
+void sensor_codec_quantize(const sensor_data_t* data, sensor_code_t* code);
+
+void sensor_codec_dequantize(const sensor_code_t* code, sensor_data_t* data);
+
+/** Pack n quantized samples; returns the bytes written, SENSOR_CODEC_SIZE(n), or 0 if cap is too small. */
+size_t sensor_codec_pack(const sensor_code_t* codes, size_t n, uint8_t* out, size_t cap);
+
+/** Unpack n quantized samples from the first SENSOR_CODEC_SIZE(n) bytes of in. */
+sensor_codec_status sensor_codec_unpack(const uint8_t* in, size_t len, sensor_code_t* codes, size_t n);
+
+/** Quantize and pack n samples; returns the bytes written, or 0 if cap is too small. */
+size_t sensor_codec_encode(const sensor_data_t* data, size_t n, uint8_t* out, size_t cap);
+
+/** Decode n samples; len must be exactly SENSOR_CODEC_SIZE(n). */
+sensor_codec_status sensor_codec_decode(const uint8_t* in, size_t len, sensor_data_t* out, size_t n);
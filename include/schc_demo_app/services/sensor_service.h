@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 
+#include "../rng.h"
+
 // responsible for waking up
 // "performs" data sensing when woke up
 
@@ -11,10 +13,25 @@ typedef struct __attribute__((packed)) {
     uint8_t bat;
 } sensor_data_t;
 
+// Per-sensor state, for running several sensors in one process
+typedef struct {
+    rng_t rng;
+} sensor_state_t;
+
 typedef enum {
     measure_status_ok, measure_status_ko
 } measure_status;
 
-void sleep_gaussian(double mean_ms);
+/** Time to the next wake-up: Gaussian around mean_ms, 10% stddev, at least 1 ms. */
+uint64_t sensor_next_interval_ns(double mean_ms);
+
+/** Same as sensor_next_interval_ns() but draws from rng. */
+uint64_t sensor_next_interval_ns_r(rng_t* rng, double mean_ms);
 
+/** Draws from the calling thread's generator (see rng.h); thread-safe. */
 measure_status measure(sensor_data_t* data);
+
+void sensor_state_init(sensor_state_t* state, uint64_t seed);
+
+/** Same as measure() but draws from the sensor's own state; thread-safe. */
+measure_status measure_r(sensor_state_t* state, sensor_data_t* data);
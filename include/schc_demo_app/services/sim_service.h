@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../net/pktbuf.h"
+
+// Multi-device simulation: N virtual sensors in one process.
+// Each device has its own ID, IPv6 IID, sequence number, sensor state and
+// SCHC context. A single scheduler thread keeps every device's next Gaussian
+// wake-up in a min-heap and hands due devices to a pool of workers, which
+// build and compress the packet and pass it to the emit callback.
+
+typedef enum {
+    SIM_OK, SIM_KO
+} sim_status;
+
+/**
+ * Called on worker thread worker (0 .. nb_workers - 1) for the buffer the
+ * next packet is built in; NULL drops the packet. emit then gets that same
+ * buffer, so the packet can be sent from where it was built (e.g. a frame of
+ * the worker's own l2_tx lane). A buffer not emitted, because the build
+ * failed, is simply not used again. Optional: workers have their own buffer.
+ */
+typedef pktbuf_t* (*sim_acquire_fn)(uint32_t worker, void* ctx);
+
+/**
+ * Called on worker thread worker with the compressed packet of one device.
+ * A worker never runs two calls at once. due_ns is the CLOCK_MONOTONIC time
+ * the device was scheduled to wake up.
+ * Return SIM_KO if the packet could not be sent (counted as dropped).
+ */
+typedef sim_status (*sim_emit_fn)(uint32_t worker, uint32_t dev_id, uint32_t seq, uint64_t due_ns, pktbuf_t* pb,
+                                  void* ctx);
+
+typedef struct {
+    uint32_t nb_devices;
+    uint32_t first_id;      // device i has ID first_id + i and IID ::first_id + i
+    uint32_t nb_workers;
+    double interval_ms;     // mean wake-up interval, 10% standard deviation
+    uint32_t duration_s;
+    uint32_t seed;          // same seed, same readings and wake-up intervals per device (see rng.h)
+    uint8_t raw_payload;    // sensor_data_t as is instead of bit-packed
+    sim_acquire_fn acquire; // NULL: workers build in their own buffer
+    sim_emit_fn emit;
+    void* emit_ctx;         // passed to acquire and emit
+} sim_config_t;
+
+typedef struct {
+    uint64_t packets;       // built, compressed and emitted
+    uint64_t dropped;       // no buffer from acquire, or emit returned SIM_KO
+    uint64_t failed;        // build or compression failed
+    uint64_t overruns;      // wake-ups skipped because the worker queue was full
+    double elapsed_s;
+    // wake-up to emit, over a bounded random sample of the packets
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+} sim_report_t;
+
+/** Run the simulation for cfg->duration_s seconds; logs packets/s every second. */
+sim_status sim_run(const sim_config_t* cfg, sim_report_t* report);
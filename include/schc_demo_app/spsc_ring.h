@@ -0,0 +1,77 @@
+#pragma once
+
+#include <errno.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Cursors of a single-producer / single-consumer ring and the semaphore that
+// hands work over: the producer fills slot head & mask and publishes it, the
+// consumer sleeps on ready until woken, then takes every slot up to head and
+// releases them by moving tail. The caller owns the slot array (depth slots,
+// a power of two) and decides how often to wake: once per slot, or once per
+// batch of slots. The semaphore only puts the consumer to sleep; which slots
+// belong to whom is decided by head and tail alone, so a spurious wake-up is
+// harmless. Objects holding a ring must be 64-byte aligned.
+
+typedef struct {
+    _Alignas(64) _Atomic size_t head;   // next slot the producer fills
+    _Alignas(64) _Atomic size_t tail;   // next slot to be released
+    size_t mask;                        // depth - 1
+    sem_t ready;
+} spsc_ring_t;
+
+/** 0, or -1 if depth is not a power of two. */
+static inline int spsc_ring_init(spsc_ring_t* r, const size_t depth) {
+    if (depth == 0 || (depth & (depth - 1)) != 0) return -1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->mask = depth - 1;
+    return sem_init(&r->ready, 0, 0);
+}
+
+static inline void spsc_ring_destroy(spsc_ring_t* r) {
+    sem_destroy(&r->ready);
+}
+
+/** Producer: head, the slot to fill, or false when the ring is full. */
+static inline bool spsc_ring_reserve(spsc_ring_t* r, size_t* head) {
+    const size_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (h - atomic_load_explicit(&r->tail, memory_order_acquire) > r->mask) return false;
+    *head = h;
+    return true;
+}
+
+/** Producer: hand over the slot filled at head; the consumer is not woken. */
+static inline void spsc_ring_publish(spsc_ring_t* r, const size_t head) {
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+static inline void spsc_ring_wake(spsc_ring_t* r) {
+    sem_post(&r->ready);
+}
+
+/** Consumer: sleep until woken; returns head, the end of the published slots. */
+static inline size_t spsc_ring_wait(spsc_ring_t* r) {
+    while (sem_wait(&r->ready) == -1 && errno == EINTR) {}
+    return atomic_load_explicit(&r->head, memory_order_acquire);
+}
+
+static inline size_t spsc_ring_head(spsc_ring_t* r) {
+    return atomic_load_explicit(&r->head, memory_order_acquire);
+}
+
+static inline size_t spsc_ring_tail(spsc_ring_t* r) {
+    return atomic_load_explicit(&r->tail, memory_order_relaxed);
+}
+
+/** Give back every slot before tail to the producer. */
+static inline void spsc_ring_release(spsc_ring_t* r, const size_t tail) {
+    atomic_store_explicit(&r->tail, tail, memory_order_release);
+}
+
+/** Slots published and not yet released. */
+static inline size_t spsc_ring_used(spsc_ring_t* r) {
+    return atomic_load_explicit(&r->head, memory_order_relaxed) - atomic_load_explicit(&r->tail, memory_order_acquire);
+}
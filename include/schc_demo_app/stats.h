@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Runtime instrumentation: per-stage latency histograms and packet counters.
+ *
+ * Every thread that records gets its own shard on first use and is the only
+ * writer of it, so recording is a few relaxed loads and stores with no shared
+ * cache line and no lock. Readers add the shards up; a snapshot taken while
+ * threads record may be a few events behind, never torn within a counter.
+ *
+ * Histograms are log-linear (HDR style): 32 sub-buckets per power of two,
+ * so a reported percentile is within 3% of the recorded value.
+ */
+
+typedef enum {
+    STAT_SENSE,         // measure()
+    STAT_BUILD,         // payload encoding and IPv6/UDP header
+    STAT_COMPRESS,      // SCHC compression
+    STAT_LOG,           // logging on the per-packet path
+    STAT_L2_SEND,       // l2_xmit(), the serial write
+    STAT_TX_LATENCY,    // frame built to l2_xmit() done
+    STAT_RATIO,         // SCHC packet size / IPv6 packet size, in thousandths
+    STAT_NB_HISTS
+} stat_hist;
+
+typedef enum {
+    STAT_PKT_BUILT,
+    STAT_PKT_COMPRESSED,
+    STAT_PKT_FRAGMENTED,
+    STAT_PKT_DROPPED_SIZE,  // too large even for fragmentation, or a session was busy
+    STAT_PKT_DROPPED_QUEUE, // TX queue full
+    STAT_L2_SENT,
+    STAT_L2_FAILED,
+    STAT_BYTES_IN,          // IPv6 packets handed to the compressor
+    STAT_BYTES_OUT,         // SCHC packets it produced
+    STAT_NB_COUNTERS
+} stat_counter;
+
+typedef struct {
+    uint64_t count;
+    double mean;
+    uint64_t p50, p90, p99, p999, max;
+} stat_hist_summary_t;
+
+/** Add n to a counter of the calling thread's shard. */
+void stats_count(stat_counter c, uint64_t n);
+
+/** Record one value (nanoseconds for the stages). */
+void stats_record(stat_hist h, uint64_t value);
+
+uint64_t stats_get_counter(stat_counter c);
+
+void stats_get_hist(stat_hist h, stat_hist_summary_t* out);
+
+/**
+ * Text report of every counter and non-empty histogram, one line each.
+ * extra, if not NULL, is appended as is (counters owned by other modules).
+ * Returns the length written, truncated to cap - 1.
+ */
+size_t stats_format(char* buf, size_t cap, const char* extra);
+
+/** stats_format() through the "stat" zlog category, one record per line. */
+void stats_log(const char* extra);
@@ -1,3 +1,21 @@
 #pragma once
 
-double gaussian_random(double mean, double stddev);
\ No newline at end of file
+#include <stdint.h>
+#include <time.h>
+
+// Normal deviate from the calling thread's generator (see rng.h)
+double gaussian_random(double mean, double stddev);
+
+// Nanoseconds on the monotonic clock: intervals, deadlines, latencies
+static inline uint64_t monotonic_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// Nanoseconds since the Unix epoch: time stamps read outside the process
+static inline uint64_t realtime_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
@@ -0,0 +1,364 @@
+#include "async_log.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger_helper.h"
+#include "utils.h"
+
+#define TEXT_CAP 512
+#define IDLE_SLEEP_NS 1000000
+
+typedef struct {
+    const alog_site_t* site;
+    uint64_t ts_ns;
+    uint8_t nargs;
+    uint8_t types[ALOG_MAX_ARGS];
+    uint8_t str_used;
+    uint64_t args[ALOG_MAX_ARGS];   // strings: offset << 8 | length in str
+    char str[ALOG_STR_BYTES];
+} record_t;
+
+_Static_assert(sizeof(record_t) == 128, "two cache lines per record");
+
+typedef struct {
+    _Alignas(64) _Atomic size_t head;      // written by the owning thread
+    _Atomic uint64_t dropped;
+    _Alignas(64) _Atomic size_t tail;      // written by the writer thread
+    record_t records[];
+} ring_t;
+
+// Set while the owner of slot i is between its running check and its publish
+typedef struct {
+    _Alignas(64) atomic_bool busy;
+} producing_t;
+
+// Rings are never freed: a thread keeps its ring for its lifetime, across alog_init() calls
+static _Atomic(ring_t*) rings[ALOG_MAX_THREADS];
+static producing_t producing[ALOG_MAX_THREADS];
+static _Atomic unsigned nb_claimed = 0;
+static size_t ring_mask = 0;        // set by the first alog_init()
+
+static __thread ring_t* t_ring = NULL;
+static __thread producing_t* t_producing = NULL;
+static __thread bool t_no_ring = false;
+
+static pthread_t writer;
+static atomic_bool running = false;
+static atomic_bool stopping = false;
+static bool atexit_done = false;
+
+static _Atomic uint64_t st_written = 0;
+static _Atomic uint64_t st_direct = 0;
+static uint64_t dropped_reported = 0;     // writer thread only
+
+/* ------------------------------------------------------------------------- */
+/* Formatting                                                                */
+/* ------------------------------------------------------------------------- */
+
+static size_t put(const size_t cap, const size_t pos, const int n) {
+    if (n < 0) return pos;
+    return pos + (size_t) n < cap ? pos + (size_t) n : cap - 1;
+}
+
+// Format one conversion; spec holds the flags, width and precision without length modifier
+static size_t format_arg(char* out, const size_t cap, size_t pos, char* spec, size_t spec_len, const char conv,
+                         const record_t* r, const size_t a) {
+    const uint8_t type = r->types[a];
+    const uint64_t v = r->args[a];
+    long long i = (long long) v;
+    double d;
+    memcpy(&d, &v, sizeof(d));
+    if (type == ALOG_ARG_DBL) i = (long long) d;
+    if (type == ALOG_ARG_INT) d = (double) i;
+
+    switch (conv) {
+        case 'd': case 'i':
+            memcpy(spec + spec_len, "lld", 4);
+            return put(cap, pos, snprintf(out + pos, cap - pos, spec, i));
+        case 'u': case 'o': case 'x': case 'X':
+            spec[spec_len] = 'l';
+            spec[spec_len + 1] = 'l';
+            spec[spec_len + 2] = conv;
+            spec[spec_len + 3] = '\0';
+            return put(cap, pos, snprintf(out + pos, cap - pos, spec, (unsigned long long) i));
+        case 'c':
+            memcpy(spec + spec_len, "c", 2);
+            return put(cap, pos, snprintf(out + pos, cap - pos, spec, (int) i));
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            spec[spec_len] = conv;
+            spec[spec_len + 1] = '\0';
+            return put(cap, pos, snprintf(out + pos, cap - pos, spec, d));
+        case 's': {
+            char s[ALOG_STR_BYTES + 1] = "(not a string)";
+            if (type == ALOG_ARG_STR) {
+                const size_t off = (size_t) (v >> 8), len = (size_t) (v & 0xFF);
+                memcpy(s, r->str + off, len);
+                s[len] = '\0';
+            }
+            memcpy(spec + spec_len, "s", 2);
+            return put(cap, pos, snprintf(out + pos, cap - pos, spec, s));
+        }
+        case 'p':
+            memcpy(spec + spec_len, "p", 2);
+            return put(cap, pos, snprintf(out + pos, cap - pos, spec, (void*) (uintptr_t) v));
+        default:
+            return put(cap, pos, snprintf(out + pos, cap - pos, "%%%c", conv));
+    }
+}
+
+static size_t format_record(const record_t* r, char* out, const size_t cap) {
+    size_t pos = 0;
+    size_t a = 0;
+    const char* p = r->site->fmt;
+
+    while (*p && pos + 1 < cap) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[pos++] = '%';
+            p += 2;
+            continue;
+        }
+
+        const char* start = p++;
+        while (*p && strchr("-+ #0", *p)) p++;
+        while (isdigit((unsigned char) *p)) p++;
+        if (*p == '.') {
+            p++;
+            while (isdigit((unsigned char) *p)) p++;
+        }
+        const char* modifiers = p;
+        while (*p && strchr("hlLqjzt", *p)) p++;
+        const char conv = *p;
+        if (!conv) break;
+        p++;
+
+        char spec[32];
+        size_t spec_len = (size_t) (modifiers - start);
+        if (spec_len > sizeof(spec) - 4) spec_len = sizeof(spec) - 4;
+        memcpy(spec, start, spec_len);
+        spec[spec_len] = '\0';
+
+        if (a >= r->nargs) {
+            pos = put(cap, pos, snprintf(out + pos, cap - pos, "(missing)"));
+            continue;
+        }
+        pos = format_arg(out, cap, pos, spec, spec_len, conv, r, a++);
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+static void fill_record(record_t* r, const alog_site_t* site, const size_t nargs, const alog_arg_t* args) {
+    r->site = site;
+    r->ts_ns = monotonic_now_ns();
+    r->nargs = (uint8_t) (nargs < ALOG_MAX_ARGS ? nargs : ALOG_MAX_ARGS);
+    r->str_used = 0;
+    for (size_t a = 0; a < r->nargs; a++) {
+        r->types[a] = (uint8_t) args[a].type;
+        switch (args[a].type) {
+            case ALOG_ARG_STR: {
+                const char* s = args[a].s ? args[a].s : "(null)";
+                const size_t room = ALOG_STR_BYTES - r->str_used;
+                const size_t len = strnlen(s, room);
+                memcpy(r->str + r->str_used, s, len);
+                r->args[a] = (uint64_t) r->str_used << 8 | len;
+                r->str_used = (uint8_t) (r->str_used + len);
+                break;
+            }
+            case ALOG_ARG_DBL:
+                memcpy(&r->args[a], &args[a].d, sizeof(double));
+                break;
+            case ALOG_ARG_PTR:
+                r->args[a] = (uint64_t) (uintptr_t) args[a].p;
+                break;
+            default:
+                r->args[a] = (uint64_t) args[a].i;
+                break;
+        }
+    }
+}
+
+static void write_record(const record_t* r) {
+    char text[TEXT_CAP];
+    format_record(r, text, sizeof(text));
+    const alog_site_t* s = r->site;
+    zlog(*s->cat, s->file, strlen(s->file), s->func, strlen(s->func), s->line, s->level, "%s", text);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Writer                                                                    */
+/* ------------------------------------------------------------------------- */
+
+// Ring whose oldest record is the oldest of all, NULL when every ring is empty
+static ring_t* oldest_ring(void) {
+    ring_t* best = NULL;
+    uint64_t best_ts = 0;
+    const unsigned n = atomic_load(&nb_claimed);
+    for (unsigned i = 0; i < n && i < ALOG_MAX_THREADS; i++) {
+        ring_t* r = atomic_load_explicit(&rings[i], memory_order_acquire);
+        if (!r) continue;
+        const size_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        if (t == atomic_load_explicit(&r->head, memory_order_acquire)) continue;
+        const uint64_t ts = r->records[t & ring_mask].ts_ns;
+        if (!best || ts < best_ts) {
+            best = r;
+            best_ts = ts;
+        }
+    }
+    return best;
+}
+
+static uint64_t total_dropped(void) {
+    uint64_t n = 0;
+    for (unsigned i = 0; i < ALOG_MAX_THREADS; i++) {
+        const ring_t* r = atomic_load_explicit(&rings[i], memory_order_acquire);
+        if (r) n += atomic_load_explicit(&r->dropped, memory_order_relaxed);
+    }
+    return n;
+}
+
+static bool any_producing(void) {
+    for (unsigned i = 0; i < ALOG_MAX_THREADS; i++) {
+        if (atomic_load(&producing[i].busy)) return true;
+    }
+    return false;
+}
+
+static void report_drops(void) {
+    const uint64_t dropped = total_dropped();
+    if (dropped == dropped_reported) return;
+    zlog_warn(error_cat, "%llu log records dropped, the log rings were full",
+              (unsigned long long) (dropped - dropped_reported));
+    dropped_reported = dropped;
+}
+
+static void* writer_main(void* arg) {
+    (void) arg;
+    const struct timespec idle = { 0, IDLE_SLEEP_NS };
+
+    // Producers never signal: the writer polls so that logging costs no syscall
+    for (;;) {
+        ring_t* r;
+        bool any = false;
+        while ((r = oldest_ring()) != NULL) {
+            const size_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            write_record(&r->records[t & ring_mask]);
+            atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+            atomic_fetch_add_explicit(&st_written, 1, memory_order_relaxed);
+            any = true;
+        }
+        report_drops();
+
+        if (!any) {
+            // Once stopping, producers log directly; wait for those already past the check
+            if (atomic_load(&stopping) && !any_producing() && !oldest_ring()) break;
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+static ring_t* claim_ring(void) {
+    const unsigned slot = atomic_fetch_add(&nb_claimed, 1);
+    if (slot >= ALOG_MAX_THREADS) return NULL;
+    ring_t* r = calloc(1, sizeof(*r) + (ring_mask + 1) * sizeof(record_t));
+    // A failed allocation leaves a hole the writer skips
+    if (r) {
+        t_producing = &producing[slot];
+        atomic_store_explicit(&rings[slot], r, memory_order_release);
+    }
+    return r;
+}
+
+static void log_direct(const alog_site_t* site, const size_t nargs, const alog_arg_t* args) {
+    record_t r;
+    fill_record(&r, site, nargs, args);
+    write_record(&r);
+    atomic_fetch_add_explicit(&st_direct, 1, memory_order_relaxed);
+}
+
+void alog_emit(const alog_site_t* site, const size_t nargs, const alog_arg_t* args) {
+    if (!t_ring && !t_no_ring && atomic_load_explicit(&running, memory_order_acquire)) {
+        t_ring = claim_ring();
+        t_no_ring = !t_ring;
+    }
+    ring_t* r = t_ring;
+    if (!r) {
+        log_direct(site, nargs, args);
+        return;
+    }
+
+    // Pairs with the writer's exit check: either it sees busy set, or we see running cleared
+    atomic_store(&t_producing->busy, true);
+    if (!atomic_load(&running)) {
+        atomic_store_explicit(&t_producing->busy, false, memory_order_release);
+        log_direct(site, nargs, args);
+        return;
+    }
+
+    const size_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (h - atomic_load_explicit(&r->tail, memory_order_acquire) > ring_mask) {
+        atomic_store_explicit(&r->dropped, atomic_load_explicit(&r->dropped, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+    } else {
+        fill_record(&r->records[h & ring_mask], site, nargs, args);
+        atomic_store_explicit(&r->head, h + 1, memory_order_release);
+    }
+    atomic_store_explicit(&t_producing->busy, false, memory_order_release);
+}
+
+size_t alog_format(const alog_site_t* site, const size_t nargs, const alog_arg_t* args, char* out,
+                   const size_t cap) {
+    if (!cap) return 0;
+    record_t r;
+    fill_record(&r, site, nargs, args);
+    return format_record(&r, out, cap);
+}
+
+static void fini_at_exit(void) {
+    alog_fini();
+}
+
+alog_status alog_init(const size_t depth) {
+    if (atomic_load(&running) || depth == 0 || (depth & (depth - 1)) != 0) return ALOG_INIT_KO;
+    if (ring_mask && ring_mask != depth - 1) return ALOG_INIT_KO;
+
+    ring_mask = depth - 1;
+    atomic_store(&stopping, false);
+    atomic_store(&running, true);
+
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        atomic_store(&running, false);
+        zlog_error(error_cat, "Log writer thread start failed");
+        return ALOG_INIT_KO;
+    }
+    if (!atexit_done) {
+        atexit(fini_at_exit);
+        atexit_done = true;
+    }
+    return ALOG_INIT_OK;
+}
+
+void alog_fini(void) {
+    if (!atomic_load(&running)) return;
+
+    atomic_store(&running, false);
+    atomic_store(&stopping, true);
+    pthread_join(writer, NULL);
+}
+
+void alog_get_stats(alog_stats_t* stats) {
+    stats->written = atomic_load_explicit(&st_written, memory_order_relaxed);
+    stats->dropped = total_dropped();
+    stats->direct = atomic_load_explicit(&st_direct, memory_order_relaxed);
+}
@@ -10,7 +10,38 @@
 #include "logger_helper.h"
 
 void print_usage(const char *prog_name) {
-    printf("TODO:");
+    printf("Usage: %s -k <hex key> [options]\n"
+           "       %s -N <devices> [simulation options]\n"
+           "       %s -r <packets> [-S rules.bin] [-m derived.json]\n"
+           "\n"
+           "Device:\n"
+           "  -i, --id <n>              modem ID\n"
+           "  -k, --key <hex>           encryption key, up to 32 hex characters\n"
+           "  -p, --port <port>         serial port; loopback build: mem, pty or unix:<path>\n"
+           "  -b, --baud <rate>         serial baud rate, only 115200\n"
+           "  -l, --link <spec>         loopback link model: bitrate=<bps>,latency_ms=<ms>,\n"
+           "                            jitter_ms=<ms>,loss=<0..1>,seed=<n>\n"
+           "  -A, --ack-on-error        fragment oversized packets in ACK-on-Error mode\n"
+           "  -K, --batch <n>           measurements per packet\n"
+           "  -M, --batch-delay-ms <ms> longest a measurement waits for its batch\n"
+           "  -R, --raw-payload         send the sensor struct as is instead of bit-packed\n"
+           "\n"
+           "SCHC rules and diagnostics:\n"
+           "  -S, --rules <rules.bin>   rule image built by schc-rulec instead of the built-in rule\n"
+           "  -C, --control <path>      UNIX datagram control socket (\"reload [<image>]\", \"stats\")\n"
+           "  -t, --trace <level>       packet trace: 0 off, 1 summary, 2 hex dump\n"
+           "  -P, --pcap <file>         capture every packet stage to a pcapng file\n"
+           "  -m, --miss-rules <file>   profile rule misses, write the derived rule set on exit\n"
+           "\n"
+           "Offline round trip:\n"
+           "  -r, --roundtrip <n>       compress and decompress n packets, then exit (no key)\n"
+           "\n"
+           "Simulation (no key):\n"
+           "  -N, --devices <n>         simulate n devices\n"
+           "  -w, --workers <n>         worker threads, default: CPUs - 1\n"
+           "  -D, --duration <s>        run length in seconds\n"
+           "  -I, --interval-ms <ms>    mean wake-up interval of each device\n",
+           prog_name, prog_name, prog_name);
 }
 
 int process_key(const char *hex, uint8_t *key_buffer, size_t key_size) {
@@ -45,7 +76,7 @@ int process_key(const char *hex, uint8_t *key_buffer, size_t key_size) {
     return 0;
 }
 
-cli_parse_status parse_cli_arguments(const int32_t argc, char* const * argv, uint8_t* id, uint8_t* key_buf, const size_t key_size, char** port_ptr, int32_t* baud) {
+cli_parse_status parse_cli_arguments(const int32_t argc, char* const * argv, cli_args_t* args) {
     const struct option options[] = {
         {"id", required_argument, 0, 'i'},
         {"key", required_argument, 0, 'k'},
@@ -53,6 +84,21 @@ cli_parse_status parse_cli_arguments(const int32_t argc, char* const * argv, uin
         {"baud", required_argument, 0, 'b'},
         {"trials", required_argument, 0, 'n'},
         {"size", required_argument, 0, 's'},
+        {"roundtrip", required_argument, 0, 'r'},
+        {"link", required_argument, 0, 'l'},
+        {"trace", required_argument, 0, 't'},
+        {"devices", required_argument, 0, 'N'},
+        {"workers", required_argument, 0, 'w'},
+        {"duration", required_argument, 0, 'D'},
+        {"interval-ms", required_argument, 0, 'I'},
+        {"ack-on-error", no_argument, 0, 'A'},
+        {"batch", required_argument, 0, 'K'},
+        {"batch-delay-ms", required_argument, 0, 'M'},
+        {"raw-payload", no_argument, 0, 'R'},
+        {"rules", required_argument, 0, 'S'},
+        {"control", required_argument, 0, 'C'},
+        {"pcap", required_argument, 0, 'P'},
+        {"miss-rules", required_argument, 0, 'm'},
         {0, 0, 0, 0}
     };
 
@@ -61,7 +107,8 @@ cli_parse_status parse_cli_arguments(const int32_t argc, char* const * argv, uin
     const char *id_arg = NULL;
     const char *key_hex = NULL;
     const char *baud_arg = NULL;
-    const char *shortopts = "i:k:p:b:";
+    const char *roundtrip_arg = NULL;
+    const char *shortopts = "i:k:p:b:r:l:t:N:w:D:I:AK:M:RS:C:P:m:";
     while ((opt = getopt_long(argc, argv, shortopts, options, &option_index)) != -1) {
         switch (opt) {
             case 'i':
@@ -71,11 +118,56 @@ cli_parse_status parse_cli_arguments(const int32_t argc, char* const * argv, uin
                 key_hex = optarg;
             break;
             case 'p':
-                *port_ptr = optarg;
+                args->port = optarg;
             break;
             case 'b':
                 baud_arg = optarg;
             break;
+            case 'r':
+                roundtrip_arg = optarg;
+            break;
+            case 'l':
+                args->link = optarg;
+            break;
+            case 't':
+                args->trace = (int32_t) atoi(optarg);
+            break;
+            case 'N':
+                args->devices = (uint32_t) strtoul(optarg, NULL, 10);
+            break;
+            case 'w':
+                args->workers = (uint32_t) strtoul(optarg, NULL, 10);
+            break;
+            case 'D':
+                args->duration = (uint32_t) strtoul(optarg, NULL, 10);
+            break;
+            case 'I':
+                args->interval_ms = strtod(optarg, NULL);
+            break;
+            case 'A':
+                args->frag_ack = 1;
+            break;
+            case 'K':
+                args->batch = (uint32_t) strtoul(optarg, NULL, 10);
+            break;
+            case 'M':
+                args->batch_delay_ms = strtod(optarg, NULL);
+            break;
+            case 'R':
+                args->raw_payload = 1;
+            break;
+            case 'S':
+                args->rules = optarg;
+            break;
+            case 'C':
+                args->control = optarg;
+            break;
+            case 'P':
+                args->pcap = optarg;
+            break;
+            case 'm':
+                args->miss_rules = optarg;
+            break;
             default:
                 print_usage(argv[0]);
             return CLI_PARSE_KO;
@@ -83,16 +175,28 @@ cli_parse_status parse_cli_arguments(const int32_t argc, char* const * argv, uin
     }
 
     if (id_arg) {
-        *id = (uint8_t) atoi(id_arg);
+        args->id = (uint8_t) atoi(id_arg);
+    }
+
+    if (roundtrip_arg) {
+        const long n = strtol(roundtrip_arg, NULL, 10);
+        if (n <= 0) {
+            zlog_error(error_cat, "Round trip count must be positive\n");
+            return CLI_PARSE_KO;
+        }
+        args->roundtrip = (uint32_t) n;
+        // Offline mode: no modem, no key needed
+        return CLI_PARSE_OK;
     }
 
-    if (!key_hex) {
+    // Simulated devices do not encrypt
+    if (!key_hex && !args->devices) {
         zlog_error(error_cat, "Error: Encryption key is required\n");
         print_usage(argv[0]);
         return CLI_PARSE_KO;
     }
 
-    if (process_key(key_hex, key_buf, key_size) != 0) {
+    if (key_hex && process_key(key_hex, args->key_buf, args->key_size) != 0) {
         return CLI_PARSE_KO;
     }
 
@@ -101,7 +205,7 @@ cli_parse_status parse_cli_arguments(const int32_t argc, char* const * argv, uin
         return CLI_PARSE_KO;
     }
 
-    *baud = B115200;
+    args->baud = B115200;
 
     return CLI_PARSE_OK;
 }
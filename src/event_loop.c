@@ -0,0 +1,225 @@
+#include "event_loop.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger_helper.h"
+#include "utils.h"
+
+#define EV_BATCH 16
+
+struct ev_timer {
+    int fd;
+    ev_timer_cb cb;
+    void* ctx;
+    uint64_t next;          // deadline of the next expiration
+    uint64_t deadline;      // deadline of the current / last expiration
+    uint64_t period;
+    // lateness statistics (Welford)
+    uint64_t fires;
+    uint64_t missed;
+    uint64_t late_max;
+    double late_mean;
+    double late_m2;
+};
+
+typedef struct {
+    int fd;                 // -1: free slot
+    ev_fd_cb cb;
+    void* ctx;
+    ev_timer_t* timer;      // set for timer handlers
+} ev_handler_t;
+
+static int epoll_fd = -1;
+static int stop_fd = -1;
+static atomic_bool stop_requested = false;
+static ev_handler_t handlers[EV_MAX_HANDLERS];
+
+uint64_t ev_now_ns(void) {
+    return monotonic_now_ns();
+}
+
+static struct timespec to_timespec(const uint64_t ns) {
+    return (struct timespec){ (time_t) (ns / 1000000000ull), (long) (ns % 1000000000ull) };
+}
+
+static ev_handler_t* add_handler(const int fd, const uint32_t events, const ev_fd_cb cb, void* ctx, ev_timer_t* timer) {
+    if (epoll_fd == -1 || fd < 0) return NULL;
+
+    for (size_t i = 0; i < EV_MAX_HANDLERS; i++) {
+        ev_handler_t* h = &handlers[i];
+        if (h->fd != -1) continue;
+
+        struct epoll_event ev = {0};
+        ev.events = events;
+        ev.data.ptr = h;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            zlog_error(error_cat, "epoll_ctl add fd %d: %s", fd, strerror(errno));
+            return NULL;
+        }
+        *h = (ev_handler_t){ fd, cb, ctx, timer };
+        return h;
+    }
+
+    zlog_error(error_cat, "Event loop handler table full");
+    return NULL;
+}
+
+static void on_stop(const int fd, const uint32_t events, void* ctx) {
+    (void) events;
+    (void) ctx;
+    uint64_t n;
+    (void) !read(fd, &n, sizeof(n));
+}
+
+ev_status ev_loop_init(void) {
+    if (epoll_fd != -1) return EV_OK;
+
+    for (size_t i = 0; i < EV_MAX_HANDLERS; i++) handlers[i].fd = -1;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd == -1 || stop_fd == -1 || !add_handler(stop_fd, EPOLLIN, on_stop, NULL, NULL)) {
+        zlog_error(error_cat, "Event loop init failed: %s", strerror(errno));
+        ev_loop_fini();
+        return EV_KO;
+    }
+
+    atomic_store(&stop_requested, false);
+    return EV_OK;
+}
+
+void ev_loop_fini(void) {
+    for (size_t i = 0; i < EV_MAX_HANDLERS; i++) {
+        if (handlers[i].timer) ev_timer_free(handlers[i].timer);
+    }
+    if (stop_fd != -1) close(stop_fd);
+    if (epoll_fd != -1) close(epoll_fd);
+    stop_fd = -1;
+    epoll_fd = -1;
+    for (size_t i = 0; i < EV_MAX_HANDLERS; i++) handlers[i].fd = -1;
+}
+
+void ev_loop_stop(void) {
+    atomic_store(&stop_requested, true);
+    if (stop_fd != -1) {
+        const uint64_t one = 1;
+        (void) !write(stop_fd, &one, sizeof(one));
+    }
+}
+
+ev_status ev_loop_add_fd(const int fd, const uint32_t events, const ev_fd_cb cb, void* ctx) {
+    return add_handler(fd, events, cb, ctx, NULL) ? EV_OK : EV_KO;
+}
+
+ev_status ev_loop_del_fd(const int fd) {
+    for (size_t i = 0; i < EV_MAX_HANDLERS; i++) {
+        if (handlers[i].fd == fd) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            handlers[i] = (ev_handler_t){ -1, NULL, NULL, NULL };
+            return EV_OK;
+        }
+    }
+    return EV_KO;
+}
+
+static void on_timer(const int fd, const uint32_t events, void* ctx) {
+    (void) events;
+    ev_timer_t* t = ctx;
+
+    uint64_t expirations = 0;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations) || !expirations) return;
+
+    const uint64_t now = ev_now_ns();
+    t->deadline = t->next + (expirations - 1) * t->period;
+    t->next = t->deadline + t->period;
+    t->missed += expirations - 1;
+
+    const uint64_t late = now > t->deadline ? now - t->deadline : 0;
+    t->fires++;
+    if (late > t->late_max) t->late_max = late;
+    const double delta = (double) late - t->late_mean;
+    t->late_mean += delta / (double) t->fires;
+    t->late_m2 += delta * ((double) late - t->late_mean);
+
+    t->cb(t, late, t->ctx);
+}
+
+ev_timer_t* ev_timer_new(const ev_timer_cb cb, void* ctx) {
+    if (!cb) return NULL;
+
+    ev_timer_t* t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    t->cb = cb;
+    t->ctx = ctx;
+    t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (t->fd == -1 || !add_handler(t->fd, EPOLLIN, on_timer, t, t)) {
+        if (t->fd != -1) close(t->fd);
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void ev_timer_free(ev_timer_t* timer) {
+    if (!timer) return;
+    ev_loop_del_fd(timer->fd);
+    close(timer->fd);
+    free(timer);
+}
+
+ev_status ev_timer_arm(ev_timer_t* timer, const uint64_t deadline_ns, const uint64_t period_ns) {
+    // A zero it_value would disarm the timer
+    const uint64_t deadline = deadline_ns ? deadline_ns : 1;
+    const struct itimerspec its = { to_timespec(period_ns), to_timespec(deadline) };
+    if (timerfd_settime(timer->fd, TFD_TIMER_ABSTIME, &its, NULL) != 0) return EV_KO;
+
+    timer->next = deadline;
+    timer->period = period_ns;
+    return EV_OK;
+}
+
+uint64_t ev_timer_deadline(const ev_timer_t* timer) {
+    return timer->deadline ? timer->deadline : timer->next;
+}
+
+void ev_timer_get_stats(const ev_timer_t* timer, ev_timer_stats_t* stats) {
+    stats->fires = timer->fires;
+    stats->missed = timer->missed;
+    stats->late_max_ns = timer->late_max;
+    stats->late_mean_ns = timer->late_mean;
+    stats->late_stddev_ns = timer->fires > 1 ? sqrt(timer->late_m2 / (double) (timer->fires - 1)) : 0.0;
+}
+
+ev_status ev_loop_run(void) {
+    if (epoll_fd == -1) return EV_KO;
+
+    struct epoll_event events[EV_BATCH];
+    while (!atomic_load(&stop_requested)) {
+        const int n = epoll_wait(epoll_fd, events, EV_BATCH, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            zlog_error(error_cat, "epoll_wait: %s", strerror(errno));
+            return EV_KO;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const ev_handler_t* h = events[i].data.ptr;
+            // The handler may have been removed by an earlier callback of this batch
+            if (h->fd == -1) continue;
+            h->cb(h->fd, events[i].events, h->timer ? (void*) h->timer : h->ctx);
+        }
+    }
+
+    atomic_store(&stop_requested, false);
+    return EV_OK;
+}
@@ -0,0 +1,444 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/services/gw_service.h"
+#include "schc_demo_app/services/schc_service.h"
+#include "schc_demo_app/utils.h"
+
+/*
+ * SCHC gateway: reads uplink frames from a UDP or UNIX datagram socket, or a
+ * file, in the loopback backend framing, rebuilds the IPv6/UDP packets on a
+ * pool of workers sharded by L2 source ID, and sends them on.
+ *
+ * UDP input is sharded by the kernel: each worker reads its own socket on the
+ * port (gw_open_shards()). Other inputs have one reader thread, this one,
+ * handing frames to the workers; it caps the throughput, whatever -w says.
+ *
+ *   schc-gateway -i unix:/tmp/gw.sock -o udp:[::1]:5683 -w 4
+ *   schc-demo-app -N 200 -D 10 -p unix:/tmp/gw.sock      (EXT=loop build)
+ */
+
+#ifndef GW_QUEUE_DEPTH
+#define GW_QUEUE_DEPTH 4096
+#endif
+
+#ifndef GW_RCVBUF
+#define GW_RCVBUF (8 * 1024 * 1024)
+#endif
+
+#define READ_CHUNK 65536
+#define WIRE_FRAME_MAX (GW_WIRE_HDR_LEN + GW_MAX_FRAME)
+
+typedef struct {
+    const char *in;
+    const char *out;
+    const char *rules;
+    uint32_t workers;
+    size_t queue_depth;
+    uint32_t duration_s;
+} gw_args_t;
+
+typedef struct {
+    uint64_t malformed;     /* not a whole frame, or a frame length over GW_MAX_FRAME */
+} reader_stats_t;
+
+static reader_stats_t rd;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s -i <input> [-o <output>] [-w workers] [-q queue depth] [-S rule image] [-d seconds]\n"
+            "  input:  udp:[host:]port, unix:<path> or file:<path>\n"
+            "  output: udp:host:port, unix:<path>, file:<path> or none (default)\n",
+            prog);
+}
+
+static int parse_args(int argc, char *argv[], gw_args_t *args)
+{
+    const struct option options[] = {
+        {"in", required_argument, 0, 'i'},
+        {"out", required_argument, 0, 'o'},
+        {"workers", required_argument, 0, 'w'},
+        {"queue", required_argument, 0, 'q'},
+        {"rules", required_argument, 0, 'S'},
+        {"duration", required_argument, 0, 'd'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:o:w:q:S:d:", options, NULL)) != -1) {
+        switch (opt) {
+            case 'i': args->in = optarg; break;
+            case 'o': args->out = optarg; break;
+            case 'w': args->workers = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'q': args->queue_depth = strtoul(optarg, NULL, 10); break;
+            case 'S': args->rules = optarg; break;
+            case 'd': args->duration_s = (uint32_t)strtoul(optarg, NULL, 10); break;
+            default: return -1;
+        }
+    }
+    return args->in ? 0 : -1;
+}
+
+/* "host:port", "[v6 addr]:port" or "port" (any address) */
+static int resolve_udp(const char *spec, const int passive, struct sockaddr_storage *sa, socklen_t *sa_len)
+{
+    char host[256] = "";
+    const char *port = spec;
+    const char *colon = strrchr(spec, ':');
+    if (colon) {
+        size_t n = (size_t)(colon - spec);
+        const char *h = spec;
+        if (n >= 2 && h[0] == '[' && h[n - 1] == ']') {
+            h++;
+            n -= 2;
+        }
+        if (n >= sizeof(host)) return -1;
+        memcpy(host, h, n);
+        host[n] = '\0';
+        port = colon + 1;
+    }
+
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0 || !res) return -1;
+    memcpy(sa, res->ai_addr, res->ai_addrlen);
+    *sa_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+static int unix_addr(const char *path, struct sockaddr_un *sa)
+{
+    if (strlen(path) >= sizeof(sa->sun_path)) return -1;
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    strcpy(sa->sun_path, path);
+    return 0;
+}
+
+/* Bursts from thousands of devices must not overflow the socket while the workers catch up */
+static void set_rcvbuf(const int fd)
+{
+    const int rcvbuf = GW_RCVBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+}
+
+/* Input descriptor; *stream is set for a file */
+static int open_input(const char *spec, int *stream)
+{
+    *stream = 0;
+    int fd = -1;
+
+    if (strncmp(spec, "file:", 5) == 0) {
+        *stream = 1;
+        fd = open(spec + 5, O_RDONLY);
+    } else if (strncmp(spec, "unix:", 5) == 0) {
+        struct sockaddr_un sa;
+        if (unix_addr(spec + 5, &sa) != 0) return -1;
+        unlink(sa.sun_path);
+        fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (fd != -1 && bind(fd, (const struct sockaddr *)&sa, sizeof(sa)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else if (strncmp(spec, "udp:", 4) == 0) {
+        struct sockaddr_storage sa;
+        socklen_t sa_len;
+        if (resolve_udp(spec + 4, 1, &sa, &sa_len) != 0) return -1;
+        fd = socket(sa.ss_family, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (fd != -1 && bind(fd, (const struct sockaddr *)&sa, sa_len) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        return -1;
+    }
+
+    if (fd != -1 && !*stream) set_rcvbuf(fd);
+    return fd;
+}
+
+/* One socket per worker for "udp:" input; 0, or -1 to fall back to open_input() */
+static int open_shards(const char *spec, const uint32_t nb, int *fds)
+{
+    struct sockaddr_storage sa;
+    socklen_t sa_len;
+    if (strncmp(spec, "udp:", 4) != 0 || resolve_udp(spec + 4, 1, &sa, &sa_len) != 0) return -1;
+    if (gw_open_shards((const struct sockaddr *)&sa, sa_len, nb, fds) != 0) {
+        zlog_warn(error_cat, "Cannot shard %s over the workers (%s): one reader feeds them", spec, strerror(errno));
+        return -1;
+    }
+    for (uint32_t i = 0; i < nb; i++) set_rcvbuf(fds[i]);
+    return 0;
+}
+
+/* Output descriptor, -1 with *none set for "none"; *stream is set for a file */
+static int open_output(const char *spec, int *stream, int *none)
+{
+    *stream = 0;
+    *none = 0;
+    if (!spec || strcmp(spec, "none") == 0) {
+        *none = 1;
+        return -1;
+    }
+
+    if (strncmp(spec, "file:", 5) == 0) {
+        *stream = 1;
+        return open(spec + 5, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    int fd = -1;
+    if (strncmp(spec, "unix:", 5) == 0) {
+        struct sockaddr_un sa;
+        if (unix_addr(spec + 5, &sa) != 0) return -1;
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (fd != -1 && connect(fd, (const struct sockaddr *)&sa, sizeof(sa)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else if (strncmp(spec, "udp:", 4) == 0) {
+        struct sockaddr_storage sa;
+        socklen_t sa_len;
+        if (resolve_udp(spec + 4, 0, &sa, &sa_len) != 0) return -1;
+        fd = socket(sa.ss_family, SOCK_DGRAM, 0);
+        if (fd != -1 && connect(fd, (const struct sockaddr *)&sa, sa_len) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    return fd;
+}
+
+static void close_input(const int in_fd, int *shard_fds, const uint32_t nb)
+{
+    if (in_fd != -1) close(in_fd);
+    if (shard_fds) {
+        for (uint32_t i = 0; i < nb; i++) close(shard_fds[i]);
+    }
+    free(shard_fds);
+}
+
+/* Queue a frame, waiting for the worker while its queue is full */
+static void submit(const l2_frame_meta_t *meta, const uint8_t *payload, size_t len)
+{
+    while (gw_submit(meta, payload, len) == GW_FULL) sched_yield();
+}
+
+/* One frame per datagram, up to GW_BATCH datagrams per recvmmsg(). Returns 0 when nothing was waiting. */
+static int read_datagrams(const int fd)
+{
+    static uint8_t bufs[GW_BATCH][WIRE_FRAME_MAX + 1];
+    static struct iovec iov[GW_BATCH];
+    static struct mmsghdr msgs[GW_BATCH];
+
+    for (size_t i = 0; i < GW_BATCH; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = sizeof(bufs[i]);
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int n = recvmmsg(fd, msgs, GW_BATCH, MSG_DONTWAIT, NULL);
+    if (n <= 0) return 0;
+
+    for (int i = 0; i < n; i++) {
+        l2_frame_meta_t meta;
+        const uint8_t *payload;
+        size_t len;
+        if (!msgs[i].msg_len || gw_parse_frame(bufs[i], msgs[i].msg_len, &meta, &payload, &len) != (long)msgs[i].msg_len) {
+            rd.malformed++;
+            continue;
+        }
+        submit(&meta, payload, len);
+    }
+    gw_kick();
+    return 1;
+}
+
+/* Frames back to back; a partial one is kept for the next read. Returns 0 on end of file. */
+static int read_stream(const int fd)
+{
+    static uint8_t buf[READ_CHUNK + WIRE_FRAME_MAX];
+    static size_t kept = 0;
+
+    const ssize_t r = read(fd, buf + kept, READ_CHUNK);
+    if (r < 0 && errno == EINTR) return 1;
+    if (r <= 0) return 0;
+
+    const size_t avail = kept + (size_t)r;
+    size_t off = 0;
+    while (off < avail) {
+        l2_frame_meta_t meta;
+        const uint8_t *payload;
+        size_t len;
+        const long used = gw_parse_frame(buf + off, avail - off, &meta, &payload, &len);
+        if (used == 0) break;
+        if (used < 0) {
+            /* No frame boundary to resync on: skip a byte */
+            rd.malformed++;
+            off++;
+            continue;
+        }
+        submit(&meta, payload, len);
+        off += (size_t)used;
+    }
+    kept = avail - off;
+    memmove(buf, buf + off, kept);
+    gw_kick();
+    return 1;
+}
+
+static void report(const double elapsed_s)
+{
+    gw_stats_t st;
+    gw_get_stats(&st);
+
+    zlog_info(ok_cat, "Gateway: %llu frames in %.1f s (%.0f packets/s), %llu rebuilt, %llu failed, "
+                      "%llu sent, %llu send errors, %llu malformed, queue full %llu times",
+              (unsigned long long)st.total.frames, elapsed_s,
+              elapsed_s > 0 ? (double)st.total.packets / elapsed_s : 0.0,
+              (unsigned long long)st.total.packets, (unsigned long long)st.total.failed,
+              (unsigned long long)st.total.sent, (unsigned long long)st.total.send_failed,
+              (unsigned long long)rd.malformed, (unsigned long long)st.queue_full);
+
+    for (uint32_t i = 0; i < st.nb_workers; i++) {
+        gw_worker_stats_t w;
+        gw_get_worker_stats(i, &w);
+        const double cpu_s = (double)w.cpu_ns / 1e9;
+        zlog_info(ok_cat, "Gateway worker %u: %llu packets, %.1f per batch, %.3f s CPU, %.0f packets/s per core",
+                  i, (unsigned long long)w.packets, w.batches ? (double)w.packets / (double)w.batches : 0.0,
+                  cpu_s, cpu_s > 0 ? (double)w.packets / cpu_s : 0.0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (logger_init() != LOGGER_INIT_OK) {
+        fprintf(stderr, "Logger initialization failed\n");
+        return EXIT_FAILURE;
+    }
+
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    gw_args_t args = {0};
+    if (parse_args(argc, argv, &args) != 0) {
+        usage(argv[0]);
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+    if (!args.workers) args.workers = cpus > 0 ? (uint32_t)cpus : 1;
+    if (!args.queue_depth) args.queue_depth = GW_QUEUE_DEPTH;
+
+    /* Stop signals go to the reader loop: block them before any thread starts */
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+    const int sig_fd = signalfd(-1, &stop_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    if (args.rules && schc_service_set_rule_file(args.rules) != SCHC_OK) {
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+    if (schc_service_init() != SCHC_OK) {
+        zlog_error(error_cat, "SCHC init failed");
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+
+    int in_stream = 0, out_stream, out_none;
+    int in_fd = -1;
+    int *shard_fds = calloc(args.workers, sizeof(*shard_fds));
+    if (!shard_fds || open_shards(args.in, args.workers, shard_fds) != 0) {
+        free(shard_fds);
+        shard_fds = NULL;
+        in_fd = open_input(args.in, &in_stream);
+    }
+    if (!shard_fds && in_fd == -1) {
+        zlog_error(error_cat, "Cannot open gateway input %s: %s", args.in, strerror(errno));
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+    const int out_fd = open_output(args.out, &out_stream, &out_none);
+    if (out_fd == -1 && !out_none) {
+        zlog_error(error_cat, "Cannot open gateway output %s: %s", args.out, strerror(errno));
+        close_input(in_fd, shard_fds, args.workers);
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+
+    const gw_config_t cfg = { args.workers, args.queue_depth, out_fd, out_stream != 0, shard_fds };
+    if (gw_start(&cfg) != GW_OK) {
+        zlog_error(error_cat, "Gateway start failed");
+        close_input(in_fd, shard_fds, args.workers);
+        if (out_fd != -1) close(out_fd);
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+    zlog_info(ok_cat, "Gateway reading %s, writing %s", args.in, args.out ? args.out : "none");
+
+    const uint64_t t0 = monotonic_now_ns();
+    const uint64_t end = args.duration_s ? t0 + (uint64_t)args.duration_s * 1000000000ull : UINT64_MAX;
+    uint64_t next_report = t0 + 1000000000ull;
+    uint64_t last_packets = 0;
+
+    /* With sharded input the workers read, and this loop only waits for a signal or the next report */
+    struct pollfd fds[2] = {
+        { in_fd, POLLIN, 0 },
+        { sig_fd, POLLIN, 0 }
+    };
+    for (;;) {
+        const uint64_t now = monotonic_now_ns();
+        if (now >= end) break;
+        if (now >= next_report) {
+            gw_stats_t st;
+            gw_get_stats(&st);
+            zlog_info(ok_cat, "gw: %llu packets/s", (unsigned long long)(st.total.packets - last_packets));
+            last_packets = st.total.packets;
+            next_report += 1000000000ull;
+        }
+
+        if (in_stream) {
+            /* Files are always readable: read until the end, checking for a stop signal in between */
+            struct signalfd_siginfo si;
+            if (sig_fd != -1 && read(sig_fd, &si, sizeof(si)) == sizeof(si)) break;
+            if (!read_stream(in_fd)) break;
+            continue;
+        }
+
+        if (in_fd != -1 && read_datagrams(in_fd)) continue;
+        const uint64_t wake = next_report < end ? next_report : end;
+        const int timeout_ms = (int)((wake - now + 999999) / 1000000);
+        if (poll(fds, sig_fd != -1 ? 2 : 1, timeout_ms) > 0 && (fds[1].revents & POLLIN)) break;
+    }
+
+    gw_stop();
+    report((double)(monotonic_now_ns() - t0) / 1e9);
+
+    close_input(in_fd, shard_fds, args.workers);
+    if (out_fd != -1) close(out_fd);
+    if (sig_fd != -1) close(sig_fd);
+    if (strncmp(args.in, "unix:", 5) == 0) unlink(args.in + 5);
+    logger_fini();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,505 @@
+#define _GNU_SOURCE
+#include "gw_service.h"
+
+#include <errno.h>
+#include <linux/filter.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger_helper.h"
+#include "schc_service.h"
+#include "spsc_ring.h"
+
+#define NB_SRC_IDS 256      // L2 source IDs are one byte on air
+#define WIRE_FRAME_MAX (GW_WIRE_HDR_LEN + GW_MAX_FRAME)
+
+// After gw_stop(), a worker reading its own socket takes what is left in it,
+// but no more than this many batches if the senders keep going
+#define STOP_DRAIN_BATCHES 1024
+
+typedef struct {
+    l2_frame_meta_t meta;
+    uint16_t len;
+    uint8_t data[GW_MAX_FRAME];
+} gw_slot_t;
+
+typedef struct {
+    pthread_t thread;
+    clockid_t cpu_clock;
+    int in_fd;                          // own input socket, -1: frames come through gw_submit()
+
+    // Single producer (the reader) / single consumer (this worker), woken once per gw_kick()
+    spsc_ring_t ring;
+    gw_slot_t* slots;
+    bool pending;                       // reader only: frames since the last gw_kick()
+
+    // Decompression contexts of the devices this worker serves, by L2 source ID
+    schc_dev_ctx_t* ctx[NB_SRC_IDS];
+
+    uint8_t out[GW_BATCH][GW_MAX_PACKET];
+    struct iovec iov[GW_BATCH];
+    struct mmsghdr msgs[GW_BATCH];
+
+    // Own input: one frame per datagram
+    uint8_t in[GW_BATCH][WIRE_FRAME_MAX + 1];
+    struct iovec in_iov[GW_BATCH];
+    struct mmsghdr in_msgs[GW_BATCH];
+
+    _Atomic uint64_t frames;
+    _Atomic uint64_t packets;
+    _Atomic uint64_t failed;
+    _Atomic uint64_t sent;
+    _Atomic uint64_t send_failed;
+    _Atomic uint64_t bytes_in;
+    _Atomic uint64_t bytes_out;
+    _Atomic uint64_t batches;
+    _Atomic uint64_t cpu_ns;            // final value, set when the worker exits
+} gw_worker_t;
+
+static gw_config_t cfg;
+static gw_worker_t* workers = NULL;
+static uint32_t nb_started = 0;
+static uint32_t nb_rings = 0;           // workers whose ring is initialised
+static int stop_fd = -1;                // readable once gw_stop() is called, for the workers in poll()
+static atomic_bool stopping = false;
+static atomic_bool running = false;
+static bool shared_rules = false;       // rules without device contexts: decompress with the service rules
+
+static _Atomic uint64_t st_queue_full = 0;
+
+static uint64_t cpu_clock_ns(const clockid_t clk) {
+    struct timespec ts;
+    if (clock_gettime(clk, &ts) != 0) return 0;
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+long gw_parse_frame(const uint8_t* buf, const size_t len, l2_frame_meta_t* meta, const uint8_t** payload,
+                    size_t* payload_len) {
+    if (len < GW_WIRE_HDR_LEN) return 0;
+    const size_t plen = (size_t) buf[0] << 8 | buf[1];
+    if (plen > GW_MAX_FRAME) return -1;
+    if (len < GW_WIRE_HDR_LEN + plen) return 0;
+
+    memset(meta, 0, sizeof(*meta));
+    meta->src = buf[2];
+    meta->dst = buf[3];
+    meta->type = buf[4];
+    meta->flags = buf[5];
+    meta->seq = buf[6];
+    *payload = buf + GW_WIRE_HDR_LEN;
+    *payload_len = plen;
+    return (long) (GW_WIRE_HDR_LEN + plen);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Workers                                                                   */
+/* ------------------------------------------------------------------------ */
+
+// The simulator gives device ID n the IID ::n; the gateway only sees its low byte
+static const schc_dev_ctx_t* device_ctx(gw_worker_t* w, const uint8_t src) {
+    if (!w->ctx[src]) {
+        uint8_t iid[8] = {0};
+        iid[7] = src;
+        w->ctx[src] = schc_service_dev_ctx_new(iid);
+    }
+    return w->ctx[src];
+}
+
+static size_t write_all(const int fd, struct iovec* iov, size_t n) {
+    size_t sent = 0;
+    while (n) {
+        const ssize_t r = writev(fd, iov, (int) n);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // Skip what went out, resume in the middle of a packet after a short write
+        size_t done = (size_t) r;
+        while (n && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            n--;
+            sent++;
+        }
+        if (n) {
+            iov->iov_base = (uint8_t*) iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return sent;
+}
+
+static size_t send_all(const int fd, struct mmsghdr* msgs, const size_t n) {
+    size_t sent = 0;
+    size_t refused = 0;
+    while (sent < n) {
+        const int r = sendmmsg(fd, msgs + sent, (unsigned int) (n - sent), 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            // An ICMP port unreachable for an earlier datagram, reported once: this one was not sent yet
+            if (errno == ECONNREFUSED && refused++ < GW_BATCH) continue;
+            break;
+        }
+        sent += (size_t) r;
+    }
+    return sent;
+}
+
+static void flush(gw_worker_t* w, const size_t n) {
+    if (!n) return;
+
+    size_t sent = n;
+    if (cfg.out_fd >= 0 && cfg.out_stream) {
+        sent = write_all(cfg.out_fd, w->iov, n);
+    } else if (cfg.out_fd >= 0) {
+        for (size_t i = 0; i < n; i++) {
+            memset(&w->msgs[i], 0, sizeof(w->msgs[i]));
+            w->msgs[i].msg_hdr.msg_iov = &w->iov[i];
+            w->msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        sent = send_all(cfg.out_fd, w->msgs, n);
+    }
+
+    atomic_fetch_add_explicit(&w->sent, sent, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->send_failed, n - sent, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->batches, 1, memory_order_relaxed);
+}
+
+// Rebuild one frame into output slot n; returns the packet length, 0 if it failed
+static size_t rebuild(gw_worker_t* w, const uint8_t src, const uint8_t* data, const size_t len, const size_t n) {
+    size_t out_len = 0;
+    const schc_dev_ctx_t* ctx = shared_rules ? NULL : device_ctx(w, src);
+    const schc_status_t st = ctx
+                             ? schc_service_decompress_dev(ctx, data, len, w->out[n], GW_MAX_PACKET, &out_len)
+                             : schc_service_decompress(data, len, w->out[n], GW_MAX_PACKET, &out_len);
+    if (st != SCHC_OK) return 0;
+    w->iov[n].iov_base = w->out[n];
+    w->iov[n].iov_len = out_len;
+    return out_len;
+}
+
+static void count_batch(gw_worker_t* w, const uint64_t frames, const size_t packets, const uint64_t failed,
+                        const uint64_t bytes_in, const uint64_t bytes_out) {
+    atomic_fetch_add_explicit(&w->frames, frames, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->packets, packets, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->failed, failed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->bytes_in, bytes_in, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->bytes_out, bytes_out, memory_order_relaxed);
+}
+
+// Decompress up to GW_BATCH queued frames into the output batch and send it
+static size_t run_batch(gw_worker_t* w, size_t t, const size_t h) {
+    size_t n = 0;
+    uint64_t frames = 0, failed = 0, bytes_in = 0, bytes_out = 0;
+
+    for (; t != h && n < GW_BATCH; t++) {
+        const gw_slot_t* s = &w->slots[t & w->ring.mask];
+        if (t + 1 != h) __builtin_prefetch(&w->slots[(t + 1) & w->ring.mask]);
+        frames++;
+        bytes_in += s->len;
+
+        const size_t len = rebuild(w, (uint8_t) s->meta.src, s->data, s->len, n);
+        if (!len) {
+            failed++;
+            continue;
+        }
+        bytes_out += len;
+        n++;
+    }
+    // The slots are free once decompressed: give them back before the send
+    spsc_ring_release(&w->ring, t);
+
+    count_batch(w, frames, n, failed, bytes_in, bytes_out);
+    flush(w, n);
+    return t;
+}
+
+static void* worker_main(void* arg) {
+    gw_worker_t* w = arg;
+
+    for (;;) {
+        size_t h = spsc_ring_wait(&w->ring);
+        size_t t = spsc_ring_tail(&w->ring);
+        while (t != h) {
+            t = run_batch(w, t, h);
+            h = spsc_ring_head(&w->ring);
+        }
+        if (atomic_load(&stopping)) break;
+    }
+
+    atomic_store(&w->cpu_ns, cpu_clock_ns(CLOCK_THREAD_CPUTIME_ID));
+    return NULL;
+}
+
+// Decompress the nb datagrams just received and send them, as run_batch() does for queued frames
+static void rx_batch(gw_worker_t* w, const size_t nb) {
+    size_t n = 0;
+    uint64_t failed = 0, bytes_in = 0, bytes_out = 0;
+
+    for (size_t i = 0; i < nb; i++) {
+        l2_frame_meta_t meta;
+        const uint8_t* payload;
+        size_t len;
+        const unsigned int got = w->in_msgs[i].msg_len;
+        if (!got || gw_parse_frame(w->in[i], got, &meta, &payload, &len) != (long) got) {
+            failed++;
+            continue;
+        }
+        bytes_in += len;
+
+        const size_t out_len = rebuild(w, (uint8_t) meta.src, payload, len, n);
+        if (!out_len) {
+            failed++;
+            continue;
+        }
+        bytes_out += out_len;
+        n++;
+    }
+
+    count_batch(w, nb, n, failed, bytes_in, bytes_out);
+    flush(w, n);
+}
+
+// The worker reads its own socket: no reader thread and no handoff in between
+static void* rx_worker_main(void* arg) {
+    gw_worker_t* w = arg;
+
+    for (size_t i = 0; i < GW_BATCH; i++) {
+        w->in_iov[i].iov_base = w->in[i];
+        w->in_iov[i].iov_len = sizeof(w->in[i]);
+        memset(&w->in_msgs[i], 0, sizeof(w->in_msgs[i]));
+        w->in_msgs[i].msg_hdr.msg_iov = &w->in_iov[i];
+        w->in_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    struct pollfd fds[2] = {
+        { w->in_fd, POLLIN, 0 },
+        { stop_fd, POLLIN, 0 }
+    };
+    size_t drained = 0;
+    for (;;) {
+        const int r = recvmmsg(w->in_fd, w->in_msgs, GW_BATCH, MSG_DONTWAIT, NULL);
+        if (r > 0) {
+            rx_batch(w, (size_t) r);
+            if (!atomic_load(&stopping) || ++drained < STOP_DRAIN_BATCHES) continue;
+        }
+        if (atomic_load(&stopping)) break;
+        poll(fds, 2, -1);
+    }
+
+    atomic_store(&w->cpu_ns, cpu_clock_ns(CLOCK_THREAD_CPUTIME_ID));
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+
+int gw_open_shards(const struct sockaddr* sa, const socklen_t sa_len, const uint32_t nb, int* fds) {
+    // Classic BPF on the UDP payload, that is the frame: socket (L2 source ID % nb), as gw_submit() shards
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 2 },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, nb },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    const struct sock_fprog prog = { sizeof(code) / sizeof(code[0]), code };
+    const int one = 1;
+    struct sockaddr_storage bound;
+    socklen_t bound_len = sa_len;
+    if (!nb || sa_len > sizeof(bound)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(&bound, sa, sa_len);
+
+    for (uint32_t i = 0; i < nb; i++) {
+        // Sockets join the group in order: socket i is index i for the program
+        fds[i] = socket(sa->sa_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fds[i] == -1 || setsockopt(fds[i], SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0 ||
+            bind(fds[i], (const struct sockaddr*) &bound, bound_len) != 0 ||
+            (i == 0 && (setsockopt(fds[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) != 0 ||
+                        getsockname(fds[0], (struct sockaddr*) &bound, &bound_len) != 0))) {
+            const int err = errno;
+            for (uint32_t j = 0; j <= i; j++) {
+                if (fds[j] != -1) close(fds[j]);
+            }
+            errno = err;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+gw_status gw_submit(const l2_frame_meta_t* meta, const uint8_t* payload, const size_t len) {
+    if (!workers || cfg.in_fds || len > GW_MAX_FRAME) return GW_KO;
+
+    // A device always goes to the same worker, so its context has a single owner
+    gw_worker_t* w = &workers[(meta->src & (NB_SRC_IDS - 1)) % nb_started];
+    size_t h;
+    if (!spsc_ring_reserve(&w->ring, &h)) {
+        atomic_fetch_add_explicit(&st_queue_full, 1, memory_order_relaxed);
+        // Make sure the worker is draining before the caller retries
+        if (w->pending) {
+            w->pending = false;
+            spsc_ring_wake(&w->ring);
+        }
+        return GW_FULL;
+    }
+
+    gw_slot_t* s = &w->slots[h & w->ring.mask];
+    s->meta = *meta;
+    s->len = (uint16_t) len;
+    memcpy(s->data, payload, len);
+    spsc_ring_publish(&w->ring, h);
+    w->pending = true;
+    return GW_OK;
+}
+
+void gw_kick(void) {
+    for (uint32_t i = 0; i < nb_started; i++) {
+        if (workers[i].pending) {
+            workers[i].pending = false;
+            spsc_ring_wake(&workers[i].ring);
+        }
+    }
+}
+
+static void release(void) {
+    if (workers) {
+        for (uint32_t i = 0; i < nb_rings; i++) spsc_ring_destroy(&workers[i].ring);
+        for (uint32_t i = 0; i < nb_started; i++) {
+            for (size_t s = 0; s < NB_SRC_IDS; s++) schc_service_dev_ctx_free(workers[i].ctx[s]);
+            free(workers[i].slots);
+        }
+    }
+    free(workers);
+    workers = NULL;
+    nb_started = 0;
+    nb_rings = 0;
+    if (stop_fd != -1) close(stop_fd);
+    stop_fd = -1;
+}
+
+// Stop and join the first nb workers
+static void join_workers(const uint32_t nb) {
+    atomic_store(&stopping, true);
+    const uint64_t one = 1;
+    (void) !write(stop_fd, &one, sizeof(one));
+    for (uint32_t i = 0; i < nb; i++) {
+        spsc_ring_wake(&workers[i].ring);
+        pthread_join(workers[i].thread, NULL);
+    }
+}
+
+void gw_stop(void) {
+    if (!atomic_load(&running)) return;
+
+    join_workers(nb_started);
+    atomic_store(&running, false);
+
+    // The counters stay readable until the next gw_start()
+    for (uint32_t i = 0; i < nb_started; i++) {
+        for (size_t s = 0; s < NB_SRC_IDS; s++) {
+            schc_service_dev_ctx_free(workers[i].ctx[s]);
+            workers[i].ctx[s] = NULL;
+        }
+        free(workers[i].slots);
+        workers[i].slots = NULL;
+    }
+}
+
+gw_status gw_start(const gw_config_t* config) {
+    if (!config || !config->nb_workers || !config->queue_depth ||
+        (config->queue_depth & (config->queue_depth - 1)) != 0 || atomic_load(&running)) {
+        return GW_KO;
+    }
+    release();
+    cfg = *config;
+    atomic_store(&stopping, false);
+    atomic_store(&st_queue_full, 0);
+
+    // Device contexts derive from the built-in rule; with a rule image every device shares its rules
+    const uint8_t probe_iid[8] = {0};
+    schc_dev_ctx_t* probe = schc_service_dev_ctx_new(probe_iid);
+    shared_rules = probe == NULL;
+    schc_service_dev_ctx_free(probe);
+    if (shared_rules) {
+        zlog_info(ok_cat, "Gateway: no device contexts, device addresses come from the rules");
+    }
+
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    workers = aligned_alloc(64, cfg.nb_workers * sizeof(*workers));
+    if (stop_fd == -1 || !workers) {
+        release();
+        return GW_KO;
+    }
+    memset(workers, 0, cfg.nb_workers * sizeof(*workers));
+
+    for (; nb_started < cfg.nb_workers; nb_started++) {
+        gw_worker_t* w = &workers[nb_started];
+        w->in_fd = cfg.in_fds ? cfg.in_fds[nb_started] : -1;
+        if (spsc_ring_init(&w->ring, cfg.queue_depth) == 0) nb_rings++;
+        if (!cfg.in_fds) w->slots = malloc(cfg.queue_depth * sizeof(*w->slots));
+        if (nb_rings == nb_started || (!cfg.in_fds && !w->slots) ||
+            pthread_create(&w->thread, NULL, cfg.in_fds ? rx_worker_main : worker_main, w) != 0) {
+            zlog_error(error_cat, "Gateway worker %u start failed", nb_started);
+            // This worker has no thread to join, but release() frees its slots and ring
+            join_workers(nb_started);
+            nb_started++;
+            release();
+            return GW_KO;
+        }
+        if (pthread_getcpuclockid(w->thread, &w->cpu_clock) != 0) w->cpu_clock = (clockid_t) -1;
+    }
+    atomic_store(&running, true);
+
+    zlog_info(ok_cat, "Gateway: %u workers, %s, output %s", cfg.nb_workers,
+              cfg.in_fds ? "each reading its own socket" : "fed by one reader",
+              cfg.out_fd < 0 ? "none" : cfg.out_stream ? "stream" : "datagrams");
+    return GW_OK;
+}
+
+void gw_get_worker_stats(const uint32_t i, gw_worker_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!workers || i >= nb_started) return;
+
+    const gw_worker_t* w = &workers[i];
+    stats->frames = atomic_load_explicit(&w->frames, memory_order_relaxed);
+    stats->packets = atomic_load_explicit(&w->packets, memory_order_relaxed);
+    stats->failed = atomic_load_explicit(&w->failed, memory_order_relaxed);
+    stats->sent = atomic_load_explicit(&w->sent, memory_order_relaxed);
+    stats->send_failed = atomic_load_explicit(&w->send_failed, memory_order_relaxed);
+    stats->bytes_in = atomic_load_explicit(&w->bytes_in, memory_order_relaxed);
+    stats->bytes_out = atomic_load_explicit(&w->bytes_out, memory_order_relaxed);
+    stats->batches = atomic_load_explicit(&w->batches, memory_order_relaxed);
+    // Set when the worker exits; until then read its CPU clock
+    stats->cpu_ns = atomic_load(&w->cpu_ns);
+    if (!stats->cpu_ns && atomic_load(&running) && w->cpu_clock != (clockid_t) -1) {
+        stats->cpu_ns = cpu_clock_ns(w->cpu_clock);
+    }
+}
+
+void gw_get_stats(gw_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->queue_full = atomic_load_explicit(&st_queue_full, memory_order_relaxed);
+    stats->nb_workers = nb_started;
+    for (uint32_t i = 0; i < nb_started; i++) {
+        gw_worker_stats_t w;
+        gw_get_worker_stats(i, &w);
+        stats->total.frames += w.frames;
+        stats->total.packets += w.packets;
+        stats->total.failed += w.failed;
+        stats->total.sent += w.sent;
+        stats->total.send_failed += w.send_failed;
+        stats->total.bytes_in += w.bytes_in;
+        stats->total.bytes_out += w.bytes_out;
+        stats->total.batches += w.batches;
+        stats->total.cpu_ns += w.cpu_ns;
+    }
+}
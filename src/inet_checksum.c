@@ -0,0 +1,219 @@
+#include "schc_demo_app/net/inet_checksum.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INET_CSUM_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define INET_CSUM_ARM 1
+#include <arm_neon.h>
+#endif
+
+/* 16-bit SIMD lanes hold two words per step; flush to 64 bits before they can overflow */
+#define SIMD_BLOCK_STEPS 8192
+
+static inline uint32_t to_be_sum(uint64_t native) {
+    uint32_t s = inet_csum_fold(native);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    s = (uint32_t) (((s & 0xFFu) << 8) | (s >> 8));
+#endif
+    return s;
+}
+
+/* Reference: one big-endian word per step, as the builder originally did */
+static uint32_t csum_ref(const uint8_t* buf, const size_t len, uint32_t sum) {
+    sum = inet_csum_fold(sum);
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        sum += (uint32_t) ((buf[i] << 8) | buf[i + 1]);
+        sum = (sum & 0xFFFFu) + (sum >> 16);
+    }
+    if (len & 1u) {
+        sum += (uint32_t) (buf[len - 1] << 8);
+        sum = (sum & 0xFFFFu) + (sum >> 16);
+    }
+    return inet_csum_fold(sum);
+}
+
+/* Native-order sum of buf; the caller converts with to_be_sum() */
+static uint64_t sum_native64(const uint8_t* p, size_t len, uint64_t acc) {
+    uint64_t w0, w1, w2, w3;
+
+    while (len >= 32) {
+        memcpy(&w0, p, 8);
+        memcpy(&w1, p + 8, 8);
+        memcpy(&w2, p + 16, 8);
+        memcpy(&w3, p + 24, 8);
+        acc += w0; acc += acc < w0;
+        acc += w1; acc += acc < w1;
+        acc += w2; acc += acc < w2;
+        acc += w3; acc += acc < w3;
+        p += 32;
+        len -= 32;
+    }
+    while (len >= 8) {
+        memcpy(&w0, p, 8);
+        acc += w0; acc += acc < w0;
+        p += 8;
+        len -= 8;
+    }
+
+    uint64_t tail = 0;
+    if (len >= 4) {
+        uint32_t w;
+        memcpy(&w, p, 4);
+        tail += w;
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        uint16_t w;
+        memcpy(&w, p, 2);
+        tail += w;
+        p += 2;
+        len -= 2;
+    }
+    if (len) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        tail += p[0];
+#else
+        tail += (uint64_t) p[0] << 8;
+#endif
+    }
+
+    acc += tail;
+    acc += acc < tail;
+    return acc;
+}
+
+static uint32_t csum_word64(const uint8_t* buf, const size_t len, const uint32_t sum) {
+    return inet_csum_fold((uint64_t) to_be_sum(sum_native64(buf, len, 0)) + sum);
+}
+
+#ifdef INET_CSUM_X86
+__attribute__((target("sse2")))
+static uint32_t csum_sse2(const uint8_t* buf, size_t len, const uint32_t sum) {
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t acc = 0;
+
+    while (len >= 16) {
+        __m128i lanes = _mm_setzero_si128();
+        size_t steps = len / 16;
+        if (steps > SIMD_BLOCK_STEPS) steps = SIMD_BLOCK_STEPS;
+        for (size_t i = 0; i < steps; i++) {
+            const __m128i v = _mm_loadu_si128((const __m128i*) buf);
+            lanes = _mm_add_epi32(lanes, _mm_unpacklo_epi16(v, zero));
+            lanes = _mm_add_epi32(lanes, _mm_unpackhi_epi16(v, zero));
+            buf += 16;
+        }
+        len -= steps * 16;
+
+        uint32_t l[4];
+        _mm_storeu_si128((__m128i*) l, lanes);
+        acc += (uint64_t) l[0] + l[1] + l[2] + l[3];
+    }
+
+    acc = sum_native64(buf, len, acc);
+    return inet_csum_fold((uint64_t) to_be_sum(acc) + sum);
+}
+
+__attribute__((target("avx2")))
+static uint32_t csum_avx2(const uint8_t* buf, size_t len, const uint32_t sum) {
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t acc = 0;
+
+    while (len >= 32) {
+        __m256i lanes = _mm256_setzero_si256();
+        size_t steps = len / 32;
+        if (steps > SIMD_BLOCK_STEPS) steps = SIMD_BLOCK_STEPS;
+        for (size_t i = 0; i < steps; i++) {
+            const __m256i v = _mm256_loadu_si256((const __m256i*) buf);
+            lanes = _mm256_add_epi32(lanes, _mm256_unpacklo_epi16(v, zero));
+            lanes = _mm256_add_epi32(lanes, _mm256_unpackhi_epi16(v, zero));
+            buf += 32;
+        }
+        len -= steps * 32;
+
+        uint32_t l[8];
+        _mm256_storeu_si256((__m256i*) l, lanes);
+        acc += (uint64_t) l[0] + l[1] + l[2] + l[3] + l[4] + l[5] + l[6] + l[7];
+    }
+    /* Avoid the AVX->SSE transition penalty in the caller's memcpy */
+    _mm256_zeroupper();
+
+    acc = sum_native64(buf, len, acc);
+    return inet_csum_fold((uint64_t) to_be_sum(acc) + sum);
+}
+#endif
+
+#ifdef INET_CSUM_ARM
+static uint32_t csum_neon(const uint8_t* buf, size_t len, const uint32_t sum) {
+    uint64_t acc = 0;
+
+    while (len >= 16) {
+        uint32x4_t lanes = vdupq_n_u32(0);
+        size_t steps = len / 16;
+        if (steps > SIMD_BLOCK_STEPS) steps = SIMD_BLOCK_STEPS;
+        for (size_t i = 0; i < steps; i++) {
+            lanes = vpadalq_u16(lanes, vreinterpretq_u16_u8(vld1q_u8(buf)));
+            buf += 16;
+        }
+        len -= steps * 16;
+        acc += vgetq_lane_u64(vpaddlq_u32(lanes), 0) + vgetq_lane_u64(vpaddlq_u32(lanes), 1);
+    }
+
+    acc = sum_native64(buf, len, acc);
+    return inet_csum_fold((uint64_t) to_be_sum(acc) + sum);
+}
+#endif
+
+inet_csum_fn_t inet_csum_get_impl(const inet_csum_impl_t impl) {
+    switch (impl) {
+        case INET_CSUM_REF:
+            return csum_ref;
+        case INET_CSUM_WORD64:
+            return csum_word64;
+#ifdef INET_CSUM_X86
+        case INET_CSUM_SSE2:
+            return __builtin_cpu_supports("sse2") ? csum_sse2 : NULL;
+        case INET_CSUM_AVX2:
+            return __builtin_cpu_supports("avx2") ? csum_avx2 : NULL;
+#endif
+#ifdef INET_CSUM_ARM
+        case INET_CSUM_NEON:
+            return csum_neon;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+const char* inet_csum_impl_name(const inet_csum_impl_t impl) {
+    static const char* names[INET_CSUM_IMPL_COUNT] = { "ref", "word64", "sse2", "avx2", "neon" };
+    return impl < INET_CSUM_IMPL_COUNT ? names[impl] : "?";
+}
+
+static inet_csum_fn_t select_impl(void) {
+    static const inet_csum_impl_t preference[] = {
+        INET_CSUM_AVX2, INET_CSUM_NEON, INET_CSUM_SSE2, INET_CSUM_WORD64
+    };
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+        const inet_csum_fn_t fn = inet_csum_get_impl(preference[i]);
+        if (fn) return fn;
+    }
+    return csum_word64;
+}
+
+uint32_t inet_csum_partial(const uint8_t* buf, const size_t len, const uint32_t sum) {
+    static inet_csum_fn_t impl = NULL;
+
+    inet_csum_fn_t fn = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+    if (!fn) {
+        /* Every thread resolves the same pointer, so racing here is harmless */
+        fn = select_impl();
+        __atomic_store_n(&impl, fn, __ATOMIC_RELAXED);
+    }
+    return fn(buf, len, sum);
+}
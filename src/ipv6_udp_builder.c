@@ -2,6 +2,8 @@
 
 #include <string.h>
 
+#include "schc_demo_app/net/inet_checksum.h"
+
 #define IPV6_HDR_LEN 40
 #define UDP_HDR_LEN  8
 
@@ -10,62 +12,33 @@ static inline void put_u16_be(uint8_t *p, uint16_t v) {
     p[1] = (uint8_t)(v & 0xFF);
 }
 
-static inline uint32_t sum16_add(uint32_t sum, uint16_t v) {
-    sum += v;
-    return (sum & 0xFFFFu) + (sum >> 16);
-}
-
 static inline uint16_t ones_complement(uint32_t sum) {
-    while (sum >> 16) sum = (sum & 0xFFFFu) + (sum >> 16);
-    return (uint16_t)(~sum);
+    return (uint16_t)(~inet_csum_fold(sum));
 }
 
 /**
  * UDP checksum for IPv6 (pseudo-header + UDP header+payload).
  * Assumes udp points to UDP header start (8 bytes) followed by payload.
- * The UDP checksum field must be treated as 0 while computing.
+ * The UDP checksum field is treated as 0 by summing around it.
  */
 static uint16_t udp_checksum_ipv6(const uint8_t src_ip[16],
                                   const uint8_t dst_ip[16],
                                   const uint8_t *udp,
                                   size_t udp_len)
 {
-    uint32_t sum = 0;
-
     // Pseudo-header: src and dst (16 bytes each)
-    for (int i = 0; i < 16; i += 2) {
-        uint16_t w = (uint16_t)((src_ip[i] << 8) | src_ip[i + 1]);
-        sum = sum16_add(sum, w);
-    }
-    for (int i = 0; i < 16; i += 2) {
-        uint16_t w = (uint16_t)((dst_ip[i] << 8) | dst_ip[i + 1]);
-        sum = sum16_add(sum, w);
-    }
-
-    // Pseudo-header: UDP length (32-bit)
-    sum = sum16_add(sum, (uint16_t)((udp_len >> 16) & 0xFFFFu));
-    sum = sum16_add(sum, (uint16_t)(udp_len & 0xFFFFu));
-
-    // Pseudo-header: next header (32-bit: 0x00000011)
-    sum = sum16_add(sum, 0x0000);
-    sum = sum16_add(sum, 0x0011);
-
-    // UDP header + payload (checksum field treated as zero)
-    for (size_t i = 0; i + 1 < udp_len; i += 2) {
-        uint16_t w;
-        if (i == 6) {
-            // checksum field
-            w = 0x0000;
-        } else {
-            w = (uint16_t)((udp[i] << 8) | udp[i + 1]);
-        }
-        sum = sum16_add(sum, w);
-    }
-
-    // Odd length padding
-    if (udp_len & 1u) {
-        uint16_t w = (uint16_t)(udp[udp_len - 1] << 8);
-        sum = sum16_add(sum, w);
+    uint32_t sum = inet_csum_partial(src_ip, 16, 0);
+    sum = inet_csum_partial(dst_ip, 16, sum);
+
+    // Pseudo-header: UDP length (32-bit) + next header (32-bit: 0x00000011)
+    sum += (uint32_t)((udp_len >> 16) & 0xFFFFu);
+    sum += (uint32_t)(udp_len & 0xFFFFu);
+    sum += 0x0011;
+
+    // UDP header up to the checksum field, then everything after it
+    sum = inet_csum_partial(udp, 6, sum);
+    if (udp_len > UDP_HDR_LEN) {
+        sum = inet_csum_partial(udp + UDP_HDR_LEN, udp_len - UDP_HDR_LEN, sum);
     }
 
     uint16_t csum = ones_complement(sum);
@@ -137,3 +110,85 @@ int build_ipv6_udp_packet(const ipv6_udp_cfg_t *cfg,
     *out_len = total_len;
     return 0;
 }
+
+int ipv6_udp_tpl_init(ipv6_udp_tpl_t *tpl,
+                      const ipv6_udp_cfg_t *cfg,
+                      uint32_t flow_lbl)
+{
+    if (!tpl || !cfg) return -1;
+
+    size_t len = 0;
+    if (build_ipv6_udp_packet(cfg, flow_lbl, NULL, 0, tpl->hdr, sizeof(tpl->hdr), &len) != 0) return -1;
+
+    // Lengths and checksum are filled per packet
+    put_u16_be(&tpl->hdr[4], 0);
+    put_u16_be(&tpl->hdr[IPV6_HDR_LEN + 4], 0);
+    put_u16_be(&tpl->hdr[IPV6_HDR_LEN + 6], 0);
+
+    // Pseudo-header addresses + next header, then UDP ports
+    uint32_t sum = inet_csum_partial(&tpl->hdr[8], 32, 0);
+    sum += 0x0011;
+    sum = inet_csum_partial(&tpl->hdr[IPV6_HDR_LEN], 4, sum);
+    tpl->partial_sum = inet_csum_fold(sum);
+
+    return 0;
+}
+
+/* Write the header in front of a payload already at pkt[48..) */
+static void tpl_fill(const ipv6_udp_tpl_t *tpl, uint8_t *pkt, size_t payload_len)
+{
+    memcpy(pkt, tpl->hdr, sizeof(tpl->hdr));
+
+    const uint16_t udp_len16 = (uint16_t)(UDP_HDR_LEN + payload_len);
+    put_u16_be(&pkt[4], udp_len16);
+    put_u16_be(&pkt[IPV6_HDR_LEN + 4], udp_len16);
+
+    // Length appears twice: pseudo-header and UDP header
+    uint32_t sum = tpl->partial_sum + 2u * udp_len16;
+    sum = inet_csum_partial(&pkt[IPV6_HDR_LEN + UDP_HDR_LEN], payload_len, sum);
+
+    uint16_t csum = ones_complement(sum);
+    if (csum == 0x0000) csum = 0xFFFF; // per convention
+    put_u16_be(&pkt[IPV6_HDR_LEN + 6], csum);
+}
+
+int ipv6_udp_tpl_build(const ipv6_udp_tpl_t *tpl,
+                       const uint8_t *payload, size_t payload_len,
+                       uint8_t *out, size_t out_cap,
+                       size_t *out_len)
+{
+    if (!tpl || !out || !out_len) return -1;
+    if (!payload && payload_len != 0) return -1;
+    if (payload_len > UINT16_MAX - UDP_HDR_LEN) return -1;
+
+    const size_t total_len = IPV6_HDR_LEN + UDP_HDR_LEN + payload_len;
+    if (out_cap < total_len) return -1;
+
+    if (payload_len) {
+        memcpy(&out[IPV6_HDR_LEN + UDP_HDR_LEN], payload, payload_len);
+    }
+    tpl_fill(tpl, out, payload_len);
+
+    *out_len = total_len;
+    return 0;
+}
+
+int ipv6_udp_tpl_push(const ipv6_udp_tpl_t *tpl, pktbuf_t *pb)
+{
+    if (!tpl || !pb) return -1;
+
+    const size_t payload_len = pb->len;
+    if (payload_len > UINT16_MAX - UDP_HDR_LEN) return -1;
+
+    uint8_t *pkt = pktbuf_push(pb, IPV6_HDR_LEN + UDP_HDR_LEN);
+    if (!pkt) return -1;
+
+    tpl_fill(tpl, pkt, payload_len);
+    return 0;
+}
+
+uint16_t ipv6_udp_checksum(const uint8_t *pkt, size_t pkt_len)
+{
+    if (!pkt || pkt_len < IPV6_HDR_LEN + UDP_HDR_LEN) return 0;
+    return udp_checksum_ipv6(&pkt[8], &pkt[24], &pkt[IPV6_HDR_LEN], pkt_len - IPV6_HDR_LEN);
+}
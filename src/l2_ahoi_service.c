@@ -1,5 +1,7 @@
 #include "l2.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdbool.h>
 #include <termios.h>
@@ -7,13 +9,16 @@
 #include <ahoilib.h>
 
 #include "../logger_helper.h"
+#include "../pkt_trace.h"
 
 static int g_ahoi_fd = -1;
+// Second open of the same tty for the downlink: its own O_NONBLOCK status
+// flag leaves the blocking writes of send_ahoi_data() untouched
+static int g_rx_fd = -1;
 static const char* port = NULL;
 static int32_t baudrate = -1;
 static uint8_t modem_id = 0x00;
 static uint32_t modem_id_32 = 0x00;
-static ahoi_packet_t staging_p = {0};
 
 l2_init_status l2_init() {
     g_ahoi_fd = open_serial_port(port, baudrate);
@@ -25,6 +30,11 @@ l2_init_status l2_init() {
 
     tcflush(g_ahoi_fd, TCIFLUSH);
     set_ahoi_id(g_ahoi_fd, modem_id);
+
+    g_rx_fd = open(port, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (g_rx_fd == -1) {
+        zlog_warn(error_cat, "No downlink, cannot open %s for reading: %s", port, strerror(errno));
+    }
     // set_ahoi_sniff_mode(g_ahoi_fd, false);
     return L2_INIT_OK;
 }
@@ -50,18 +60,29 @@ uint8_t* l2_get_id_byte() {
     return &modem_id;
 }
 
-void l2_send_prepare(const void* header) {
-    memcpy(&staging_p, header, HEADER_SIZE - 1);
+int l2_get_fd(void) {
+    return g_rx_fd;
 }
 
-l2_send_status l2_send_run(const uint8_t* payload, const size_t size) {
-    staging_p.pl_size = (uint8_t) size;
-    staging_p.payload = payload;
+l2_send_status l2_xmit(const l2_frame_meta_t* meta, pktbuf_t* pb) {
+    if (pb->len > MAX_PAYLOAD_SIZE) {
+        return L2_SEND_KO;
+    }
+
+    // ahoi-serial-lib does its own framing and byte stuffing on the fly
+    ahoi_packet_t p = {0};
+    p.dst = (uint8_t) meta->dst;
+    p.type = meta->type;
+    p.flags = meta->flags;
+    p.seq = (uint8_t) meta->seq;
+    p.pl_size = (uint8_t) pb->len;
+    p.payload = pktbuf_data(pb);
 
-    const packet_send_status ret = send_ahoi_data(g_ahoi_fd, &staging_p);
+    const packet_send_status ret = send_ahoi_data(g_ahoi_fd, &p);
     if (ret == PACKET_SEND_KO) {
         return L2_SEND_KO;
     }
 
+    PKT_TRACE(PKT_TRACE_SUMMARY, "L2 TX", meta->seq, p.payload, p.pl_size);
     return L2_SEND_OK;
 }
\ No newline at end of file
@@ -0,0 +1,377 @@
+#define _GNU_SOURCE
+#include "l2.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../logger_helper.h"
+#include "../rng.h"
+#include "../utils.h"
+
+// Frames in flight between l2_xmit() and their delivery time
+#define DELAY_LINE_DEPTH 1024
+// Delivered frames waiting for l2_loop_recv()
+#define MEM_SINK_DEPTH 4096
+
+#define WIRE_HDR_LEN 7
+
+static uint8_t modem_id = 0x00;
+static uint32_t modem_id_32 = 0x00;
+
+static l2_loop_sink sink = L2_LOOP_MEM;
+static struct sockaddr_un sink_addr;
+static int sink_fd = -1;
+static int pty_slave_fd = -1;
+
+static l2_link_model_t link_model = { 0, 0, 0, 0, 1 };
+static rng_t link_rng;              // only the writer thread draws from it
+static uint64_t link_free_ns = 0;   // end of the previous frame's serialization
+static uint64_t last_arrival_ns = 0;
+
+// Single producer (the L2 TX writer) / single consumer (the delivery thread)
+static l2_loop_frame_t* delay_line = NULL;
+static _Atomic size_t dl_head = 0;
+static _Atomic size_t dl_tail = 0;
+static sem_t dl_items;
+
+// Single producer (the delivery thread) / single consumer (l2_loop_recv)
+static l2_loop_frame_t* mem_sink = NULL;
+static _Atomic size_t ms_head = 0;
+static _Atomic size_t ms_tail = 0;
+
+static pthread_t deliverer;
+static bool running = false;
+static atomic_bool stopping = false;
+
+static _Atomic uint64_t st_sent = 0;
+static _Atomic uint64_t st_lost = 0;
+static _Atomic uint64_t st_delivered = 0;
+static _Atomic uint64_t st_overruns = 0;
+static _Atomic uint64_t st_bytes = 0;
+
+static void sleep_until_ns(const uint64_t deadline) {
+    if (deadline <= monotonic_now_ns()) return;
+    const struct timespec ts = {
+        .tv_sec = (time_t) (deadline / 1000000000ull),
+        .tv_nsec = (long) (deadline % 1000000000ull)
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+int l2_loop_set_target(const char* spec) {
+    if (!spec || strcmp(spec, "mem") == 0) {
+        sink = L2_LOOP_MEM;
+        return 0;
+    }
+    if (strcmp(spec, "pty") == 0) {
+        sink = L2_LOOP_PTY;
+        return 0;
+    }
+    if (strncmp(spec, "unix:", 5) == 0 && spec[5] != '\0') {
+        if (strlen(spec + 5) >= sizeof(sink_addr.sun_path)) {
+            zlog_error(error_cat, "UNIX socket path too long: %s", spec + 5);
+            return -1;
+        }
+        memset(&sink_addr, 0, sizeof(sink_addr));
+        sink_addr.sun_family = AF_UNIX;
+        strcpy(sink_addr.sun_path, spec + 5);
+        sink = L2_LOOP_UNIX;
+        return 0;
+    }
+
+    zlog_error(error_cat, "Unknown loopback target: %s", spec);
+    return -1;
+}
+
+void l2_loop_set_link(const l2_link_model_t* model) {
+    link_model = *model;
+}
+
+int l2_loop_parse_link(const char* spec, l2_link_model_t* model) {
+    char buf[256];
+    if (strlen(spec) >= sizeof(buf)) return -1;
+    strcpy(buf, spec);
+
+    char* save = NULL;
+    for (char* kv = strtok_r(buf, ",", &save); kv; kv = strtok_r(NULL, ",", &save)) {
+        char* eq = strchr(kv, '=');
+        if (!eq) return -1;
+        *eq = '\0';
+
+        char* end = NULL;
+        const double v = strtod(eq + 1, &end);
+        if (end == eq + 1 || *end != '\0' || v < 0) {
+            zlog_error(error_cat, "Bad value for link parameter %s", kv);
+            return -1;
+        }
+
+        if (strcmp(kv, "bitrate") == 0) {
+            model->bitrate_bps = (uint32_t) v;
+        } else if (strcmp(kv, "latency_ms") == 0) {
+            model->latency_us = (uint32_t) (v * 1000.0);
+        } else if (strcmp(kv, "jitter_ms") == 0) {
+            model->jitter_us = (uint32_t) (v * 1000.0);
+        } else if (strcmp(kv, "loss") == 0) {
+            if (v > 1.0) {
+                zlog_error(error_cat, "Link parameter loss=%s out of range, a probability from 0 to 1", eq + 1);
+                return -1;
+            }
+            model->loss_ppm = (uint32_t) (v * 1e6);
+        } else if (strcmp(kv, "seed") == 0) {
+            model->seed = (uint64_t) v;
+        } else {
+            zlog_error(error_cat, "Unknown link parameter %s", kv);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int open_pty(void) {
+    const int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        if (master != -1) close(master);
+        return -1;
+    }
+
+    const char* name = ptsname(master);
+    // Keep the slave open in raw mode so the master never sees a hangup
+    pty_slave_fd = name ? open(name, O_RDWR | O_NOCTTY) : -1;
+    if (pty_slave_fd == -1) {
+        close(master);
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(pty_slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty_slave_fd, TCSANOW, &tio);
+
+    zlog_info(ok_cat, "Loopback frames on %s", name);
+    return master;
+}
+
+static void deliver(l2_loop_frame_t* f) {
+    bool ok = false;
+
+    if (sink == L2_LOOP_MEM) {
+        const size_t h = atomic_load_explicit(&ms_head, memory_order_relaxed);
+        if (h - atomic_load_explicit(&ms_tail, memory_order_acquire) < MEM_SINK_DEPTH) {
+            l2_loop_frame_t* slot = &mem_sink[h % MEM_SINK_DEPTH];
+            memcpy(slot, f, offsetof(l2_loop_frame_t, data) + f->len);
+            atomic_store_explicit(&ms_head, h + 1, memory_order_release);
+            ok = true;
+        }
+    } else {
+        const uint8_t hdr[WIRE_HDR_LEN] = {
+            (uint8_t) (f->len >> 8), (uint8_t) f->len,
+            (uint8_t) (f->meta.src ? f->meta.src : modem_id_32), (uint8_t) f->meta.dst, f->meta.type, f->meta.flags, (uint8_t) f->meta.seq
+        };
+        struct iovec iov[2] = {
+            { (void*) hdr, sizeof(hdr) },
+            { f->data, f->len }
+        };
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        if (sink == L2_LOOP_UNIX) {
+            msg.msg_name = &sink_addr;
+            msg.msg_namelen = sizeof(sink_addr);
+            ok = sendmsg(sink_fd, &msg, MSG_DONTWAIT) == (ssize_t) (sizeof(hdr) + f->len);
+        } else {
+            // A partial write would desynchronise the stream reader; pty writes
+            // of this size are atomic or fail with EAGAIN
+            ok = writev(sink_fd, iov, 2) == (ssize_t) (sizeof(hdr) + f->len);
+        }
+    }
+
+    if (ok) {
+        atomic_fetch_add_explicit(&st_delivered, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&st_bytes, f->len, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&st_overruns, 1, memory_order_relaxed);
+    }
+}
+
+static void* deliverer_main(void* arg) {
+    (void) arg;
+
+    for (;;) {
+        while (sem_wait(&dl_items) == -1 && errno == EINTR) {}
+
+        const size_t t = atomic_load_explicit(&dl_tail, memory_order_relaxed);
+        if (t == atomic_load_explicit(&dl_head, memory_order_acquire)) {
+            if (atomic_load(&stopping)) break;
+            continue;
+        }
+
+        l2_loop_frame_t* f = &delay_line[t % DELAY_LINE_DEPTH];
+        sleep_until_ns(f->deliver_ns);
+        f->deliver_ns = monotonic_now_ns();
+        deliver(f);
+        atomic_store_explicit(&dl_tail, t + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+l2_init_status l2_init() {
+    if (running) return L2_INIT_OK;
+
+    if (sink == L2_LOOP_PTY) {
+        sink_fd = open_pty();
+    } else if (sink == L2_LOOP_UNIX) {
+        sink_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    }
+    if (sink != L2_LOOP_MEM && sink_fd == -1) {
+        zlog_error(error_cat, "Error opening loopback sink: %s", strerror(errno));
+        return L2_INIT_ERROR;
+    }
+
+    free(mem_sink);
+    delay_line = calloc(DELAY_LINE_DEPTH, sizeof(*delay_line));
+    mem_sink = sink == L2_LOOP_MEM ? calloc(MEM_SINK_DEPTH, sizeof(*mem_sink)) : NULL;
+    if (!delay_line || (sink == L2_LOOP_MEM && !mem_sink)) {
+        zlog_error(error_cat, "Loopback buffers allocation failed");
+        l2_loop_fini();
+        return L2_INIT_ERROR;
+    }
+
+    rng_seed(&link_rng, link_model.seed);
+    link_free_ns = 0;
+    last_arrival_ns = 0;
+    atomic_store(&dl_head, 0);
+    atomic_store(&dl_tail, 0);
+    atomic_store(&ms_head, 0);
+    atomic_store(&ms_tail, 0);
+    atomic_store(&stopping, false);
+    sem_init(&dl_items, 0, 0);
+
+    if (pthread_create(&deliverer, NULL, deliverer_main, NULL) != 0) {
+        zlog_error(error_cat, "Loopback delivery thread start failed");
+        sem_destroy(&dl_items);
+        l2_loop_fini();
+        return L2_INIT_ERROR;
+    }
+    running = true;
+
+    zlog_info(ok_cat, "Loopback link: %u bps, %u us latency, %u us jitter, %u ppm loss",
+              link_model.bitrate_bps, link_model.latency_us, link_model.jitter_us, link_model.loss_ppm);
+    return L2_INIT_OK;
+}
+
+void l2_loop_fini(void) {
+    if (running) {
+        atomic_store(&stopping, true);
+        sem_post(&dl_items);
+        pthread_join(deliverer, NULL);
+        sem_destroy(&dl_items);
+        running = false;
+    }
+
+    if (sink_fd != -1) close(sink_fd);
+    if (pty_slave_fd != -1) close(pty_slave_fd);
+    sink_fd = -1;
+    pty_slave_fd = -1;
+
+    // The in-memory sink stays readable until the next l2_init()
+    free(delay_line);
+    delay_line = NULL;
+}
+
+void l2_set_id(const uint32_t id) {
+    modem_id = (uint8_t) id;
+    modem_id_32 = id;
+}
+
+uint32_t* l2_get_id() {
+    return &modem_id_32;
+}
+
+uint8_t* l2_get_id_byte() {
+    return &modem_id;
+}
+
+int l2_get_fd(void) {
+    // Whatever the peer writes on the pty slave is our downlink
+    return sink == L2_LOOP_PTY ? sink_fd : -1;
+}
+
+l2_send_status l2_xmit(const l2_frame_meta_t* meta, pktbuf_t* pb) {
+    if (!running || pb->len > L2_LOOP_MTU) {
+        return L2_SEND_KO;
+    }
+
+    const uint64_t now = monotonic_now_ns();
+    atomic_fetch_add_explicit(&st_sent, 1, memory_order_relaxed);
+
+    // The link is busy until the previous frame is fully serialized; the
+    // caller is held for that long, like with a real modem
+    uint64_t depart = link_free_ns > now ? link_free_ns : now;
+    if (link_model.bitrate_bps) {
+        depart += (uint64_t) pb->len * 8u * 1000000000ull / link_model.bitrate_bps;
+        link_free_ns = depart;
+        sleep_until_ns(depart);
+    }
+
+    // A lost frame still used its air time
+    if (link_model.loss_ppm && rng_below(&link_rng, 1000000u) < link_model.loss_ppm) {
+        atomic_fetch_add_explicit(&st_lost, 1, memory_order_relaxed);
+        return L2_SEND_OK;
+    }
+
+    uint64_t arrival = depart + (uint64_t) link_model.latency_us * 1000u;
+    if (link_model.jitter_us) {
+        arrival += rng_below(&link_rng, (uint64_t) link_model.jitter_us * 1000u + 1u);
+    }
+    // The link does not reorder frames
+    if (arrival < last_arrival_ns) arrival = last_arrival_ns;
+    last_arrival_ns = arrival;
+
+    const size_t h = atomic_load_explicit(&dl_head, memory_order_relaxed);
+    if (h - atomic_load_explicit(&dl_tail, memory_order_acquire) >= DELAY_LINE_DEPTH) {
+        atomic_fetch_add_explicit(&st_overruns, 1, memory_order_relaxed);
+        return L2_SEND_OK;
+    }
+
+    l2_loop_frame_t* f = &delay_line[h % DELAY_LINE_DEPTH];
+    f->meta = *meta;
+    f->sent_ns = meta->stamp_ns ? meta->stamp_ns : now;
+    f->deliver_ns = arrival;
+    f->len = (uint16_t) pb->len;
+    memcpy(f->data, pktbuf_data(pb), pb->len);
+
+    atomic_store_explicit(&dl_head, h + 1, memory_order_release);
+    sem_post(&dl_items);
+    return L2_SEND_OK;
+}
+
+int l2_loop_recv(l2_loop_frame_t* out) {
+    if (!mem_sink) return 0;
+
+    const size_t t = atomic_load_explicit(&ms_tail, memory_order_relaxed);
+    if (t == atomic_load_explicit(&ms_head, memory_order_acquire)) return 0;
+
+    const l2_loop_frame_t* slot = &mem_sink[t % MEM_SINK_DEPTH];
+    memcpy(out, slot, offsetof(l2_loop_frame_t, data) + slot->len);
+    atomic_store_explicit(&ms_tail, t + 1, memory_order_release);
+    return 1;
+}
+
+void l2_loop_get_stats(l2_loop_stats_t* stats) {
+    stats->sent = atomic_load_explicit(&st_sent, memory_order_relaxed);
+    stats->lost = atomic_load_explicit(&st_lost, memory_order_relaxed);
+    stats->delivered = atomic_load_explicit(&st_delivered, memory_order_relaxed);
+    stats->overruns = atomic_load_explicit(&st_overruns, memory_order_relaxed);
+    stats->bytes = atomic_load_explicit(&st_bytes, memory_order_relaxed);
+}
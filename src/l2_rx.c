@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+#include "l2_rx.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../logger_helper.h"
+#include "../utils.h"
+
+#define DLE 0x10
+#define STX 0x02
+#define ETX 0x03
+
+typedef enum {
+    RX_HUNT,        // outside a frame, looking for DLE
+    RX_HUNT_DLE,    // outside a frame, after DLE
+    RX_IN,          // inside a frame
+    RX_IN_DLE       // inside a frame, after DLE
+} rx_state_t;
+
+// The same pages are mapped at base and base + capacity, so the bytes from any
+// index up to capacity bytes further are contiguous starting at base + (i & mask).
+static uint8_t* base = NULL;
+static size_t capacity = 0;
+static size_t mask = 0;
+
+// Monotonic byte indexes: tail <= frame_start <= scan <= head.
+// head: next byte read in; scan: next byte to parse; tail: oldest byte still needed.
+static size_t head = 0;
+static size_t scan = 0;
+static size_t tail = 0;
+static size_t frame_start = 0;  // first byte after DLE STX
+static size_t frame_len = 0;    // unstuffed bytes written back from frame_start
+static rx_state_t state = RX_HUNT;
+
+static l2_rx_cb rx_cb = NULL;
+static void* rx_ctx = NULL;
+
+static l2_rx_stats_t st;
+
+static uint8_t* map_mirrored(const size_t size) {
+    const int fd = memfd_create("l2-rx-ring", MFD_CLOEXEC);
+    if (fd == -1) return NULL;
+
+    uint8_t* addr = MAP_FAILED;
+    if (ftruncate(fd, (off_t) size) == 0) {
+        // Reserve both halves first so nothing else can land in the second one
+        addr = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (addr != MAP_FAILED &&
+        (mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+         mmap(addr + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+        munmap(addr, 2 * size);
+        addr = MAP_FAILED;
+    }
+    close(fd);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+l2_rx_status l2_rx_init(const size_t cap, const l2_rx_cb cb, void* ctx) {
+    if (base || !cb) return L2_RX_KO;
+
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t size = page;
+    while (size < cap || size < 2 * (L2_RX_MAX_FRAME + 2)) size <<= 1;
+
+    base = map_mirrored(size);
+    if (!base) {
+        zlog_error(error_cat, "Cannot map the L2 RX ring: %s", strerror(errno));
+        return L2_RX_KO;
+    }
+
+    capacity = size;
+    mask = size - 1;
+    head = scan = tail = frame_start = frame_len = 0;
+    state = RX_HUNT;
+    rx_cb = cb;
+    rx_ctx = ctx;
+    memset(&st, 0, sizeof(st));
+    return L2_RX_OK;
+}
+
+void l2_rx_fini(void) {
+    if (base) munmap(base, 2 * capacity);
+    base = NULL;
+    rx_cb = NULL;
+}
+
+static void start_frame(void) {
+    frame_start = tail = scan;
+    frame_len = 0;
+    state = RX_IN;
+}
+
+static void drop_frame(void) {
+    tail = scan;
+    state = RX_HUNT;
+}
+
+static void end_frame(const uint8_t* f) {
+    drop_frame();
+
+    if (frame_len < L2_RX_HDR_SIZE || frame_len < (size_t) L2_RX_HDR_SIZE + f[5]) {
+        st.malformed++;
+        return;
+    }
+
+    l2_rx_frame_t frame;
+    frame.meta = (l2_frame_meta_t){ f[0], f[1], f[4], f[2], f[3], monotonic_now_ns() };
+    frame.payload = f + L2_RX_HDR_SIZE;
+    frame.len = f[5];
+    frame.footer = frame.payload + frame.len;
+    frame.footer_len = frame_len - L2_RX_HDR_SIZE - frame.len;
+
+    st.frames++;
+    rx_cb(&frame, rx_ctx);
+}
+
+static void parse(void) {
+    while (scan != head) {
+        const size_t avail = head - scan;
+
+        if (state == RX_HUNT) {
+            const uint8_t* p = base + (scan & mask);
+            const uint8_t* dle = memchr(p, DLE, avail);
+            const size_t skip = dle ? (size_t) (dle - p) + 1 : avail;
+            st.discarded += skip;
+            scan += skip;
+            tail = scan;
+            if (dle) state = RX_HUNT_DLE;
+            continue;
+        }
+
+        if (state == RX_HUNT_DLE) {
+            const uint8_t b = base[scan & mask];
+            scan++;
+            if (b == STX) {
+                st.discarded--;     // the DLE belonged to the frame
+                start_frame();
+            } else {
+                st.discarded++;
+                tail = scan;
+                // DLE DLE outside a frame: the second one may still open one
+                if (b != DLE) state = RX_HUNT;
+            }
+            continue;
+        }
+
+        // Unstuffed bytes are written back over the stuffed ones, from frame_start on
+        uint8_t* f = base + (frame_start & mask);
+        const uint8_t* p = f + (scan - frame_start);
+
+        if (state == RX_IN) {
+            const uint8_t* dle = memchr(p, DLE, avail);
+            const size_t run = dle ? (size_t) (dle - p) : avail;
+            if (frame_len + run > L2_RX_MAX_FRAME) {
+                st.oversize++;
+                drop_frame();
+                continue;
+            }
+            // Equal until the first escaped DLE; after it the write side lags behind
+            if (f + frame_len != p) memmove(f + frame_len, p, run);
+            frame_len += run;
+            scan += run;
+            if (dle) {
+                scan++;
+                state = RX_IN_DLE;
+            }
+            continue;
+        }
+
+        // RX_IN_DLE
+        scan++;
+        switch (*p) {
+            case DLE:
+                if (frame_len == L2_RX_MAX_FRAME) {
+                    st.oversize++;
+                    drop_frame();
+                    break;
+                }
+                f[frame_len++] = DLE;
+                state = RX_IN;
+                break;
+            case ETX:
+                end_frame(f);
+                break;
+            case STX:
+                st.aborted++;
+                start_frame();
+                break;
+            default:
+                st.aborted++;
+                drop_frame();
+                break;
+        }
+    }
+}
+
+// A frame never needs more than 2 * L2_RX_MAX_FRAME + 2 bytes of ring, so this
+// only happens if bytes are pushed in without parsing them
+static size_t make_room(void) {
+    size_t room = capacity - (head - tail);
+    if (!room) {
+        st.overflows++;
+        scan = head;
+        drop_frame();
+        room = capacity;
+    }
+    return room;
+}
+
+l2_rx_status l2_rx_poll(const int fd) {
+    if (!base) return L2_RX_KO;
+
+    for (;;) {
+        const size_t room = make_room();
+        const ssize_t n = read(fd, base + (head & mask), room);
+        if (n > 0) {
+            head += (size_t) n;
+            st.bytes += (uint64_t) n;
+            parse();
+            // A short read drained the descriptor; a level-triggered loop calls again otherwise
+            if ((size_t) n < room) return L2_RX_OK;
+            continue;
+        }
+        if (n == 0) return L2_RX_KO;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return L2_RX_OK;
+
+        zlog_error(error_cat, "L2 RX read: %s", strerror(errno));
+        return L2_RX_KO;
+    }
+}
+
+size_t l2_rx_feed(const uint8_t* data, const size_t len) {
+    if (!base) return 0;
+
+    size_t done = 0;
+    while (done < len) {
+        size_t n = make_room();
+        if (n > len - done) n = len - done;
+        memcpy(base + (head & mask), data + done, n);
+        head += n;
+        st.bytes += n;
+        done += n;
+        parse();
+    }
+    return done;
+}
+
+void l2_rx_get_stats(l2_rx_stats_t* stats) {
+    *stats = st;
+}
@@ -0,0 +1,289 @@
+#include "l2_tx.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../logger_helper.h"
+#include "../spsc_ring.h"
+#include "../utils.h"
+
+// One lane per producer thread, each an SPSC ring of its own frames.
+// queue.head: next slot the producer fills; sent: next slot the writer sends;
+// queue.tail: next slot to be released. sent == tail unless completions are deferred.
+typedef struct {
+    spsc_ring_t queue;          // its semaphore is unused: the writer sleeps on work_sem
+    _Atomic size_t sent;
+    size_t acquired;            // producer only: slot of the last acquire
+    l2_tx_frame_t* frames;
+    // Only used to sleep/wake, like work_sem. Posted only when space_waiter is set,
+    // so it never counts more than one wake-up
+    sem_t space_sem;
+    atomic_bool space_waiter;   // the producer is about to sleep on space_sem
+} tx_lane_t;
+
+static tx_lane_t* lanes = NULL;
+static size_t nb_lanes = 1;
+static size_t lane_depth = 0;
+static l2_tx_frame_t* frames = NULL;    // lane after lane, lane_depth each
+static uint8_t* buffers = NULL;         // L2_TX_FRAME_CAP bytes per frame, plus one spare
+static _Atomic(uint8_t*) spare = NULL;  // NULL while a buffer is taken out (l2_tx_take_buffer())
+static l2_tx_policy tx_policy = L2_TX_BLOCK;
+static l2_tx_done_cb done_cb = NULL;
+static void* done_ctx = NULL;
+
+static sem_t work_sem;              // one post per committed frame, whatever its lane
+static size_t next_lane = 0;        // writer only: lane looked at first, for round robin
+static int completion_fd = -1;      // deferred completions only
+static atomic_bool stopping = false;
+
+static pthread_t writer;
+static bool running = false;
+
+static _Atomic uint64_t st_enqueued = 0;
+static _Atomic uint64_t st_sent = 0;
+static _Atomic uint64_t st_failed = 0;
+static _Atomic uint64_t st_dropped = 0;
+
+static void sem_wait_nointr(sem_t* sem) {
+    while (sem_wait(sem) == -1 && errno == EINTR) {}
+}
+
+// After releasing slots of lane: wake its producer if it waits for one
+static void wake_space_waiter(tx_lane_t* lane) {
+    // Pairs with the fence in l2_tx_acquire_lane(): either it sees the new tail, or we see its flag
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&lane->space_waiter, memory_order_relaxed) &&
+        atomic_exchange_explicit(&lane->space_waiter, false, memory_order_relaxed)) {
+        sem_post(&lane->space_sem);
+    }
+}
+
+// Next lane with a frame committed and not sent, lanes taken in turn so none starves
+static tx_lane_t* next_ready_lane(void) {
+    for (size_t i = 0; i < nb_lanes; i++) {
+        tx_lane_t* lane = &lanes[(next_lane + i) % nb_lanes];
+        if (atomic_load_explicit(&lane->sent, memory_order_relaxed) != spsc_ring_head(&lane->queue)) {
+            next_lane = (next_lane + i + 1) % nb_lanes;
+            return lane;
+        }
+    }
+    return NULL;
+}
+
+static void* writer_main(void* arg) {
+    (void) arg;
+
+    for (;;) {
+        // One post per committed frame: there is a frame to send unless woken to stop
+        sem_wait_nointr(&work_sem);
+
+        tx_lane_t* lane = next_ready_lane();
+        if (!lane) {
+            if (atomic_load(&stopping)) break;
+            continue;
+        }
+
+        const size_t t = atomic_load_explicit(&lane->sent, memory_order_relaxed);
+        l2_tx_frame_t* f = &lane->frames[t & lane->queue.mask];
+        f->xmit_start_ns = monotonic_now_ns();
+        f->status = l2_xmit(&f->meta, &f->pb);
+        f->xmit_end_ns = monotonic_now_ns();
+        atomic_fetch_add_explicit(f->status == L2_SEND_OK ? &st_sent : &st_failed, 1, memory_order_relaxed);
+
+        if (completion_fd != -1) {
+            // The slot stays owned until l2_tx_dispatch_completions() runs its callback
+            atomic_store_explicit(&lane->sent, t + 1, memory_order_release);
+            const uint64_t one = 1;
+            (void) !write(completion_fd, &one, sizeof(one));
+            continue;
+        }
+
+        if (done_cb) done_cb(f, f->status, done_ctx);
+
+        atomic_store_explicit(&lane->sent, t + 1, memory_order_relaxed);
+        spsc_ring_release(&lane->queue, t + 1);
+        wake_space_waiter(lane);
+    }
+
+    return NULL;
+}
+
+static void free_lanes(const size_t nb_init) {
+    for (size_t i = 0; i < nb_init; i++) {
+        spsc_ring_destroy(&lanes[i].queue);
+        sem_destroy(&lanes[i].space_sem);
+    }
+    free(lanes);
+    free(frames);
+    free(buffers);
+    lanes = NULL;
+    frames = NULL;
+    buffers = NULL;
+    atomic_store(&spare, NULL);
+}
+
+l2_tx_status l2_tx_set_lanes(const size_t n) {
+    if (running || n == 0) return L2_TX_KO;
+    nb_lanes = n;
+    return L2_TX_OK;
+}
+
+l2_tx_status l2_tx_start(const size_t depth, const l2_tx_policy policy, const l2_tx_done_cb cb, void* ctx) {
+    if (running || depth == 0 || (depth & (depth - 1)) != 0) return L2_TX_KO;
+
+    lanes = aligned_alloc(64, nb_lanes * sizeof(*lanes));
+    frames = calloc(nb_lanes * depth, sizeof(*frames));
+    buffers = malloc((nb_lanes * depth + 1) * L2_TX_FRAME_CAP);
+    if (!lanes || !frames || !buffers) {
+        free_lanes(0);
+        return L2_TX_KO;
+    }
+    for (size_t i = 0; i < nb_lanes * depth; i++) frames[i].storage = buffers + i * L2_TX_FRAME_CAP;
+    atomic_store(&spare, buffers + nb_lanes * depth * L2_TX_FRAME_CAP);
+    memset(lanes, 0, nb_lanes * sizeof(*lanes));
+    size_t nb_init = 0;
+    for (; nb_init < nb_lanes; nb_init++) {
+        tx_lane_t* lane = &lanes[nb_init];
+        if (spsc_ring_init(&lane->queue, depth) != 0) break;
+        sem_init(&lane->space_sem, 0, 0);
+        lane->frames = frames + nb_init * depth;
+    }
+    if (nb_init < nb_lanes) {
+        free_lanes(nb_init);
+        return L2_TX_KO;
+    }
+
+    lane_depth = depth;
+    tx_policy = policy;
+    done_cb = cb;
+    done_ctx = ctx;
+    next_lane = 0;
+    atomic_store(&stopping, false);
+    sem_init(&work_sem, 0, 0);
+
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        zlog_error(error_cat, "L2 TX writer thread start failed");
+        sem_destroy(&work_sem);
+        free_lanes(nb_lanes);
+        return L2_TX_KO;
+    }
+
+    running = true;
+    return L2_TX_OK;
+}
+
+void l2_tx_stop(void) {
+    if (!running) return;
+
+    atomic_store(&stopping, true);
+    sem_post(&work_sem);
+    pthread_join(writer, NULL);
+
+    // Frames sent but not yet dispatched still get their callback
+    if (completion_fd != -1) l2_tx_dispatch_completions();
+
+    sem_destroy(&work_sem);
+    free_lanes(nb_lanes);
+    running = false;
+
+    if (completion_fd != -1) close(completion_fd);
+    completion_fd = -1;
+}
+
+int l2_tx_defer_completions(void) {
+    if (running) return -1;
+    if (completion_fd == -1) completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return completion_fd;
+}
+
+size_t l2_tx_dispatch_completions(void) {
+    if (completion_fd == -1 || !lanes) return 0;
+
+    uint64_t n;
+    (void) !read(completion_fd, &n, sizeof(n));
+
+    size_t count = 0;
+    for (size_t l = 0; l < nb_lanes; l++) {
+        tx_lane_t* lane = &lanes[l];
+        size_t t = spsc_ring_tail(&lane->queue);
+        const size_t s = atomic_load_explicit(&lane->sent, memory_order_acquire);
+        if (t == s) continue;
+        for (; t != s; t++, count++) {
+            l2_tx_frame_t* f = &lane->frames[t & lane->queue.mask];
+            if (done_cb) done_cb(f, f->status, done_ctx);
+            spsc_ring_release(&lane->queue, t + 1);
+        }
+        wake_space_waiter(lane);
+    }
+    return count;
+}
+
+l2_tx_frame_t* l2_tx_acquire_lane(const size_t l) {
+    if (!running || l >= nb_lanes) return NULL;
+    tx_lane_t* lane = &lanes[l];
+
+    while (!spsc_ring_reserve(&lane->queue, &lane->acquired)) {
+        if (tx_policy == L2_TX_DROP_NEWEST) {
+            atomic_fetch_add_explicit(&st_dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+        // Announce the wait, then look again: a slot released before the flag was seen is not missed
+        atomic_store_explicit(&lane->space_waiter, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (spsc_ring_reserve(&lane->queue, &lane->acquired)) {
+            // A wake-up already posted for the flag is left over; the next wait returns at once and looks again
+            atomic_store_explicit(&lane->space_waiter, false, memory_order_relaxed);
+            break;
+        }
+        sem_wait_nointr(&lane->space_sem);
+    }
+
+    l2_tx_frame_t* f = &lane->frames[lane->acquired & lane->queue.mask];
+    pktbuf_init(&f->pb, f->storage, L2_TX_FRAME_CAP, PKTBUF_HEADROOM);
+    f->user = NULL;
+    return f;
+}
+
+l2_tx_frame_t* l2_tx_acquire(void) {
+    return l2_tx_acquire_lane(0);
+}
+
+void l2_tx_commit(l2_tx_frame_t* frame) {
+    tx_lane_t* lane = &lanes[(size_t) (frame - frames) / lane_depth];
+
+    spsc_ring_publish(&lane->queue, lane->acquired);
+    atomic_fetch_add_explicit(&st_enqueued, 1, memory_order_relaxed);
+    sem_post(&work_sem);
+}
+
+uint8_t* l2_tx_take_buffer(l2_tx_frame_t* frame) {
+    uint8_t* s = atomic_exchange(&spare, NULL);
+    if (!s) return NULL;
+    uint8_t* taken = frame->storage;
+    frame->storage = s;
+    return taken;
+}
+
+void l2_tx_give_back_buffer(uint8_t* buffer) {
+    atomic_store(&spare, buffer);
+}
+
+size_t l2_tx_available(void) {
+    if (!running) return 0;
+    return lanes[0].queue.mask + 1 - spsc_ring_used(&lanes[0].queue);
+}
+
+void l2_tx_get_stats(l2_tx_stats_t* stats) {
+    stats->enqueued = atomic_load_explicit(&st_enqueued, memory_order_relaxed);
+    stats->sent = atomic_load_explicit(&st_sent, memory_order_relaxed);
+    stats->failed = atomic_load_explicit(&st_failed, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&st_dropped, memory_order_relaxed);
+}
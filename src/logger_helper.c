@@ -2,8 +2,12 @@
 
 #include <stdio.h>
 
+#include "async_log.h"
+
 zlog_category_t* ok_cat = NULL;
 zlog_category_t* error_cat = NULL;
+zlog_category_t* trace_cat = NULL;
+zlog_category_t* stat_cat = NULL;
 
 logger_status logger_init() {
     const int rc = zlog_init(LOG_CONFIG_FILE);
@@ -26,5 +30,24 @@ logger_status logger_init() {
         return LOGGER_INIT_KO;
     }
 
+    trace_cat = zlog_get_category("trace");
+    if (!trace_cat) {
+        fprintf(stderr, "Trace category init failed\n");
+        zlog_fini();
+        return LOGGER_INIT_KO;
+    }
+
+    stat_cat = zlog_get_category("stat");
+    if (!stat_cat) {
+        fprintf(stderr, "Stat category init failed\n");
+        zlog_fini();
+        return LOGGER_INIT_KO;
+    }
+
     return LOGGER_INIT_OK;
+}
+
+void logger_fini(void) {
+    alog_fini();
+    zlog_fini();
 }
\ No newline at end of file
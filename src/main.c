@@ -1,24 +1,102 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <time.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <ahoi_serial/ahoi_defs.h>
 #include <ahoi_serial/core.h>
 
+#include "schc_demo_app/async_log.h"
 #include "schc_demo_app/l2/l2.h"
+#include "schc_demo_app/l2/l2_rx.h"
+#include "schc_demo_app/l2/l2_tx.h"
 #include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/pkt_trace.h"
+#include "schc_demo_app/pcap_writer.h"
+#include "schc_demo_app/rng.h"
+#include "schc_demo_app/stats.h"
 #include "schc_demo_app/cli_helper.h"
+#include "schc_demo_app/event_loop.h"
 #include "schc_demo_app/services/sensor_service.h"
+#include "schc_demo_app/services/sensor_agg.h"
+#include "schc_demo_app/services/sensor_codec.h"
 #include "schc_demo_app/services/schc_service.h"
+#include "schc_demo_app/services/schc_frag.h"
+#include "schc_demo_app/services/sim_service.h"
 #include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/utils.h"
 
 #ifndef SENSOR_SLEEP_SEC
 #define SENSOR_SLEEP_SEC 3
 #endif
 
+#ifndef L2_TX_DEPTH
+#define L2_TX_DEPTH 16
+#endif
+
+#ifndef L2_RX_RING_SIZE
+#define L2_RX_RING_SIZE 4096
+#endif
+
+#ifndef STATS_PERIOD_NS
+#define STATS_PERIOD_NS (60ull * 1000000000ull)
+#endif
+
+#ifndef FRAG_ACK_TIMEOUT_NS
+#define FRAG_ACK_TIMEOUT_NS (20ull * 1000000000ull)
+#endif
+
+/* Per simulation worker */
+#ifndef SIM_TX_DEPTH
+#define SIM_TX_DEPTH 1024
+#endif
+
+#ifndef SIM_DEFAULT_DURATION_S
+#define SIM_DEFAULT_DURATION_S 10
+#endif
+
+#ifndef PKT_TRACE_DEPTH
+#define PKT_TRACE_DEPTH 256
+#endif
+
+#ifndef LOG_RING_DEPTH
+#define LOG_RING_DEPTH 1024
+#endif
+
+#ifndef PCAP_RING_DEPTH
+#define PCAP_RING_DEPTH 4096
+#endif
+
+/* Downlink control frames: L2 type DL_TYPE_CONTROL, the first payload byte is the command */
+#define DL_TYPE_CONTROL 0x7C
+#define DL_CTRL_RELOAD_RULES 0x01
+
 const double SLEEP_MEAN_MS = SENSOR_SLEEP_SEC * 1000.0;
 
+/* Runs on the L2 writer thread, or on the event loop when completions are deferred */
+static void on_tx_done(const l2_tx_frame_t *frame, l2_send_status status, void *ctx)
+{
+    (void)ctx;
+    stats_record(STAT_L2_SEND, frame->xmit_end_ns - frame->xmit_start_ns);
+    if (status != L2_SEND_OK) {
+        stats_count(STAT_L2_FAILED, 1);
+        ALOG_ERROR(error_cat, "Error sending packet %u", frame->meta.seq);
+        return;
+    }
+    stats_count(STAT_L2_SENT, 1);
+    if (frame->meta.stamp_ns && frame->xmit_end_ns > frame->meta.stamp_ns) {
+        stats_record(STAT_TX_LATENCY, frame->xmit_end_ns - frame->meta.stamp_ns);
+    }
+}
+
 static void dump_hex(const char *label, const uint8_t *buf, size_t len)
 {
     printf("\n=== %s (len=%zu) ===\n", label, len);
@@ -48,6 +126,649 @@ static void init_net_cfg_from_schc(ipv6_udp_cfg_t *cfg)
     cfg->hop_limit = schc_service_hop_limit();
 }
 
+/* Counters other modules keep, appended to the stats report */
+static void format_module_stats(char *buf, size_t cap)
+{
+    schc_service_stats_t schc;
+    schc_service_get_stats(&schc);
+    l2_tx_stats_t tx;
+    l2_tx_get_stats(&tx);
+    alog_stats_t log;
+    alog_get_stats(&log);
+    snprintf(buf, cap, "schc: compressed %llu, no-compression rule %llu, failed %llu; "
+                       "tx queue: queued %llu, dropped %llu; "
+                       "log: written %llu, dropped %llu, direct %llu",
+             (unsigned long long)schc.compressed, (unsigned long long)schc.no_comp,
+             (unsigned long long)schc.failed, (unsigned long long)tx.enqueued, (unsigned long long)tx.dropped,
+             (unsigned long long)log.written, (unsigned long long)log.dropped, (unsigned long long)log.direct);
+}
+
+static void log_stats(void)
+{
+    char extra[512];
+    format_module_stats(extra, sizeof(extra));
+    stats_log(extra);
+}
+
+/*
+ * Offline verification: every packet goes through the zero-copy pipeline
+ * (measure into the buffer, push the header, compress in place), is
+ * decompressed and compared byte for byte with what build_ipv6_udp_packet
+ * produces for the same payload. No payload copy is allowed in the pipeline.
+ * Reports throughput.
+ */
+static int run_roundtrip(uint32_t count)
+{
+    static ipv6_udp_cfg_t net_cfg;
+    init_net_cfg_from_schc(&net_cfg);
+
+    static ipv6_udp_tpl_t net_tpl;
+    if (ipv6_udp_tpl_init(&net_tpl, &net_cfg, schc_service_flow_label()) != 0) {
+        zlog_error(error_cat, "IPv6/UDP header template init failed");
+        return EXIT_FAILURE;
+    }
+
+    static uint8_t pkt_storage[256];
+    static uint8_t ipv6udp_pkt[256];
+    static uint8_t rebuilt[256];
+    pktbuf_t pb;
+
+    uint32_t mismatches = 0;
+    uint32_t copies = 0;
+    uint64_t comp_ns = 0;
+    uint64_t decomp_ns = 0;
+    size_t in_bytes = 0;
+    size_t out_bytes = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        pktbuf_init(&pb, pkt_storage, sizeof(pkt_storage), PKTBUF_HEADROOM);
+        sensor_data_t *sensor_data = (sensor_data_t *)pktbuf_put(&pb, sizeof(sensor_data_t));
+        (void)measure(sensor_data);
+
+        size_t ipv6udp_len = 0;
+        if (build_ipv6_udp_packet(&net_cfg, schc_service_flow_label(),
+                                  pktbuf_data(&pb), pb.len,
+                                  ipv6udp_pkt, sizeof(ipv6udp_pkt),
+                                  &ipv6udp_len) != 0 ||
+            ipv6_udp_tpl_push(&net_tpl, &pb) != 0) {
+            zlog_error(error_cat, "IPv6/UDP packet build failed");
+            return EXIT_FAILURE;
+        }
+
+        uint64_t t0 = monotonic_now_ns();
+        if (schc_service_compress_pkt(&pb) != SCHC_OK) {
+            zlog_error(error_cat, "SCHC compress failed for packet %u", i);
+            return EXIT_FAILURE;
+        }
+        uint64_t t1 = monotonic_now_ns();
+
+        size_t rebuilt_len = 0;
+        if (schc_service_decompress(pktbuf_data(&pb), pb.len,
+                                    rebuilt, sizeof(rebuilt), &rebuilt_len) != SCHC_OK) {
+            zlog_error(error_cat, "SCHC decompress failed for packet %u", i);
+            return EXIT_FAILURE;
+        }
+        uint64_t t2 = monotonic_now_ns();
+
+        comp_ns += t1 - t0;
+        decomp_ns += t2 - t1;
+        in_bytes += ipv6udp_len;
+        out_bytes += pb.len;
+        copies += pb.copies;
+
+        if (rebuilt_len != ipv6udp_len || memcmp(rebuilt, ipv6udp_pkt, ipv6udp_len) != 0) {
+            if (mismatches++ == 0) {
+                dump_hex("Original", ipv6udp_pkt, ipv6udp_len);
+                dump_hex("Rebuilt", rebuilt, rebuilt_len);
+            }
+        }
+    }
+
+    zlog_info(ok_cat, "Round trip: %u packets, %u mismatches, %u payload copies, ratio %.3f",
+              count, mismatches, copies, (double)out_bytes / (double)in_bytes);
+    zlog_info(ok_cat, "Compress: %.1f ns/pkt, decompress: %.1f ns/pkt (%.0f pkt/s)",
+              (double)comp_ns / count, (double)decomp_ns / count,
+              decomp_ns ? 1e9 * count / (double)decomp_ns : 0.0);
+
+    return mismatches || copies ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Each simulation worker fills its own TX lane: packets are built in the frame they are sent from */
+static pktbuf_t *sim_acquire(uint32_t worker, void *ctx)
+{
+    (void)ctx;
+    l2_tx_frame_t *frame = l2_tx_acquire_lane(worker);
+    if (!frame) stats_count(STAT_PKT_DROPPED_QUEUE, 1);
+    return frame ? &frame->pb : NULL;
+}
+
+static sim_status sim_emit(uint32_t worker, uint32_t dev_id, uint32_t seq, uint64_t due_ns, pktbuf_t *pb, void *ctx)
+{
+    (void)worker;
+    (void)ctx;
+    if (pb->len > MAX_PAYLOAD_SIZE) return SIM_KO;
+
+    PCAP_CAPTURE(PCAP_STAGE_SCHC, pktbuf_data(pb), pb->len);
+
+    l2_tx_frame_t *frame = (l2_tx_frame_t *)((uint8_t *)pb - offsetof(l2_tx_frame_t, pb));
+    frame->meta.src = dev_id;
+    frame->meta.dst = 0xff;
+    frame->meta.type = 0x00;
+    frame->meta.flags = 0x00;
+    frame->meta.seq = seq;
+    frame->meta.stamp_ns = due_ns;
+    l2_tx_commit(frame);
+    return SIM_OK;
+}
+
+/* One TX lane per worker */
+static uint32_t sim_workers(const cli_args_t *args)
+{
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return args->workers ? args->workers : (cpus > 1 ? (uint32_t)cpus - 1 : 1);
+}
+
+static int run_simulation(const cli_args_t *args)
+{
+    sim_config_t cfg = {0};
+    cfg.nb_devices = args->devices;
+    cfg.first_id = args->id ? args->id : 1;
+    cfg.nb_workers = sim_workers(args);
+    cfg.interval_ms = args->interval_ms > 0.0 ? args->interval_ms : SLEEP_MEAN_MS;
+    cfg.duration_s = args->duration ? args->duration : SIM_DEFAULT_DURATION_S;
+    cfg.seed = (uint32_t)time(NULL);
+    cfg.raw_payload = args->raw_payload;
+    cfg.acquire = sim_acquire;
+    cfg.emit = sim_emit;
+
+    sim_report_t r;
+    if (sim_run(&cfg, &r) != SIM_OK) {
+        zlog_error(error_cat, "Simulation failed");
+        return EXIT_FAILURE;
+    }
+
+    l2_tx_stop();
+    l2_tx_stats_t tx;
+    l2_tx_get_stats(&tx);
+
+    zlog_info(ok_cat, "Simulation: %llu packets in %.1f s (%.0f packets/s), %llu dropped, %llu failed, %llu overruns",
+              (unsigned long long)r.packets, r.elapsed_s, r.elapsed_s > 0.0 ? r.packets / r.elapsed_s : 0.0,
+              (unsigned long long)r.dropped, (unsigned long long)r.failed, (unsigned long long)r.overruns);
+    zlog_info(ok_cat, "Wake-up to TX queue latency us: p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f",
+              r.p50_ns / 1e3, r.p90_ns / 1e3, r.p99_ns / 1e3, r.p999_ns / 1e3, r.max_ns / 1e3);
+    zlog_info(ok_cat, "L2: %llu sent, %llu failed", (unsigned long long)tx.sent, (unsigned long long)tx.failed);
+    log_stats();
+    return EXIT_SUCCESS;
+}
+
+static ipv6_udp_tpl_t net_tpl;
+static uint32_t tx_seq = 0;
+/* Send sensor_data_t as is instead of bit-packed (see sensor_codec.h) */
+static uint8_t raw_payload = 0;
+
+/* One fragmentation session at a time for SCHC packets above the L2 MTU */
+static schc_frag_mode frag_mode = SCHC_FRAG_NO_ACK;
+static schc_frag_sender_t frag_tx;
+/* TX buffer the packet being fragmented was built in, out of the queue until the session ends */
+static uint8_t *frag_buffer = NULL;
+static uint32_t frag_copies = 0;
+static uint8_t frag_dtag = 0;
+static uint32_t frag_seq = 0;
+static ev_timer_t *frag_timer = NULL;
+
+static schc_frag_status frag_emit(const schc_frag_t *frag, void *ctx)
+{
+    (void)ctx;
+    /* Queue full: the session resumes once completions free a slot */
+    if (!l2_tx_available()) return SCHC_FRAG_KO;
+
+    l2_tx_frame_t *frame = l2_tx_acquire();
+    memcpy(pktbuf_put(&frame->pb, frag->hdr_len), frag->hdr, frag->hdr_len);
+    if (frag->tile_len) {
+        /* l2_xmit() takes one contiguous payload, so the tile joins its header in the frame */
+        memcpy(pktbuf_put(&frame->pb, frag->tile_len), frag->tile, frag->tile_len);
+        frame->pb.copies++;
+        frag_copies++;
+    }
+    frame->meta = (l2_frame_meta_t){0, 0xff, frag_seq, 0x00, 0x00, monotonic_now_ns()};
+
+    PKT_TRACE(PKT_TRACE_SUMMARY, "SCHC fragment", frag_seq, pktbuf_data(&frame->pb), frame->pb.len);
+    PCAP_CAPTURE(PCAP_STAGE_FRAGMENT, pktbuf_data(&frame->pb), frame->pb.len);
+    l2_tx_commit(frame);
+    return SCHC_FRAG_OK;
+}
+
+/* Emit what the session can send now and follow its state */
+static void frag_pump(void)
+{
+    const schc_frag_state before = frag_tx.state;
+    if (before == SCHC_FRAG_IDLE) return;
+
+    const schc_frag_status st = schc_frag_sender_poll(&frag_tx);
+    if (frag_tx.state == SCHC_FRAG_WAIT_ACK) {
+        if (before != SCHC_FRAG_WAIT_ACK) {
+            ev_timer_arm(frag_timer, ev_now_ns() + FRAG_ACK_TIMEOUT_NS, 0);
+        }
+        return;
+    }
+    if (st == SCHC_FRAG_OK) return;
+
+    if (st == SCHC_FRAG_DONE) {
+        ALOG_INFO(ok_cat, "Packet %u sent in %llu fragments (%llu retransmitted, %u tile copies)", frag_seq,
+                  (unsigned long long)frag_tx.stats.fragments, (unsigned long long)frag_tx.stats.retransmitted,
+                  frag_copies);
+    } else {
+        ALOG_ERROR(error_cat, "Fragmentation of packet %u aborted", frag_seq);
+    }
+    frag_tx.state = SCHC_FRAG_IDLE;
+    l2_tx_give_back_buffer(frag_buffer);
+    frag_buffer = NULL;
+}
+
+static void on_frag_timer(ev_timer_t *timer, uint64_t late_ns, void *ctx)
+{
+    (void)timer;
+    (void)late_ns;
+    (void)ctx;
+    if (frag_tx.state != SCHC_FRAG_WAIT_ACK) return;
+    ALOG_WARN(error_cat, "No fragmentation ACK for packet %u, asking again", frag_seq);
+    schc_frag_sender_on_timeout(&frag_tx);
+    frag_pump();
+}
+
+/* The frame is not committed: its packet stays in its buffer and is sent and resent from there */
+static void send_fragmented(l2_tx_frame_t *frame, uint32_t seq)
+{
+    const pktbuf_t *pb = &frame->pb;
+    uint8_t *buffer = frag_tx.state == SCHC_FRAG_IDLE ? l2_tx_take_buffer(frame) : NULL;
+    if (!buffer) {
+        stats_count(STAT_PKT_DROPPED_SIZE, 1);
+        ALOG_ERROR(error_cat, "Cannot fragment seq=%u (%zu bytes), dropping", seq, pb->len);
+        return;
+    }
+
+    /* pb still points into the buffer taken; the slot only gets its new one at the next acquire */
+    if (schc_frag_sender_start(&frag_tx, frag_mode, frag_dtag++, pktbuf_data(pb), pb->len, MAX_PAYLOAD_SIZE,
+                               frag_emit, NULL) != SCHC_OK) {
+        stats_count(STAT_PKT_DROPPED_SIZE, 1);
+        ALOG_ERROR(error_cat, "Fragmentation start failed for seq=%u", seq);
+        frag_tx.state = SCHC_FRAG_IDLE;
+        l2_tx_give_back_buffer(buffer);
+        return;
+    }
+    frag_buffer = buffer;
+    frag_copies = 0;
+
+    stats_count(STAT_PKT_FRAGMENTED, 1);
+    frag_seq = seq;
+    ALOG_INFO(ok_cat, "Fragmenting packet %u (%zu bytes)", seq, pb->len);
+    frag_pump();
+}
+
+/*
+ * Push the headers in front of the payload already in the frame, compress and queue it.
+ * build_start: when the payload started being encoded.
+ */
+static void compress_and_queue(l2_tx_frame_t *frame, uint32_t seq, uint64_t build_start)
+{
+    pktbuf_t *pb = &frame->pb;
+
+    if (ipv6_udp_tpl_push(&net_tpl, pb) != 0) {
+        ALOG_ERROR(error_cat, "IPv6/UDP packet build failed");
+        return;
+    }
+    const uint64_t built = monotonic_now_ns();
+    stats_record(STAT_BUILD, built - build_start);
+    stats_count(STAT_PKT_BUILT, 1);
+
+    PKT_TRACE(PKT_TRACE_HEX, "IPv6+UDP packet BEFORE SCHC", seq, pktbuf_data(pb), pb->len);
+    PCAP_CAPTURE(PCAP_STAGE_IPV6, pktbuf_data(pb), pb->len);
+
+    const size_t in_len = pb->len;
+    if (schc_service_compress_pkt(pb) != SCHC_OK) {
+        ALOG_ERROR(error_cat, "SCHC compress failed for seq=%u", seq);
+        return;
+    }
+    stats_record(STAT_COMPRESS, monotonic_now_ns() - built);
+    stats_count(STAT_PKT_COMPRESSED, 1);
+    stats_count(STAT_BYTES_IN, in_len);
+    stats_count(STAT_BYTES_OUT, pb->len);
+    stats_record(STAT_RATIO, pb->len * 1000u / in_len);
+
+    PKT_TRACE(PKT_TRACE_HEX, "SCHC packet AFTER compression", seq, pktbuf_data(pb), pb->len);
+    PCAP_CAPTURE(PCAP_STAGE_SCHC, pktbuf_data(pb), pb->len);
+
+    if (pb->len > MAX_PAYLOAD_SIZE) {
+        send_fragmented(frame, seq);
+        return;
+    }
+
+    if (pb->copies) {
+        ALOG_WARN(error_cat, "Packet %u needed %u payload copies", seq, pb->copies);
+    }
+
+    frame->meta.dst = 0xff;
+    frame->meta.type = 0x00;
+    frame->meta.flags = 0x00;
+    frame->meta.seq = seq;
+    l2_tx_commit(frame);
+}
+
+/* Build, compress and queue one measurement */
+static void sense_and_send(void)
+{
+    const uint32_t seq = tx_seq++;
+
+    /* The frame is filled in place inside the TX ring */
+    l2_tx_frame_t *frame = l2_tx_acquire();
+    if (!frame) {
+        stats_count(STAT_PKT_DROPPED_QUEUE, 1);
+        ALOG_ERROR(error_cat, "TX queue full, dropping seq=%u", seq);
+        return;
+    }
+    const uint64_t t0 = monotonic_now_ns();
+    frame->meta.stamp_ns = t0;
+
+    ALOG_INFO(ok_cat, "Sensing data...");
+    const uint64_t t1 = monotonic_now_ns();
+    /* Measurement is written once, raw straight into the frame; every header goes in front of it */
+    sensor_data_t sample;
+    (void)measure(raw_payload ? (sensor_data_t *)pktbuf_put(&frame->pb, sizeof(sample)) : &sample);
+    const uint64_t t2 = monotonic_now_ns();
+    stats_record(STAT_LOG, t1 - t0);
+    stats_record(STAT_SENSE, t2 - t1);
+
+    if (!raw_payload) {
+        sensor_codec_encode(&sample, 1, pktbuf_put(&frame->pb, SENSOR_CODEC_SIZE(1)), SENSOR_CODEC_SIZE(1));
+    }
+
+    compress_and_queue(frame, seq, t2);
+}
+
+/* Batching: several measurements per packet (-K), sent at the latest batch_delay after the first */
+static sensor_agg_t agg;
+static uint64_t batch_delay_ns = 0;
+static ev_timer_t *batch_timer = NULL;
+
+static void flush_batch(void)
+{
+    if (!agg.count) return;
+
+    const uint32_t seq = tx_seq++;
+    l2_tx_frame_t *frame = l2_tx_acquire();
+    if (!frame) {
+        stats_count(STAT_PKT_DROPPED_QUEUE, 1);
+        ALOG_ERROR(error_cat, "TX queue full, dropping a batch of %u measurements", agg.count);
+        sensor_agg_reset(&agg);
+        return;
+    }
+    /* TX latency counts from the oldest measurement */
+    frame->meta.stamp_ns = agg.first_ns;
+
+    const uint32_t count = agg.count;
+    const uint64_t t0 = monotonic_now_ns();
+    if (sensor_agg_flush(&agg, &frame->pb) != SENSOR_AGG_OK) {
+        ALOG_ERROR(error_cat, "Batch encoding failed for seq=%u", seq);
+        return;
+    }
+    const uint64_t t1 = monotonic_now_ns();
+    ALOG_INFO(ok_cat, "Sending %u measurements in %zu bytes", count, frame->pb.len);
+    const uint64_t t2 = monotonic_now_ns();
+    stats_record(STAT_LOG, t2 - t1);
+    /* Build time excludes the log call */
+    compress_and_queue(frame, seq, t0 + (t2 - t1));
+}
+
+static void sense_and_batch(void)
+{
+    sensor_data_t sample;
+    const uint64_t t0 = monotonic_now_ns();
+    ALOG_INFO(ok_cat, "Sensing data...");
+    const uint64_t t1 = monotonic_now_ns();
+    (void)measure(&sample);
+
+    const uint64_t now = monotonic_now_ns();
+    stats_record(STAT_LOG, t1 - t0);
+    stats_record(STAT_SENSE, now - t1);
+    sensor_agg_status st = sensor_agg_add(&agg, &sample, now);
+    if (st == SENSOR_AGG_FULL) {
+        flush_batch();
+        st = sensor_agg_add(&agg, &sample, now);
+    }
+
+    if (st == SENSOR_AGG_READY) {
+        flush_batch();
+    } else if (st == SENSOR_AGG_OK && agg.count == 1) {
+        ev_timer_arm(batch_timer, now + batch_delay_ns, 0);
+    }
+}
+
+static void on_batch_timer(ev_timer_t *timer, uint64_t late_ns, void *ctx)
+{
+    (void)timer;
+    (void)late_ns;
+    (void)ctx;
+    flush_batch();
+}
+
+/* Payload bytes that fit in one L2 frame once the headers are compressed */
+static size_t payload_budget(void)
+{
+    uint8_t storage[PKTBUF_HEADROOM + 64];
+    pktbuf_t pb;
+    pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+
+    const size_t probe = 1 + SENSOR_CODEC_SIZE(1);
+    memset(pktbuf_put(&pb, probe), 0, probe);
+    if (ipv6_udp_tpl_push(&net_tpl, &pb) != 0 || schc_service_compress_pkt(&pb) != SCHC_OK) return 0;
+
+    const size_t overhead = pb.len - probe;
+    return MAX_PAYLOAD_SIZE > overhead ? MAX_PAYLOAD_SIZE - overhead : 0;
+}
+
+static void on_sense_timer(ev_timer_t *timer, uint64_t late_ns, void *ctx)
+{
+    (void)late_ns;
+    (void)ctx;
+    if (agg.max_samples > 1) {
+        sense_and_batch();
+    } else {
+        sense_and_send();
+    }
+
+    /* The next deadline follows the scheduled one, so build/send time does not add up */
+    ev_timer_arm(timer, ev_timer_deadline(timer) + sensor_next_interval_ns(SLEEP_MEAN_MS), 0);
+}
+
+static void on_stats_timer(ev_timer_t *timer, uint64_t late_ns, void *ctx)
+{
+    (void)timer;
+    (void)late_ns;
+    ev_timer_stats_t js;
+    ev_timer_get_stats((const ev_timer_t *)ctx, &js);
+    l2_tx_stats_t tx;
+    l2_tx_get_stats(&tx);
+
+    zlog_info(ok_cat, "Wake-up jitter over %llu wake-ups: mean %.1f us, stddev %.1f us, max %.1f us",
+              (unsigned long long)js.fires, js.late_mean_ns / 1e3, js.late_stddev_ns / 1e3, js.late_max_ns / 1e3);
+    zlog_info(ok_cat, "TX: %llu queued, %llu sent, %llu failed, %llu dropped",
+              (unsigned long long)tx.enqueued, (unsigned long long)tx.sent,
+              (unsigned long long)tx.failed, (unsigned long long)tx.dropped);
+
+    if (l2_get_fd() != -1) {
+        l2_rx_stats_t rx;
+        l2_rx_get_stats(&rx);
+        zlog_info(ok_cat, "RX: %llu bytes, %llu frames, %llu discarded, %llu aborted, %llu malformed, %llu oversize",
+                  (unsigned long long)rx.bytes, (unsigned long long)rx.frames, (unsigned long long)rx.discarded,
+                  (unsigned long long)rx.aborted, (unsigned long long)rx.malformed, (unsigned long long)rx.oversize);
+    }
+
+    log_stats();
+}
+
+static void on_tx_completions(int fd, uint32_t events, void *ctx)
+{
+    (void)fd;
+    (void)events;
+    (void)ctx;
+    l2_tx_dispatch_completions();
+    frag_pump();
+}
+
+/* Prepare the headers for the addresses and ports the current rules compress */
+static int init_net_tpl(void)
+{
+    ipv6_udp_cfg_t net_cfg;
+    init_net_cfg_from_schc(&net_cfg);
+    return ipv6_udp_tpl_init(&net_tpl, &net_cfg, schc_service_flow_label());
+}
+
+/* Rules may change the addresses and ports: the headers follow them */
+static schc_status_t reload_rules(const char *path)
+{
+    if (schc_service_reload_rules(path) != SCHC_OK) return SCHC_ERR;
+    if (init_net_tpl() != 0) {
+        zlog_error(error_cat, "IPv6/UDP header template init failed");
+        return SCHC_ERR;
+    }
+    return SCHC_OK;
+}
+
+/* Fragmentation ACKs go to the sender; of the control frames only the rule reload is interpreted */
+static void on_downlink(const l2_rx_frame_t *frame, void *ctx)
+{
+    (void)ctx;
+    PKT_TRACE(PKT_TRACE_SUMMARY, "L2 RX", frame->meta.seq, frame->payload, frame->len);
+    PCAP_CAPTURE(PCAP_STAGE_L2_RX, frame->payload, frame->len);
+
+    if (frame->meta.type == DL_TYPE_CONTROL) {
+        if (frame->len && frame->payload[0] == DL_CTRL_RELOAD_RULES) {
+            zlog_info(ok_cat, "Rule reload requested by %u", frame->meta.src);
+            reload_rules(NULL);
+        } else {
+            zlog_warn(error_cat, "Unknown control frame from %u", frame->meta.src);
+        }
+        return;
+    }
+
+    if (frame->len && frame->payload[0] == SCHC_FRAG_ACK_RULE_ID) {
+        if (schc_frag_sender_on_ack(&frag_tx, frame->payload, frame->len) == SCHC_FRAG_KO) {
+            ALOG_WARN(error_cat, "Unexpected fragmentation ACK");
+        }
+        frag_pump();
+        return;
+    }
+    ALOG_DEBUG(ok_cat, "Downlink frame from %u to %u, type %u, seq %u, %zu bytes",
+               frame->meta.src, frame->meta.dst, frame->meta.type, frame->meta.seq, frame->len);
+}
+
+static void on_l2_readable(int fd, uint32_t events, void *ctx)
+{
+    (void)events;
+    (void)ctx;
+    if (l2_rx_poll(fd) != L2_RX_OK) {
+        zlog_warn(error_cat, "Layer 2 downlink closed");
+        ev_loop_del_fd(fd);
+    }
+}
+
+/* SIGHUP reloads the rules, anything else stops */
+static void on_signal(int fd, uint32_t events, void *ctx)
+{
+    (void)events;
+    (void)ctx;
+    struct signalfd_siginfo si;
+    if (read(fd, &si, sizeof(si)) != sizeof(si)) return;
+    if (si.ssi_signo == SIGHUP) {
+        zlog_info(ok_cat, "SIGHUP, reloading the SCHC rules");
+        reload_rules(NULL);
+        return;
+    }
+    zlog_info(ok_cat, "Signal %u, stopping", si.ssi_signo);
+    ev_loop_stop();
+}
+
+/*
+ * Control socket, one command per datagram, answered "ok" or "error":
+ *   reload          reload the current rule image
+ *   reload <path>   switch to the rule image at path
+ *   stats           answered with the stats report instead (see stats.h)
+ */
+static int open_control_socket(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        zlog_error(error_cat, "UNIX socket path too long: %s", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    const int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) return -1;
+    unlink(path);
+    if (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        zlog_error(error_cat, "Cannot bind the control socket %s", path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void on_control(int fd, uint32_t events, void *ctx)
+{
+    (void)events;
+    (void)ctx;
+    char cmd[256];
+    struct sockaddr_un peer;
+    socklen_t peer_len = sizeof(peer);
+    ssize_t n;
+    while ((n = recvfrom(fd, cmd, sizeof(cmd) - 1, 0, (struct sockaddr *)&peer, &peer_len)) >= 0) {
+        while (n > 0 && (cmd[n - 1] == '\n' || cmd[n - 1] == '\r')) n--;
+        cmd[n] = '\0';
+
+        const char *reply = "error\n";
+        char report[2048];
+        if (strncmp(cmd, "reload", 6) == 0 && (cmd[6] == '\0' || cmd[6] == ' ')) {
+            if (reload_rules(cmd[6] ? cmd + 7 : NULL) == SCHC_OK) reply = "ok\n";
+        } else if (strcmp(cmd, "stats") == 0) {
+            char extra[512];
+            format_module_stats(extra, sizeof(extra));
+            stats_format(report, sizeof(report), extra);
+            reply = report;
+        } else {
+            zlog_warn(error_cat, "Unknown control command: %s", cmd);
+        }
+        /* Unbound senders have no address to answer to */
+        if (peer_len > sizeof(sa_family_t)) {
+            sendto(fd, reply, strlen(reply), MSG_DONTWAIT, (const struct sockaddr *)&peer, peer_len);
+        }
+        peer_len = sizeof(peer);
+    }
+}
+
+static void stop_capture(void)
+{
+    if (!pcap_writer_on) return;
+
+    pcap_writer_stats_t st;
+    pcap_writer_get_stats(&st);
+    pcap_writer_fini();
+    zlog_info(ok_cat, "Capture: %llu packets written, %llu dropped",
+              (unsigned long long)st.written, (unsigned long long)st.dropped);
+}
+
+/* Candidates for the misses seen so far; the rule set goes to path */
+static void report_misses(const char *path)
+{
+    if (!path) return;
+
+    schc_service_profile_misses(0);
+    if (schc_service_profile_report(path) == SCHC_OK) {
+        zlog_info(ok_cat, "Derived rule set written to %s", path);
+    } else {
+        zlog_error(error_cat, "Derived rule set %s not written", path);
+    }
+}
+
 int main(int argc, char *argv[])
 {
     if (logger_init() != LOGGER_INIT_OK) {
@@ -56,25 +777,67 @@ int main(int argc, char *argv[])
     }
     zlog_info(ok_cat, "Logger initialized");
 
-    srand((unsigned)time(NULL));
+    rng_set_seed((uint64_t)time(NULL));
 
-    uint8_t id_arg = 0x00;
     uint8_t key_arg[KEY_SIZE];
-    char *port = NULL;
-    int32_t baudrate;
+    cli_args_t args = {0};
+    args.key_buf = key_arg;
+    args.key_size = sizeof(key_arg);
 
-    if (parse_cli_arguments(argc, argv, &id_arg, key_arg, KEY_SIZE, &port, &baudrate) != CLI_PARSE_OK) {
+    if (parse_cli_arguments(argc, argv, &args) != CLI_PARSE_OK) {
         zlog_error(error_cat, "Error parsing cli arguments");
-        zlog_fini();
+        logger_fini();
         return EXIT_FAILURE;
     }
     zlog_info(ok_cat, "Cli arg parse OK");
 
-    l2_set_id(id_arg);
+    if (args.rules && schc_service_set_rule_file(args.rules) != SCHC_OK) {
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+
+    if (args.roundtrip) {
+        if (schc_service_init() != SCHC_OK) {
+            zlog_error(error_cat, "SCHC init failed");
+            return EXIT_FAILURE;
+        }
+        if (args.miss_rules) schc_service_profile_misses(1);
+        const int rc = run_roundtrip(args.roundtrip);
+        report_misses(args.miss_rules);
+        logger_fini();
+        return rc;
+    }
+
+    l2_set_id(args.id);
+
+    /* Stop signals go to the event loop: block them before any thread starts */
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    sigaddset(&stop_signals, SIGHUP);
+    if (!args.devices) {
+        pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+    }
+
+    /* Per-packet messages go through the async log; its writer inherits the signal mask */
+    if (alog_init(LOG_RING_DEPTH) != ALOG_INIT_OK) {
+        zlog_error(error_cat, "Async log init failed, logging synchronously");
+    }
 
 #ifdef L2_AHOI_EXT
-    l2_ahoi_set_port(port);
-    l2_ahoi_set_baudrate(baudrate);
+    l2_ahoi_set_port(args.port);
+    l2_ahoi_set_baudrate(args.baud);
+#endif
+
+#ifdef L2_LOOP_EXT
+    l2_link_model_t link = { 0, 0, 0, 0, 1 };
+    if (l2_loop_set_target(args.port) != 0 ||
+        (args.link && l2_loop_parse_link(args.link, &link) != 0)) {
+        zlog_error(error_cat, "Bad loopback configuration");
+        return EXIT_FAILURE;
+    }
+    l2_loop_set_link(&link);
 #endif
 
     if (l2_init() != L2_INIT_OK) {
@@ -89,73 +852,117 @@ int main(int argc, char *argv[])
     }
     zlog_info(ok_cat, "SCHC service init OK");
 
-    static sensor_data_t sensor_data = {0};
-
-    static ahoi_packet_t p = {0};
-    p.dst = 0xff;
-    p.type = 0x00;
-    p.flags = 0x00;
-    p.seq = 0;
-    p.pl_size = 0;
-    p.payload = NULL;
-
-    static ipv6_udp_cfg_t net_cfg;
-    init_net_cfg_from_schc(&net_cfg);
-
-    uint32_t seq = 0;
-    for (;;) {
-        sleep_gaussian(SLEEP_MEAN_MS);
+    if (args.trace > PKT_TRACE_OFF) {
+        if (pkt_trace_init(NULL, PKT_TRACE_DEPTH) != PKT_TRACE_INIT_OK) {
+            zlog_error(error_cat, "Packet trace init failed");
+            return EXIT_FAILURE;
+        }
+        pkt_trace_set_level(args.trace);
+        zlog_info(ok_cat, "Packet trace level %d", args.trace);
+    }
 
-        zlog_info(ok_cat, "Sensing data...");
-        (void)measure(&sensor_data);
+    if (args.pcap) {
+        if (pcap_writer_init(args.pcap, PCAP_RING_DEPTH) != PCAP_WRITER_INIT_OK) {
+            return EXIT_FAILURE;
+        }
+        zlog_info(ok_cat, "Capturing packets to %s", args.pcap);
+    }
 
-        /* For exact byte recovery with your current rule: */
-        const uint32_t flow_label = schc_service_flow_label();
+    if (args.miss_rules && schc_service_profile_misses(1) != SCHC_OK) {
+        zlog_error(error_cat, "Rule miss profiler start failed");
+        return EXIT_FAILURE;
+    }
 
-        static uint8_t ipv6udp_pkt[256];
-        size_t ipv6udp_len = 0;
+    /* Outside the simulation, TX completions are handled by the event loop */
+    const int tx_done_fd = args.devices ? -1 : l2_tx_defer_completions();
 
-        if (build_ipv6_udp_packet(&net_cfg, flow_label,
-                                  (const uint8_t *)&sensor_data, sizeof(sensor_data),
-                                  ipv6udp_pkt, sizeof(ipv6udp_pkt),
-                                  &ipv6udp_len) != 0) {
-            zlog_error(error_cat, "IPv6/UDP packet build failed");
-            seq++;
-            continue;
-        }
+    if ((args.devices && l2_tx_set_lanes(sim_workers(&args)) != L2_TX_OK) ||
+        l2_tx_start(args.devices ? SIM_TX_DEPTH : L2_TX_DEPTH, L2_TX_DROP_NEWEST, on_tx_done, NULL) != L2_TX_OK) {
+        zlog_error(error_cat, "Layer 2 TX queue start failed");
+        return EXIT_FAILURE;
+    }
+    zlog_info(ok_cat, "Layer 2 TX queue started");
 
-        dump_hex("IPv6+UDP packet BEFORE SCHC", ipv6udp_pkt, ipv6udp_len);
+    /* Prepared once, and again on every rule reload */
+    if (init_net_tpl() != 0) {
+        zlog_error(error_cat, "IPv6/UDP header template init failed");
+        return EXIT_FAILURE;
+    }
 
-        static uint8_t schc_buf[256];
-        size_t schc_len = 0;
+    if (args.devices) {
+        const int rc = run_simulation(&args);
+        stop_capture();
+        report_misses(args.miss_rules);
+        pkt_trace_fini();
+        logger_fini();
+        return rc;
+    }
 
-        if (schc_service_compress(ipv6udp_pkt, ipv6udp_len,
-                                  schc_buf, sizeof(schc_buf),
-                                  &schc_len) != SCHC_OK) {
-            zlog_error(error_cat, "SCHC compress failed for seq=%u", seq);
-            seq++;
-            continue;
-        }
+    /* Every wake-up, completion and RX event is handled on this thread */
+    if (ev_loop_init() != EV_OK) {
+        zlog_error(error_cat, "Event loop init failed");
+        return EXIT_FAILURE;
+    }
 
-        dump_hex("SCHC packet AFTER compression", schc_buf, schc_len);
+    const int sig_fd = signalfd(-1, &stop_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    ev_timer_t *sense_timer = ev_timer_new(on_sense_timer, NULL);
+    ev_timer_t *stats_timer = ev_timer_new(on_stats_timer, sense_timer);
+    frag_timer = ev_timer_new(on_frag_timer, NULL);
+    batch_timer = ev_timer_new(on_batch_timer, NULL);
+    if (sig_fd == -1 || !sense_timer || !stats_timer || !frag_timer || !batch_timer ||
+        ev_loop_add_fd(sig_fd, EPOLLIN, on_signal, NULL) != EV_OK ||
+        ev_loop_add_fd(tx_done_fd, EPOLLIN, on_tx_completions, NULL) != EV_OK) {
+        zlog_error(error_cat, "Event loop setup failed");
+        return EXIT_FAILURE;
+    }
+    if (l2_get_fd() != -1 && (l2_rx_init(L2_RX_RING_SIZE, on_downlink, NULL) != L2_RX_OK ||
+                              ev_loop_add_fd(l2_get_fd(), EPOLLIN, on_l2_readable, NULL) != EV_OK)) {
+        zlog_error(error_cat, "Layer 2 downlink setup failed");
+        return EXIT_FAILURE;
+    }
+    const int ctl_fd = args.control ? open_control_socket(args.control) : -1;
+    if (args.control && (ctl_fd == -1 || ev_loop_add_fd(ctl_fd, EPOLLIN, on_control, NULL) != EV_OK)) {
+        zlog_error(error_cat, "Control socket setup failed");
+        return EXIT_FAILURE;
+    }
 
-        if (schc_len > MAX_PAYLOAD_SIZE) {
-            zlog_error(error_cat, "Max payload size exceeded!");
-            seq++;
-            continue;
-        }
+    raw_payload = args.raw_payload;
+    sensor_agg_init(&agg, args.batch, payload_budget());
+    if (raw_payload && agg.max_samples > 1) {
+        zlog_warn(error_cat, "Raw payloads only apply to one measurement per packet, batches stay packed");
+    }
+    if (agg.max_samples > 1) {
+        const double delay_ms = args.batch_delay_ms > 0.0 ? args.batch_delay_ms : 1.5 * agg.max_samples * SLEEP_MEAN_MS;
+        batch_delay_ns = (uint64_t)(delay_ms * 1e6);
+        zlog_info(ok_cat, "Batching up to %u measurements in %zu payload bytes, at most %.0f ms apart",
+                  agg.max_samples, agg.max_len, delay_ms);
+    }
 
-        p.seq = seq;
-        p.pl_size = (uint8_t)schc_len;
-        p.payload = schc_buf;
+    frag_mode = args.frag_ack ? SCHC_FRAG_ACK_ON_ERROR : SCHC_FRAG_NO_ACK;
+    if (frag_mode == SCHC_FRAG_ACK_ON_ERROR && l2_get_fd() == -1) {
+        zlog_warn(error_cat, "ACK-on-Error without a downlink: fragmented packets will be aborted");
+    }
 
-        l2_send_prepare(&p);
+    const uint64_t start = ev_now_ns();
+    ev_timer_arm(sense_timer, start + sensor_next_interval_ns(SLEEP_MEAN_MS), 0);
+    ev_timer_arm(stats_timer, start + STATS_PERIOD_NS, STATS_PERIOD_NS);
 
-        if (l2_send_run(p.payload, p.pl_size) != L2_SEND_OK) {
-            zlog_error(error_cat, "Error sending packet %u", seq);
-        }
+    zlog_info(ok_cat, "Event loop running");
+    const ev_status rc = ev_loop_run();
 
-        print_packet(&p);
-        seq++;
+    flush_batch();
+    on_stats_timer(stats_timer, 0, sense_timer);
+    ev_loop_fini();
+    close(sig_fd);
+    if (ctl_fd != -1) {
+        close(ctl_fd);
+        unlink(args.control);
     }
+    l2_rx_fini();
+    l2_tx_stop();
+    stop_capture();
+    report_misses(args.miss_rules);
+    pkt_trace_fini();
+    logger_fini();
+    return rc == EV_OK ? EXIT_SUCCESS : EXIT_FAILURE;
 }
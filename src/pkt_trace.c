@@ -0,0 +1,195 @@
+#include "pkt_trace.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger_helper.h"
+#include "utils.h"
+
+// Worst case for one record: header line plus 3 chars per byte and a newline every 16
+#define TEXT_CAP (128 + PKT_TRACE_MAX_BYTES * 3 + PKT_TRACE_MAX_BYTES / 16 + 1)
+#define IDLE_SLEEP_NS 1000000
+
+typedef struct {
+    _Atomic size_t turn;    // bounded MPMC queue sequence (Vyukov)
+    uint64_t ts_ns;
+    const char* label;
+    uint32_t seq;
+    uint16_t len;           // bytes kept
+    uint16_t orig_len;
+    uint8_t level;
+    uint8_t data[PKT_TRACE_MAX_BYTES];
+} trace_slot_t;
+
+int pkt_trace_level = PKT_TRACE_OFF;
+
+static trace_slot_t* ring = NULL;
+static size_t ring_mask = 0;
+static _Atomic size_t enq_pos = 0;
+static size_t deq_pos = 0;          // writer thread only
+
+static FILE* out_file = NULL;
+static char text[TEXT_CAP];         // writer thread only
+
+static pthread_t writer;
+static bool running = false;
+static atomic_bool stopping = false;
+
+static _Atomic uint64_t st_written = 0;
+static _Atomic uint64_t st_dropped = 0;
+
+static size_t format_record(const trace_slot_t* r) {
+    static const char hex[] = "0123456789abcdef";
+
+    int n = snprintf(text, TEXT_CAP, "%llu.%09llu %s seq=%u len=%u%s",
+                     (unsigned long long) (r->ts_ns / 1000000000ull),
+                     (unsigned long long) (r->ts_ns % 1000000000ull),
+                     r->label, r->seq, r->orig_len,
+                     r->orig_len > r->len ? " (truncated)" : "");
+    // snprintf returns the length it wanted, not what fit: a long label must not push pos past the buffer
+    size_t pos = n < 0 ? 0 : (size_t) n;
+    if (pos > TEXT_CAP - 1) pos = TEXT_CAP - 1;
+
+    if (r->level >= PKT_TRACE_HEX) {
+        for (size_t i = 0; i < r->len && pos + 3 <= TEXT_CAP - 1; i++) {
+            text[pos++] = (i % 16 == 0) ? '\n' : ' ';
+            text[pos++] = hex[r->data[i] >> 4];
+            text[pos++] = hex[r->data[i] & 0x0F];
+        }
+    }
+    text[pos] = '\0';
+    return pos;
+}
+
+static bool write_one(void) {
+    trace_slot_t* r = &ring[deq_pos & ring_mask];
+    if (atomic_load_explicit(&r->turn, memory_order_acquire) != deq_pos + 1) return false;
+
+    const size_t n = format_record(r);
+    if (out_file) {
+        text[n] = '\n';
+        fwrite(text, 1, n + 1, out_file);
+    } else {
+        zlog_debug(trace_cat, "%s", text);
+    }
+
+    atomic_store_explicit(&r->turn, deq_pos + ring_mask + 1, memory_order_release);
+    deq_pos++;
+    atomic_fetch_add_explicit(&st_written, 1, memory_order_relaxed);
+    return true;
+}
+
+static void* writer_main(void* arg) {
+    (void) arg;
+    const struct timespec idle = { 0, IDLE_SLEEP_NS };
+
+    // Producers never signal: the writer polls so that emitting costs no syscall
+    for (;;) {
+        bool any = false;
+        while (write_one()) any = true;
+
+        if (!any) {
+            if (atomic_load(&stopping)) break;
+            if (out_file) fflush(out_file);
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+pkt_trace_status pkt_trace_init(const char* path, const size_t depth) {
+    if (running || depth == 0 || (depth & (depth - 1)) != 0) return PKT_TRACE_INIT_KO;
+
+    if (path) {
+        out_file = fopen(path, "a");
+        if (!out_file) {
+            zlog_error(error_cat, "Cannot open trace file %s", path);
+            return PKT_TRACE_INIT_KO;
+        }
+    }
+
+    ring = calloc(depth, sizeof(*ring));
+    if (!ring) {
+        if (out_file) fclose(out_file);
+        out_file = NULL;
+        return PKT_TRACE_INIT_KO;
+    }
+    ring_mask = depth - 1;
+    for (size_t i = 0; i < depth; i++) atomic_init(&ring[i].turn, i);
+    atomic_store(&enq_pos, 0);
+    deq_pos = 0;
+    atomic_store(&stopping, false);
+
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        zlog_error(error_cat, "Trace writer thread start failed");
+        free(ring);
+        ring = NULL;
+        if (out_file) fclose(out_file);
+        out_file = NULL;
+        return PKT_TRACE_INIT_KO;
+    }
+
+    running = true;
+    return PKT_TRACE_INIT_OK;
+}
+
+void pkt_trace_fini(void) {
+    if (!running) return;
+
+    pkt_trace_set_level(PKT_TRACE_OFF);
+    atomic_store(&stopping, true);
+    pthread_join(writer, NULL);
+    running = false;
+
+    if (out_file) fclose(out_file);
+    out_file = NULL;
+    free(ring);
+    ring = NULL;
+}
+
+void pkt_trace_set_level(const int level) {
+    __atomic_store_n(&pkt_trace_level, level, __ATOMIC_RELAXED);
+}
+
+void pkt_trace_get_stats(pkt_trace_stats_t* stats) {
+    stats->written = atomic_load_explicit(&st_written, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&st_dropped, memory_order_relaxed);
+}
+
+void pkt_trace_emit(const int level, const char* label, const uint32_t seq, const uint8_t* buf, const size_t len) {
+    if (!running) return;
+
+    trace_slot_t* r;
+    size_t pos = atomic_load_explicit(&enq_pos, memory_order_relaxed);
+    for (;;) {
+        r = &ring[pos & ring_mask];
+        const size_t turn = atomic_load_explicit(&r->turn, memory_order_acquire);
+        const intptr_t diff = (intptr_t) turn - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enq_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&st_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&enq_pos, memory_order_relaxed);
+        }
+    }
+
+    r->ts_ns = monotonic_now_ns();
+    r->label = label;
+    r->seq = seq;
+    r->level = (uint8_t) level;
+    r->orig_len = (uint16_t) (len > UINT16_MAX ? UINT16_MAX : len);
+    r->len = (uint16_t) (len < PKT_TRACE_MAX_BYTES ? len : PKT_TRACE_MAX_BYTES);
+    if (level >= PKT_TRACE_HEX) memcpy(r->data, buf, r->len);
+
+    atomic_store_explicit(&r->turn, pos + 1, memory_order_release);
+}
@@ -0,0 +1,127 @@
+#include "rng.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Ziggurat of 128 layers of equal area (Marsaglia and Tsang, layout of Doornik's ZIGNOR)
+#define ZIG_LAYERS 128
+#define ZIG_R 3.442619855899                // start of the tail
+#define ZIG_V 9.91256303526217e-3           // area of each layer
+
+#define DEFAULT_SEED 0x853c49e6748fea9bull
+
+static double zig_x[ZIG_LAYERS + 1];        // layer i spans [0, zig_x[i]), zig_x[0] the base strip
+static double zig_f[ZIG_LAYERS + 1];        // exp(-zig_x[i]^2 / 2)
+static int64_t zig_k[ZIG_LAYERS];           // zig_x[i + 1] / zig_x[i] * 2^52: below it, under the curve
+static double zig_w[ZIG_LAYERS];            // zig_x[i] / 2^52
+static pthread_once_t zig_once = PTHREAD_ONCE_INIT;
+
+static _Atomic uint64_t process_seed = DEFAULT_SEED;
+static _Atomic uint64_t next_stream = 1;
+static _Thread_local rng_t local;
+static _Thread_local bool local_seeded = false;
+
+static void zig_init(void) {
+    double f = exp(-0.5 * ZIG_R * ZIG_R);
+    zig_x[0] = ZIG_V / f;
+    zig_x[1] = ZIG_R;
+    zig_x[ZIG_LAYERS] = 0.0;
+    for (int i = 2; i < ZIG_LAYERS; i++) {
+        zig_x[i] = sqrt(-2.0 * log(ZIG_V / zig_x[i - 1] + f));
+        f = exp(-0.5 * zig_x[i] * zig_x[i]);
+    }
+    for (int i = 0; i <= ZIG_LAYERS; i++) zig_f[i] = exp(-0.5 * zig_x[i] * zig_x[i]);
+    for (int i = 0; i < ZIG_LAYERS; i++) {
+        zig_k[i] = (int64_t) (zig_x[i + 1] / zig_x[i] * 0x1.0p52);
+        zig_w[i] = zig_x[i] * 0x1.0p-52;
+    }
+}
+
+static uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed_stream(rng_t* rng, const uint64_t seed, const uint64_t stream) {
+    pthread_once(&zig_once, zig_init);
+
+    // Hashing seed and stream apart keeps the splitmix sequences of two streams from overlapping
+    uint64_t a = seed, b = stream ^ 0x6A09E667F3BCC909ull;
+    uint64_t x = splitmix64(&a) ^ splitmix64(&b);
+    for (int i = 0; i < 4; i++) rng->s[i] = splitmix64(&x);
+}
+
+void rng_seed(rng_t* rng, const uint64_t seed) {
+    rng_seed_stream(rng, seed, 0);
+}
+
+rng_t* rng_local(void) {
+    if (!local_seeded) {
+        rng_seed_stream(&local, atomic_load_explicit(&process_seed, memory_order_relaxed),
+                        atomic_fetch_add_explicit(&next_stream, 1, memory_order_relaxed));
+        local_seeded = true;
+    }
+    return &local;
+}
+
+void rng_set_seed(const uint64_t seed) {
+    atomic_store(&process_seed, seed);
+    atomic_store(&next_stream, 1);
+    rng_seed_stream(&local, seed, 0);
+    local_seeded = true;
+}
+
+// Beyond ZIG_R, by Marsaglia's exponential rejection
+static double zig_tail(rng_t* rng, const bool negative) {
+    double x, y;
+    do {
+        x = -log(1.0 - rng_uniform(rng)) / ZIG_R;
+        y = -log(1.0 - rng_uniform(rng));
+    } while (y + y < x * x);
+    return negative ? -(ZIG_R + x) : ZIG_R + x;
+}
+
+static double zig_normal(rng_t* rng);
+
+// Out of the layer's inner rectangle: the tail past the base strip, or the wedge under the curve
+static __attribute__((noinline)) double zig_edge(rng_t* rng, const unsigned i, const double u) {
+    if (i == 0) return zig_tail(rng, u < 0.0);
+    const double x = u * zig_x[i];
+    const double y = zig_f[i] + rng_uniform(rng) * (zig_f[i + 1] - zig_f[i]);
+    return y < exp(-0.5 * x * x) ? x : zig_normal(rng);
+}
+
+static inline double zig_normal(rng_t* rng) {
+    // Low 7 bits pick the layer, the top 53 the signed abscissa, compared as an integer
+    const uint64_t r = rng_next(rng);
+    const unsigned i = (unsigned) r & (ZIG_LAYERS - 1);
+    const int64_t j = (int64_t) r >> 11;
+    if ((j < 0 ? -j : j) < zig_k[i]) return (double) j * zig_w[i];
+    return zig_edge(rng, i, (double) j * 0x1.0p-52);
+}
+
+double rng_normal(rng_t* rng) {
+    return zig_normal(rng);
+}
+
+void rng_fill_u64(rng_t* rng, uint64_t* out, const size_t n) {
+    rng_t r = *rng;
+    for (size_t i = 0; i < n; i++) out[i] = rng_next(&r);
+    *rng = r;
+}
+
+void rng_fill_uniform(rng_t* rng, double* out, const size_t n) {
+    rng_t r = *rng;
+    for (size_t i = 0; i < n; i++) out[i] = rng_uniform(&r);
+    *rng = r;
+}
+
+void rng_fill_normal(rng_t* rng, double* out, const size_t n, const double mean, const double stddev) {
+    rng_t r = *rng;
+    for (size_t i = 0; i < n; i++) out[i] = mean + stddev * zig_normal(&r);
+    *rng = r;
+}
@@ -0,0 +1,336 @@
+#include "schc_frag.h"
+
+#include <string.h>
+
+#define FCN_ALL1 63u
+#define W_ABORT 3u
+#define WINDOW_MASK ((1ull << SCHC_FRAG_WINDOW_SIZE) - 1)
+
+/* CRC32 (IEEE 802.3, reflected), 4 bits at a time */
+static const uint32_t crc_nibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+uint32_t schc_frag_crc32(const uint8_t* data, const size_t len) {
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0x0f];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+static void put_be32(uint8_t* p, const uint32_t v) {
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+static uint32_t get_be32(const uint8_t* p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static void put_hdr(uint8_t* hdr, const uint8_t rule_id, const uint8_t dtag, const uint32_t w, const uint32_t fcn) {
+    hdr[0] = rule_id;
+    hdr[1] = dtag;
+    hdr[2] = (uint8_t) (w << 6 | fcn);
+}
+
+/* ------------------------------------------------------------ */
+/* Sender                                                       */
+/* ------------------------------------------------------------ */
+
+schc_status_t schc_frag_sender_start(schc_frag_sender_t* s, const schc_frag_mode mode, const uint8_t dtag,
+                                     const uint8_t* pkt, const size_t len, const size_t mtu,
+                                     const schc_frag_emit_fn emit, void* ctx) {
+    if (!pkt || !len || !emit || mtu <= SCHC_FRAG_HDR_SIZE + SCHC_FRAG_RCS_SIZE) return SCHC_ERR;
+    if (len > SCHC_FRAG_MAX_PACKET(mtu)) return SCHC_BUF_TOO_SMALL;
+
+    memset(s, 0, sizeof(*s));
+    s->mode = mode;
+    s->dtag = dtag;
+    s->pkt = pkt;
+    s->len = len;
+    s->tile_size = mtu - SCHC_FRAG_HDR_SIZE;
+    s->rcs = schc_frag_crc32(pkt, len);
+    s->emit = emit;
+    s->ctx = ctx;
+
+    switch (mode) {
+        case SCHC_FRAG_NO_ACK: {
+            // Full tiles until the rest fits next to the RCS; the All-1 always carries at least one byte
+            const size_t all1_cap = mtu - SCHC_FRAG_HDR_SIZE - SCHC_FRAG_RCS_SIZE;
+            const size_t regular = len > all1_cap ? len - all1_cap : 0;
+            s->nb_tiles = (uint32_t) ((regular + s->tile_size - 1) / s->tile_size);
+            s->all1_off = (size_t) s->nb_tiles * s->tile_size;
+            if (s->all1_off >= len) s->all1_off = len - 1;
+            s->rule_id = SCHC_FRAG_NOACK_RULE_ID;
+            break;
+        }
+        case SCHC_FRAG_ACK_ON_ERROR:
+            s->nb_tiles = (uint32_t) ((len + s->tile_size - 1) / s->tile_size);
+            s->all1_off = len;
+            s->rule_id = SCHC_FRAG_ACK_RULE_ID;
+            break;
+        default:
+            return SCHC_MODE_NOT_AVAILABLE;
+    }
+
+    s->all1_pending = 1;
+    s->state = SCHC_FRAG_SENDING;
+    return SCHC_OK;
+}
+
+static void regular_frag(const schc_frag_sender_t* s, const uint32_t idx, schc_frag_t* f) {
+    const size_t off = (size_t) idx * s->tile_size;
+    if (s->mode == SCHC_FRAG_NO_ACK) {
+        put_hdr(f->hdr, s->rule_id, s->dtag, 0, 0);
+    } else {
+        put_hdr(f->hdr, s->rule_id, s->dtag, idx / SCHC_FRAG_WINDOW_SIZE,
+                SCHC_FRAG_WINDOW_SIZE - 1 - idx % SCHC_FRAG_WINDOW_SIZE);
+    }
+    f->hdr_len = SCHC_FRAG_HDR_SIZE;
+    f->tile = s->pkt + off;
+    f->tile_len = s->all1_off - off < s->tile_size ? s->all1_off - off : s->tile_size;
+}
+
+static void all1_frag(const schc_frag_sender_t* s, schc_frag_t* f) {
+    const uint32_t w = s->mode == SCHC_FRAG_NO_ACK ? 0 : (s->nb_tiles - 1) / SCHC_FRAG_WINDOW_SIZE;
+    put_hdr(f->hdr, s->rule_id, s->dtag, w, FCN_ALL1);
+    put_be32(f->hdr + SCHC_FRAG_HDR_SIZE, s->rcs);
+    f->hdr_len = SCHC_FRAG_HDR_SIZE + SCHC_FRAG_RCS_SIZE;
+    f->tile = s->pkt + s->all1_off;
+    f->tile_len = s->len - s->all1_off;
+}
+
+schc_frag_status schc_frag_sender_poll(schc_frag_sender_t* s) {
+    while (s->state == SCHC_FRAG_SENDING) {
+        schc_frag_t f;
+
+        if (s->abort_pending) {
+            // Sender-Abort: All-1 header with every W bit set and no RCS
+            put_hdr(f.hdr, s->rule_id, s->dtag, W_ABORT, FCN_ALL1);
+            f.hdr_len = SCHC_FRAG_HDR_SIZE;
+            f.tile = NULL;
+            f.tile_len = 0;
+            if (s->emit(&f, s->ctx) != SCHC_FRAG_OK) break;
+            s->abort_pending = 0;
+            s->state = SCHC_FRAG_ABORTED;
+            break;
+        }
+
+        if (s->retx_bitmap) {
+            const uint32_t pos = (uint32_t) __builtin_ctzll(s->retx_bitmap);
+            regular_frag(s, s->retx_window * SCHC_FRAG_WINDOW_SIZE + pos, &f);
+            if (s->emit(&f, s->ctx) != SCHC_FRAG_OK) break;
+            s->retx_bitmap &= ~(1ull << pos);
+            s->stats.fragments++;
+            s->stats.retransmitted++;
+            continue;
+        }
+
+        if (s->next < s->nb_tiles) {
+            regular_frag(s, s->next, &f);
+            if (s->emit(&f, s->ctx) != SCHC_FRAG_OK) break;
+            s->next++;
+            s->stats.fragments++;
+            continue;
+        }
+
+        all1_frag(s, &f);
+        if (s->emit(&f, s->ctx) != SCHC_FRAG_OK) break;
+        s->all1_pending = 0;
+        s->ack_reqs++;
+        s->stats.fragments++;
+        s->state = s->mode == SCHC_FRAG_NO_ACK ? SCHC_FRAG_SENT : SCHC_FRAG_WAIT_ACK;
+    }
+
+    switch (s->state) {
+        case SCHC_FRAG_SENT: return SCHC_FRAG_DONE;
+        case SCHC_FRAG_ABORTED: return SCHC_FRAG_KO;
+        default: return SCHC_FRAG_OK;
+    }
+}
+
+/* Next All-1, or an abort once the ACK requests are used up */
+static void request_ack(schc_frag_sender_t* s) {
+    if (s->ack_reqs >= SCHC_FRAG_MAX_ACK_REQ) {
+        s->abort_pending = 1;
+    } else {
+        s->all1_pending = 1;
+    }
+    s->state = SCHC_FRAG_SENDING;
+}
+
+schc_frag_status schc_frag_sender_on_ack(schc_frag_sender_t* s, const uint8_t* ack, const size_t len) {
+    if (s->state != SCHC_FRAG_WAIT_ACK) return SCHC_FRAG_OK;
+    if (len < SCHC_FRAG_HDR_SIZE || ack[0] != s->rule_id || ack[1] != s->dtag) return SCHC_FRAG_KO;
+
+    const uint32_t w = ack[2] >> 6;
+    if (ack[2] & 0x20) {
+        s->state = SCHC_FRAG_SENT;
+        return SCHC_FRAG_DONE;
+    }
+    if (len < SCHC_FRAG_ACK_MAX_SIZE) return SCHC_FRAG_KO;
+
+    // Tiles of window w the receiver has not seen, restricted to the ones that exist
+    uint64_t received = 0;
+    for (uint32_t i = 0; i < 8; i++) received = received << 8 | ack[SCHC_FRAG_HDR_SIZE + i];
+    uint64_t missing = 0;
+    for (uint32_t pos = 0; pos < SCHC_FRAG_WINDOW_SIZE; pos++) {
+        const uint32_t idx = w * SCHC_FRAG_WINDOW_SIZE + pos;
+        if (idx >= s->nb_tiles) break;
+        if (!(received >> (63 - pos) & 1)) missing |= 1ull << pos;
+    }
+
+    if (!missing) {
+        // Every tile arrived yet the RCS does not match: nothing a retransmission can fix
+        s->abort_pending = 1;
+        s->state = SCHC_FRAG_SENDING;
+        return SCHC_FRAG_OK;
+    }
+
+    s->retx_window = (uint8_t) w;
+    s->retx_bitmap = missing;
+    request_ack(s);
+    return SCHC_FRAG_OK;
+}
+
+schc_frag_status schc_frag_sender_on_timeout(schc_frag_sender_t* s) {
+    if (s->state != SCHC_FRAG_WAIT_ACK) return SCHC_FRAG_OK;
+    s->stats.ack_requests++;
+    request_ack(s);
+    return SCHC_FRAG_OK;
+}
+
+/* ------------------------------------------------------------ */
+/* Receiver                                                     */
+/* ------------------------------------------------------------ */
+
+void schc_frag_receiver_init(schc_frag_receiver_t* r, uint8_t* buf, const size_t cap, const size_t mtu) {
+    memset(r, 0, sizeof(*r));
+    r->buf = buf;
+    r->cap = cap;
+    r->tile_size = mtu - SCHC_FRAG_HDR_SIZE;
+}
+
+static size_t make_ack(const schc_frag_receiver_t* r, uint8_t* ack, const uint32_t w, const int complete) {
+    // C sits right after W, where a fragment has the top bit of its FCN
+    put_hdr(ack, r->rule_id, r->dtag, w, complete ? 0x20u : 0);
+    if (complete) return SCHC_FRAG_HDR_SIZE;
+
+    const uint64_t bm = r->bitmap[w];
+    uint64_t wire = 0;
+    for (uint32_t pos = 0; pos < SCHC_FRAG_WINDOW_SIZE; pos++) {
+        if (bm >> pos & 1) wire |= 1ull << (63 - pos);
+    }
+    put_be32(ack + SCHC_FRAG_HDR_SIZE, (uint32_t) (wire >> 32));
+    put_be32(ack + SCHC_FRAG_HDR_SIZE + 4, (uint32_t) wire);
+    return SCHC_FRAG_ACK_MAX_SIZE;
+}
+
+static schc_frag_status all1_ack_on_error(schc_frag_receiver_t* r, const uint32_t w, const uint32_t rcs,
+                                          size_t* pkt_len, uint8_t* ack, size_t* ack_len) {
+    const size_t nb_tiles = (r->len + r->tile_size - 1) / r->tile_size;
+    uint32_t first_gap = w;
+    int all_there = r->len > 0;
+    for (uint32_t i = 0; i <= w; i++) {
+        const size_t in_window = nb_tiles > (size_t) i * SCHC_FRAG_WINDOW_SIZE
+                                     ? nb_tiles - (size_t) i * SCHC_FRAG_WINDOW_SIZE : 0;
+        const uint64_t expected = in_window >= SCHC_FRAG_WINDOW_SIZE ? WINDOW_MASK : (1ull << in_window) - 1;
+        if ((r->bitmap[i] & expected) != expected || (i < w && expected != WINDOW_MASK)) {
+            first_gap = i;
+            all_there = 0;
+            break;
+        }
+    }
+
+    if (all_there && schc_frag_crc32(r->buf, r->len) == rcs) {
+        r->complete = 1;
+        r->stats.packets++;
+        *pkt_len = r->len;
+        *ack_len = make_ack(r, ack, w, 1);
+        return SCHC_FRAG_DONE;
+    }
+
+    // Missing tiles after the highest one received only show up as an RCS mismatch
+    r->stats.rcs_failures++;
+    *ack_len = make_ack(r, ack, first_gap, 0);
+    return SCHC_FRAG_OK;
+}
+
+schc_frag_status schc_frag_receiver_input(schc_frag_receiver_t* r, const uint8_t* frag, const size_t len,
+                                          size_t* pkt_len, uint8_t* ack, size_t* ack_len) {
+    *pkt_len = 0;
+    *ack_len = 0;
+    if (!schc_frag_is_fragment(frag, len)) return SCHC_FRAG_KO;
+
+    const uint8_t rule_id = frag[0];
+    const uint8_t dtag = frag[1];
+    const uint32_t w = frag[2] >> 6;
+    const uint32_t fcn = frag[2] & 0x3f;
+    const uint8_t* payload = frag + SCHC_FRAG_HDR_SIZE;
+    const size_t plen = len - SCHC_FRAG_HDR_SIZE;
+
+    if (!r->active || rule_id != r->rule_id || dtag != r->dtag) {
+        if (r->active && !r->complete) r->stats.aborted++;
+        r->active = 1;
+        r->complete = 0;
+        r->rule_id = rule_id;
+        r->dtag = dtag;
+        r->len = 0;
+        memset(r->bitmap, 0, sizeof(r->bitmap));
+    }
+    r->stats.fragments++;
+
+    if (fcn == FCN_ALL1 && plen < SCHC_FRAG_RCS_SIZE) {
+        // Sender-Abort
+        if (!r->complete) r->stats.aborted++;
+        r->active = 0;
+        return SCHC_FRAG_KO;
+    }
+
+    if (rule_id == SCHC_FRAG_NOACK_RULE_ID) {
+        const size_t off = fcn == FCN_ALL1 ? SCHC_FRAG_RCS_SIZE : 0;
+        if (r->len + plen - off > r->cap) {
+            r->stats.aborted++;
+            r->active = 0;
+            return SCHC_FRAG_KO;
+        }
+        memcpy(r->buf + r->len, payload + off, plen - off);
+        r->len += plen - off;
+        if (fcn != FCN_ALL1) return SCHC_FRAG_OK;
+
+        r->active = 0;
+        if (schc_frag_crc32(r->buf, r->len) != get_be32(payload)) {
+            r->stats.rcs_failures++;
+            return SCHC_FRAG_KO;
+        }
+        r->stats.packets++;
+        *pkt_len = r->len;
+        return SCHC_FRAG_DONE;
+    }
+
+    if (fcn == FCN_ALL1) {
+        if (r->complete) {
+            // Our C = 1 ACK was lost: repeat it
+            *ack_len = make_ack(r, ack, w, 1);
+            return SCHC_FRAG_OK;
+        }
+        return all1_ack_on_error(r, w, get_be32(payload), pkt_len, ack, ack_len);
+    }
+
+    if (r->complete) return SCHC_FRAG_OK;
+
+    const uint32_t pos = SCHC_FRAG_WINDOW_SIZE - 1 - fcn;
+    const size_t off = ((size_t) w * SCHC_FRAG_WINDOW_SIZE + pos) * r->tile_size;
+    if (!plen || plen > r->tile_size || off + plen > r->cap) return SCHC_FRAG_KO;
+
+    memcpy(r->buf + off, payload, plen);
+    r->bitmap[w] |= 1ull << pos;
+    if (off + plen > r->len) r->len = off + plen;
+    return SCHC_FRAG_OK;
+}
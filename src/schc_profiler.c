@@ -0,0 +1,603 @@
+#include "schc_profiler.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <schc_sdk/schccomp.h>
+
+#include "logger_helper.h"
+#include "net/ipv6_udp_builder.h"
+#include "schc_frag.h"
+#include "schc_rule_json.h"
+
+#define MAX_RULES_SCANNED 64    /* signature search; later rules are rarely the closest */
+#define MIN_SAMPLES 8           /* per signature, to derive a candidate */
+#define EQUAL_COVER 0.95        /* a value this common is matched, the rest stays a miss */
+
+static const char* const field_names[SCHC_NB_HDR_FIELDS] = {
+    "version", "traffic-class", "flow-label", "payload-length", "next-header", "hop-limit",
+    "dev-prefix", "dev-iid", "app-prefix", "app-iid", "dev-port", "app-port", "udp-length", "udp-checksum"
+};
+
+enum { F_PAYLOAD_LENGTH = 3, F_UDP_LENGTH = 12, F_UDP_CHECKSUM = 13 };
+
+typedef struct {
+    _Atomic uint64_t key;       /* signature key + 1, 0: free */
+    _Atomic uint64_t count;
+} sig_slot_t;
+
+typedef struct {
+    uint8_t hdr[SCHC_HDR_LEN];
+    uint16_t len;
+    bool lengths_ok;            /* both length fields are what compute-length rebuilds */
+    bool checksum_ok;           /* the UDP checksum is what compute-checksum rebuilds */
+    uint32_t sig_key;
+} sample_t;
+
+int schc_profiler_on = 0;
+
+static _Atomic uint32_t g_sample_every = 1;
+static sig_slot_t g_sigs[SCHC_PROFILER_SIGNATURES];
+static _Atomic uint64_t st_misses = 0;
+static _Atomic uint64_t st_sampled = 0;
+static _Atomic uint64_t st_other = 0;
+
+/* The reservoir (algorithm R) and its generator, under g_lock */
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static sample_t g_samples[SCHC_PROFILER_RESERVOIR];
+static uint64_t g_seen = 0;
+static uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+
+static __thread uint32_t t_misses = 0;
+
+static uint32_t sig_key(const uint16_t rule_id, const uint16_t fields) {
+    return (uint32_t) rule_id << 16 | fields;
+}
+
+static uint16_t be16(const uint8_t* p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+/* Field value, right-aligned; fields wider than a byte are byte aligned, none spans more than 8 bytes */
+static uint64_t field_value(const uint8_t* p, const uint16_t off, const uint16_t len) {
+    const size_t first = off >> 3, last = (size_t)(off + len - 1u) >> 3;
+    uint64_t v = 0;
+    for (size_t i = first; i <= last; i++) v = v << 8 | p[i];
+    v >>= 7u - ((off + len - 1u) & 7u);
+    return len == 64 ? v : v & ((1ull << len) - 1u);
+}
+
+/* Fields of hdr that rule r would not match */
+static uint16_t diff_fields(const schc_compiled_rule_t* cr, const uint8_t* hdr) {
+    uint64_t h[SCHC_HDR_WORDS];
+    uint8_t diff[SCHC_HDR_LEN];
+    memcpy(h, hdr, SCHC_HDR_LEN);
+    for (size_t w = 0; w < SCHC_HDR_WORDS; w++) h[w] = (h[w] ^ cr->value[w]) & cr->mask[w];
+    memcpy(diff, h, SCHC_HDR_LEN);
+
+    uint16_t fields = 0;
+    for (size_t i = 0; i < SCHC_NB_HDR_FIELDS; i++) {
+        if (field_value(diff, schc_hdr_fields[i].bit_off, schc_hdr_fields[i].bit_len)) fields |= (uint16_t)(1u << i);
+    }
+    return fields;
+}
+
+static uint32_t signature(const schc_engine_t* eng, const uint8_t* hdr) {
+    uint16_t best_id = eng->default_rule_id, best = 0;
+    int best_n = SCHC_NB_HDR_FIELDS + 1;
+    const size_t n = eng->nb_rules < MAX_RULES_SCANNED ? eng->nb_rules : MAX_RULES_SCANNED;
+    for (size_t r = 0; r < n; r++) {
+        const uint16_t f = diff_fields(&eng->rules[r], hdr);
+        if (__builtin_popcount(f) < best_n) {
+            best_n = __builtin_popcount(f);
+            best = f;
+            best_id = eng->rules[r].rule_id;
+        }
+    }
+    return sig_key(best_id, best);
+}
+
+static void count_signature(const uint32_t key) {
+    const uint64_t k = (uint64_t) key + 1;
+    size_t i = (size_t)((k * 0x9E3779B97F4A7C15ull) >> 57) % SCHC_PROFILER_SIGNATURES;
+    for (size_t probe = 0; probe < SCHC_PROFILER_SIGNATURES; probe++, i = (i + 1) % SCHC_PROFILER_SIGNATURES) {
+        uint64_t cur = atomic_load_explicit(&g_sigs[i].key, memory_order_acquire);
+        if (cur == 0 && atomic_compare_exchange_strong(&g_sigs[i].key, &cur, k)) cur = k;
+        if (cur == k) {
+            atomic_fetch_add_explicit(&g_sigs[i].count, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&st_other, 1, memory_order_relaxed);
+}
+
+static void sample(const uint8_t* pkt, const size_t len, const uint32_t key) {
+    const uint16_t udp_len = (uint16_t)(len - 40u);
+    sample_t s = { .len = (uint16_t) len, .sig_key = key };
+    memcpy(s.hdr, pkt, SCHC_HDR_LEN);
+    s.lengths_ok = len - 40u <= UINT16_MAX && be16(pkt + 4) == udp_len && be16(pkt + 44) == udp_len;
+    s.checksum_ok = s.lengths_ok && ipv6_udp_checksum(pkt, len) == be16(pkt + 46);
+
+    pthread_mutex_lock(&g_lock);
+    size_t slot = (size_t) g_seen;
+    if (g_seen >= SCHC_PROFILER_RESERVOIR) {
+        g_rng ^= g_rng << 13;
+        g_rng ^= g_rng >> 7;
+        g_rng ^= g_rng << 17;
+        slot = (size_t)(g_rng % (g_seen + 1));
+    }
+    if (slot < SCHC_PROFILER_RESERVOIR) g_samples[slot] = s;
+    g_seen++;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void schc_profiler_miss(const schc_engine_t* eng, const uint8_t* pkt, const size_t len) {
+    atomic_fetch_add_explicit(&st_misses, 1, memory_order_relaxed);
+    if (!eng || !pkt || len < SCHC_HDR_LEN || len > UINT16_MAX) {
+        atomic_fetch_add_explicit(&st_other, 1, memory_order_relaxed);
+        return;
+    }
+
+    const uint32_t key = signature(eng, pkt);
+    count_signature(key);
+
+    if (++t_misses % atomic_load_explicit(&g_sample_every, memory_order_relaxed) != 0) return;
+    atomic_fetch_add_explicit(&st_sampled, 1, memory_order_relaxed);
+    sample(pkt, len, key);
+}
+
+schc_profiler_status schc_profiler_start(const uint32_t sample_every) {
+    if (sample_every == 0) return SCHC_PROFILER_KO;
+
+    __atomic_store_n(&schc_profiler_on, 0, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&g_lock);
+    for (size_t i = 0; i < SCHC_PROFILER_SIGNATURES; i++) {
+        atomic_store(&g_sigs[i].key, 0);
+        atomic_store(&g_sigs[i].count, 0);
+    }
+    atomic_store(&st_misses, 0);
+    atomic_store(&st_sampled, 0);
+    atomic_store(&st_other, 0);
+    atomic_store(&g_sample_every, sample_every);
+    g_seen = 0;
+    pthread_mutex_unlock(&g_lock);
+    __atomic_store_n(&schc_profiler_on, 1, __ATOMIC_RELEASE);
+    return SCHC_PROFILER_OK;
+}
+
+void schc_profiler_stop(void) {
+    __atomic_store_n(&schc_profiler_on, 0, __ATOMIC_RELAXED);
+}
+
+void schc_profiler_get_stats(schc_profiler_stats_t* stats) {
+    stats->misses = atomic_load_explicit(&st_misses, memory_order_relaxed);
+    stats->sampled = atomic_load_explicit(&st_sampled, memory_order_relaxed);
+    stats->other = atomic_load_explicit(&st_other, memory_order_relaxed);
+    stats->nb_signatures = 0;
+    for (size_t i = 0; i < SCHC_PROFILER_SIGNATURES; i++) {
+        stats->nb_signatures += atomic_load_explicit(&g_sigs[i].key, memory_order_relaxed) != 0;
+    }
+}
+
+static int by_count_desc(const void* a, const void* b) {
+    const uint64_t x = ((const schc_miss_signature_t*) a)->count, y = ((const schc_miss_signature_t*) b)->count;
+    return (x < y) - (x > y);
+}
+
+size_t schc_profiler_signatures(schc_miss_signature_t* out, const size_t cap) {
+    schc_miss_signature_t all[SCHC_PROFILER_SIGNATURES];
+    size_t n = 0;
+    for (size_t i = 0; i < SCHC_PROFILER_SIGNATURES; i++) {
+        const uint64_t k = atomic_load_explicit(&g_sigs[i].key, memory_order_acquire);
+        if (!k) continue;
+        all[n].rule_id = (uint16_t)((k - 1) >> 16);
+        all[n].fields = (uint16_t)(k - 1);
+        all[n].count = atomic_load_explicit(&g_sigs[i].count, memory_order_relaxed);
+        n++;
+    }
+    qsort(all, n, sizeof(all[0]), by_count_desc);
+    if (n > cap) n = cap;
+    if (n) memcpy(out, all, n * sizeof(all[0]));
+    return n;
+}
+
+/* Copy of the reservoir, so that deriving never holds up the compressors */
+static sample_t* snapshot(size_t* n) {
+    sample_t* copy = malloc(sizeof(g_samples));
+    if (!copy) {
+        *n = 0;
+        return NULL;
+    }
+    pthread_mutex_lock(&g_lock);
+    *n = g_seen < SCHC_PROFILER_RESERVOIR ? (size_t) g_seen : SCHC_PROFILER_RESERVOIR;
+    memcpy(copy, g_samples, *n * sizeof(*copy));
+    pthread_mutex_unlock(&g_lock);
+    return copy;
+}
+
+static int by_value(const void* a, const void* b) {
+    const uint64_t x = ((const schc_value_count_t*) a)->value, y = ((const schc_value_count_t*) b)->value;
+    return (x > y) - (x < y);
+}
+
+static int by_value_count_desc(const void* a, const void* b) {
+    const uint32_t x = ((const schc_value_count_t*) a)->count, y = ((const schc_value_count_t*) b)->count;
+    if (x != y) return (x < y) - (x > y);
+    return by_value(a, b);
+}
+
+/* Distinct values of a field over samples[idx[0..n)], by decreasing count; vals holds n entries */
+static size_t distinct_values(const sample_t* samples, const size_t* idx, const size_t n, const size_t field,
+                              schc_value_count_t* vals) {
+    const schc_field_layout_t* l = &schc_hdr_fields[field];
+    for (size_t i = 0; i < n; i++) {
+        vals[i].value = field_value(samples[idx ? idx[i] : i].hdr, l->bit_off, l->bit_len);
+        vals[i].count = 1;
+    }
+    qsort(vals, n, sizeof(*vals), by_value);
+    size_t d = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (d && vals[d - 1].value == vals[i].value) {
+            vals[d - 1].count++;
+        } else {
+            vals[d++] = vals[i];
+        }
+    }
+    qsort(vals, d, sizeof(*vals), by_value_count_desc);
+    return d;
+}
+
+size_t schc_profiler_histogram(const size_t field, schc_value_count_t* out, const size_t cap) {
+    if (field >= SCHC_NB_HDR_FIELDS) return 0;
+    size_t n;
+    sample_t* samples = snapshot(&n);
+    schc_value_count_t* vals = samples && n ? malloc(n * sizeof(*vals)) : NULL;
+    size_t d = vals ? distinct_values(samples, NULL, n, field, vals) : 0;
+    if (d > cap) d = cap;
+    if (d) memcpy(out, vals, d * sizeof(*vals));
+    free(vals);
+    free(samples);
+    return d;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Candidate rules                                                           */
+/* ------------------------------------------------------------------------ */
+
+typedef struct {
+    uint8_t mo;
+    uint8_t cda;
+    uint8_t msb_len;
+    uint64_t value;             /* MO_EQUAL / MO_MSB target */
+    uint16_t cost;              /* residue bits */
+    uint8_t nb_map;             /* > 0: mapping-sent over map[] */
+    uint64_t map[SCHC_PROFILER_MAX_MAPPING];
+} field_choice_t;
+
+static void put_tv(uint8_t tv[8], const uint64_t value, const uint16_t len) {
+    memset(tv, 0, 8);
+    const uint64_t left = len == 64 ? value : value << (64u - len);
+    for (size_t i = 0; i < 8; i++) tv[i] = (uint8_t)(left >> (56u - 8u * i));
+}
+
+static uint8_t common_prefix(const schc_value_count_t* vals, const size_t d, const uint16_t len) {
+    uint64_t diff = 0;
+    for (size_t i = 1; i < d; i++) diff |= vals[i].value ^ vals[0].value;
+    if (!diff) return (uint8_t) len;
+    return (uint8_t)(__builtin_clzll(diff) - (64u - len));
+}
+
+static void choose(field_choice_t* c, const size_t field, const schc_value_count_t* vals, const size_t d,
+                   const size_t n, const bool lengths_ok, const bool checksum_ok) {
+    const uint16_t len = schc_hdr_fields[field].bit_len;
+    memset(c, 0, sizeof(*c));
+    c->mo = MO_IGNORE;
+    c->cda = CDA_VALUE_SENT;
+    c->cost = len;
+
+    if (field == F_PAYLOAD_LENGTH || field == F_UDP_LENGTH || field == F_UDP_CHECKSUM) {
+        if (field == F_UDP_CHECKSUM ? checksum_ok : lengths_ok) {
+            c->cda = field == F_UDP_CHECKSUM ? CDA_COMPUTE_CHECKSUM : CDA_COMPUTE_LENGTH;
+            c->cost = 0;
+        }
+        return;
+    }
+
+    if (vals[0].count >= EQUAL_COVER * (double) n) {
+        c->mo = MO_EQUAL;
+        c->cda = CDA_NOT_SENT;
+        c->value = vals[0].value;
+        c->cost = 0;
+        return;
+    }
+
+    const uint8_t prefix = common_prefix(vals, d, len);
+    if (prefix > 0) {
+        c->mo = MO_MSB;
+        c->cda = CDA_LSB;
+        c->msb_len = prefix;
+        c->value = vals[0].value;
+        c->cost = (uint16_t)(len - prefix);
+    }
+    if (d <= SCHC_PROFILER_MAX_MAPPING) {
+        c->nb_map = (uint8_t) d;
+        for (size_t i = 0; i < d; i++) c->map[i] = vals[i].value;
+    }
+}
+
+static bool field_matches(const field_choice_t* c, const uint16_t len, const uint64_t v) {
+    switch (c->mo) {
+        case MO_EQUAL:
+            return v == c->value;
+        case MO_MSB:
+            return c->msb_len == 0 || (v ^ c->value) >> (len - c->msb_len) == 0;
+        default:
+            return true;
+    }
+}
+
+static bool id_free(const schc_engine_t* eng, const uint8_t* taken, const uint32_t id, const uint8_t bits) {
+    const uint8_t first = (uint8_t)(id >> (bits - 8));
+    if (id == eng->default_rule_id || first == SCHC_FRAG_NOACK_RULE_ID || first == SCHC_FRAG_ACK_RULE_ID) return false;
+    if (eng->by_id && eng->by_id[id] >= 0) return false;
+    return !(taken[id >> 3] & (1u << (id & 7u)));
+}
+
+/* Build cand from the samples of its signature; false if it would not compress anything */
+static bool derive_one(schc_rule_candidate_t* cand, const sample_t* samples, const size_t* idx, const size_t n,
+                       schc_value_count_t* vals, const uint8_t rule_id_bits) {
+    field_choice_t ch[SCHC_NB_HDR_FIELDS];
+    bool lengths_ok = true, checksum_ok = true;
+    for (size_t i = 0; i < n; i++) {
+        lengths_ok &= samples[idx[i]].lengths_ok;
+        checksum_ok &= samples[idx[i]].checksum_ok;
+    }
+    for (size_t f = 0; f < SCHC_NB_HDR_FIELDS; f++) {
+        const size_t d = distinct_values(samples, idx, n, f, vals);
+        choose(&ch[f], f, vals, d, n, lengths_ok, checksum_ok);
+    }
+
+    /* One mapping-sent field at most, where it saves the most; the others keep MSB or value-sent */
+    int mapped = -1;
+    for (size_t f = 0; f < SCHC_NB_HDR_FIELDS; f++) {
+        if (ch[f].nb_map && ch[f].cost && (mapped < 0 || ch[f].cost > ch[mapped].cost)) mapped = (int) f;
+    }
+    cand->mapped_field = (int8_t) mapped;
+    cand->nb_rules = mapped < 0 ? 1 : ch[mapped].nb_map;
+
+    uint16_t residue = 0;
+    for (size_t f = 0; f < SCHC_NB_HDR_FIELDS; f++) residue = (uint16_t)(residue + ((int) f == mapped ? 0 : ch[f].cost));
+    cand->residue_bits = residue;
+
+    /* Savings over the no-compression rule, on the samples the candidate matches */
+    size_t matched = 0;
+    uint64_t saved_bits = 0;
+    for (size_t i = 0; i < n; i++) {
+        const sample_t* s = &samples[idx[i]];
+        bool ok = true;
+        for (size_t f = 0; f < SCHC_NB_HDR_FIELDS && ok; f++) {
+            const uint16_t len = schc_hdr_fields[f].bit_len;
+            const uint64_t v = field_value(s->hdr, schc_hdr_fields[f].bit_off, len);
+            if ((int) f == mapped) {
+                ok = false;
+                for (size_t m = 0; m < ch[f].nb_map; m++) ok |= ch[f].map[m] == v;
+            } else {
+                ok = field_matches(&ch[f], len, v);
+            }
+        }
+        if (!ok) continue;
+        matched++;
+        const size_t payload_bits = (size_t)(s->len - SCHC_HDR_LEN) * 8u;
+        const size_t comp_bytes = (rule_id_bits + residue + payload_bits + 7u) / 8u;
+        saved_bits += (uint64_t)(rule_id_bits / 8u + s->len - comp_bytes) * 8u;
+    }
+    cand->coverage = (double) matched / (double) n;
+    cand->bytes_saved = (uint64_t)((double) saved_bits / 8.0 / (double) n * (double) cand->signature.count);
+    if (!matched || !saved_bits) return false;
+
+    for (uint8_t r = 0; r < cand->nb_rules; r++) {
+        for (size_t f = 0; f < SCHC_NB_HDR_FIELDS; f++) {
+            const field_choice_t* c = &ch[f];
+            const uint16_t len = schc_hdr_fields[f].bit_len;
+            schc_field_desc_t* fd = &cand->fields[r][f];
+            *fd = (schc_field_desc_t){ schc_hdr_fields[f].fid, len, c->mo, c->cda, NULL, c->msb_len };
+            if ((int) f == mapped) {
+                fd->mo = MO_EQUAL;
+                fd->cda = CDA_NOT_SENT;
+                fd->msb_len = 0;
+                put_tv(cand->tvs[r][f], c->map[r], len);
+                fd->tv = cand->tvs[r][f];
+            } else if (c->mo != MO_IGNORE) {
+                put_tv(cand->tvs[r][f], c->value, len);
+                fd->tv = cand->tvs[r][f];
+            }
+        }
+        cand->rules[r].nb_fields = SCHC_NB_HDR_FIELDS;
+        cand->rules[r].fields = cand->fields[r];
+    }
+    return true;
+}
+
+static int by_savings_desc(const void* a, const void* b) {
+    const uint64_t x = ((const schc_rule_candidate_t*) a)->bytes_saved;
+    const uint64_t y = ((const schc_rule_candidate_t*) b)->bytes_saved;
+    return (x < y) - (x > y);
+}
+
+size_t schc_profiler_derive(const schc_engine_t* eng, schc_rule_candidate_t* out, const size_t cap) {
+    if (!eng || !out || !cap) return 0;
+    const uint8_t rule_id_bits = eng->rule_id_bits ? eng->rule_id_bits : 8;
+
+    schc_miss_signature_t sigs[SCHC_PROFILER_SIGNATURES];
+    const size_t nb_sigs = schc_profiler_signatures(sigs, SCHC_PROFILER_SIGNATURES);
+    size_t n;
+    sample_t* samples = snapshot(&n);
+    size_t* idx = samples && n ? malloc(n * sizeof(*idx)) : NULL;
+    schc_value_count_t* vals = idx ? malloc(n * sizeof(*vals)) : NULL;
+    schc_rule_candidate_t* cands = vals ? calloc(SCHC_PROFILER_MAX_CANDIDATES, sizeof(*cands)) : NULL;
+    uint8_t* taken = cands ? calloc((size_t) 1 << (rule_id_bits - 3), 1) : NULL;
+
+    size_t nb = 0;
+    for (size_t s = 0; taken && s < nb_sigs && nb < SCHC_PROFILER_MAX_CANDIDATES; s++) {
+        const uint32_t key = sig_key(sigs[s].rule_id, sigs[s].fields);
+        size_t m = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (samples[i].sig_key == key) idx[m++] = i;
+        }
+        if (m < MIN_SAMPLES) continue;
+
+        schc_rule_candidate_t* c = &cands[nb];
+        c->signature = sigs[s];
+        if (!derive_one(c, samples, idx, m, vals, rule_id_bits)) continue;
+
+        /* Rule IDs last: a candidate that saves nothing takes none */
+        uint32_t id = 0;
+        for (uint8_t r = 0; r < c->nb_rules; r++) {
+            while (id < (1u << rule_id_bits) && !id_free(eng, taken, id, rule_id_bits)) id++;
+            if (id == 1u << rule_id_bits) break;
+            taken[id >> 3] |= (uint8_t)(1u << (id & 7u));
+            c->rules[r].rule_id = (uint16_t) id;
+        }
+        if (id == 1u << rule_id_bits) break;
+        nb++;
+    }
+
+    qsort(cands, nb, sizeof(*cands), by_savings_desc);
+    if (nb > cap) nb = cap;
+    for (size_t i = 0; i < nb; i++) {
+        /* The descriptors point into the candidate itself: fix them up at their new place */
+        out[i] = cands[i];
+        for (uint8_t r = 0; r < out[i].nb_rules; r++) {
+            out[i].rules[r].fields = out[i].fields[r];
+            for (size_t f = 0; f < SCHC_NB_HDR_FIELDS; f++) {
+                if (out[i].fields[r][f].tv) out[i].fields[r][f].tv = out[i].tvs[r][f];
+            }
+        }
+    }
+
+    free(taken);
+    free(cands);
+    free(vals);
+    free(idx);
+    free(samples);
+    return nb;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Reports                                                                   */
+/* ------------------------------------------------------------------------ */
+
+static void fields_text(const uint16_t fields, char* buf, const size_t cap) {
+    size_t o = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < SCHC_NB_HDR_FIELDS && o < cap; i++) {
+        if (fields & (1u << i)) o += (size_t) snprintf(buf + o, cap - o, "%s%s", o ? " " : "", field_names[i]);
+    }
+    if (!fields) snprintf(buf, cap, "none");
+}
+
+static void candidate_text(const schc_rule_candidate_t* c, char* buf, const size_t cap) {
+    size_t o = 0;
+    buf[0] = '\0';
+    for (size_t f = 0; f < SCHC_NB_HDR_FIELDS && o < cap; f++) {
+        const schc_field_desc_t* fd = &c->fields[0][f];
+        const char* what = NULL;
+        char msb[24];
+        if ((int) f == c->mapped_field) {
+            snprintf(msb, sizeof(msb), "mapping-sent(%u)", c->nb_rules);
+            what = msb;
+        } else if (fd->mo == MO_MSB) {
+            snprintf(msb, sizeof(msb), "MSB(%u)/LSB", fd->msb_len);
+            what = msb;
+        } else if (fd->cda == CDA_VALUE_SENT) {
+            what = "value-sent";
+        } else if (fd->mo == MO_IGNORE && fd->cda == CDA_NOT_SENT) {
+            what = "ignore";
+        }
+        if (what) o += (size_t) snprintf(buf + o, cap - o, "%s%s %s", o ? ", " : "", field_names[f], what);
+    }
+    if (!o) snprintf(buf, cap, "every field equal/not-sent or computed");
+}
+
+void schc_profiler_report(const schc_engine_t* eng) {
+    schc_profiler_stats_t st;
+    schc_profiler_get_stats(&st);
+    zlog_info(stat_cat, "Rule misses: %llu, %llu sampled, %zu signatures, %llu uncounted",
+              (unsigned long long) st.misses, (unsigned long long) st.sampled, st.nb_signatures,
+              (unsigned long long) st.other);
+    if (!st.misses) return;
+
+    schc_miss_signature_t sigs[SCHC_PROFILER_SIGNATURES];
+    const size_t nb_sigs = schc_profiler_signatures(sigs, SCHC_PROFILER_SIGNATURES);
+    uint16_t missed_fields = 0;
+    char text[256];
+    for (size_t i = 0; i < nb_sigs; i++) {
+        fields_text(sigs[i].fields, text, sizeof(text));
+        zlog_info(stat_cat, "  closest rule %u, %llu misses (%.1f%%), differing: %s", sigs[i].rule_id,
+                  (unsigned long long) sigs[i].count, 100.0 * (double) sigs[i].count / (double) st.misses, text);
+        missed_fields |= sigs[i].fields;
+    }
+
+    for (size_t f = 0; f < SCHC_NB_HDR_FIELDS; f++) {
+        if (!(missed_fields & (1u << f))) continue;
+        schc_value_count_t top[SCHC_PROFILER_TOP_VALUES];
+        const size_t d = schc_profiler_histogram(f, top, SCHC_PROFILER_TOP_VALUES);
+        size_t o = 0;
+        for (size_t i = 0; i < d && o < sizeof(text); i++) {
+            o += (size_t) snprintf(text + o, sizeof(text) - o, "%s0x%llx x%u", i ? ", " : "",
+                                   (unsigned long long) top[i].value, top[i].count);
+        }
+        zlog_info(stat_cat, "  %s: %s", field_names[f], d ? text : "no samples");
+    }
+
+    schc_rule_candidate_t* cands = eng ? calloc(SCHC_PROFILER_MAX_CANDIDATES, sizeof(*cands)) : NULL;
+    const size_t nb = cands ? schc_profiler_derive(eng, cands, SCHC_PROFILER_MAX_CANDIDATES) : 0;
+    for (size_t i = 0; i < nb; i++) {
+        candidate_text(&cands[i], text, sizeof(text));
+        zlog_info(stat_cat, "  candidate rule %u%s: %u residue bits, matches %.0f%% of its misses, "
+                  "saves ~%llu bytes: %s", cands[i].rules[0].rule_id, cands[i].nb_rules > 1 ? "+" : "",
+                  cands[i].residue_bits, 100.0 * cands[i].coverage,
+                  (unsigned long long) cands[i].bytes_saved, text);
+    }
+    free(cands);
+}
+
+schc_profiler_status schc_profiler_write_rules(const schc_engine_t* eng, const char* path) {
+    if (!eng || !eng->rule_id_bits || !path) return SCHC_PROFILER_KO;
+
+    schc_rule_candidate_t* cands = calloc(SCHC_PROFILER_MAX_CANDIDATES, sizeof(*cands));
+    const size_t nb = cands ? schc_profiler_derive(eng, cands, SCHC_PROFILER_MAX_CANDIDATES) : 0;
+    const size_t max_rules = eng->nb_rules + nb * SCHC_PROFILER_MAX_MAPPING;
+    schc_rule_desc_t* rules = cands ? calloc(max_rules + 1, sizeof(*rules)) : NULL;
+    schc_field_desc_t (*fields)[SCHC_NB_HDR_FIELDS] = rules ? calloc(eng->nb_rules + 1, sizeof(*fields)) : NULL;
+    uint8_t (*tvs)[SCHC_NB_HDR_FIELDS][8] = fields ? calloc(eng->nb_rules + 1, sizeof(*tvs)) : NULL;
+
+    /* The current rules first, so that what compresses today keeps its rule ID */
+    schc_rule_set_t set = { rules, 0, eng->rule_id_bits, eng->default_rule_id, NULL };
+    bool ok = tvs != NULL;
+    for (size_t r = 0; ok && r < eng->nb_rules; r++) {
+        ok = schc_engine_describe(eng, r, &rules[set.nb_rules++], fields[r], tvs[r]) == SCHC_ENGINE_OK;
+    }
+    for (size_t c = 0; ok && c < nb; c++) {
+        for (uint8_t r = 0; r < cands[c].nb_rules; r++) rules[set.nb_rules++] = cands[c].rules[r];
+    }
+
+    FILE* f = ok ? fopen(path, "w") : NULL;
+    ok = f && schc_rule_json_write(f, &set) == SCHC_RULE_JSON_OK;
+    if (f && fclose(f) != 0) ok = false;
+    if (ok) {
+        zlog_info(ok_cat, "Rule set with %zu derived candidate%s written to %s", nb, nb == 1 ? "" : "s", path);
+    } else {
+        zlog_error(error_cat, "Cannot write the derived rule set to %s", path);
+    }
+
+    free(tvs);
+    free(fields);
+    free(rules);
+    free(cands);
+    return ok ? SCHC_PROFILER_OK : SCHC_PROFILER_KO;
+}
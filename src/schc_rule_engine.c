@@ -0,0 +1,784 @@
+#include "schc_rule_engine.h"
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <schc_sdk/schccomp.h>
+
+#include "net/ipv6_udp_builder.h"
+
+#define SIG_CACHE_SIZE 64 /* power of two */
+
+typedef struct {
+    uint64_t key[SCHC_HDR_WORDS];
+    uint32_t generation; /* 0 = empty slot */
+    int32_t rule_idx;
+} sig_cache_entry_t;
+
+/* Per-thread so concurrent compressors never share mutable state */
+static __thread sig_cache_entry_t sig_cache[SIG_CACHE_SIZE];
+
+static _Atomic uint32_t g_generation = 0;
+
+/* Engines may be built on any thread (rule reloads): every one gets its own non-zero tag */
+static uint32_t next_generation(void) {
+    uint32_t gen;
+    do {
+        gen = atomic_fetch_add_explicit(&g_generation, 1, memory_order_relaxed) + 1;
+    } while (gen == 0);
+    return gen;
+}
+
+const schc_field_layout_t schc_hdr_fields[SCHC_NB_HDR_FIELDS] = {
+    { FID_IPV6_VERSION,        0,   4  },
+    { FID_IPV6_TRAFFIC_CLASS,  4,   8  },
+    { FID_IPV6_FLOW_LABEL,     12,  20 },
+    { FID_IPV6_PAYLOAD_LENGTH, 32,  16 },
+    { FID_IPV6_NEXT_HEADER,    48,  8  },
+    { FID_IPV6_HOP_LIMIT,      56,  8  },
+    { FID_IPV6_PREFIX_DEV,     64,  64 },
+    { FID_IPV6_IID_DEV,        128, 64 },
+    { FID_IPV6_PREFIX_APP,     192, 64 },
+    { FID_IPV6_IID_APP,        256, 64 },
+    { FID_UDP_PORT_DEV,        320, 16 },
+    { FID_UDP_PORT_APP,        336, 16 },
+    { FID_UDP_LENGTH,          352, 16 },
+    { FID_UDP_CHECKSUM,        368, 16 },
+};
+
+/* Bit offset of a field in the uplink header */
+static int fid_bit_offset(const uint8_t fid, const uint16_t len, uint16_t* off) {
+    for (size_t i = 0; i < SCHC_NB_HDR_FIELDS; i++) {
+        if (schc_hdr_fields[i].fid == fid) {
+            if (len != schc_hdr_fields[i].bit_len) return -1;
+            *off = schc_hdr_fields[i].bit_off;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline int get_bit(const uint8_t* p, const size_t bit) {
+    return (p[bit >> 3] >> (7u - (bit & 7u))) & 1;
+}
+
+static inline void set_bit(uint8_t* p, const size_t bit) {
+    p[bit >> 3] |= (uint8_t)(0x80u >> (bit & 7u));
+}
+
+/* Append n bits of src (starting at bit src_off) to a zeroed dst at bit dst_off */
+static void append_bits(uint8_t* dst, const size_t dst_off,
+                        const uint8_t* src, const size_t src_off, const size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (get_bit(src, src_off + i)) set_bit(dst, dst_off + i);
+    }
+}
+
+static inline void load_hdr(uint64_t w[SCHC_HDR_WORDS], const uint8_t* hdr) {
+    memcpy(w, hdr, SCHC_HDR_LEN);
+}
+
+static inline uint32_t sig_hash(const uint64_t k[SCHC_HDR_WORDS]) {
+    uint64_t x = 0;
+    for (size_t w = 0; w < SCHC_HDR_WORDS; w++) {
+        x = (x ^ k[w]) * 0x9E3779B97F4A7C15ull;
+    }
+    /* Multiplying only carries bits upward: fold the high ones back into the low ones */
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return (uint32_t) x;
+}
+
+/* Rule ID in front of the residue, big endian; returns its size in bytes */
+static inline size_t put_rule_id(const schc_engine_t* eng, uint8_t* out, const uint16_t rule_id) {
+    if (eng->rule_id_bits == 16) {
+        out[0] = (uint8_t)(rule_id >> 8);
+        out[1] = (uint8_t)(rule_id & 0xFFu);
+        return 2;
+    }
+    out[0] = (uint8_t) rule_id;
+    return 1;
+}
+
+static inline uint16_t get_rule_id(const schc_engine_t* eng, const uint8_t* in) {
+    return eng->rule_id_bits == 16 ? (uint16_t)(in[0] << 8 | in[1]) : in[0];
+}
+
+static schc_engine_status compile_rule(schc_compiled_rule_t* cr, const schc_rule_desc_t* rd) {
+    uint8_t mask[SCHC_HDR_LEN] = {0};
+    uint8_t value[SCHC_HDR_LEN] = {0};
+
+    if (rd->nb_fields > SCHC_MAX_RULE_FIELDS) return SCHC_ENGINE_UNSUPPORTED;
+
+    memset(cr, 0, sizeof(*cr));
+    cr->rule_id = rd->rule_id;
+
+    for (uint8_t i = 0; i < rd->nb_fields; i++) {
+        const schc_field_desc_t* f = &rd->fields[i];
+        uint16_t off;
+        if (fid_bit_offset(f->fid, f->len, &off) != 0) return SCHC_ENGINE_UNSUPPORTED;
+
+        switch (f->mo) {
+            case MO_EQUAL:
+                if (!f->tv) return SCHC_ENGINE_KO;
+                for (uint16_t b = 0; b < f->len; b++) {
+                    set_bit(mask, (size_t)off + b);
+                    if (get_bit(f->tv, b)) set_bit(value, (size_t)off + b);
+                }
+                break;
+            case MO_IGNORE:
+                break;
+            case MO_MSB:
+                if (!f->tv || f->msb_len > f->len) return SCHC_ENGINE_KO;
+                for (uint16_t b = 0; b < f->msb_len; b++) {
+                    set_bit(mask, (size_t)off + b);
+                    if (get_bit(f->tv, b)) set_bit(value, (size_t)off + b);
+                }
+                break;
+            default:
+                return SCHC_ENGINE_UNSUPPORTED;
+        }
+
+        switch (f->cda) {
+            case CDA_NOT_SENT:
+                if (!f->tv) return SCHC_ENGINE_KO;
+                append_bits(cr->rebuild, off, f->tv, 0, f->len);
+                break;
+            case CDA_COMPUTE_LENGTH:
+                if (f->fid == FID_IPV6_PAYLOAD_LENGTH) cr->compute |= SCHC_COMPUTE_IPV6_LEN;
+                else if (f->fid == FID_UDP_LENGTH) cr->compute |= SCHC_COMPUTE_UDP_LEN;
+                else return SCHC_ENGINE_UNSUPPORTED;
+                break;
+            case CDA_COMPUTE_CHECKSUM:
+                if (f->fid != FID_UDP_CHECKSUM) return SCHC_ENGINE_UNSUPPORTED;
+                cr->compute |= SCHC_COMPUTE_UDP_CSUM;
+                break;
+            case CDA_VALUE_SENT:
+                cr->residues[cr->nb_residues].bit_off = off;
+                cr->residues[cr->nb_residues].bit_len = f->len;
+                cr->nb_residues++;
+                cr->residue_bits = (uint16_t)(cr->residue_bits + f->len);
+                break;
+            case CDA_LSB:
+                /* The matched MSBs come from the rule, the rest is sent */
+                if (f->mo != MO_MSB) return SCHC_ENGINE_KO;
+                append_bits(cr->rebuild, off, f->tv, 0, f->msb_len);
+                if (f->msb_len < f->len) {
+                    cr->residues[cr->nb_residues].bit_off = (uint16_t)(off + f->msb_len);
+                    cr->residues[cr->nb_residues].bit_len = (uint16_t)(f->len - f->msb_len);
+                    cr->nb_residues++;
+                    cr->residue_bits = (uint16_t)(cr->residue_bits + f->len - f->msb_len);
+                }
+                break;
+            default:
+                return SCHC_ENGINE_UNSUPPORTED;
+        }
+    }
+
+    load_hdr(cr->mask, mask);
+    load_hdr(cr->value, value);
+    return SCHC_ENGINE_OK;
+}
+
+static int same_mask(const uint64_t a[SCHC_HDR_WORDS], const uint64_t b[SCHC_HDR_WORDS]) {
+    return memcmp(a, b, SCHC_HDR_LEN) == 0;
+}
+
+static inline int same_key(const uint64_t a[SCHC_HDR_WORDS], const uint64_t b[SCHC_HDR_WORDS]) {
+    uint64_t diff = 0;
+    for (size_t w = 0; w < SCHC_HDR_WORDS; w++) diff |= a[w] ^ b[w];
+    return diff == 0;
+}
+
+/* Group the rules by mask and hash each rule's value into its group's table */
+static schc_engine_status build_index(schc_engine_t* eng) {
+    const size_t n = eng->nb_rules;
+    if (!n) return SCHC_ENGINE_OK;
+
+    uint32_t* group_of = malloc(n * sizeof(*group_of));
+    uint32_t* group_size = calloc(n, sizeof(*group_size));
+    eng->groups = calloc(n, sizeof(*eng->groups));
+    if (!group_of || !group_size || !eng->groups) {
+        free(group_of);
+        free(group_size);
+        return SCHC_ENGINE_KO;
+    }
+
+    /* Groups are created in rule order, so they come out sorted by first rule */
+    for (size_t r = 0; r < n; r++) {
+        size_t g = 0;
+        while (g < eng->nb_groups && !same_mask(eng->groups[g].mask, eng->rules[r].mask)) g++;
+        if (g == eng->nb_groups) {
+            memcpy(eng->groups[g].mask, eng->rules[r].mask, SCHC_HDR_LEN);
+            eng->groups[g].first = (uint32_t) r;
+            eng->nb_groups++;
+        }
+        group_of[r] = (uint32_t) g;
+        group_size[g]++;
+    }
+
+    /* Tables at most half full */
+    size_t total = 0;
+    for (size_t g = 0; g < eng->nb_groups; g++) {
+        uint32_t size = 2;
+        while (size < 2 * group_size[g]) size <<= 1;
+        eng->groups[g].slot_mask = size - 1;
+        total += size;
+    }
+    eng->slots = calloc(total, sizeof(*eng->slots));
+    if (!eng->slots) {
+        free(group_of);
+        free(group_size);
+        return SCHC_ENGINE_KO;
+    }
+    eng->nb_slots = total;
+    for (size_t g = 0, off = 0; g < eng->nb_groups; g++) {
+        eng->groups[g].slot_off = (uint32_t) off;
+        off += eng->groups[g].slot_mask + 1u;
+    }
+
+    for (size_t r = 0; r < n; r++) {
+        const schc_rule_group_t* grp = &eng->groups[group_of[r]];
+        uint32_t* slots = eng->slots + grp->slot_off;
+        uint32_t i = sig_hash(eng->rules[r].value) & grp->slot_mask;
+        int shadowed = 0;
+        while (slots[i]) {
+            /* Same mask and value as an earlier rule: that one always wins */
+            if (same_key(eng->rules[slots[i] - 1].value, eng->rules[r].value)) {
+                shadowed = 1;
+                break;
+            }
+            i = (i + 1) & grp->slot_mask;
+        }
+        if (!shadowed) slots[i] = (uint32_t) r + 1;
+    }
+
+    free(group_of);
+    free(group_size);
+    return SCHC_ENGINE_OK;
+}
+
+schc_engine_status schc_engine_compile(schc_engine_t* eng,
+                                       const schc_rule_desc_t* rules, const size_t nb_rules,
+                                       const uint8_t rule_id_bits, const uint16_t default_rule_id) {
+    if (!eng || (!rules && nb_rules)) return SCHC_ENGINE_KO;
+    if (rule_id_bits != 8 && rule_id_bits != 16) return SCHC_ENGINE_UNSUPPORTED;
+
+    memset(eng, 0, sizeof(*eng));
+    const size_t nb_ids = (size_t) 1 << rule_id_bits;
+    if (default_rule_id >= nb_ids || nb_rules > INT32_MAX) return SCHC_ENGINE_KO;
+    eng->default_rule_id = default_rule_id;
+    eng->rule_id_bits = rule_id_bits;
+
+    eng->by_id = malloc(nb_ids * sizeof(*eng->by_id));
+    if (!eng->by_id) return SCHC_ENGINE_KO;
+    memset(eng->by_id, 0xFF, nb_ids * sizeof(*eng->by_id));
+
+    if (nb_rules) {
+        eng->rules = calloc(nb_rules, sizeof(*eng->rules));
+        if (!eng->rules) {
+            schc_engine_free(eng);
+            return SCHC_ENGINE_KO;
+        }
+    }
+
+    for (size_t r = 0; r < nb_rules; r++) {
+        schc_engine_status st = rules[r].rule_id < nb_ids && rules[r].rule_id != default_rule_id
+                                    ? compile_rule(&eng->rules[r], &rules[r])
+                                    : SCHC_ENGINE_KO;
+        if (st != SCHC_ENGINE_OK) {
+            schc_engine_free(eng);
+            return st;
+        }
+        for (size_t w = 0; w < SCHC_HDR_WORDS; w++) {
+            eng->sig_mask[w] |= eng->rules[r].mask[w];
+        }
+        /* First rule wins, as in rule selection */
+        if (eng->by_id[rules[r].rule_id] < 0) eng->by_id[rules[r].rule_id] = (int32_t) r;
+    }
+
+    eng->nb_rules = nb_rules;
+    if (build_index(eng) != SCHC_ENGINE_OK) {
+        schc_engine_free(eng);
+        return SCHC_ENGINE_KO;
+    }
+
+    /* Never 0 so that zeroed cache slots stay empty */
+    eng->generation = next_generation();
+    return SCHC_ENGINE_OK;
+}
+
+void schc_engine_free(schc_engine_t* eng) {
+    if (!eng) return;
+    if (eng->image) {
+        munmap(eng->image, eng->image_len);
+    } else {
+        free(eng->rules);
+        free(eng->groups);
+        free(eng->slots);
+        free(eng->by_id);
+    }
+    memset(eng, 0, sizeof(*eng));
+}
+
+/* Leading ones of the mask over a field, -1 if the mask is not a prefix of it */
+static int mask_prefix(const uint8_t* mask, const uint16_t off, const uint16_t len) {
+    uint16_t n = 0;
+    while (n < len && get_bit(mask, (size_t) off + n)) n++;
+    for (uint16_t b = n; b < len; b++) {
+        if (get_bit(mask, (size_t) off + b)) return -1;
+    }
+    return n;
+}
+
+schc_engine_status schc_engine_describe(const schc_engine_t* eng, const size_t idx, schc_rule_desc_t* rd,
+                                        schc_field_desc_t fields[SCHC_NB_HDR_FIELDS],
+                                        uint8_t tvs[SCHC_NB_HDR_FIELDS][8]) {
+    if (!eng || idx >= eng->nb_rules || !rd || !fields || !tvs) return SCHC_ENGINE_KO;
+    const schc_compiled_rule_t* cr = &eng->rules[idx];
+    uint8_t mask[SCHC_HDR_LEN], value[SCHC_HDR_LEN];
+    memcpy(mask, cr->mask, SCHC_HDR_LEN);
+    memcpy(value, cr->value, SCHC_HDR_LEN);
+
+    /* Residues go out in rule field order: sent fields take the sent slots in that order */
+    int residue_of[SCHC_NB_HDR_FIELDS];
+    size_t nb_sent = 0;
+    for (size_t i = 0; i < SCHC_NB_HDR_FIELDS; i++) {
+        const schc_field_layout_t* l = &schc_hdr_fields[i];
+        residue_of[i] = -1;
+        for (uint8_t r = 0; r < cr->nb_residues; r++) {
+            const uint32_t end = (uint32_t) cr->residues[r].bit_off + cr->residues[r].bit_len;
+            if (cr->residues[r].bit_off >= l->bit_off && end == (uint32_t) l->bit_off + l->bit_len) {
+                residue_of[i] = r;
+                nb_sent++;
+            }
+        }
+    }
+    if (nb_sent != cr->nb_residues) return SCHC_ENGINE_UNSUPPORTED;
+
+    size_t next_residue = 0;
+    for (size_t i = 0; i < SCHC_NB_HDR_FIELDS; i++) {
+        size_t src = i;
+        if (residue_of[i] >= 0) {
+            /* The field sent next, wherever it is in the header */
+            for (src = 0; residue_of[src] != (int) next_residue; src++) {}
+            next_residue++;
+        }
+        const schc_field_layout_t* sl = &schc_hdr_fields[src];
+        schc_field_desc_t* f = &fields[i];
+        const int msb = mask_prefix(mask, sl->bit_off, sl->bit_len);
+        if (msb < 0) return SCHC_ENGINE_UNSUPPORTED;
+
+        memset(tvs[i], 0, 8);
+        *f = (schc_field_desc_t){ sl->fid, sl->bit_len, MO_IGNORE, CDA_NOT_SENT, tvs[i], 0 };
+        if (msb == sl->bit_len) {
+            f->mo = MO_EQUAL;
+        } else if (msb > 0) {
+            f->mo = MO_MSB;
+            f->msb_len = (uint8_t) msb;
+        }
+
+        if (residue_of[src] >= 0) {
+            const schc_residue_t* r = &cr->residues[residue_of[src]];
+            f->cda = r->bit_off == sl->bit_off ? CDA_VALUE_SENT : CDA_LSB;
+            if (f->cda == CDA_LSB && (f->mo != MO_MSB || r->bit_off != sl->bit_off + msb)) {
+                return SCHC_ENGINE_UNSUPPORTED;
+            }
+            append_bits(tvs[i], 0, value, sl->bit_off, (size_t) msb);
+            if (f->mo == MO_IGNORE) f->tv = NULL;
+        } else if ((sl->fid == FID_IPV6_PAYLOAD_LENGTH && (cr->compute & SCHC_COMPUTE_IPV6_LEN)) ||
+                   (sl->fid == FID_UDP_LENGTH && (cr->compute & SCHC_COMPUTE_UDP_LEN))) {
+            f->cda = CDA_COMPUTE_LENGTH;
+            f->tv = NULL;
+        } else if (sl->fid == FID_UDP_CHECKSUM && (cr->compute & SCHC_COMPUTE_UDP_CSUM)) {
+            f->cda = CDA_COMPUTE_CHECKSUM;
+            f->tv = NULL;
+        } else {
+            /* Not sent: the template holds the whole value, matched or not */
+            append_bits(tvs[i], 0, cr->rebuild, sl->bit_off, sl->bit_len);
+        }
+    }
+
+    rd->rule_id = cr->rule_id;
+    rd->nb_fields = SCHC_NB_HDR_FIELDS;
+    rd->fields = fields;
+    return SCHC_ENGINE_OK;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Rule images                                                               */
+/* ------------------------------------------------------------------------ */
+
+/*
+ * Header, then the rules, groups, slots and by_id arrays of the engine,
+ * each at a 64-byte aligned offset from the start of the file.
+ */
+#define IMAGE_MAGIC "SCHCRIMG"
+#define IMAGE_VERSION 1u
+#define IMAGE_BYTE_ORDER 0x01020304u
+#define IMAGE_ALIGN 64u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        /* IMAGE_BYTE_ORDER as written by the host */
+    uint32_t rule_size;         /* sizeof(schc_compiled_rule_t) of the writer */
+    uint32_t group_size;
+    uint32_t nb_rules;
+    uint32_t nb_groups;
+    uint32_t nb_slots;
+    uint16_t default_rule_id;
+    uint8_t rule_id_bits;
+    uint8_t reserved;
+    uint64_t sig_mask[SCHC_HDR_WORDS];
+    uint64_t rules_off;
+    uint64_t groups_off;
+    uint64_t slots_off;
+    uint64_t by_id_off;
+    uint64_t total_len;
+} image_hdr_t;
+
+static uint64_t align_up(const uint64_t v) {
+    return (v + IMAGE_ALIGN - 1) & ~(uint64_t)(IMAGE_ALIGN - 1);
+}
+
+static int write_section(FILE* f, const void* data, const size_t len) {
+    static const uint8_t zeros[IMAGE_ALIGN] = {0};
+    if (len && fwrite(data, 1, len, f) != len) return -1;
+    const size_t pad = (size_t)(align_up(len) - len);
+    return pad && fwrite(zeros, 1, pad, f) != pad ? -1 : 0;
+}
+
+schc_engine_status schc_engine_save(const schc_engine_t* eng, const char* path) {
+    if (!eng || !eng->by_id || !path || eng->nb_rules > UINT32_MAX || eng->nb_slots > UINT32_MAX) {
+        return SCHC_ENGINE_KO;
+    }
+
+    image_hdr_t h = {0};
+    memcpy(h.magic, IMAGE_MAGIC, sizeof(h.magic));
+    h.version = IMAGE_VERSION;
+    h.byte_order = IMAGE_BYTE_ORDER;
+    h.rule_size = sizeof(schc_compiled_rule_t);
+    h.group_size = sizeof(schc_rule_group_t);
+    h.nb_rules = (uint32_t) eng->nb_rules;
+    h.nb_groups = (uint32_t) eng->nb_groups;
+    h.nb_slots = (uint32_t) eng->nb_slots;
+    h.default_rule_id = eng->default_rule_id;
+    h.rule_id_bits = eng->rule_id_bits;
+    memcpy(h.sig_mask, eng->sig_mask, sizeof(h.sig_mask));
+
+    const size_t rules_len = eng->nb_rules * sizeof(*eng->rules);
+    const size_t groups_len = eng->nb_groups * sizeof(*eng->groups);
+    const size_t slots_len = eng->nb_slots * sizeof(*eng->slots);
+    const size_t by_id_len = ((size_t) 1 << eng->rule_id_bits) * sizeof(*eng->by_id);
+    h.rules_off = align_up(sizeof(h));
+    h.groups_off = h.rules_off + align_up(rules_len);
+    h.slots_off = h.groups_off + align_up(groups_len);
+    h.by_id_off = h.slots_off + align_up(slots_len);
+    h.total_len = h.by_id_off + align_up(by_id_len);
+
+    FILE* f = fopen(path, "wb");
+    if (!f) return SCHC_ENGINE_KO;
+    const int err = write_section(f, &h, sizeof(h)) ||
+                    write_section(f, eng->rules, rules_len) ||
+                    write_section(f, eng->groups, groups_len) ||
+                    write_section(f, eng->slots, slots_len) ||
+                    write_section(f, eng->by_id, by_id_len);
+    return fclose(f) != 0 || err ? SCHC_ENGINE_KO : SCHC_ENGINE_OK;
+}
+
+static int section_ok(const image_hdr_t* h, const uint64_t off, const uint64_t count, const uint64_t size) {
+    return off % IMAGE_ALIGN == 0 && off <= h->total_len && count <= (h->total_len - off) / size;
+}
+
+/* Everything the hot path trusts without checking: indices, offsets, bit ranges */
+static int image_ok(const image_hdr_t* h, const size_t file_len) {
+    if (file_len < sizeof(*h) || memcmp(h->magic, IMAGE_MAGIC, sizeof(h->magic)) != 0) return 0;
+    if (h->version != IMAGE_VERSION || h->byte_order != IMAGE_BYTE_ORDER) return 0;
+    if (h->rule_size != sizeof(schc_compiled_rule_t) || h->group_size != sizeof(schc_rule_group_t)) return 0;
+    if ((h->rule_id_bits != 8 && h->rule_id_bits != 16) || h->default_rule_id >> h->rule_id_bits) return 0;
+    if (h->total_len != file_len || h->nb_groups > h->nb_rules || h->nb_rules > INT32_MAX) return 0;
+
+    const uint8_t* base = (const uint8_t*) h;
+    const size_t nb_ids = (size_t) 1 << h->rule_id_bits;
+    if (!section_ok(h, h->rules_off, h->nb_rules, sizeof(schc_compiled_rule_t)) ||
+        !section_ok(h, h->groups_off, h->nb_groups, sizeof(schc_rule_group_t)) ||
+        !section_ok(h, h->slots_off, h->nb_slots, sizeof(uint32_t)) ||
+        !section_ok(h, h->by_id_off, nb_ids, sizeof(int32_t))) {
+        return 0;
+    }
+
+    const schc_compiled_rule_t* rules = (const schc_compiled_rule_t*)(base + h->rules_off);
+    for (uint32_t r = 0; r < h->nb_rules; r++) {
+        const schc_compiled_rule_t* cr = &rules[r];
+        if (cr->rule_id >> h->rule_id_bits || cr->nb_residues > SCHC_MAX_RULE_FIELDS) return 0;
+        uint32_t bits = 0;
+        for (uint8_t i = 0; i < cr->nb_residues; i++) {
+            if ((uint32_t) cr->residues[i].bit_off + cr->residues[i].bit_len > SCHC_HDR_LEN * 8u) return 0;
+            bits += cr->residues[i].bit_len;
+        }
+        if (bits != cr->residue_bits) return 0;
+    }
+
+    const schc_rule_group_t* groups = (const schc_rule_group_t*)(base + h->groups_off);
+    for (uint32_t g = 0; g < h->nb_groups; g++) {
+        const uint64_t size = (uint64_t) groups[g].slot_mask + 1;
+        if (size & (size - 1) || groups[g].slot_off + size > h->nb_slots || groups[g].first >= h->nb_rules) return 0;
+    }
+    const uint32_t* slots = (const uint32_t*)(base + h->slots_off);
+    for (uint32_t i = 0; i < h->nb_slots; i++) {
+        if (slots[i] > h->nb_rules) return 0;
+    }
+    const int32_t* by_id = (const int32_t*)(base + h->by_id_off);
+    for (size_t i = 0; i < nb_ids; i++) {
+        if (by_id[i] < -1 || by_id[i] >= (int64_t) h->nb_rules) return 0;
+    }
+    return 1;
+}
+
+schc_engine_status schc_engine_load(schc_engine_t* eng, const char* path) {
+    if (!eng || !path) return SCHC_ENGINE_KO;
+    memset(eng, 0, sizeof(*eng));
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return SCHC_ENGINE_KO;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(image_hdr_t)) {
+        close(fd);
+        return SCHC_ENGINE_KO;
+    }
+    const size_t len = (size_t) st.st_size;
+    void* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return SCHC_ENGINE_KO;
+
+    const image_hdr_t* h = map;
+    if (!image_ok(h, len)) {
+        munmap(map, len);
+        return SCHC_ENGINE_KO;
+    }
+
+    /* Read-only mapping: nothing below is ever written through these pointers */
+    uint8_t* base = map;
+    eng->rules = (schc_compiled_rule_t*)(base + h->rules_off);
+    eng->nb_rules = h->nb_rules;
+    eng->groups = (schc_rule_group_t*)(base + h->groups_off);
+    eng->nb_groups = h->nb_groups;
+    eng->slots = (uint32_t*)(base + h->slots_off);
+    eng->nb_slots = h->nb_slots;
+    eng->by_id = (int32_t*)(base + h->by_id_off);
+    memcpy(eng->sig_mask, h->sig_mask, sizeof(eng->sig_mask));
+    eng->default_rule_id = h->default_rule_id;
+    eng->rule_id_bits = h->rule_id_bits;
+    eng->image = map;
+    eng->image_len = len;
+
+    eng->generation = next_generation();
+    return SCHC_ENGINE_OK;
+}
+
+int32_t schc_engine_select(const schc_engine_t* eng, const uint8_t* hdr) {
+    uint64_t h[SCHC_HDR_WORDS];
+    uint64_t key[SCHC_HDR_WORDS];
+    load_hdr(h, hdr);
+
+    for (size_t w = 0; w < SCHC_HDR_WORDS; w++) {
+        key[w] = h[w] & eng->sig_mask[w];
+    }
+
+    sig_cache_entry_t* e = &sig_cache[sig_hash(key) & (SIG_CACHE_SIZE - 1)];
+    if (e->generation == eng->generation && memcmp(e->key, key, sizeof(key)) == 0) {
+        return e->rule_idx;
+    }
+
+    /* One probe per mask; a group starting after the best match so far cannot beat it */
+    int32_t idx = -1;
+    for (size_t g = 0; g < eng->nb_groups; g++) {
+        const schc_rule_group_t* grp = &eng->groups[g];
+        if (idx >= 0 && grp->first > (uint32_t) idx) break;
+
+        uint64_t k[SCHC_HDR_WORDS];
+        for (size_t w = 0; w < SCHC_HDR_WORDS; w++) k[w] = h[w] & grp->mask[w];
+        const uint32_t* slots = eng->slots + grp->slot_off;
+        for (uint32_t i = sig_hash(k) & grp->slot_mask; slots[i]; i = (i + 1) & grp->slot_mask) {
+            const int32_t r = (int32_t) slots[i] - 1;
+            if (same_key(eng->rules[r].value, k)) {
+                if (idx < 0 || r < idx) idx = r;
+                break;
+            }
+        }
+    }
+
+    memcpy(e->key, key, sizeof(key));
+    e->generation = eng->generation;
+    e->rule_idx = idx;
+    return idx;
+}
+
+schc_engine_status schc_engine_compress(const schc_engine_t* eng,
+                                        const uint8_t* in, const size_t in_len,
+                                        uint8_t* out, const size_t out_cap,
+                                        size_t* out_bits) {
+    if (!eng || !in || !out || !out_bits) return SCHC_ENGINE_KO;
+    if (in_len < SCHC_HDR_LEN) return SCHC_ENGINE_NO_MATCH;
+
+    const int32_t idx = schc_engine_select(eng, in);
+    if (idx < 0) return SCHC_ENGINE_NO_MATCH;
+
+    const schc_compiled_rule_t* cr = &eng->rules[idx];
+    const size_t payload_len = in_len - SCHC_HDR_LEN;
+    const size_t total_bits = eng->rule_id_bits + cr->residue_bits + payload_len * 8u;
+    const size_t total_bytes = (total_bits + 7u) / 8u;
+    if (total_bytes > out_cap) return SCHC_ENGINE_BUF_TOO_SMALL;
+
+    const size_t id_len = put_rule_id(eng, out, cr->rule_id);
+    size_t pos = eng->rule_id_bits;
+
+    if (cr->residue_bits) {
+        memset(out + id_len, 0, total_bytes - id_len);
+        for (uint8_t i = 0; i < cr->nb_residues; i++) {
+            append_bits(out, pos, in, cr->residues[i].bit_off, cr->residues[i].bit_len);
+            pos += cr->residues[i].bit_len;
+        }
+    }
+
+    const uint8_t* payload = in + SCHC_HDR_LEN;
+    const unsigned shift = (unsigned)(pos & 7u);
+    uint8_t* dst = out + (pos >> 3);
+    if (shift == 0) {
+        memcpy(dst, payload, payload_len);
+    } else {
+        for (size_t i = 0; i < payload_len; i++) {
+            dst[i] |= (uint8_t)(payload[i] >> shift);
+            dst[i + 1] = (uint8_t)(payload[i] << (8u - shift));
+        }
+    }
+
+    *out_bits = total_bits;
+    return SCHC_ENGINE_OK;
+}
+
+schc_engine_status schc_engine_compress_inplace(const schc_engine_t* eng,
+                                                uint8_t* pkt, const size_t len,
+                                                size_t* out_off, size_t* out_bits,
+                                                int* moved) {
+    if (!eng || !pkt || !out_off || !out_bits || !moved) return SCHC_ENGINE_KO;
+    if (len < SCHC_HDR_LEN) return SCHC_ENGINE_NO_MATCH;
+
+    const int32_t idx = schc_engine_select(eng, pkt);
+    if (idx < 0) return SCHC_ENGINE_NO_MATCH;
+
+    const schc_compiled_rule_t* cr = &eng->rules[idx];
+    const size_t head_bits = eng->rule_id_bits + cr->residue_bits;
+    const size_t payload_len = len - SCHC_HDR_LEN;
+
+    /* Residue is taken from the header before the header is overwritten */
+    uint8_t head[SCHC_RULE_ID_MAX_BITS / 8 + SCHC_HDR_LEN + 1] = {0};
+    put_rule_id(eng, head, cr->rule_id);
+    size_t pos = eng->rule_id_bits;
+    for (uint8_t i = 0; i < cr->nb_residues; i++) {
+        append_bits(head, pos, pkt, cr->residues[i].bit_off, cr->residues[i].bit_len);
+        pos += cr->residues[i].bit_len;
+    }
+
+    const size_t head_bytes = head_bits / 8u;
+    const unsigned shift = (unsigned)(head_bits & 7u);
+    if (head_bytes >= SCHC_HDR_LEN) return SCHC_ENGINE_UNSUPPORTED;
+
+    if (shift == 0) {
+        *out_off = SCHC_HDR_LEN - head_bytes;
+        memcpy(pkt + *out_off, head, head_bytes);
+        *moved = 0;
+    } else {
+        /* Writes stay behind the reads: destination index < source index */
+        *out_off = 0;
+        memcpy(pkt, head, head_bytes + 1);
+        uint8_t* dst = pkt + head_bytes;
+        const uint8_t* src = pkt + SCHC_HDR_LEN;
+        for (size_t i = 0; i < payload_len; i++) {
+            const uint8_t b = src[i];
+            dst[i] |= (uint8_t)(b >> shift);
+            dst[i + 1] = (uint8_t)(b << (8u - shift));
+        }
+        *moved = payload_len != 0;
+    }
+
+    *out_bits = head_bits + payload_len * 8u;
+    return SCHC_ENGINE_OK;
+}
+
+static inline void put_u16_be(uint8_t* p, const uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)(v & 0xFFu);
+}
+
+int32_t schc_engine_rule_id(const schc_engine_t* eng, const uint8_t* in, const size_t in_len) {
+    if (!eng || !in || in_len == 0 || in_len < eng->rule_id_bits / 8u) return -1;
+    return get_rule_id(eng, in);
+}
+
+schc_engine_status schc_engine_decompress(const schc_engine_t* eng,
+                                          const uint8_t* in, const size_t in_len,
+                                          uint8_t* out, const size_t out_cap,
+                                          size_t* out_len) {
+    if (!eng || !eng->by_id || !in || !out || !out_len) return SCHC_ENGINE_KO;
+
+    const size_t id_len = eng->rule_id_bits / 8u;
+    if (in_len < id_len || in_len == 0) return SCHC_ENGINE_KO;
+    const uint16_t rule_id = get_rule_id(eng, in);
+
+    if (rule_id == eng->default_rule_id) {
+        if (in_len - id_len > out_cap) return SCHC_ENGINE_BUF_TOO_SMALL;
+        memcpy(out, in + id_len, in_len - id_len);
+        *out_len = in_len - id_len;
+        return SCHC_ENGINE_OK;
+    }
+
+    const int32_t idx = eng->by_id[rule_id];
+    if (idx < 0) return SCHC_ENGINE_UNKNOWN_RULE;
+
+    const schc_compiled_rule_t* cr = &eng->rules[idx];
+    const size_t head_bits = eng->rule_id_bits + cr->residue_bits;
+    if (in_len * 8u < head_bits) return SCHC_ENGINE_KO;
+
+    /* Anything short of a full byte after the residue is padding */
+    const size_t payload_len = (in_len * 8u - head_bits) / 8u;
+    const size_t total_len = SCHC_HDR_LEN + payload_len;
+    if (total_len > out_cap || payload_len > UINT16_MAX - 8u) return SCHC_ENGINE_BUF_TOO_SMALL;
+
+    memcpy(out, cr->rebuild, SCHC_HDR_LEN);
+
+    size_t pos = eng->rule_id_bits;
+    for (uint8_t i = 0; i < cr->nb_residues; i++) {
+        const schc_residue_t* r = &cr->residues[i];
+        /* Sent fields are zero in the template, so the residue can be OR-ed in */
+        append_bits(out, r->bit_off, in, pos, r->bit_len);
+        pos += r->bit_len;
+    }
+
+    const uint8_t* src = in + (pos >> 3);
+    const unsigned shift = (unsigned)(pos & 7u);
+    uint8_t* payload = out + SCHC_HDR_LEN;
+    if (shift == 0) {
+        memcpy(payload, src, payload_len);
+    } else {
+        for (size_t i = 0; i < payload_len; i++) {
+            payload[i] = (uint8_t)((src[i] << shift) | (src[i + 1] >> (8u - shift)));
+        }
+    }
+
+    const uint16_t udp_len = (uint16_t)(8u + payload_len);
+    if (cr->compute & SCHC_COMPUTE_IPV6_LEN) put_u16_be(&out[4], udp_len);
+    if (cr->compute & SCHC_COMPUTE_UDP_LEN) put_u16_be(&out[44], udp_len);
+    if (cr->compute & SCHC_COMPUTE_UDP_CSUM) put_u16_be(&out[46], ipv6_udp_checksum(out, total_len));
+
+    *out_len = total_len;
+    return SCHC_ENGINE_OK;
+}
@@ -0,0 +1,635 @@
+#include "schc_rule_json.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <schc_sdk/schccomp.h>
+
+/*
+ * Two passes: the text is parsed into a flat array of nodes (values keep
+ * pointers into the text, nothing is unescaped), then the rule set is read
+ * from the nodes into one allocation.
+ */
+
+#define MAX_DEPTH 32
+#define MAX_TV_BYTES 8      /* widest field the compressor knows: a 64-bit prefix or IID */
+
+typedef enum { J_NULL, J_BOOL, J_NUM, J_STR, J_ARR, J_OBJ } jtype_t;
+
+typedef struct {
+    jtype_t type;
+    const char* s;          /* string contents without the quotes, or the number's text */
+    size_t len;
+    const char* key;        /* member name when the parent is an object */
+    size_t key_len;
+    size_t line;
+    int32_t child;          /* first element or member, -1 if none */
+    int32_t next;           /* next sibling, -1 if last */
+} jnode_t;
+
+typedef struct {
+    const char* p;
+    const char* end;
+    size_t line;
+    jnode_t* nodes;
+    size_t nb_nodes;
+    size_t cap;
+    char* err;
+    size_t err_cap;
+    size_t err_line;
+} jparser_t;
+
+static void fail(jparser_t* jp, const size_t line, const char* fmt, ...) {
+    jp->err_line = line;
+    if (!jp->err || !jp->err_cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(jp->err, jp->err_cap, fmt, ap);
+    va_end(ap);
+}
+
+static void skip_ws(jparser_t* jp) {
+    while (jp->p < jp->end && (*jp->p == ' ' || *jp->p == '\t' || *jp->p == '\r' || *jp->p == '\n')) {
+        if (*jp->p == '\n') jp->line++;
+        jp->p++;
+    }
+}
+
+static int32_t new_node(jparser_t* jp, const jtype_t type) {
+    if (jp->nb_nodes == jp->cap) {
+        const size_t cap = jp->cap ? jp->cap * 2 : 256;
+        jnode_t* nodes = realloc(jp->nodes, cap * sizeof(*nodes));
+        if (!nodes || cap > INT32_MAX) return -1;
+        jp->nodes = nodes;
+        jp->cap = cap;
+    }
+    jnode_t* n = &jp->nodes[jp->nb_nodes];
+    memset(n, 0, sizeof(*n));
+    n->type = type;
+    n->line = jp->line;
+    n->child = -1;
+    n->next = -1;
+    return (int32_t) jp->nb_nodes++;
+}
+
+/* String at jp->p (on the opening quote); escapes are checked, not decoded */
+static int scan_string(jparser_t* jp, const char** s, size_t* len) {
+    const char* start = ++jp->p;
+    while (jp->p < jp->end && *jp->p != '"') {
+        if ((unsigned char) *jp->p < 0x20) return -1;
+        if (*jp->p == '\\') {
+            if (++jp->p == jp->end) return -1;
+            if (*jp->p == 'u') {
+                if (jp->end - jp->p < 5) return -1;
+                jp->p += 4;
+            } else if (!strchr("\"\\/bfnrt", *jp->p)) {
+                return -1;
+            }
+        }
+        jp->p++;
+    }
+    if (jp->p == jp->end) return -1;
+    *s = start;
+    *len = (size_t)(jp->p - start);
+    jp->p++;
+    return 0;
+}
+
+static int32_t parse_value(jparser_t* jp, int depth);
+
+static int32_t parse_container(jparser_t* jp, const int depth, const int is_obj) {
+    const int32_t idx = new_node(jp, is_obj ? J_OBJ : J_ARR);
+    if (idx < 0) return -1;
+    const char close = is_obj ? '}' : ']';
+    int32_t last = -1;
+    jp->p++;
+    skip_ws(jp);
+    if (jp->p < jp->end && *jp->p == close) {
+        jp->p++;
+        return idx;
+    }
+    for (;;) {
+        const char* key = NULL;
+        size_t key_len = 0;
+        if (is_obj) {
+            skip_ws(jp);
+            if (jp->p == jp->end || *jp->p != '"' || scan_string(jp, &key, &key_len) != 0) return -1;
+            skip_ws(jp);
+            if (jp->p == jp->end || *jp->p++ != ':') return -1;
+        }
+        const int32_t child = parse_value(jp, depth + 1);
+        if (child < 0) return -1;
+        jp->nodes[child].key = key;
+        jp->nodes[child].key_len = key_len;
+        if (last < 0) jp->nodes[idx].child = child;
+        else jp->nodes[last].next = child;
+        last = child;
+
+        skip_ws(jp);
+        if (jp->p == jp->end) return -1;
+        if (*jp->p == ',') {
+            jp->p++;
+            continue;
+        }
+        if (*jp->p++ != close) return -1;
+        return idx;
+    }
+}
+
+static int32_t parse_value(jparser_t* jp, const int depth) {
+    skip_ws(jp);
+    if (jp->p == jp->end || depth > MAX_DEPTH) return -1;
+
+    const char c = *jp->p;
+    if (c == '{' || c == '[') return parse_container(jp, depth, c == '{');
+
+    if (c == '"') {
+        const int32_t idx = new_node(jp, J_STR);
+        if (idx < 0 || scan_string(jp, &jp->nodes[idx].s, &jp->nodes[idx].len) != 0) return -1;
+        return idx;
+    }
+
+    static const struct { const char* word; jtype_t type; } words[] = {
+        { "true", J_BOOL }, { "false", J_BOOL }, { "null", J_NULL },
+    };
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        const size_t n = strlen(words[i].word);
+        if ((size_t)(jp->end - jp->p) >= n && memcmp(jp->p, words[i].word, n) == 0) {
+            const int32_t idx = new_node(jp, words[i].type);
+            if (idx < 0) return -1;
+            jp->nodes[idx].s = jp->p;
+            jp->nodes[idx].len = n;
+            jp->p += n;
+            return idx;
+        }
+    }
+
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        const int32_t idx = new_node(jp, J_NUM);
+        if (idx < 0) return -1;
+        const char* start = jp->p;
+        while (jp->p < jp->end && strchr("0123456789+-.eE", *jp->p)) jp->p++;
+        jp->nodes[idx].s = start;
+        jp->nodes[idx].len = (size_t)(jp->p - start);
+        return idx;
+    }
+    return -1;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Rule set                                                                  */
+/* ------------------------------------------------------------------------ */
+
+/* Names and identities may carry a module prefix: "ietf-schc:rule" */
+static int name_is(const char* s, size_t len, const char* name) {
+    const char* colon = memchr(s, ':', len);
+    if (colon) {
+        len -= (size_t)(colon + 1 - s);
+        s = colon + 1;
+    }
+    return strlen(name) == len && memcmp(s, name, len) == 0;
+}
+
+static const jnode_t* member(const jparser_t* jp, const jnode_t* obj, const char* name) {
+    if (!obj || obj->type != J_OBJ) return NULL;
+    for (int32_t i = obj->child; i >= 0; i = jp->nodes[i].next) {
+        if (name_is(jp->nodes[i].key, jp->nodes[i].key_len, name)) return &jp->nodes[i];
+    }
+    return NULL;
+}
+
+static const jnode_t* first(const jparser_t* jp, const jnode_t* n) {
+    return n && n->child >= 0 ? &jp->nodes[n->child] : NULL;
+}
+
+static const jnode_t* next(const jparser_t* jp, const jnode_t* n) {
+    return n->next >= 0 ? &jp->nodes[n->next] : NULL;
+}
+
+/* YANG JSON encodes up to 32-bit integers as numbers and 64-bit ones as strings */
+static int get_uint(const jnode_t* n, const uint32_t max, uint32_t* v) {
+    if (!n || (n->type != J_NUM && n->type != J_STR) || n->len == 0 || n->len > 10) return -1;
+    uint64_t x = 0;
+    for (size_t i = 0; i < n->len; i++) {
+        if (n->s[i] < '0' || n->s[i] > '9') return -1;
+        x = x * 10 + (uint64_t)(n->s[i] - '0');
+    }
+    if (x > max) return -1;
+    *v = (uint32_t) x;
+    return 0;
+}
+
+typedef struct {
+    const char* name;
+    int value;
+} ident_t;
+
+static int lookup(const jnode_t* n, const ident_t* table, const size_t count, int* value) {
+    if (!n || n->type != J_STR) return -1;
+    for (size_t i = 0; i < count; i++) {
+        if (name_is(n->s, n->len, table[i].name)) {
+            *value = table[i].value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+#define LOOKUP(n, table, value) lookup(n, table, sizeof(table) / sizeof(table[0]), value)
+
+static const ident_t fids[] = {
+    { "fid-ipv6-version", FID_IPV6_VERSION },
+    { "fid-ipv6-trafficclass", FID_IPV6_TRAFFIC_CLASS },
+    { "fid-ipv6-flowlabel", FID_IPV6_FLOW_LABEL },
+    { "fid-ipv6-payload-length", FID_IPV6_PAYLOAD_LENGTH },
+    { "fid-ipv6-nextheader", FID_IPV6_NEXT_HEADER },
+    { "fid-ipv6-hoplimit", FID_IPV6_HOP_LIMIT },
+    { "fid-ipv6-devprefix", FID_IPV6_PREFIX_DEV },
+    { "fid-ipv6-deviid", FID_IPV6_IID_DEV },
+    { "fid-ipv6-appprefix", FID_IPV6_PREFIX_APP },
+    { "fid-ipv6-appiid", FID_IPV6_IID_APP },
+    { "fid-udp-dev-port", FID_UDP_PORT_DEV },
+    { "fid-udp-app-port", FID_UDP_PORT_APP },
+    { "fid-udp-length", FID_UDP_LENGTH },
+    { "fid-udp-checksum", FID_UDP_CHECKSUM },
+};
+
+static const ident_t mos[] = {
+    { "mo-equal", MO_EQUAL },
+    { "mo-ignore", MO_IGNORE },
+    { "mo-msb", MO_MSB },
+    { "mo-match-mapping", MO_MATCH_MAPPING },
+};
+
+/* -1: cda-compute, which RFC 9363 resolves by field */
+static const ident_t cdas[] = {
+    { "cda-not-sent", CDA_NOT_SENT },
+    { "cda-value-sent", CDA_VALUE_SENT },
+    { "cda-mapping-sent", CDA_MAPPING_SENT },
+    { "cda-lsb", CDA_LSB },
+    { "cda-compute", -1 },
+    { "cda-compute-length", CDA_COMPUTE_LENGTH },
+    { "cda-compute-checksum", CDA_COMPUTE_CHECKSUM },
+    { "cda-deviid", CDA_DEVIID },
+    { "cda-appiid", CDA_APPIID },
+};
+
+enum { DI_BI, DI_UP, DI_DOWN };
+static const ident_t dis[] = {
+    { "di-bidirectional", DI_BI },
+    { "di-up", DI_UP },
+    { "di-down", DI_DOWN },
+};
+
+enum { NATURE_COMP, NATURE_NO_COMP, NATURE_FRAG };
+static const ident_t natures[] = {
+    { "nature-compression", NATURE_COMP },
+    { "nature-no-compression", NATURE_NO_COMP },
+    { "nature-fragmentation", NATURE_FRAG },
+};
+
+static int b64_val(const char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/* Returns the number of bytes decoded into out, -1 if invalid or longer than cap */
+static int b64_decode(const char* s, size_t len, uint8_t* out, const size_t cap) {
+    while (len && s[len - 1] == '=') len--;
+    size_t n = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < len; i++) {
+        const int v = b64_val(s[i]);
+        if (v < 0) return -1;
+        acc = acc << 6 | (uint32_t) v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n == cap) return -1;
+            out[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    return (int) n;
+}
+
+static int target_value_raw(const jnode_t* n, uint8_t* raw, const size_t cap) {
+    return n && n->type == J_STR ? b64_decode(n->s, n->len, raw, cap) : -1;
+}
+
+/*
+ * Target values are binary, right-aligned: the last bit of the value is the
+ * last bit of the field. The compressor wants them MSB-first from the first
+ * bit of the field, left-aligned in tv.
+ */
+static int target_value(const jnode_t* n, const uint16_t len, uint8_t tv[MAX_TV_BYTES]) {
+    uint8_t raw[MAX_TV_BYTES];
+    const int nb = target_value_raw(n, raw, sizeof(raw));
+    if (nb < 0) return -1;
+    memset(tv, 0, MAX_TV_BYTES);
+    const size_t raw_bits = (size_t) nb * 8u;
+    for (size_t b = 0; b < len; b++) {
+        /* bit b of the field is bit raw_bits - len + b of raw, or a leading zero */
+        if (b + raw_bits < len) continue;
+        const size_t src = raw_bits - len + b;
+        if (raw[src / 8] & (0x80u >> (src % 8))) tv[b / 8] |= (uint8_t)(0x80u >> (b % 8));
+    }
+    /* Anything left of the field must be zero */
+    for (size_t b = 0; b + len < raw_bits; b++) {
+        if (raw[b / 8] & (0x80u >> (b % 8))) return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    schc_rule_desc_t* rules;
+    schc_field_desc_t* fields;
+    uint8_t (*tvs)[MAX_TV_BYTES];
+    size_t nb_rules;
+    size_t nb_fields;
+} set_builder_t;
+
+static schc_rule_json_status read_entry(jparser_t* jp, const jnode_t* e, set_builder_t* sb, int* used) {
+    int fid, mo, cda, di = DI_BI;
+    uint32_t len;
+    *used = 0;
+    if (LOOKUP(member(jp, e, "field-id"), fids, &fid) != 0) {
+        fail(jp, e->line, "unknown or missing field-id");
+        return SCHC_RULE_JSON_INVALID;
+    }
+    const jnode_t* di_node = member(jp, e, "direction-indicator");
+    if (di_node && LOOKUP(di_node, dis, &di) != 0) {
+        fail(jp, e->line, "unknown direction-indicator");
+        return SCHC_RULE_JSON_INVALID;
+    }
+    if (di == DI_DOWN) return SCHC_RULE_JSON_OK;   /* only the uplink is compressed */
+
+    uint32_t pos = 1;
+    const jnode_t* pos_node = member(jp, e, "field-position");
+    if (pos_node && (get_uint(pos_node, UINT8_MAX, &pos) != 0 || pos != 1)) {
+        fail(jp, e->line, "only field-position 1 is supported");
+        return SCHC_RULE_JSON_INVALID;
+    }
+    if (get_uint(member(jp, e, "field-length"), MAX_TV_BYTES * 8u, &len) != 0 || len == 0) {
+        fail(jp, e->line, "field-length must be a number of bits up to %u", MAX_TV_BYTES * 8u);
+        return SCHC_RULE_JSON_INVALID;
+    }
+    if (LOOKUP(member(jp, e, "matching-operator"), mos, &mo) != 0) {
+        fail(jp, e->line, "unknown or missing matching-operator");
+        return SCHC_RULE_JSON_INVALID;
+    }
+    if (LOOKUP(member(jp, e, "comp-decomp-action"), cdas, &cda) != 0) {
+        fail(jp, e->line, "unknown or missing comp-decomp-action");
+        return SCHC_RULE_JSON_INVALID;
+    }
+    if (cda < 0) {
+        cda = fid == FID_UDP_CHECKSUM ? CDA_COMPUTE_CHECKSUM : CDA_COMPUTE_LENGTH;
+    }
+
+    schc_field_desc_t* f = &sb->fields[sb->nb_fields];
+    f->fid = (uint8_t) fid;
+    f->len = (uint16_t) len;
+    f->mo = (uint8_t) mo;
+    f->cda = (uint8_t) cda;
+    f->tv = NULL;
+
+    /* The first target value (index 0); mapping lists are left to the SDK */
+    const jnode_t* tvs = member(jp, e, "target-value");
+    if (tvs && tvs->type == J_ARR && first(jp, tvs)) {
+        const jnode_t* v = first(jp, tvs);
+        for (const jnode_t* i = v; i; i = next(jp, i)) {
+            uint32_t index;
+            if (get_uint(member(jp, i, "index"), UINT16_MAX, &index) == 0 && index == 0) v = i;
+        }
+        if (target_value(member(jp, v, "value"), f->len, sb->tvs[sb->nb_fields]) != 0) {
+            fail(jp, v->line, "target-value must be base64 and fit in %u bits", len);
+            return SCHC_RULE_JSON_INVALID;
+        }
+        f->tv = sb->tvs[sb->nb_fields];
+    }
+
+    /* MSB(x): x is the first matching-operator-value, a binary number */
+    if (mo == MO_MSB) {
+        const jnode_t* mov = member(jp, e, "matching-operator-value");
+        const jnode_t* v = mov && mov->type == J_ARR ? first(jp, mov) : NULL;
+        uint8_t raw[2];
+        const int nb = v ? target_value_raw(member(jp, v, "value"), raw, sizeof(raw)) : -1;
+        const uint32_t msb = nb == 2 ? (uint32_t) raw[0] << 8 | raw[1] : nb == 1 ? raw[0] : UINT32_MAX;
+        if (msb > len || !f->tv) {
+            fail(jp, e->line, "mo-msb needs a target-value and a matching-operator-value up to %u", len);
+            return SCHC_RULE_JSON_INVALID;
+        }
+        f->msb_len = (uint8_t) msb;
+    }
+    sb->nb_fields++;
+    *used = 1;
+    return SCHC_RULE_JSON_OK;
+}
+
+static schc_rule_json_status read_rules(jparser_t* jp, const jnode_t* list, schc_rule_set_t* set) {
+    /* Upper bounds first, so everything fits in one block */
+    size_t max_rules = 0, max_fields = 0;
+    for (const jnode_t* r = first(jp, list); r; r = next(jp, r)) {
+        max_rules++;
+        const jnode_t* entries = member(jp, r, "entry");
+        for (const jnode_t* e = entries ? first(jp, entries) : NULL; e; e = next(jp, e)) max_fields++;
+    }
+
+    const size_t rules_len = max_rules * sizeof(schc_rule_desc_t);
+    const size_t fields_len = max_fields * sizeof(schc_field_desc_t);
+    uint8_t* block = calloc(1, rules_len + fields_len + max_fields * MAX_TV_BYTES + 1);
+    if (!block) return SCHC_RULE_JSON_NO_MEM;
+    set_builder_t sb = {
+        .rules = (schc_rule_desc_t*) block,
+        .fields = (schc_field_desc_t*)(block + rules_len),
+        .tvs = (uint8_t (*)[MAX_TV_BYTES])(block + rules_len + fields_len),
+    };
+
+    int have_default = 0;
+    uint32_t max_id_len = 0;
+    schc_rule_json_status st = SCHC_RULE_JSON_OK;
+    for (const jnode_t* r = first(jp, list); r && st == SCHC_RULE_JSON_OK; r = next(jp, r)) {
+        uint32_t id, id_len;
+        int nature = NATURE_COMP;
+        if (get_uint(member(jp, r, "rule-id-length"), SCHC_RULE_ID_MAX_BITS, &id_len) != 0 || id_len == 0 ||
+            get_uint(member(jp, r, "rule-id-value"), (1u << id_len) - 1u, &id) != 0) {
+            fail(jp, r->line, "rule-id-value must fit in rule-id-length, at most %u bits", SCHC_RULE_ID_MAX_BITS);
+            st = SCHC_RULE_JSON_INVALID;
+            break;
+        }
+        const jnode_t* nature_node = member(jp, r, "rule-nature");
+        if (nature_node && LOOKUP(nature_node, natures, &nature) != 0) {
+            fail(jp, r->line, "unknown rule-nature");
+            st = SCHC_RULE_JSON_INVALID;
+            break;
+        }
+        if (nature == NATURE_FRAG) continue;   /* fragmentation has its own rule IDs, see schc_frag.h */
+        if (id_len > max_id_len) max_id_len = id_len;
+        if (nature == NATURE_NO_COMP) {
+            if (have_default) {
+                fail(jp, r->line, "more than one no-compression rule");
+                st = SCHC_RULE_JSON_INVALID;
+            }
+            set->default_rule_id = (uint16_t) id;
+            have_default = 1;
+            continue;
+        }
+
+        schc_rule_desc_t* rd = &sb.rules[sb.nb_rules];
+        rd->rule_id = (uint16_t) id;
+        rd->fields = &sb.fields[sb.nb_fields];
+        const jnode_t* entries = member(jp, r, "entry");
+        for (const jnode_t* e = entries ? first(jp, entries) : NULL; e; e = next(jp, e)) {
+            int used;
+            if ((st = read_entry(jp, e, &sb, &used)) != SCHC_RULE_JSON_OK) break;
+            if (used && ++rd->nb_fields > SCHC_MAX_RULE_FIELDS) {
+                fail(jp, e->line, "more than %u fields in rule %u", SCHC_MAX_RULE_FIELDS, id);
+                st = SCHC_RULE_JSON_INVALID;
+                break;
+            }
+        }
+        sb.nb_rules++;
+    }
+    if (st == SCHC_RULE_JSON_OK && !have_default) {
+        fail(jp, list->line, "no rule of nature no-compression");
+        st = SCHC_RULE_JSON_INVALID;
+    }
+    if (st != SCHC_RULE_JSON_OK) {
+        free(block);
+        return st;
+    }
+
+    set->rules = sb.rules;
+    set->nb_rules = sb.nb_rules;
+    set->rule_id_bits = max_id_len <= 8 ? 8 : 16;
+    set->storage = block;
+    return SCHC_RULE_JSON_OK;
+}
+
+schc_rule_json_status schc_rule_json_parse(const char* json, const size_t len, schc_rule_set_t* set,
+                                           size_t* err_line, char* err_msg, const size_t err_cap) {
+    if (!json || !set) return SCHC_RULE_JSON_INVALID;
+    memset(set, 0, sizeof(*set));
+    if (err_msg && err_cap) err_msg[0] = '\0';
+
+    jparser_t jp = { .p = json, .end = json + len, .line = 1, .err = err_msg, .err_cap = err_cap };
+    schc_rule_json_status st = SCHC_RULE_JSON_OK;
+    const int32_t root = parse_value(&jp, 0);
+    skip_ws(&jp);
+    if (root < 0 || jp.p != jp.end) {
+        fail(&jp, jp.line, "JSON syntax error");
+        st = SCHC_RULE_JSON_SYNTAX;
+    } else {
+        /* {"ietf-schc:schc": {"rule": [...]}}, or the inner object alone */
+        const jnode_t* top = &jp.nodes[root];
+        const jnode_t* schc = member(&jp, top, "schc");
+        const jnode_t* list = member(&jp, schc ? schc : top, "rule");
+        if (!list || list->type != J_ARR) {
+            fail(&jp, top->line, "no \"ietf-schc:schc\" rule list");
+            st = SCHC_RULE_JSON_INVALID;
+        } else {
+            st = read_rules(&jp, list, set);
+        }
+    }
+
+    if (err_line) *err_line = jp.err_line;
+    free(jp.nodes);
+    return st;
+}
+
+void schc_rule_set_free(schc_rule_set_t* set) {
+    if (!set) return;
+    free(set->storage);
+    memset(set, 0, sizeof(*set));
+}
+
+/* ------------------------------------------------------------------------ */
+/* Writer                                                                    */
+/* ------------------------------------------------------------------------ */
+
+static const char* ident_name(const ident_t* table, const size_t count, const int value) {
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].value == value) return table[i].name;
+    }
+    return NULL;
+}
+
+#define NAME(table, value) ident_name(table, sizeof(table) / sizeof(table[0]), value)
+
+static void b64_encode(const uint8_t* in, const size_t len, char* out) {
+    static const char abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        const uint32_t v = (uint32_t) in[i] << 16 | (i + 1 < len ? (uint32_t) in[i + 1] << 8 : 0) |
+                           (i + 2 < len ? in[i + 2] : 0);
+        out[o++] = abc[v >> 18 & 63];
+        out[o++] = abc[v >> 12 & 63];
+        out[o++] = i + 1 < len ? abc[v >> 6 & 63] : '=';
+        out[o++] = i + 2 < len ? abc[v & 63] : '=';
+    }
+    out[o] = '\0';
+}
+
+/* The reverse of target_value(): right-aligned in the fewest bytes */
+static void write_tv(FILE* f, const uint8_t* tv, const uint16_t len) {
+    uint8_t raw[MAX_TV_BYTES] = {0};
+    const size_t nb = (len + 7u) / 8u;
+    const size_t pad = nb * 8u - len;
+    for (size_t b = 0; b < len; b++) {
+        if (tv[b / 8] & (0x80u >> (b % 8))) raw[(b + pad) / 8] |= (uint8_t)(0x80u >> ((b + pad) % 8));
+    }
+    char text[2 * MAX_TV_BYTES + 4];
+    b64_encode(raw, nb, text);
+    fprintf(f, "[{ \"index\": 0, \"value\": \"%s\" }]", text);
+}
+
+static void write_rule_head(FILE* f, const uint16_t id, const uint8_t id_bits, const char* nature) {
+    fprintf(f, "      {\n        \"rule-id-value\": %u,\n        \"rule-id-length\": %u,\n"
+               "        \"rule-nature\": \"ietf-schc:%s\"", id, id_bits, nature);
+}
+
+schc_rule_json_status schc_rule_json_write(FILE* f, const schc_rule_set_t* set) {
+    if (!f || !set || (set->nb_rules && !set->rules)) return SCHC_RULE_JSON_INVALID;
+
+    fputs("{\n  \"ietf-schc:schc\": {\n    \"rule\": [\n", f);
+    for (size_t r = 0; r < set->nb_rules; r++) {
+        const schc_rule_desc_t* rd = &set->rules[r];
+        write_rule_head(f, rd->rule_id, set->rule_id_bits, "nature-compression");
+        fputs(",\n        \"entry\": [\n", f);
+        for (uint8_t i = 0; i < rd->nb_fields; i++) {
+            const schc_field_desc_t* fd = &rd->fields[i];
+            const char* fid = NAME(fids, fd->fid);
+            const char* mo = NAME(mos, fd->mo);
+            const char* cda = NAME(cdas, fd->cda);
+            if (!fid || !mo || !cda || fd->len > MAX_TV_BYTES * 8u) return SCHC_RULE_JSON_INVALID;
+
+            fprintf(f, "          {\n            \"field-id\": \"ietf-schc:%s\",\n"
+                       "            \"field-length\": %u,\n            \"field-position\": 1,\n"
+                       "            \"direction-indicator\": \"ietf-schc:di-bidirectional\",\n", fid, fd->len);
+            if (fd->tv) {
+                fputs("            \"target-value\": ", f);
+                write_tv(f, fd->tv, fd->len);
+                fputs(",\n", f);
+            }
+            fprintf(f, "            \"matching-operator\": \"ietf-schc:%s\",\n", mo);
+            if (fd->mo == MO_MSB) {
+                const uint8_t x = fd->msb_len;
+                fputs("            \"matching-operator-value\": ", f);
+                write_tv(f, &x, 8);
+                fputs(",\n", f);
+            }
+            fprintf(f, "            \"comp-decomp-action\": \"ietf-schc:%s\"\n          }%s\n", cda,
+                    i + 1 < rd->nb_fields ? "," : "");
+        }
+        fputs("        ]\n      },\n", f);
+    }
+    write_rule_head(f, set->default_rule_id, set->rule_id_bits, "nature-no-compression");
+    fputs("\n      }\n    ]\n  }\n}\n", f);
+    return ferror(f) ? SCHC_RULE_JSON_NO_MEM : SCHC_RULE_JSON_OK;
+}
@@ -1,31 +1,50 @@
 #include "schc_service.h"
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include <schc_sdk/fullsdknet.h>
 #include <schc_sdk/schccomp.h>
 
+#include "async_log.h"
 #include "l2/l2.h"
 #include "logger_helper.h"
+#include "schc_frag.h"
+#include "schc_profiler.h"
+#include "schc_rule_engine.h"
 
 #define NB_RULES 1
 #define NO_COMP_RULE_ID 150
 #define IPV6_UDP_RULE_ID 28
 
 
-static uint8_t dev_ip[16] = {
+/* Target values of the built-in rule; never written */
+static const uint8_t k_dev_ip[16] = {
     0x20,0x01,0x0d,0xb8, 0x00,0x00,0x00,0x01,
     0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x01
 };
 
-static uint8_t app_ip[16] = {
+static const uint8_t k_app_ip[16] = {
     0x20,0x01,0x0d,0xb8, 0x00,0x00,0x00,0x02,
     0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x02
 };
 
-static uint8_t dev_port[2] = { 0x12, 0x34 };
-static uint8_t app_port[2] = { 0x56, 0x78 };
+static const uint8_t k_dev_port[2] = { 0x12, 0x34 };
+static const uint8_t k_app_port[2] = { 0x56, 0x78 };
+
+/*
+ * Addresses and ports the application sends from and to: those the current
+ * rules compress best. Refreshed from every rule set published, under
+ * g_writer_lock.
+ */
+static uint8_t dev_ip[16];
+static uint8_t app_ip[16];
+static uint8_t dev_port[2];
+static uint8_t app_port[2];
 
 /* These must match your rule if you want exact byte recovery */
 static const uint8_t  k_ipv6_hop_limit = 255;
@@ -34,6 +53,31 @@ static const uint32_t k_ipv6_flow_label = 0; /* 20-bit value */
 /* -------------------------------------------------------------------------- */
 
 static rules_t *g_rules = NULL;
+static comp_callbacks_t g_cb = {0};
+
+/*
+ * Rules the compressor works with. A set is published whole through g_set
+ * and never modified afterwards: replacing the rules builds a new set and
+ * swaps the pointer (see the reclamation section below).
+ */
+typedef struct {
+    schc_engine_t engine;       /* compiled rules; used instead of schc_compress when possible */
+    bool fast_path;
+    bool sdk_rules_match;       /* false for any other rules than the built-in one: g_rules is then only the SDK fallback's */
+    bool from_image;
+    uint16_t default_rule_id;   /* no-compression rule, in front of the uncompressed packet */
+    uint8_t rule_id_bits;
+} rule_set_t;
+
+static _Atomic(rule_set_t *) g_set = NULL;
+
+static void adopt_rule_context(const rule_set_t *set);
+
+/* Serializes whoever replaces the rules; compressing never takes it */
+static pthread_mutex_t g_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Rule image the rules come from, empty for the built-in rule; under g_writer_lock */
+static char g_rule_file[256] = "";
 
 static bool mocked_ext_compress(bit_buffer_t *output_bb_ptr, bit_string_t *input_bs_ptr)
 {
@@ -51,59 +95,63 @@ static bool mocked_ext_decompress(bit_buffer_t *p_out_data, bit_buffer_t *p_in_d
 
 
 
-rules_t *tpl_get_template_rules(void)
-{
-    /* ===================== IPv6 / UDP RULE ===================== */
-
-    static uint8_t ipv6_version = 0x60;
-    static target_value_t ipv6_version_tv = { TV_BIT_STRING, {{&ipv6_version, 0, 4}} };
-
-    static uint8_t ipv6_tc = 0;
-    static target_value_t ipv6_tc_tv = { TV_BIT_STRING, {{&ipv6_tc, 0, 8}} };
-
-    static uint8_t ipv6_fl[] = {0,0,0};
-    static target_value_t ipv6_fl_tv = { TV_BIT_STRING, {{ipv6_fl, 0, 20}} };
-
-    static uint8_t ipv6_nh = 17;
-    static target_value_t ipv6_nh_tv = { TV_BIT_STRING, {{&ipv6_nh, 0, 8}} };
-
-    static uint8_t ipv6_hl = 255;
-    static target_value_t ipv6_hl_tv = { TV_BIT_STRING, {{&ipv6_hl, 0, 8}} };
+/* ===================== IPv6 / UDP RULE ===================== */
+
+static const uint8_t ipv6_version = 0x60;
+static const uint8_t ipv6_tc = 0;
+static const uint8_t ipv6_fl[] = {0,0,0};
+static const uint8_t ipv6_nh = 17;
+static const uint8_t ipv6_hl = 255;
+
+static const schc_field_desc_t ipv6udp_fields[] = {
+    { FID_IPV6_VERSION,        4,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_version, 0 },
+    { FID_IPV6_TRAFFIC_CLASS,  8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_tc, 0 },
+    { FID_IPV6_FLOW_LABEL,     20, MO_IGNORE, CDA_NOT_SENT,         ipv6_fl, 0 },
+    { FID_IPV6_PAYLOAD_LENGTH, 16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+    { FID_IPV6_NEXT_HEADER,    8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_nh, 0 },
+    { FID_IPV6_HOP_LIMIT,      8,  MO_IGNORE, CDA_NOT_SENT,         &ipv6_hl, 0 },
+    { FID_IPV6_PREFIX_DEV,     64, MO_EQUAL,  CDA_NOT_SENT,         k_dev_ip, 0 },
+    { FID_IPV6_IID_DEV,        64, MO_EQUAL,  CDA_NOT_SENT,         k_dev_ip + 8, 0 },
+    { FID_IPV6_PREFIX_APP,     64, MO_EQUAL,  CDA_NOT_SENT,         k_app_ip, 0 },
+    { FID_IPV6_IID_APP,        64, MO_EQUAL,  CDA_NOT_SENT,         k_app_ip + 8, 0 },
+    { FID_UDP_PORT_DEV,        16, MO_EQUAL,  CDA_NOT_SENT,         k_dev_port, 0 },
+    { FID_UDP_PORT_APP,        16, MO_EQUAL,  CDA_NOT_SENT,         k_app_port, 0 },
+    { FID_UDP_LENGTH,          16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+    { FID_UDP_CHECKSUM,        16, MO_IGNORE, CDA_COMPUTE_CHECKSUM, NULL, 0 },
+};
 
-    static target_value_t dev_pref_tv = { TV_BIT_STRING, {{dev_ip, 0, 64}} };
-    static target_value_t dev_iid_tv  = { TV_BIT_STRING, {{dev_ip + 8, 0, 64}} };
-    static target_value_t app_pref_tv = { TV_BIT_STRING, {{app_ip, 0, 64}} };
-    static target_value_t app_iid_tv  = { TV_BIT_STRING, {{app_ip + 8, 0, 64}} };
+#define IPV6UDP_NB_FIELDS (sizeof(ipv6udp_fields) / sizeof(ipv6udp_fields[0]))
 
-    static target_value_t dev_port_tv = { TV_BIT_STRING, {{dev_port, 0, 16}} };
-    static target_value_t app_port_tv = { TV_BIT_STRING, {{app_port, 0, 16}} };
+static const schc_rule_desc_t template_rules[NB_RULES] = {
+    { IPV6_UDP_RULE_ID, IPV6UDP_NB_FIELDS, ipv6udp_fields },
+};
 
-    static rule_field_t f0  = { FID_IPV6_VERSION,        1, DIR_BI, &ipv6_version_tv, 4,  MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f1  = { FID_IPV6_TRAFFIC_CLASS,  1, DIR_BI, &ipv6_tc_tv,      8,  MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f2  = { FID_IPV6_FLOW_LABEL,     1, DIR_BI, &ipv6_fl_tv,      20, MO_IGNORE, {0}, CDA_NOT_SENT };
-    static rule_field_t f3  = { FID_IPV6_PAYLOAD_LENGTH, 1, DIR_BI, NULL,             16, MO_IGNORE, {0}, CDA_COMPUTE_LENGTH };
-    static rule_field_t f4  = { FID_IPV6_NEXT_HEADER,    1, DIR_BI, &ipv6_nh_tv,      8,  MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f5  = { FID_IPV6_HOP_LIMIT,      1, DIR_BI, &ipv6_hl_tv,      8,  MO_IGNORE, {0}, CDA_NOT_SENT };
-    static rule_field_t f6  = { FID_IPV6_PREFIX_DEV,     1, DIR_BI, &dev_pref_tv,     64, MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f7  = { FID_IPV6_IID_DEV,        1, DIR_BI, &dev_iid_tv,      64, MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f8  = { FID_IPV6_PREFIX_APP,     1, DIR_BI, &app_pref_tv,     64, MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f9  = { FID_IPV6_IID_APP,        1, DIR_BI, &app_iid_tv,      64, MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f10 = { FID_UDP_PORT_DEV,        1, DIR_BI, &dev_port_tv,     16, MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f11 = { FID_UDP_PORT_APP,        1, DIR_BI, &app_port_tv,     16, MO_EQUAL,  {0}, CDA_NOT_SENT };
-    static rule_field_t f12 = { FID_UDP_LENGTH,          1, DIR_BI, NULL,             16, MO_IGNORE, {0}, CDA_COMPUTE_LENGTH };
-    static rule_field_t f13 = { FID_UDP_CHECKSUM,        1, DIR_BI, NULL,             16, MO_IGNORE, {0}, CDA_COMPUTE_CHECKSUM };
+/* Materialize a rule descriptor as SDK rule fields backed by caller storage */
+static void build_sdk_rule(const schc_rule_desc_t* rd, rule_t* rule, rule_field_t** field_ptrs,
+                           rule_field_t* fields, target_value_t* tvs)
+{
+    init_rule(rule, rd->rule_id, STACK_IPV6_UDP, field_ptrs);
+    for (uint8_t i = 0; i < rd->nb_fields; i++) {
+        const schc_field_desc_t* d = &rd->fields[i];
+        target_value_t* tv = NULL;
+        if (d->tv) {
+            tvs[i] = (target_value_t){ TV_BIT_STRING, {{(uint8_t*)d->tv, 0, d->len}} };
+            tv = &tvs[i];
+        }
+        fields[i] = (rule_field_t){ d->fid, 1, DIR_BI, tv, d->len, d->mo, {d->msb_len}, d->cda };
+        add_rule_field(rule, &fields[i]);
+    }
+}
 
-    static rule_field_t *ipv6udp_fields[14];
+rules_t *tpl_get_template_rules(void)
+{
+    static target_value_t ipv6udp_tvs[IPV6UDP_NB_FIELDS];
+    static rule_field_t ipv6udp_rule_fields[IPV6UDP_NB_FIELDS];
+    static rule_field_t *ipv6udp_fields_ptrs[IPV6UDP_NB_FIELDS];
     static rule_t ipv6udp_rule;
 
-    init_rule(&ipv6udp_rule, IPV6_UDP_RULE_ID, STACK_IPV6_UDP, ipv6udp_fields);
-    add_rule_field(&ipv6udp_rule,&f0);  add_rule_field(&ipv6udp_rule,&f1);
-    add_rule_field(&ipv6udp_rule,&f2);  add_rule_field(&ipv6udp_rule,&f3);
-    add_rule_field(&ipv6udp_rule,&f4);  add_rule_field(&ipv6udp_rule,&f5);
-    add_rule_field(&ipv6udp_rule,&f6);  add_rule_field(&ipv6udp_rule,&f7);
-    add_rule_field(&ipv6udp_rule,&f8);  add_rule_field(&ipv6udp_rule,&f9);
-    add_rule_field(&ipv6udp_rule,&f10); add_rule_field(&ipv6udp_rule,&f11);
-    add_rule_field(&ipv6udp_rule,&f12); add_rule_field(&ipv6udp_rule,&f13);
+    build_sdk_rule(&template_rules[0], &ipv6udp_rule, ipv6udp_fields_ptrs,
+                   ipv6udp_rule_fields, ipv6udp_tvs);
 
     /* ===================== RULE SET ===================== */
 
@@ -116,30 +164,341 @@ rules_t *tpl_get_template_rules(void)
     return &rules;
 }
 
+/* -------------------------------------------------------------------------- */
+/* Epoch-based reclamation of replaced rule sets                              */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * A compressing thread writes the current epoch into its own slot before it
+ * loads g_set, and clears the slot when it is done with the set. Whoever
+ * replaces the set swaps g_set, advances the epoch and then waits until no
+ * slot holds an epoch older than the new one: every thread that may still
+ * use the old set has left it, and it can be freed. Readers never wait.
+ * Threads beyond MAX_READERS share one counter, which only delays writers.
+ */
+#define MAX_READERS 128
+
+/* Compression counters; a slot's are only written by the thread owning it */
+typedef struct {
+    _Atomic uint64_t compressed;
+    _Atomic uint64_t no_comp;
+    _Atomic uint64_t failed;
+} comp_counts_t;
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t epoch;    /* 0: not using any set */
+    atomic_bool used;
+    comp_counts_t counts;
+} reader_slot_t;
+
+static reader_slot_t g_readers[MAX_READERS];
+static _Atomic uint64_t g_epoch = 1;
+static _Atomic uint64_t g_overflow_readers = 0;
+
+/* Counts of the threads without a slot, and of the threads gone */
+static comp_counts_t g_shared_counts;
+
+static pthread_once_t g_reader_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_reader_key;
+static __thread reader_slot_t *t_reader = NULL;
+static __thread bool t_overflow = false;
+
+static void add_counts(comp_counts_t *to, const uint64_t compressed, const uint64_t no_comp, const uint64_t failed)
+{
+    atomic_fetch_add_explicit(&to->compressed, compressed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&to->no_comp, no_comp, memory_order_relaxed);
+    atomic_fetch_add_explicit(&to->failed, failed, memory_order_relaxed);
+}
+
+static void release_reader(void *slot)
+{
+    reader_slot_t *r = slot;
+    comp_counts_t *c = &r->counts;
+    add_counts(&g_shared_counts, atomic_exchange(&c->compressed, 0), atomic_exchange(&c->no_comp, 0),
+               atomic_exchange(&c->failed, 0));
+    atomic_store(&r->used, false);
+}
+
+static void make_reader_key(void)
+{
+    pthread_key_create(&g_reader_key, release_reader);
+}
+
+static reader_slot_t *claim_reader(void)
+{
+    pthread_once(&g_reader_key_once, make_reader_key);
+    for (size_t i = 0; i < MAX_READERS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&g_readers[i].used, &expected, true)) {
+            pthread_setspecific(g_reader_key, &g_readers[i]);
+            return &g_readers[i];
+        }
+    }
+    return NULL;
+}
+
+/* The current set, safe to use until set_leave(); NULL before schc_service_init() */
+static const rule_set_t *set_enter(void)
+{
+    if (!t_reader && !t_overflow) {
+        t_reader = claim_reader();
+        t_overflow = !t_reader;
+    }
+    if (t_reader) {
+        atomic_store(&t_reader->epoch, atomic_load_explicit(&g_epoch, memory_order_relaxed));
+    } else {
+        atomic_fetch_add(&g_overflow_readers, 1);
+    }
+    return atomic_load(&g_set);
+}
+
+static void set_leave(void)
+{
+    if (t_reader) {
+        atomic_store_explicit(&t_reader->epoch, 0, memory_order_release);
+    } else {
+        atomic_fetch_sub_explicit(&g_overflow_readers, 1, memory_order_release);
+    }
+}
+
+static void bump(_Atomic uint64_t *c, const uint64_t n)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+/* After set_enter(): no shared cache line is written unless the thread has no slot */
+static void count_compressions(const uint64_t compressed, const uint64_t no_comp, const uint64_t failed)
+{
+    if (!t_reader) {
+        add_counts(&g_shared_counts, compressed, no_comp, failed);
+        return;
+    }
+    bump(&t_reader->counts.compressed, compressed);
+    bump(&t_reader->counts.no_comp, no_comp);
+    bump(&t_reader->counts.failed, failed);
+}
+
+static void wait_for_readers(void)
+{
+    const uint64_t epoch = atomic_fetch_add(&g_epoch, 1) + 1;
+    for (size_t i = 0; i < MAX_READERS; i++) {
+        uint64_t e;
+        while ((e = atomic_load(&g_readers[i].epoch)) != 0 && e < epoch) sched_yield();
+    }
+    while (atomic_load(&g_overflow_readers) != 0) sched_yield();
+}
+
+static void free_set(rule_set_t *set)
+{
+    if (!set) return;
+    schc_engine_free(&set->engine);
+    free(set);
+}
+
+/* Swap in set and free the previous one once nobody uses it; g_writer_lock held */
+static void publish_set(rule_set_t *set)
+{
+    adopt_rule_context(set);
+    rule_set_t *old = atomic_exchange(&g_set, set);
+    if (!old) return;
+    wait_for_readers();
+    free_set(old);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Building rule sets                                                         */
+/* -------------------------------------------------------------------------- */
+
+/* A compressed packet must never start like a SCHC fragment */
+static bool is_frag_rule_id(const uint16_t rule_id, const uint8_t rule_id_bits)
+{
+    const uint8_t first = (uint8_t)(rule_id >> (rule_id_bits - 8));
+    return first == SCHC_FRAG_NOACK_RULE_ID || first == SCHC_FRAG_ACK_RULE_ID;
+}
+
+/* A field the first rule fixes completely (matched and not sent) */
+static bool rule_fixes(const schc_compiled_rule_t *cr, const size_t byte_off, const size_t len)
+{
+    const uint8_t *mask = (const uint8_t *)cr->mask;
+    for (size_t i = byte_off; i < byte_off + len; i++) {
+        if (mask[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+/*
+ * The application sends what the first rule compresses best: take its
+ * addresses and ports, and the built-in rule's for the fields it leaves open
+ */
+static void adopt_rule_context(const rule_set_t *set)
+{
+    memcpy(dev_ip, k_dev_ip, 16);
+    memcpy(app_ip, k_app_ip, 16);
+    memcpy(dev_port, k_dev_port, 2);
+    memcpy(app_port, k_app_port, 2);
+    if (!set->fast_path || !set->engine.nb_rules) return;
+
+    const schc_compiled_rule_t *cr = &set->engine.rules[0];
+    if (rule_fixes(cr, 8, 16)) memcpy(dev_ip, cr->rebuild + 8, 16);
+    if (rule_fixes(cr, 24, 16)) memcpy(app_ip, cr->rebuild + 24, 16);
+    if (rule_fixes(cr, 40, 2)) memcpy(dev_port, cr->rebuild + 40, 2);
+    if (rule_fixes(cr, 42, 2)) memcpy(app_port, cr->rebuild + 42, 2);
+}
+
+static rule_set_t *builtin_set(void)
+{
+    rule_set_t *set = calloc(1, sizeof(*set));
+    if (!set) return NULL;
+
+    const schc_engine_status est = schc_engine_compile(&set->engine, template_rules, NB_RULES, 8, NO_COMP_RULE_ID);
+    set->fast_path = est == SCHC_ENGINE_OK;
+    if (!set->fast_path) {
+        zlog_warn(error_cat, "SCHC rules not compilable (%d), using SDK compression only", est);
+    }
+    set->sdk_rules_match = true;
+    set->default_rule_id = g_rules->default_rule_id;
+    set->rule_id_bits = 8;
+    return set;
+}
+
+static rule_set_t *image_set(const char *path)
+{
+    rule_set_t *set = calloc(1, sizeof(*set));
+    if (!set) return NULL;
+
+    if (schc_engine_load(&set->engine, path) != SCHC_ENGINE_OK) {
+        zlog_error(error_cat, "SCHC rule image %s missing or invalid", path);
+        free(set);
+        return NULL;
+    }
+    const schc_engine_t *eng = &set->engine;
+    for (size_t i = 0; i <= eng->nb_rules; i++) {
+        const uint16_t id = i < eng->nb_rules ? eng->rules[i].rule_id : eng->default_rule_id;
+        if (is_frag_rule_id(id, eng->rule_id_bits)) {
+            zlog_error(error_cat, "SCHC rule ID %u collides with the fragmentation rules", id);
+            free_set(set);
+            return NULL;
+        }
+    }
+
+    set->fast_path = true;
+    set->from_image = true;
+    set->default_rule_id = eng->default_rule_id;
+    set->rule_id_bits = eng->rule_id_bits;
+    zlog_info(ok_cat, "SCHC rule image %s: %zu rules, %zu distinct masks, %u-bit rule IDs",
+              path, eng->nb_rules, eng->nb_groups, eng->rule_id_bits);
+    return set;
+}
+
+schc_status_t schc_service_set_rule_file(const char *path)
+{
+    if (path && strlen(path) >= sizeof(g_rule_file)) {
+        zlog_error(error_cat, "SCHC rule image path too long");
+        return SCHC_ERR;
+    }
+    pthread_mutex_lock(&g_writer_lock);
+    strcpy(g_rule_file, path ? path : "");
+    pthread_mutex_unlock(&g_writer_lock);
+    return SCHC_OK;
+}
+
 schc_status_t schc_service_init(void)
 {
+    pthread_mutex_lock(&g_writer_lock);
     g_rules = tpl_get_template_rules();
-    return SCHC_OK;
+
+    g_cb.ext_compress   = mocked_ext_compress;
+    g_cb.ext_decompress = mocked_ext_decompress;
+    /* cb.get_dev_iid intentionally not set: IID is fixed in the rule */
+
+    rule_set_t *set = g_rule_file[0] ? image_set(g_rule_file) : builtin_set();
+    if (set) publish_set(set);
+    pthread_mutex_unlock(&g_writer_lock);
+    return set ? SCHC_OK : SCHC_ERR;
 }
 
-schc_status_t schc_service_compress(const uint8_t *in, size_t in_len,
-                                    uint8_t *out, size_t out_cap,
-                                    size_t *out_len)
+schc_status_t schc_service_reload_rules(const char *path)
 {
-    if (!in || !out || !out_len) return SCHC_ERR;
-    if (in_len > UINT16_MAX || out_cap > UINT16_MAX) return SCHC_ERR;
+    if (path && strlen(path) >= sizeof(g_rule_file)) {
+        zlog_error(error_cat, "SCHC rule image path too long");
+        return SCHC_ERR;
+    }
 
+    pthread_mutex_lock(&g_writer_lock);
     if (!g_rules) {
+        pthread_mutex_unlock(&g_writer_lock);
         zlog_error(error_cat, "SCHC is not initialized");
         return SCHC_ERR;
     }
+    const char *source = path ? path : g_rule_file;
+    rule_set_t *set = source[0] ? image_set(source) : builtin_set();
+    if (set) {
+        if (path) strcpy(g_rule_file, path);
+        publish_set(set);
+        zlog_info(ok_cat, "SCHC rules reloaded from %s", source[0] ? source : "the built-in rule");
+    } else {
+        zlog_error(error_cat, "SCHC rules not reloaded, keeping the current ones");
+    }
+    pthread_mutex_unlock(&g_writer_lock);
+    return set ? SCHC_OK : SCHC_ERR;
+}
 
-    uint16_t comp_bits = 0;
+schc_status_t schc_service_set_rules(const schc_rule_desc_t *rules, size_t nb_rules,
+                                     uint8_t rule_id_bits, uint16_t default_rule_id)
+{
+    if (!g_rules) {
+        zlog_error(error_cat, "SCHC is not initialized");
+        return SCHC_ERR;
+    }
+    if (rule_id_bits != 8 && rule_id_bits != 16) {
+        zlog_error(error_cat, "SCHC rule IDs must be 8 or 16 bits, not %u", rule_id_bits);
+        return SCHC_ERR;
+    }
+    for (size_t i = 0; i <= nb_rules; i++) {
+        const uint16_t id = i < nb_rules ? rules[i].rule_id : default_rule_id;
+        if (is_frag_rule_id(id, rule_id_bits)) {
+            zlog_error(error_cat, "SCHC rule ID %u collides with the fragmentation rules", id);
+            return SCHC_ERR;
+        }
+    }
 
-    comp_callbacks_t cb = {0};
-    cb.ext_compress   = mocked_ext_compress;
-    cb.ext_decompress = mocked_ext_decompress;
-    /* cb.get_dev_iid intentionally not set: IID is fixed in the rule */
+    rule_set_t *set = calloc(1, sizeof(*set));
+    if (!set) return SCHC_ERR;
+    const schc_engine_status est = schc_engine_compile(&set->engine, rules, nb_rules, rule_id_bits, default_rule_id);
+    if (est != SCHC_ENGINE_OK) {
+        zlog_error(error_cat, "SCHC rule set not compilable (%d)", est);
+        free(set);
+        return SCHC_ERR;
+    }
+    set->fast_path = true;
+    set->default_rule_id = default_rule_id;
+    set->rule_id_bits = rule_id_bits;
+    zlog_info(ok_cat, "SCHC rule set: %zu rules, %zu distinct masks, %u-bit rule IDs",
+              set->engine.nb_rules, set->engine.nb_groups, rule_id_bits);
+
+    pthread_mutex_lock(&g_writer_lock);
+    publish_set(set);
+    pthread_mutex_unlock(&g_writer_lock);
+    return SCHC_OK;
+}
+
+/* Rule ID of the no-compression rule, big endian; returns its size in bytes */
+static size_t put_default_rule_id(uint8_t *out, const uint16_t rule_id, const uint8_t rule_id_bits)
+{
+    if (rule_id_bits == 16) {
+        out[0] = (uint8_t)(rule_id >> 8);
+        out[1] = (uint8_t)(rule_id & 0xFFu);
+        return 2;
+    }
+    out[0] = (uint8_t)rule_id;
+    return 1;
+}
+
+static schc_status_t sdk_compress(const uint8_t *in, size_t in_len,
+                                  uint8_t *out, size_t out_cap,
+                                  size_t *out_bits)
+{
+    uint16_t comp_bits = 0;
 
     const comp_status_t st = schc_compress(
         g_rules,
@@ -148,26 +507,453 @@ schc_status_t schc_service_compress(const uint8_t *in, size_t in_len,
         &comp_bits,
         (uint8_t *)in,
         (uint16_t)in_len,
-        &cb
+        &g_cb
     );
 
     if (st == COMP_RULES_NOT_FOUND_ERR) {
-        zlog_info(ok_cat, "SCHC rule not found, using no compression rule %d", NO_COMP_RULE_ID);
-        out[0] = g_rules->default_rule_id;
-        memcpy(out + 1, in, in_len);
-        *out_len = in_len + 1;
-        return SCHC_OK;
+        return SCHC_MODE_NOT_AVAILABLE;
     }
 
     if (st != COMP_SUCCESS) {
-        zlog_error(error_cat, "SCHC compress failed: %d", st);
         return SCHC_ERR;
     }
 
+    *out_bits = comp_bits;
+    return SCHC_OK;
+}
+
+static schc_status_t fast_compress(const rule_set_t *rs, const uint8_t *in, size_t in_len,
+                                   uint8_t *out, size_t out_cap,
+                                   size_t *out_bits)
+{
+    const schc_engine_status st = schc_engine_compress(&rs->engine, in, in_len, out, out_cap, out_bits);
+    switch (st) {
+        case SCHC_ENGINE_OK:
+            return SCHC_OK;
+        case SCHC_ENGINE_NO_MATCH:
+            return SCHC_MODE_NOT_AVAILABLE;
+        case SCHC_ENGINE_BUF_TOO_SMALL:
+            return SCHC_BUF_TOO_SMALL;
+        default:
+            return SCHC_ERR;
+    }
+}
+
+/* Differential check: the compiled rules must emit exactly the SDK's bytes; logs and returns false otherwise */
+static bool fast_path_agrees(const uint8_t *in, size_t in_len, schc_status_t fast_st,
+                             const uint8_t *fast_out, size_t fast_bits)
+{
+    static __thread uint8_t sdk_out[UINT16_MAX];
+    size_t sdk_bits = 0;
+
+    const schc_status_t sdk_st = sdk_compress(in, in_len, sdk_out, sizeof(sdk_out), &sdk_bits);
+    if (sdk_st != fast_st && !(fast_st == SCHC_BUF_TOO_SMALL && sdk_st == SCHC_OK)) {
+        zlog_error(error_cat, "SCHC fast path status %d differs from SDK status %d", fast_st, sdk_st);
+        return false;
+    }
+    if (fast_st == SCHC_OK && (sdk_bits != fast_bits || memcmp(sdk_out, fast_out, (fast_bits + 7) / 8) != 0)) {
+        zlog_error(error_cat, "SCHC fast path output differs from SDK (%zu vs %zu bits)", fast_bits, sdk_bits);
+        return false;
+    }
+    return true;
+}
+
+#ifdef SCHC_FAST_PATH_VERIFY
+static void verify_fast_path(const rule_set_t *rs, const uint8_t *in, size_t in_len, schc_status_t fast_st,
+                             const uint8_t *fast_out, size_t fast_bits)
+{
+    if (rs->sdk_rules_match) (void)fast_path_agrees(in, in_len, fast_st, fast_out, fast_bits);
+}
+#endif
+
+/* Compress one packet, falling back to the no-compression rule. Never logs. */
+static schc_status_t compress_one(const rule_set_t *rs, const uint8_t *in, size_t in_len,
+                                  uint8_t *out, size_t out_cap,
+                                  size_t *out_bits, bool *fallback)
+{
+    schc_status_t st;
+    if (rs->fast_path) {
+        st = fast_compress(rs, in, in_len, out, out_cap, out_bits);
+#ifdef SCHC_FAST_PATH_VERIFY
+        verify_fast_path(rs, in, in_len, st, out, *out_bits);
+#endif
+    } else {
+        st = sdk_compress(in, in_len, out, out_cap, out_bits);
+    }
+
+    *fallback = st == SCHC_MODE_NOT_AVAILABLE;
+    if (*fallback) {
+        SCHC_PROFILE_MISS(&rs->engine, in, in_len);
+        const size_t id_len = rs->rule_id_bits / 8u;
+        if (in_len + id_len > out_cap) return SCHC_BUF_TOO_SMALL;
+        put_default_rule_id(out, rs->default_rule_id, rs->rule_id_bits);
+        memcpy(out + id_len, in, in_len);
+        *out_bits = (in_len + id_len) * 8;
+        return SCHC_OK;
+    }
+
+    return st;
+}
+
+schc_status_t schc_service_compress(const uint8_t *in, size_t in_len,
+                                    uint8_t *out, size_t out_cap,
+                                    size_t *out_len)
+{
+    if (!in || !out || !out_len) return SCHC_ERR;
+    if (in_len > UINT16_MAX || out_cap > UINT16_MAX) return SCHC_ERR;
+
+    const rule_set_t *rs = set_enter();
+    if (!rs) {
+        set_leave();
+        zlog_error(error_cat, "SCHC is not initialized");
+        return SCHC_ERR;
+    }
+
+    size_t comp_bits = 0;
+    bool fallback = false;
+    const schc_status_t st = compress_one(rs, in, in_len, out, out_cap, &comp_bits, &fallback);
+    const uint16_t default_rule_id = rs->default_rule_id;
+    set_leave();
+    count_compressions(st == SCHC_OK, st == SCHC_OK && fallback, st != SCHC_OK);
+    if (st != SCHC_OK) {
+        ALOG_ERROR(error_cat, "SCHC compress failed: %d", st);
+        return st;
+    }
+
+    if (fallback) {
+        ALOG_INFO(ok_cat, "SCHC rule not found, using no compression rule %u", default_rule_id);
+    }
+
     *out_len = (comp_bits + 7) / 8;
     return SCHC_OK;
 }
 
+/* In-place compression of pb with a compiled rule set; pb is left as is on failure */
+static schc_status_t engine_compress_pkt(const schc_engine_t *eng, pktbuf_t *pb, size_t *out_bits)
+{
+    size_t off = 0;
+    size_t comp_bits = 0;
+    int moved = 0;
+    const schc_engine_status est = schc_engine_compress_inplace(eng, pktbuf_data(pb), pb->len,
+                                                                &off, &comp_bits, &moved);
+    if (est == SCHC_ENGINE_NO_MATCH) return SCHC_MODE_NOT_AVAILABLE;
+    if (est != SCHC_ENGINE_OK) return SCHC_ERR;
+
+    pktbuf_pull(pb, off);
+    pktbuf_trim(pb, (comp_bits + 7) / 8);
+    pb->copies += moved != 0;
+    *out_bits = comp_bits;
+    return SCHC_OK;
+}
+
+/* schc_service_compress_pkt() with rs held; logs nothing */
+static schc_status_t compress_pkt(const rule_set_t *rs, pktbuf_t *pb)
+{
+    uint8_t *pkt = pktbuf_data(pb);
+    schc_status_t st;
+
+    if (rs->fast_path) {
+#ifdef SCHC_FAST_PATH_VERIFY
+        static __thread uint8_t orig[UINT16_MAX];
+        const size_t orig_len = pb->len;
+        memcpy(orig, pkt, orig_len);
+#endif
+        size_t comp_bits = 0;
+        st = engine_compress_pkt(&rs->engine, pb, &comp_bits);
+#ifdef SCHC_FAST_PATH_VERIFY
+        verify_fast_path(rs, orig, orig_len, st, pktbuf_data(pb), comp_bits);
+#endif
+    } else {
+        /* The SDK cannot work in place: compress aside and copy back */
+        static __thread uint8_t scratch[UINT16_MAX];
+        size_t comp_bits = 0;
+        st = sdk_compress(pkt, pb->len, scratch, sizeof(scratch), &comp_bits);
+        if (st == SCHC_OK) {
+            const size_t comp_len = (comp_bits + 7) / 8;
+            if (comp_len > pb->len + pktbuf_tailroom(pb)) return SCHC_BUF_TOO_SMALL;
+            memcpy(pkt, scratch, comp_len);
+            pb->len = comp_len;
+            pb->copies++;
+        }
+    }
+
+    if (st == SCHC_MODE_NOT_AVAILABLE) {
+        SCHC_PROFILE_MISS(&rs->engine, pkt, pb->len);
+        uint8_t *rule_id = pktbuf_push(pb, rs->rule_id_bits / 8u);
+        if (!rule_id) return SCHC_BUF_TOO_SMALL;
+        put_default_rule_id(rule_id, rs->default_rule_id, rs->rule_id_bits);
+    }
+    return st;
+}
+
+schc_status_t schc_service_compress_pkt(pktbuf_t *pb)
+{
+    if (!pb) return SCHC_ERR;
+    if (pb->len > UINT16_MAX) return SCHC_ERR;
+
+    const rule_set_t *rs = set_enter();
+    if (!rs) {
+        set_leave();
+        zlog_error(error_cat, "SCHC is not initialized");
+        return SCHC_ERR;
+    }
+    const schc_status_t st = compress_pkt(rs, pb);
+    const uint16_t default_rule_id = rs->default_rule_id;
+    set_leave();
+    const bool fallback = st == SCHC_MODE_NOT_AVAILABLE;
+    count_compressions(st == SCHC_OK || fallback, fallback, st != SCHC_OK && !fallback);
+
+    if (st == SCHC_MODE_NOT_AVAILABLE) {
+        ALOG_INFO(ok_cat, "SCHC rule not found, using no compression rule %u", default_rule_id);
+        return SCHC_OK;
+    }
+    if (st != SCHC_OK) {
+        ALOG_ERROR(error_cat, "SCHC compress failed: %d", st);
+    }
+    return st;
+}
+
+size_t schc_service_compress_batch(const schc_cspan_t *in, const schc_span_t *out,
+                                   size_t count,
+                                   schc_status_t *status, size_t *out_bits)
+{
+    if (!in || !out || !status || !out_bits) return 0;
+
+    /* One set for the whole batch: a reload applies from the next batch */
+    const rule_set_t *rs = set_enter();
+    if (!rs) {
+        set_leave();
+        zlog_error(error_cat, "SCHC is not initialized");
+        for (size_t i = 0; i < count; i++) status[i] = SCHC_ERR;
+        return 0;
+    }
+
+    size_t nb_ok = 0;
+    size_t nb_no_comp = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i + 1 < count) __builtin_prefetch(in[i + 1].data);
+
+        out_bits[i] = 0;
+        if (!in[i].data || !out[i].data || in[i].len > UINT16_MAX || out[i].len > UINT16_MAX) {
+            status[i] = SCHC_ERR;
+            continue;
+        }
+
+        bool fallback;
+        status[i] = compress_one(rs, in[i].data, in[i].len, out[i].data, out[i].len, &out_bits[i], &fallback);
+        nb_ok += status[i] == SCHC_OK;
+        nb_no_comp += status[i] == SCHC_OK && fallback;
+    }
+    set_leave();
+    count_compressions(nb_ok, nb_no_comp, count - nb_ok);
+
+    return nb_ok;
+}
+
+schc_status_t schc_service_check_fast_path(const uint8_t *in, size_t in_len)
+{
+    static __thread uint8_t out[UINT16_MAX];
+    static __thread uint8_t storage[PKTBUF_HEADROOM + UINT16_MAX];
+
+    if (!in || in_len > UINT16_MAX - PKTBUF_HEADROOM) return SCHC_ERR;
+
+    const rule_set_t *rs = set_enter();
+    if (!rs || !rs->fast_path || !rs->sdk_rules_match) {
+        set_leave();
+        return SCHC_MODE_NOT_AVAILABLE;
+    }
+
+    size_t comp_bits = 0;
+    schc_status_t st = fast_compress(rs, in, in_len, out, sizeof(out), &comp_bits);
+    bool agrees = fast_path_agrees(in, in_len, st, out, comp_bits);
+
+    pktbuf_t pb;
+    pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+    memcpy(pktbuf_put(&pb, in_len), in, in_len);
+    comp_bits = 0;
+    st = engine_compress_pkt(&rs->engine, &pb, &comp_bits);
+    agrees = fast_path_agrees(in, in_len, st, pktbuf_data(&pb), comp_bits) && agrees;
+    set_leave();
+
+    return agrees ? SCHC_OK : SCHC_ERR;
+}
+
+void schc_service_get_stats(schc_service_stats_t *stats)
+{
+    stats->compressed = atomic_load_explicit(&g_shared_counts.compressed, memory_order_relaxed);
+    stats->no_comp = atomic_load_explicit(&g_shared_counts.no_comp, memory_order_relaxed);
+    stats->failed = atomic_load_explicit(&g_shared_counts.failed, memory_order_relaxed);
+    for (size_t i = 0; i < MAX_READERS; i++) {
+        const comp_counts_t *c = &g_readers[i].counts;
+        stats->compressed += atomic_load_explicit(&c->compressed, memory_order_relaxed);
+        stats->no_comp += atomic_load_explicit(&c->no_comp, memory_order_relaxed);
+        stats->failed += atomic_load_explicit(&c->failed, memory_order_relaxed);
+    }
+}
+
+schc_status_t schc_service_decompress(const uint8_t *in, size_t in_len,
+                                      uint8_t *out, size_t out_cap,
+                                      size_t *out_len)
+{
+    if (!in || !out || !out_len) return SCHC_ERR;
+
+    const rule_set_t *rs = set_enter();
+    if (!rs) {
+        set_leave();
+        zlog_error(error_cat, "SCHC is not initialized");
+        return SCHC_ERR;
+    }
+
+    if (!rs->fast_path) {
+        set_leave();
+        zlog_error(error_cat, "SCHC decompression needs compiled rules");
+        return SCHC_MODE_NOT_AVAILABLE;
+    }
+
+    const schc_engine_status st = schc_engine_decompress(&rs->engine, in, in_len, out, out_cap, out_len);
+    /* 8 or 16 bits, as the rule set reads it */
+    const int32_t rule_id = st == SCHC_ENGINE_UNKNOWN_RULE ? schc_engine_rule_id(&rs->engine, in, in_len) : -1;
+    set_leave();
+    switch (st) {
+        case SCHC_ENGINE_OK:
+            return SCHC_OK;
+        case SCHC_ENGINE_BUF_TOO_SMALL:
+            return SCHC_BUF_TOO_SMALL;
+        case SCHC_ENGINE_UNKNOWN_RULE:
+            ALOG_ERROR(error_cat, "SCHC decompress: unknown rule %d", rule_id);
+            return SCHC_ERR;
+        default:
+            ALOG_ERROR(error_cat, "SCHC decompress failed: %d", st);
+            return SCHC_ERR;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Miss profiling                                                             */
+/* -------------------------------------------------------------------------- */
+
+schc_status_t schc_service_profile_misses(const uint32_t sample_every)
+{
+    if (!sample_every) {
+        schc_profiler_stop();
+        return SCHC_OK;
+    }
+    return schc_profiler_start(sample_every) == SCHC_PROFILER_OK ? SCHC_OK : SCHC_ERR;
+}
+
+schc_status_t schc_service_profile_report(const char *rules_out)
+{
+    const rule_set_t *rs = set_enter();
+    if (!rs) {
+        set_leave();
+        zlog_error(error_cat, "SCHC is not initialized");
+        return SCHC_ERR;
+    }
+
+    /* Candidates are derived against the compiled rules; the SDK path has none */
+    const schc_engine_t *eng = rs->fast_path ? &rs->engine : NULL;
+    schc_profiler_report(eng);
+    schc_status_t st = SCHC_OK;
+    if (rules_out) {
+        st = eng && schc_profiler_write_rules(eng, rules_out) == SCHC_PROFILER_OK ? SCHC_OK : SCHC_ERR;
+    }
+    set_leave();
+    return st;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Per-device contexts                                                        */
+/* -------------------------------------------------------------------------- */
+
+struct schc_dev_ctx {
+    schc_engine_t engine;
+    uint8_t dev_ip[16];
+};
+
+schc_dev_ctx_t *schc_service_dev_ctx_new(const uint8_t dev_iid[8])
+{
+    const rule_set_t *rs = set_enter();
+    const bool fast_path = rs && rs->fast_path;
+    const bool from_image = rs && rs->from_image;
+    set_leave();
+    if (!fast_path) {
+        zlog_error(error_cat, "SCHC device contexts need compiled rules");
+        return NULL;
+    }
+    if (from_image) {
+        zlog_error(error_cat, "SCHC device contexts derive from the built-in rule, not from a rule image");
+        return NULL;
+    }
+
+    schc_dev_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) return NULL;
+
+    memcpy(ctx->dev_ip, k_dev_ip, 8);
+    memcpy(ctx->dev_ip + 8, dev_iid, 8);
+
+    /* Same rules as the template, but the dev address fields target this device */
+    schc_field_desc_t fields[IPV6UDP_NB_FIELDS];
+    memcpy(fields, ipv6udp_fields, sizeof(fields));
+    for (size_t i = 0; i < IPV6UDP_NB_FIELDS; i++) {
+        if (fields[i].fid == FID_IPV6_PREFIX_DEV) fields[i].tv = ctx->dev_ip;
+        if (fields[i].fid == FID_IPV6_IID_DEV) fields[i].tv = ctx->dev_ip + 8;
+    }
+    const schc_rule_desc_t rules[NB_RULES] = {
+        { IPV6_UDP_RULE_ID, IPV6UDP_NB_FIELDS, fields },
+    };
+
+    if (schc_engine_compile(&ctx->engine, rules, NB_RULES, 8, NO_COMP_RULE_ID) != SCHC_ENGINE_OK) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void schc_service_dev_ctx_free(schc_dev_ctx_t *ctx)
+{
+    if (!ctx) return;
+    schc_engine_free(&ctx->engine);
+    free(ctx);
+}
+
+const uint8_t *schc_service_dev_ctx_ip(const schc_dev_ctx_t *ctx)
+{
+    return ctx->dev_ip;
+}
+
+schc_status_t schc_service_compress_pkt_dev(const schc_dev_ctx_t *ctx, pktbuf_t *pb)
+{
+    if (!ctx || !pb || pb->len > UINT16_MAX) return SCHC_ERR;
+
+    size_t comp_bits;
+    const schc_status_t st = engine_compress_pkt(&ctx->engine, pb, &comp_bits);
+    const bool fallback = st == SCHC_MODE_NOT_AVAILABLE;
+    count_compressions(st == SCHC_OK || fallback, fallback, st != SCHC_OK && !fallback);
+    if (fallback) {
+        SCHC_PROFILE_MISS(&ctx->engine, pktbuf_data(pb), pb->len);
+        uint8_t *rule_id = pktbuf_push(pb, 1);
+        if (!rule_id) return SCHC_BUF_TOO_SMALL;
+        rule_id[0] = NO_COMP_RULE_ID;
+        return SCHC_OK;
+    }
+    return st;
+}
+
+schc_status_t schc_service_decompress_dev(const schc_dev_ctx_t *ctx, const uint8_t *in, size_t in_len,
+                                          uint8_t *out, size_t out_cap, size_t *out_len)
+{
+    if (!ctx || !in || !out || !out_len) return SCHC_ERR;
+
+    switch (schc_engine_decompress(&ctx->engine, in, in_len, out, out_cap, out_len)) {
+        case SCHC_ENGINE_OK:
+            return SCHC_OK;
+        case SCHC_ENGINE_BUF_TOO_SMALL:
+            return SCHC_BUF_TOO_SMALL;
+        default:
+            return SCHC_ERR;
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /* Getters for main.c                                    */
 /* -------------------------------------------------------------------------- */
@@ -0,0 +1,143 @@
+#include "sensor_agg.h"
+
+#define DELTA_FLAG 0x80
+
+static uint32_t zigzag(const int32_t v) {
+    return (uint32_t) v << 1 ^ (uint32_t) (v >> 31);
+}
+
+static int32_t unzigzag(const uint32_t v) {
+    return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+static size_t varint_len(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static uint8_t* put_varint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t) v;
+    return p;
+}
+
+static const uint8_t* get_varint(const uint8_t* p, const uint8_t* end, uint32_t* v) {
+    *v = 0;
+    for (uint32_t shift = 0; p < end && shift < 35; shift += 7) {
+        const uint8_t b = *p++;
+        *v |= (uint32_t) (b & 0x7f) << shift;
+        if (!(b & 0x80)) return p;
+    }
+    return NULL;
+}
+
+static int32_t field_delta(const sensor_code_t* prev, const sensor_code_t* cur, const size_t i) {
+    return (int32_t) cur->v[i] - (int32_t) prev->v[i];
+}
+
+static size_t delta_size(const sensor_code_t* prev, const sensor_code_t* cur) {
+    size_t n = 0;
+    for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) n += varint_len(zigzag(field_delta(prev, cur, i)));
+    return n;
+}
+
+void sensor_agg_reset(sensor_agg_t* agg) {
+    agg->count = 0;
+    agg->packed_len = 1;
+    agg->delta_len = 1;
+    agg->first_ns = 0;
+}
+
+void sensor_agg_init(sensor_agg_t* agg, const uint32_t max_samples, const size_t max_len) {
+    agg->max_samples = max_samples == 0 ? 1 : max_samples > SENSOR_AGG_MAX_SAMPLES ? SENSOR_AGG_MAX_SAMPLES : max_samples;
+    agg->max_len = max_len;
+    sensor_agg_reset(agg);
+}
+
+size_t sensor_agg_len(const sensor_agg_t* agg) {
+    return agg->delta_len < agg->packed_len ? agg->delta_len : agg->packed_len;
+}
+
+sensor_agg_status sensor_agg_add(sensor_agg_t* agg, const sensor_data_t* data, const uint64_t now_ns) {
+    if (!data || agg->max_len < 1 + SENSOR_CODEC_SIZE(1)) return SENSOR_AGG_KO;
+
+    sensor_code_t code;
+    sensor_codec_quantize(data, &code);
+    const size_t packed_len = 1 + SENSOR_CODEC_SIZE(agg->count + 1);
+    const size_t delta_len = agg->delta_len + (agg->count ? delta_size(&agg->samples[agg->count - 1], &code)
+                                                          : SENSOR_CODEC_SIZE(1));
+    if ((packed_len < delta_len ? packed_len : delta_len) > agg->max_len) return SENSOR_AGG_FULL;
+
+    if (!agg->count) agg->first_ns = now_ns;
+    agg->samples[agg->count++] = code;
+    agg->packed_len = packed_len;
+    agg->delta_len = delta_len;
+    return agg->count >= agg->max_samples ? SENSOR_AGG_READY : SENSOR_AGG_OK;
+}
+
+sensor_agg_status sensor_agg_flush(sensor_agg_t* agg, pktbuf_t* pb) {
+    if (!agg->count) return SENSOR_AGG_KO;
+
+    const int delta = agg->delta_len < agg->packed_len;
+    const size_t len = sensor_agg_len(agg);
+    uint8_t* p = pktbuf_put(pb, len);
+    if (!p) return SENSOR_AGG_KO;
+
+    *p++ = (uint8_t) ((delta ? DELTA_FLAG : 0) | agg->count);
+    if (!delta) {
+        sensor_codec_pack(agg->samples, agg->count, p, len - 1);
+    } else {
+        p += sensor_codec_pack(agg->samples, 1, p, len - 1);
+        for (uint32_t s = 1; s < agg->count; s++) {
+            for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+                p = put_varint(p, zigzag(field_delta(&agg->samples[s - 1], &agg->samples[s], i)));
+            }
+        }
+    }
+
+    sensor_agg_reset(agg);
+    return SENSOR_AGG_OK;
+}
+
+sensor_agg_status sensor_agg_decode(const uint8_t* payload, const size_t len, sensor_data_t* out, const size_t cap,
+                                    size_t* count) {
+    *count = 0;
+    if (len < 1 + SENSOR_CODEC_SIZE(1)) return SENSOR_AGG_KO;
+
+    const uint8_t* p = payload + 1;
+    const uint8_t* end = payload + len;
+    const size_t n = payload[0] & ~DELTA_FLAG;
+    if (n == 0 || n > cap) return SENSOR_AGG_KO;
+
+    if (!(payload[0] & DELTA_FLAG)) {
+        if (sensor_codec_decode(p, (size_t) (end - p), out, n) != SENSOR_CODEC_OK) return SENSOR_AGG_KO;
+        *count = n;
+        return SENSOR_AGG_OK;
+    }
+
+    sensor_code_t code;
+    sensor_codec_unpack(p, (size_t) (end - p), &code, 1);
+    sensor_codec_dequantize(&code, &out[0]);
+    p += SENSOR_CODEC_SIZE(1);
+    for (size_t s = 1; s < n; s++) {
+        for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+            uint32_t d;
+            if (!(p = get_varint(p, end, &d))) return SENSOR_AGG_KO;
+            const int64_t v = (int64_t) code.v[i] + unzigzag(d);
+            if (v < 0 || v >> sensor_codec_fields[i].bits) return SENSOR_AGG_KO;
+            code.v[i] = (uint32_t) v;
+        }
+        sensor_codec_dequantize(&code, &out[s]);
+    }
+
+    if (p != end) return SENSOR_AGG_KO;
+    *count = n;
+    return SENSOR_AGG_OK;
+}
@@ -0,0 +1,124 @@
+#include "sensor_codec.h"
+
+#include <math.h>
+#include <string.h>
+
+#define FIELD_ENTRY(name, type, min, step, bits) { #name, type, offsetof(sensor_data_t, name), min, step, bits },
+#define FIELD_CHECK(name, type, min, step, bits) _Static_assert((bits) > 0 && (bits) <= 32, #name " bits");
+
+const sensor_field_t sensor_codec_fields[SENSOR_CODEC_NB_FIELDS] = {
+    SENSOR_CODEC_SCHEMA(FIELD_ENTRY)
+};
+SENSOR_CODEC_SCHEMA(FIELD_CHECK)
+
+static uint32_t max_code(const sensor_field_t* f) {
+    return (uint32_t) ((1ull << f->bits) - 1);
+}
+
+static double get_value(const sensor_data_t* data, const sensor_field_t* f) {
+    const uint8_t* p = (const uint8_t*) data + f->offset;
+    if (f->type == SENSOR_FIELD_U8) return *p;
+    float v;
+    memcpy(&v, p, sizeof(v));   // sensor_data_t is packed
+    return v;
+}
+
+static void set_value(sensor_data_t* data, const sensor_field_t* f, const double v) {
+    uint8_t* p = (uint8_t*) data + f->offset;
+    if (f->type == SENSOR_FIELD_U8) {
+        *p = (uint8_t) (v > 255.0 ? 255.0 : v);
+        return;
+    }
+    const float fv = (float) v;
+    memcpy(p, &fv, sizeof(fv));
+}
+
+void sensor_codec_quantize(const sensor_data_t* data, sensor_code_t* code) {
+    for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+        const sensor_field_t* f = &sensor_codec_fields[i];
+        const double steps = (get_value(data, f) - f->min) / f->step;
+        const uint32_t max = max_code(f);
+        // !(steps > 0) also catches NaN
+        code->v[i] = !(steps > 0.0) ? 0 : steps >= max ? max : (uint32_t) llround(steps);
+    }
+}
+
+void sensor_codec_dequantize(const sensor_code_t* code, sensor_data_t* data) {
+    for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+        const sensor_field_t* f = &sensor_codec_fields[i];
+        set_value(data, f, f->min + (double) code->v[i] * f->step);
+    }
+}
+
+size_t sensor_codec_pack(const sensor_code_t* codes, const size_t n, uint8_t* out, const size_t cap) {
+    const size_t len = SENSOR_CODEC_SIZE(n);
+    if (len > cap) return 0;
+
+    // Bits above nbits are stale; every byte written is cut out of the low ones
+    uint64_t acc = 0;
+    uint32_t nbits = 0;
+    size_t o = 0;
+    for (size_t s = 0; s < n; s++) {
+        for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+            const uint8_t bits = sensor_codec_fields[i].bits;
+            acc = acc << bits | (codes[s].v[i] & max_code(&sensor_codec_fields[i]));
+            nbits += bits;
+            while (nbits >= 8) {
+                nbits -= 8;
+                out[o++] = (uint8_t) (acc >> nbits);
+            }
+        }
+    }
+    if (nbits) out[o++] = (uint8_t) (acc << (8 - nbits));
+    return o;
+}
+
+sensor_codec_status sensor_codec_unpack(const uint8_t* in, const size_t len, sensor_code_t* codes, const size_t n) {
+    if (len < SENSOR_CODEC_SIZE(n)) return SENSOR_CODEC_KO;
+
+    uint64_t acc = 0;
+    uint32_t nbits = 0;
+    size_t o = 0;
+    for (size_t s = 0; s < n; s++) {
+        for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+            const uint8_t bits = sensor_codec_fields[i].bits;
+            while (nbits < bits) {
+                acc = acc << 8 | in[o++];
+                nbits += 8;
+            }
+            nbits -= bits;
+            codes[s].v[i] = (uint32_t) (acc >> nbits) & max_code(&sensor_codec_fields[i]);
+        }
+    }
+    return SENSOR_CODEC_OK;
+}
+
+size_t sensor_codec_encode(const sensor_data_t* data, const size_t n, uint8_t* out, const size_t cap) {
+    if (SENSOR_CODEC_SIZE(n) > cap) return 0;
+
+    // Small blocks keep the quantized copy on the stack
+    sensor_code_t codes[16];
+    size_t o = 0;
+    for (size_t s = 0; s < n; s += 16) {
+        const size_t m = n - s < 16 ? n - s : 16;
+        for (size_t j = 0; j < m; j++) sensor_codec_quantize(&data[s + j], &codes[j]);
+        // 16 samples always end on a byte boundary, so blocks simply follow each other
+        _Static_assert(16 * SENSOR_CODEC_BITS % 8 == 0, "block not byte aligned");
+        o += sensor_codec_pack(codes, m, out + o, cap - o);
+    }
+    return o;
+}
+
+sensor_codec_status sensor_codec_decode(const uint8_t* in, const size_t len, sensor_data_t* out, const size_t n) {
+    if (len != SENSOR_CODEC_SIZE(n)) return SENSOR_CODEC_KO;
+
+    sensor_code_t codes[16];
+    size_t o = 0;
+    for (size_t s = 0; s < n; s += 16) {
+        const size_t m = n - s < 16 ? n - s : 16;
+        if (sensor_codec_unpack(in + o, len - o, codes, m) != SENSOR_CODEC_OK) return SENSOR_CODEC_KO;
+        for (size_t j = 0; j < m; j++) sensor_codec_dequantize(&codes[j], &out[s + j]);
+        o += SENSOR_CODEC_SIZE(m);
+    }
+    return SENSOR_CODEC_OK;
+}
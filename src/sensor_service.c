@@ -1,44 +1,54 @@
 #include "sensor_service.h"
 
-#include <stdlib.h>
-#include <time.h>
 #include <math.h>
-#include <unistd.h>
 
-#include "utils.h"
+uint64_t sensor_next_interval_ns_r(rng_t* rng, const double mean_ms) {
+    const double stddev_ms = mean_ms * 0.1; // modest stddev
+    double sampled_ms = mean_ms + stddev_ms * rng_normal(rng);
+    if (sampled_ms < 1.0) sampled_ms = 1.0; // clamp to at least 1 ms
+    return (uint64_t) llround(sampled_ms * 1e6);
+}
 
-void sleep_gaussian(const double mean_ms) {
-    const double sleep_stddev_ms = mean_ms * 0.1; // modest stddev
-    double sampled_ms_d = gaussian_random(mean_ms, sleep_stddev_ms);
-    if (sampled_ms_d < 1.0) sampled_ms_d = 1.0; // clamp to at least 1 ms
-    unsigned long ms = (unsigned long) llround(sampled_ms_d);
-    if (ms == 0) ms = 1; // ensure non-zero
-    usleep(ms * 1000);
+uint64_t sensor_next_interval_ns(const double mean_ms) {
+    return sensor_next_interval_ns_r(rng_local(), mean_ms);
 }
 
-measure_status measure(sensor_data_t* data) {
+static measure_status sample(rng_t* rng, sensor_data_t* data) {
     if (!data) return measure_status_ko;
 
     float t_min = 5.0f;
     float t_max = 15.0f;
-    float t = t_min + (float)rand() / (float)RAND_MAX * (t_max - t_min); /* NOLINT */
+    float t = t_min + rng_uniform_f(rng) * (t_max - t_min);
 
     // pH: most plausible 6.5 - 8.5, but allow full 0-14 range with small chance of extremes
     float ph_min_common = 6.5f;
     float ph_max_common = 8.5f;
     float ph;
-    if ((rand() % 100) < 95) { /* NOLINT */ // 95% of readings in common range
-        ph = ph_min_common + (float)rand() / (float)RAND_MAX * (ph_max_common - ph_min_common); /* NOLINT */
+    if (rng_below(rng, 100) < 95) { // 95% of readings in common range
+        ph = ph_min_common + rng_uniform_f(rng) * (ph_max_common - ph_min_common);
     } else {
-        ph = (float)rand() / (float)RAND_MAX * 14.0f; /* NOLINT */
+        ph = rng_uniform_f(rng) * 14.0f;
     }
 
     // battery: simulate gradual decrease with some jitter
-    uint8_t bat = (uint8_t)(rand() % 101); /* NOLINT */ // 0-100
+    uint8_t bat = (uint8_t)rng_below(rng, 101); // 0-100
 
     data->temp = t;
     data->pH = ph;
     data->bat = bat;
 
     return measure_status_ok;
+}
+
+measure_status measure(sensor_data_t* data) {
+    return sample(rng_local(), data);
+}
+
+void sensor_state_init(sensor_state_t* state, const uint64_t seed) {
+    rng_seed(&state->rng, seed);
+}
+
+measure_status measure_r(sensor_state_t* state, sensor_data_t* data) {
+    if (!state) return measure_status_ko;
+    return sample(&state->rng, data);
 }
\ No newline at end of file
@@ -0,0 +1,379 @@
+#include "sim_service.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger_helper.h"
+#include "net/ipv6_udp_builder.h"
+#include "pcap_writer.h"
+#include "rng.h"
+#include "schc_service.h"
+#include "sensor_codec.h"
+#include "sensor_service.h"
+#include "spsc_ring.h"
+#include "stats.h"
+#include "utils.h"
+
+#define JOB_QUEUE_DEPTH 1024u
+#define LAT_SAMPLES_PER_WORKER (1u << 18)
+#define PKT_STORAGE 256
+
+typedef struct {
+    uint32_t id;
+    uint32_t seq;
+    sensor_state_t sensor;
+    schc_dev_ctx_t* schc;
+    ipv6_udp_tpl_t tpl;
+} sim_device_t;
+
+typedef struct {
+    uint64_t due_ns;
+    uint32_t dev;
+} sim_job_t;
+
+typedef struct {
+    pthread_t thread;
+    uint32_t index;
+    // Single producer (scheduler) / single consumer (this worker)
+    spsc_ring_t ring;
+    sim_job_t jobs[JOB_QUEUE_DEPTH];
+
+    _Atomic uint64_t packets;
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t failed;
+
+    // Latency reservoir, touched by the worker only until it is joined
+    uint64_t* lat;
+    uint64_t lat_seen;
+    uint64_t lat_max;
+    rng_t rng;
+} sim_worker_t;
+
+typedef struct {
+    uint64_t due_ns;
+    uint32_t dev;
+} heap_entry_t;
+
+static const sim_config_t* cfg;
+static sim_device_t* devices;
+static sim_worker_t* workers;
+static heap_entry_t* heap;
+static rng_t sched_rng;             // scheduler thread: device seeds, phases, wake-up intervals
+static uint32_t nb_rings;           // workers whose ring is initialised
+static atomic_bool stopping;
+
+static void sleep_until_ns(const uint64_t deadline) {
+    const struct timespec ts = {
+        .tv_sec = (time_t) (deadline / 1000000000ull),
+        .tv_nsec = (long) (deadline % 1000000000ull)
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+/* ------------------------------------------------------------------------ */
+/* Wake-up schedule: binary min-heap on due time, one entry per device       */
+/* ------------------------------------------------------------------------ */
+
+static void heap_sift_down(const size_t n, size_t i) {
+    const heap_entry_t e = heap[i];
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && heap[c + 1].due_ns < heap[c].due_ns) c++;
+        if (heap[c].due_ns >= e.due_ns) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = e;
+}
+
+static void heap_build(const size_t n) {
+    for (size_t i = n / 2; i-- > 0;) heap_sift_down(n, i);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Workers                                                                   */
+/* ------------------------------------------------------------------------ */
+
+static void record_latency(sim_worker_t* w, const uint64_t ns) {
+    if (ns > w->lat_max) w->lat_max = ns;
+
+    // Reservoir sampling keeps a uniform sample of every packet seen
+    const uint64_t seen = w->lat_seen++;
+    if (seen < LAT_SAMPLES_PER_WORKER) {
+        w->lat[seen] = ns;
+    } else {
+        const uint64_t r = rng_below(&w->rng, seen + 1);
+        if (r < LAT_SAMPLES_PER_WORKER) w->lat[r] = ns;
+    }
+}
+
+static void run_job(sim_worker_t* w, const sim_job_t* job) {
+    static __thread uint8_t storage[PKT_STORAGE];
+    sim_device_t* dev = &devices[job->dev];
+
+    pktbuf_t own;
+    pktbuf_t* pb = &own;
+    if (cfg->acquire) {
+        pb = cfg->acquire(w->index, cfg->emit_ctx);
+        if (!pb) {
+            atomic_fetch_add_explicit(&w->dropped, 1, memory_order_relaxed);
+            return;
+        }
+    } else {
+        pktbuf_init(&own, storage, sizeof(storage), PKTBUF_HEADROOM);
+    }
+
+    const uint64_t start = monotonic_now_ns();
+    // A raw measurement is written straight into the packet, a packed one is encoded into it
+    sensor_data_t data;
+    sensor_data_t* out = cfg->raw_payload ? (sensor_data_t*) pktbuf_put(pb, sizeof(data)) : &data;
+    if (measure_r(&dev->sensor, out) != measure_status_ok) {
+        atomic_fetch_add_explicit(&w->failed, 1, memory_order_relaxed);
+        return;
+    }
+    if (!cfg->raw_payload) {
+        sensor_codec_encode(&data, 1, pktbuf_put(pb, SENSOR_CODEC_SIZE(1)), SENSOR_CODEC_SIZE(1));
+    }
+
+    if (ipv6_udp_tpl_push(&dev->tpl, pb) != 0) {
+        atomic_fetch_add_explicit(&w->failed, 1, memory_order_relaxed);
+        return;
+    }
+    const uint64_t built = monotonic_now_ns();
+    stats_record(STAT_BUILD, built - start);
+    stats_count(STAT_PKT_BUILT, 1);
+
+    PCAP_CAPTURE(PCAP_STAGE_IPV6, pktbuf_data(pb), pb->len);
+    const size_t in_len = pb->len;
+    if (schc_service_compress_pkt_dev(dev->schc, pb) != SCHC_OK) {
+        atomic_fetch_add_explicit(&w->failed, 1, memory_order_relaxed);
+        return;
+    }
+    stats_record(STAT_COMPRESS, monotonic_now_ns() - built);
+    stats_count(STAT_PKT_COMPRESSED, 1);
+    stats_count(STAT_BYTES_IN, in_len);
+    stats_count(STAT_BYTES_OUT, pb->len);
+    stats_record(STAT_RATIO, pb->len * 1000u / in_len);
+
+    const uint32_t seq = dev->seq++;
+    if (cfg->emit(w->index, dev->id, seq, job->due_ns, pb, cfg->emit_ctx) != SIM_OK) {
+        atomic_fetch_add_explicit(&w->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    record_latency(w, monotonic_now_ns() - job->due_ns);
+    atomic_fetch_add_explicit(&w->packets, 1, memory_order_relaxed);
+}
+
+static void* worker_main(void* arg) {
+    sim_worker_t* w = arg;
+
+    for (;;) {
+        const size_t h = spsc_ring_wait(&w->ring);
+        size_t t = spsc_ring_tail(&w->ring);
+        if (t == h) {
+            if (atomic_load(&stopping)) break;
+            continue;
+        }
+
+        // One post per job: the jobs after this one have their own wake-up
+        run_job(w, &w->jobs[t & w->ring.mask]);
+        spsc_ring_release(&w->ring, ++t);
+    }
+    return NULL;
+}
+
+/* A device always goes to the same worker, so its state has a single owner */
+static bool dispatch(const uint32_t dev, const uint64_t due_ns) {
+    sim_worker_t* w = &workers[dev % cfg->nb_workers];
+
+    size_t h;
+    if (!spsc_ring_reserve(&w->ring, &h)) return false;
+
+    w->jobs[h & w->ring.mask] = (sim_job_t){ due_ns, dev };
+    spsc_ring_publish(&w->ring, h);
+    spsc_ring_wake(&w->ring);
+    return true;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static int cmp_u64(const void* a, const void* b) {
+    const uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+static void fill_percentiles(sim_report_t* report) {
+    size_t n = 0;
+    for (uint32_t i = 0; i < cfg->nb_workers; i++) {
+        const sim_worker_t* w = &workers[i];
+        n += w->lat_seen < LAT_SAMPLES_PER_WORKER ? w->lat_seen : LAT_SAMPLES_PER_WORKER;
+        if (w->lat_max > report->max_ns) report->max_ns = w->lat_max;
+    }
+    if (!n) return;
+
+    uint64_t* all = malloc(n * sizeof(*all));
+    if (!all) return;
+    size_t k = 0;
+    for (uint32_t i = 0; i < cfg->nb_workers; i++) {
+        const sim_worker_t* w = &workers[i];
+        const size_t m = w->lat_seen < LAT_SAMPLES_PER_WORKER ? w->lat_seen : LAT_SAMPLES_PER_WORKER;
+        memcpy(all + k, w->lat, m * sizeof(*all));
+        k += m;
+    }
+    qsort(all, n, sizeof(*all), cmp_u64);
+
+    report->p50_ns = all[(n - 1) * 50 / 100];
+    report->p90_ns = all[(n - 1) * 90 / 100];
+    report->p99_ns = all[(n - 1) * 99 / 100];
+    report->p999_ns = all[(n - 1) * 999 / 1000];
+    free(all);
+}
+
+static void cleanup(const uint32_t nb_started) {
+    atomic_store(&stopping, true);
+    for (uint32_t i = 0; i < nb_started; i++) {
+        spsc_ring_wake(&workers[i].ring);
+        pthread_join(workers[i].thread, NULL);
+    }
+}
+
+static void release(void) {
+    if (workers) {
+        for (uint32_t i = 0; i < nb_rings; i++) spsc_ring_destroy(&workers[i].ring);
+        for (uint32_t i = 0; i < cfg->nb_workers; i++) free(workers[i].lat);
+    }
+    nb_rings = 0;
+    if (devices) {
+        for (uint32_t i = 0; i < cfg->nb_devices; i++) schc_service_dev_ctx_free(devices[i].schc);
+    }
+    free(workers);
+    free(devices);
+    free(heap);
+    workers = NULL;
+    devices = NULL;
+    heap = NULL;
+}
+
+static sim_status setup_devices(void) {
+    ipv6_udp_cfg_t net = {0};
+    memcpy(net.dst_ip, schc_service_app_ip(), 16);
+    net.src_port = schc_service_dev_port();
+    net.dst_port = schc_service_app_port();
+    net.next_header = 17;
+    net.hop_limit = schc_service_hop_limit();
+
+    const uint64_t start = monotonic_now_ns();
+
+    for (uint32_t i = 0; i < cfg->nb_devices; i++) {
+        sim_device_t* dev = &devices[i];
+        dev->id = cfg->first_id + i;
+        sensor_state_init(&dev->sensor, rng_next(&sched_rng));
+
+        uint8_t iid[8] = {0};
+        for (int b = 0; b < 4; b++) iid[7 - b] = (uint8_t) (dev->id >> (8 * b));
+        dev->schc = schc_service_dev_ctx_new(iid);
+        if (!dev->schc) return SIM_KO;
+
+        memcpy(net.src_ip, schc_service_dev_ctx_ip(dev->schc), 16);
+        if (ipv6_udp_tpl_init(&dev->tpl, &net, schc_service_flow_label()) != 0) return SIM_KO;
+
+        // Spread the first wake-ups over one interval instead of waking everyone at once
+        const uint64_t phase = (uint64_t) (rng_uniform(&sched_rng) * cfg->interval_ms * 1e6);
+        heap[i] = (heap_entry_t){ start + phase, i };
+    }
+    heap_build(cfg->nb_devices);
+    return SIM_OK;
+}
+
+sim_status sim_run(const sim_config_t* config, sim_report_t* report) {
+    if (!config || !report || !config->emit || !config->nb_devices || !config->nb_workers) return SIM_KO;
+    cfg = config;
+    memset(report, 0, sizeof(*report));
+    atomic_store(&stopping, false);
+
+    devices = calloc(cfg->nb_devices, sizeof(*devices));
+    heap = calloc(cfg->nb_devices, sizeof(*heap));
+    workers = aligned_alloc(64, cfg->nb_workers * sizeof(*workers));
+    if (workers) memset(workers, 0, cfg->nb_workers * sizeof(*workers));
+    if (!devices || !heap || !workers) {
+        release();
+        return SIM_KO;
+    }
+
+    rng_seed(&sched_rng, cfg->seed);
+    if (setup_devices() != SIM_OK) {
+        zlog_error(error_cat, "Simulated device setup failed");
+        release();
+        return SIM_KO;
+    }
+
+    uint32_t started = 0;
+    for (; started < cfg->nb_workers; started++) {
+        sim_worker_t* w = &workers[started];
+        w->index = started;
+        w->lat = malloc(LAT_SAMPLES_PER_WORKER * sizeof(*w->lat));
+        rng_seed_stream(&w->rng, cfg->seed, 1 + started);
+        if (spsc_ring_init(&w->ring, JOB_QUEUE_DEPTH) == 0) nb_rings++;
+        if (!w->lat || nb_rings == started || pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            zlog_error(error_cat, "Simulation worker %u start failed", started);
+            cleanup(started);
+            release();
+            return SIM_KO;
+        }
+    }
+
+    zlog_info(ok_cat, "Simulating %u devices on %u workers, mean interval %.1f ms",
+              cfg->nb_devices, cfg->nb_workers, cfg->interval_ms);
+
+    const uint64_t t0 = monotonic_now_ns();
+    const uint64_t end = t0 + (uint64_t) cfg->duration_s * 1000000000ull;
+    uint64_t next_report = t0 + 1000000000ull;
+    uint64_t last_packets = 0;
+
+    for (;;) {
+        const uint64_t due = heap[0].due_ns;
+        uint64_t wake = due < next_report ? due : next_report;
+        if (wake > end) wake = end;
+        if (wake > monotonic_now_ns()) sleep_until_ns(wake);
+
+        const uint64_t now = monotonic_now_ns();
+        if (now >= end) break;
+
+        if (now >= next_report) {
+            uint64_t packets = 0;
+            for (uint32_t i = 0; i < cfg->nb_workers; i++) {
+                packets += atomic_load_explicit(&workers[i].packets, memory_order_relaxed);
+            }
+            zlog_info(ok_cat, "sim: %llu packets/s", (unsigned long long) (packets - last_packets));
+            last_packets = packets;
+            next_report += 1000000000ull;
+        }
+
+        // Every device due by now, earliest first
+        while (heap[0].due_ns <= now) {
+            if (!dispatch(heap[0].dev, heap[0].due_ns)) report->overruns++;
+            // Next wake-up is relative to the scheduled one, so timing errors do not accumulate
+            heap[0].due_ns += sensor_next_interval_ns_r(&sched_rng, cfg->interval_ms);
+            heap_sift_down(cfg->nb_devices, 0);
+        }
+    }
+
+    cleanup(cfg->nb_workers);
+    report->elapsed_s = (double) (monotonic_now_ns() - t0) / 1e9;
+
+    for (uint32_t i = 0; i < cfg->nb_workers; i++) {
+        report->packets += atomic_load(&workers[i].packets);
+        report->dropped += atomic_load(&workers[i].dropped);
+        report->failed += atomic_load(&workers[i].failed);
+    }
+    fill_percentiles(report);
+
+    release();
+    return SIM_OK;
+}
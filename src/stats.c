@@ -0,0 +1,232 @@
+#include "stats.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger_helper.h"
+
+#define SUB_BITS 5
+#define SUB_COUNT (1u << SUB_BITS)
+#define MAX_EXP 47                                          // values up to 2^48 (78 h in ns)
+#define NB_BUCKETS ((MAX_EXP - SUB_BITS + 2) * SUB_COUNT)
+
+// Recording threads beyond this share the overflow shard with atomic adds
+#define MAX_SHARDS 64
+
+typedef struct {
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[NB_BUCKETS];
+} hist_t;
+
+typedef struct {
+    _Atomic uint64_t counters[STAT_NB_COUNTERS];
+    hist_t hists[STAT_NB_HISTS];
+} shard_t;
+
+static const char* const hist_names[STAT_NB_HISTS] = {
+    "sense", "build", "compress", "log", "l2 send", "tx latency", "ratio"
+};
+
+static const char* const counter_names[STAT_NB_COUNTERS] = {
+    "built", "compressed", "fragmented", "dropped-size", "dropped-queue",
+    "sent", "send-failed", "bytes-in", "bytes-out"
+};
+
+static _Atomic(shard_t*) shards[MAX_SHARDS];
+static _Atomic unsigned nb_claimed = 0;
+static shard_t overflow_shard;
+
+static __thread shard_t* t_shard = NULL;
+
+static shard_t* my_shard(void) {
+    if (t_shard) return t_shard;
+
+    const unsigned slot = atomic_fetch_add(&nb_claimed, 1);
+    shard_t* s = slot < MAX_SHARDS ? calloc(1, sizeof(*s)) : NULL;
+    if (s) {
+        atomic_store_explicit(&shards[slot], s, memory_order_release);
+    } else {
+        s = &overflow_shard;
+    }
+    t_shard = s;
+    return s;
+}
+
+// The owner is the only writer of its shard: a plain load and store is enough
+static inline void bump(shard_t* s, _Atomic uint64_t* c, const uint64_t n) {
+    if (s == &overflow_shard) {
+        atomic_fetch_add_explicit(c, n, memory_order_relaxed);
+    } else {
+        atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+    }
+}
+
+static inline size_t bucket_of(uint64_t v) {
+    if (v < SUB_COUNT) return (size_t) v;
+    if (v >> (MAX_EXP + 1)) v = (1ull << (MAX_EXP + 1)) - 1;
+    const unsigned e = 63u - (unsigned) __builtin_clzll(v);
+    return ((size_t) (e - SUB_BITS + 1) << SUB_BITS) + ((v >> (e - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+// Highest value that lands in bucket b
+static uint64_t bucket_top(const size_t b) {
+    if (b < SUB_COUNT) return b;
+    const unsigned shift = (unsigned) (b >> SUB_BITS) - 1;
+    return (((uint64_t) (SUB_COUNT + (b & (SUB_COUNT - 1))) + 1) << shift) - 1;
+}
+
+void stats_count(const stat_counter c, const uint64_t n) {
+    shard_t* s = my_shard();
+    bump(s, &s->counters[c], n);
+}
+
+void stats_record(const stat_hist h, const uint64_t value) {
+    shard_t* s = my_shard();
+    hist_t* hist = &s->hists[h];
+    bump(s, &hist->buckets[bucket_of(value)], 1);
+    bump(s, &hist->sum, value);
+    if (value > atomic_load_explicit(&hist->max, memory_order_relaxed)) {
+        if (s == &overflow_shard) {
+            uint64_t m = atomic_load_explicit(&hist->max, memory_order_relaxed);
+            while (value > m && !atomic_compare_exchange_weak_explicit(&hist->max, &m, value, memory_order_relaxed,
+                                                                       memory_order_relaxed)) {
+            }
+        } else {
+            atomic_store_explicit(&hist->max, value, memory_order_relaxed);
+        }
+    }
+}
+
+// Calls fn on every shard in use, the overflow one included
+static void for_each_shard(void (*fn)(const shard_t* s, void* ctx), void* ctx) {
+    for (size_t i = 0; i < MAX_SHARDS; i++) {
+        const shard_t* s = atomic_load_explicit(&shards[i], memory_order_acquire);
+        if (s) fn(s, ctx);
+    }
+    fn(&overflow_shard, ctx);
+}
+
+typedef struct {
+    stat_counter c;
+    uint64_t total;
+} counter_acc_t;
+
+static void add_counter(const shard_t* s, void* ctx) {
+    counter_acc_t* acc = ctx;
+    acc->total += atomic_load_explicit(&s->counters[acc->c], memory_order_relaxed);
+}
+
+uint64_t stats_get_counter(const stat_counter c) {
+    counter_acc_t acc = { c, 0 };
+    for_each_shard(add_counter, &acc);
+    return acc.total;
+}
+
+typedef struct {
+    stat_hist h;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[NB_BUCKETS];
+} hist_acc_t;
+
+static void add_hist(const shard_t* s, void* ctx) {
+    hist_acc_t* acc = ctx;
+    const hist_t* hist = &s->hists[acc->h];
+    acc->sum += atomic_load_explicit(&hist->sum, memory_order_relaxed);
+    const uint64_t m = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    if (m > acc->max) acc->max = m;
+    for (size_t b = 0; b < NB_BUCKETS; b++) {
+        acc->buckets[b] += atomic_load_explicit(&hist->buckets[b], memory_order_relaxed);
+    }
+}
+
+static uint64_t percentile(const hist_acc_t* acc, const uint64_t count, const double p) {
+    const uint64_t rank = (uint64_t) (p * (double) (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < NB_BUCKETS; b++) {
+        seen += acc->buckets[b];
+        if (seen >= rank) {
+            const uint64_t top = bucket_top(b);
+            return top < acc->max ? top : acc->max;
+        }
+    }
+    return acc->max;
+}
+
+void stats_get_hist(const stat_hist h, stat_hist_summary_t* out) {
+    static __thread hist_acc_t acc;
+    memset(&acc, 0, sizeof(acc));
+    acc.h = h;
+    for_each_shard(add_hist, &acc);
+
+    memset(out, 0, sizeof(*out));
+    for (size_t b = 0; b < NB_BUCKETS; b++) out->count += acc.buckets[b];
+    if (!out->count) return;
+
+    out->mean = (double) acc.sum / (double) out->count;
+    out->p50 = percentile(&acc, out->count, 0.50);
+    out->p90 = percentile(&acc, out->count, 0.90);
+    out->p99 = percentile(&acc, out->count, 0.99);
+    out->p999 = percentile(&acc, out->count, 0.999);
+    out->max = acc.max;
+}
+
+static size_t append(char* buf, const size_t cap, size_t pos, const char* fmt, ...)
+        __attribute__((format(printf, 4, 5)));
+
+static size_t append(char* buf, const size_t cap, size_t pos, const char* fmt, ...) {
+    if (pos + 1 >= cap) return pos;
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(buf + pos, cap - pos, fmt, ap);
+    va_end(ap);
+    if (n < 0) return pos;
+    return pos + (size_t) n < cap ? pos + (size_t) n : cap - 1;
+}
+
+size_t stats_format(char* buf, const size_t cap, const char* extra) {
+    if (!cap) return 0;
+    buf[0] = '\0';
+    size_t pos = 0;
+
+    for (size_t c = 0; c < STAT_NB_COUNTERS; c++) {
+        pos = append(buf, cap, pos, "%s%s %llu", c ? ", " : "counters: ", counter_names[c],
+                     (unsigned long long) stats_get_counter((stat_counter) c));
+    }
+    pos = append(buf, cap, pos, "\n");
+
+    for (size_t h = 0; h < STAT_NB_HISTS; h++) {
+        stat_hist_summary_t s;
+        stats_get_hist((stat_hist) h, &s);
+        if (!s.count) continue;
+        if (h == STAT_RATIO) {
+            pos = append(buf, cap, pos, "%s: n %llu, mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+                         hist_names[h], (unsigned long long) s.count, s.mean / 1e3, s.p50 / 1e3,
+                         s.p90 / 1e3, s.p99 / 1e3, s.max / 1e3);
+        } else {
+            pos = append(buf, cap, pos, "%s us: n %llu, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, "
+                                        "max %.1f\n",
+                         hist_names[h], (unsigned long long) s.count, s.mean / 1e3, s.p50 / 1e3, s.p90 / 1e3,
+                         s.p99 / 1e3, s.p999 / 1e3, s.max / 1e3);
+        }
+    }
+
+    if (extra) pos = append(buf, cap, pos, "%s\n", extra);
+    return pos;
+}
+
+void stats_log(const char* extra) {
+    char report[2048];
+    stats_format(report, sizeof(report), extra);
+
+    char* line = report;
+    for (char* nl; (nl = strchr(line, '\n')) != NULL; line = nl + 1) {
+        *nl = '\0';
+        zlog_info(stat_cat, "%s", line);
+    }
+}
@@ -0,0 +1,292 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <schc_sdk/schccomp.h>
+
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/rng.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_rule_engine.h"
+#include "schc_demo_app/services/schc_service.h"
+
+/*
+ * Differential check of the compiled-rule fast path against the SDK, which
+ * is the reference: both compress the same packets and must agree on the
+ * status and on every bit emitted.
+ * First through the service with the built-in rule (schc_service_check_fast_path,
+ * buffer and in-place paths), then straight on the engine for rule sets with
+ * residues the built-in rule does not have: value-sent, MSB/LSB and fields
+ * that do not end on a byte boundary, several rules in priority order.
+ * Packets are built from the rules' target values with random payloads and
+ * sent fields; one in four has a random header bit flipped, one in sixteen
+ * is cut short. Exits non-zero if any packet of any set differs.
+ */
+
+#define NB_PACKETS 20000
+#define MAX_PAYLOAD 1232
+#define PKT_CAP (SCHC_HDR_LEN + MAX_PAYLOAD)
+#define MAX_RULES 4
+#define NB_FIELDS SCHC_NB_HDR_FIELDS
+#define DEFAULT_RULE_ID 150
+
+static const uint8_t ipv6_version = 0x60;
+static const uint8_t ipv6_tc = 0;
+static const uint8_t ipv6_fl[] = {0, 0, 0};
+static const uint8_t ipv6_nh = 17;
+static const uint8_t ipv6_hl = 255;
+
+static uint8_t dev_ip[16];
+static uint8_t app_ip[16];
+static uint8_t dev_port[2];
+static uint8_t app_port[2];
+
+static uint8_t pkt[PKT_CAP];
+static uint8_t fast_out[PKT_CAP + 2];
+static uint8_t sdk_out[PKT_CAP + 2];
+static uint8_t storage[PKTBUF_HEADROOM + PKT_CAP];
+
+static rng_t rng;
+
+/* A packet of the service's flow with random sent fields and payload, maybe damaged */
+static size_t make_packet(void) {
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, dev_ip, 16);
+    memcpy(cfg.dst_ip, app_ip, 16);
+    cfg.src_port = (uint16_t) (dev_port[0] << 8 | dev_port[1]);
+    cfg.dst_port = (uint16_t) (app_port[0] << 8 | app_port[1]);
+    cfg.next_header = 17;
+    cfg.hop_limit = 255;
+    uint32_t flow_lbl = 0;
+
+    // Vary what the rules send or only match on the leading bits of
+    if (rng_below(&rng, 2)) {
+        cfg.src_ip[15] ^= (uint8_t) rng_next(&rng);
+        cfg.src_port ^= (uint16_t) rng_below(&rng, 16);
+        cfg.dst_port ^= (uint16_t) rng_below(&rng, 16);
+        cfg.traffic_class = (uint8_t) rng_below(&rng, 32);
+        cfg.hop_limit = (uint8_t) rng_next(&rng);
+        flow_lbl = (uint32_t) rng_below(&rng, 1u << 20);
+    }
+
+    const size_t payload_len = rng_below(&rng, 8) ? rng_below(&rng, 64) : rng_below(&rng, MAX_PAYLOAD + 1);
+    uint8_t payload[MAX_PAYLOAD];
+    for (size_t i = 0; i < payload_len; i++) payload[i] = (uint8_t) rng_next(&rng);
+
+    size_t len = 0;
+    if (build_ipv6_udp_packet(&cfg, flow_lbl, payload, payload_len, pkt, sizeof(pkt), &len) != 0) exit(EXIT_FAILURE);
+
+    if (rng_below(&rng, 4) == 0) {
+        const uint64_t bit = rng_below(&rng, SCHC_HDR_LEN * 8);
+        pkt[bit / 8] ^= (uint8_t) (0x80u >> (bit % 8));
+    }
+    if (rng_below(&rng, 16) == 0) len = rng_below(&rng, SCHC_HDR_LEN + 1);
+    return len;
+}
+
+/* ------------------------------------------------------------------ */
+/* Rule sets                                                          */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    const char* name;
+    size_t nb_rules;
+    schc_rule_desc_t rules[MAX_RULES];
+    schc_field_desc_t fields[MAX_RULES][NB_FIELDS];
+} rule_set_desc_t;
+
+/* The built-in rule: every field matched or computed, only the payload is sent */
+static void base_fields(schc_field_desc_t f[NB_FIELDS]) {
+    const schc_field_desc_t base[NB_FIELDS] = {
+        { FID_IPV6_VERSION,        4,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_version, 0 },
+        { FID_IPV6_TRAFFIC_CLASS,  8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_tc, 0 },
+        { FID_IPV6_FLOW_LABEL,     20, MO_IGNORE, CDA_NOT_SENT,         ipv6_fl, 0 },
+        { FID_IPV6_PAYLOAD_LENGTH, 16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+        { FID_IPV6_NEXT_HEADER,    8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_nh, 0 },
+        { FID_IPV6_HOP_LIMIT,      8,  MO_IGNORE, CDA_NOT_SENT,         &ipv6_hl, 0 },
+        { FID_IPV6_PREFIX_DEV,     64, MO_EQUAL,  CDA_NOT_SENT,         dev_ip, 0 },
+        { FID_IPV6_IID_DEV,        64, MO_EQUAL,  CDA_NOT_SENT,         dev_ip + 8, 0 },
+        { FID_IPV6_PREFIX_APP,     64, MO_EQUAL,  CDA_NOT_SENT,         app_ip, 0 },
+        { FID_IPV6_IID_APP,        64, MO_EQUAL,  CDA_NOT_SENT,         app_ip + 8, 0 },
+        { FID_UDP_PORT_DEV,        16, MO_EQUAL,  CDA_NOT_SENT,         dev_port, 0 },
+        { FID_UDP_PORT_APP,        16, MO_EQUAL,  CDA_NOT_SENT,         app_port, 0 },
+        { FID_UDP_LENGTH,          16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+        { FID_UDP_CHECKSUM,        16, MO_IGNORE, CDA_COMPUTE_CHECKSUM, NULL, 0 },
+    };
+    memcpy(f, base, sizeof(base));
+}
+
+static schc_field_desc_t* field(schc_field_desc_t f[NB_FIELDS], const uint8_t fid) {
+    for (size_t i = 0; i < NB_FIELDS; i++) {
+        if (f[i].fid == fid) return &f[i];
+    }
+    exit(EXIT_FAILURE);
+}
+
+static void add_desc(rule_set_desc_t* set, const uint16_t rule_id) {
+    const size_t i = set->nb_rules++;
+    base_fields(set->fields[i]);
+    set->rules[i] = (schc_rule_desc_t){ rule_id, NB_FIELDS, set->fields[i] };
+}
+
+static void make_sets(rule_set_desc_t sets[], size_t* nb_sets) {
+    size_t n = 0;
+
+    // Fields sent whole, one of them 20 bits long: the residue ends off the byte boundary
+    rule_set_desc_t* s = &sets[n++];
+    s->name = "value-sent";
+    add_desc(s, 12);
+    *field(s->fields[0], FID_IPV6_FLOW_LABEL) = (schc_field_desc_t){ FID_IPV6_FLOW_LABEL, 20, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 };
+    *field(s->fields[0], FID_IPV6_HOP_LIMIT) = (schc_field_desc_t){ FID_IPV6_HOP_LIMIT, 8, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 };
+
+    // Leading bits matched, the others sent
+    s = &sets[n++];
+    s->name = "msb-lsb";
+    add_desc(s, 13);
+    *field(s->fields[0], FID_IPV6_TRAFFIC_CLASS) = (schc_field_desc_t){ FID_IPV6_TRAFFIC_CLASS, 8, MO_MSB, CDA_LSB, &ipv6_tc, 3 };
+    *field(s->fields[0], FID_IPV6_IID_DEV) = (schc_field_desc_t){ FID_IPV6_IID_DEV, 64, MO_MSB, CDA_LSB, dev_ip + 8, 56 };
+    *field(s->fields[0], FID_UDP_PORT_DEV) = (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_MSB, CDA_LSB, dev_port, 12 };
+    *field(s->fields[0], FID_UDP_PORT_APP) = (schc_field_desc_t){ FID_UDP_PORT_APP, 16, MO_MSB, CDA_LSB, app_port, 12 };
+
+    // Narrow rule first, then wider ones with the same and with other masks
+    s = &sets[n++];
+    s->name = "priority";
+    add_desc(s, 20);
+    add_desc(s, 21);
+    *field(s->fields[1], FID_UDP_PORT_DEV) = (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 };
+    add_desc(s, 22);
+    *field(s->fields[2], FID_IPV6_IID_DEV) = (schc_field_desc_t){ FID_IPV6_IID_DEV, 64, MO_MSB, CDA_LSB, dev_ip + 8, 60 };
+    *field(s->fields[2], FID_IPV6_FLOW_LABEL) = (schc_field_desc_t){ FID_IPV6_FLOW_LABEL, 20, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 };
+    add_desc(s, 23);
+    *field(s->fields[3], FID_IPV6_TRAFFIC_CLASS) = (schc_field_desc_t){ FID_IPV6_TRAFFIC_CLASS, 8, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 };
+    *field(s->fields[3], FID_IPV6_IID_DEV) = (schc_field_desc_t){ FID_IPV6_IID_DEV, 64, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 };
+    *field(s->fields[3], FID_UDP_PORT_APP) = (schc_field_desc_t){ FID_UDP_PORT_APP, 16, MO_MSB, CDA_LSB, app_port, 13 };
+
+    *nb_sets = n;
+}
+
+/* ------------------------------------------------------------------ */
+/* SDK rules from the same descriptors                                */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    rules_t rules;
+    rule_t* rule_ptrs[MAX_RULES];
+    rule_t rule[MAX_RULES];
+    rule_field_t* field_ptrs[MAX_RULES][NB_FIELDS];
+    rule_field_t fields[MAX_RULES][NB_FIELDS];
+    target_value_t tvs[MAX_RULES][NB_FIELDS];
+} sdk_rules_t;
+
+static void build_sdk_rules(const rule_set_desc_t* set, sdk_rules_t* sr) {
+    init_rules(&sr->rules, sr->rule_ptrs, DEFAULT_RULE_ID);
+    for (size_t r = 0; r < set->nb_rules; r++) {
+        const schc_rule_desc_t* rd = &set->rules[r];
+        init_rule(&sr->rule[r], (uint8_t) rd->rule_id, STACK_IPV6_UDP, sr->field_ptrs[r]);
+        for (uint8_t i = 0; i < rd->nb_fields; i++) {
+            const schc_field_desc_t* d = &rd->fields[i];
+            target_value_t* tv = NULL;
+            if (d->tv) {
+                sr->tvs[r][i] = (target_value_t){ TV_BIT_STRING, {{d->tv, 0, d->len}} };
+                tv = &sr->tvs[r][i];
+            }
+            sr->fields[r][i] = (rule_field_t){ d->fid, 1, DIR_BI, tv, d->len, d->mo, {d->msb_len}, d->cda };
+            add_rule_field(&sr->rule[r], &sr->fields[r][i]);
+        }
+        add_rule(&sr->rules, &sr->rule[r]);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Checks                                                             */
+/* ------------------------------------------------------------------ */
+
+static bool same(const schc_engine_status fast_st, const size_t fast_bits, const uint8_t* fast,
+                 const comp_status_t sdk_st, const size_t sdk_bits) {
+    if (sdk_st == COMP_RULES_NOT_FOUND_ERR) return fast_st == SCHC_ENGINE_NO_MATCH;
+    if (sdk_st != COMP_SUCCESS || fast_st != SCHC_ENGINE_OK) return false;
+    return fast_bits == sdk_bits && memcmp(fast, sdk_out, (sdk_bits + 7) / 8) == 0;
+}
+
+/* Engine and SDK on one rule set; returns the number of packets they disagree on */
+static size_t check_engine(const rule_set_desc_t* set) {
+    schc_engine_t eng;
+    const schc_engine_status est = schc_engine_compile(&eng, set->rules, set->nb_rules, 8, DEFAULT_RULE_ID);
+    if (est != SCHC_ENGINE_OK) {
+        printf("%-12s not compiled (%d)\n", set->name, est);
+        return 1;
+    }
+    static sdk_rules_t sr;
+    build_sdk_rules(set, &sr);
+
+    size_t diffs = 0, compressed = 0;
+    for (size_t p = 0; p < NB_PACKETS; p++) {
+        const size_t len = make_packet();
+
+        uint16_t sdk_bits = 0;
+        const comp_status_t sdk_st = schc_compress(&sr.rules, sdk_out, sizeof(sdk_out), &sdk_bits, pkt,
+                                                   (uint16_t) len, NULL);
+        compressed += sdk_st == COMP_SUCCESS;
+
+        size_t fast_bits = 0;
+        schc_engine_status st = schc_engine_compress(&eng, pkt, len, fast_out, sizeof(fast_out), &fast_bits);
+        bool ok = same(st, fast_bits, fast_out, sdk_st, sdk_bits);
+
+        pktbuf_t pb;
+        pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+        uint8_t* data = pktbuf_put(&pb, len);
+        if (!data) exit(EXIT_FAILURE);
+        memcpy(data, pkt, len);
+        size_t off = 0;
+        int moved = 0;
+        fast_bits = 0;
+        st = schc_engine_compress_inplace(&eng, pktbuf_data(&pb), pb.len, &off, &fast_bits, &moved);
+        ok = same(st, fast_bits, pktbuf_data(&pb) + off, sdk_st, sdk_bits) && ok;
+
+        if (!ok && diffs++ < 5) {
+            printf("%-12s packet %zu (%zu bytes): fast path status %d, %zu bits; SDK status %d, %u bits\n",
+                   set->name, p, len, st, fast_bits, sdk_st, sdk_bits);
+        }
+    }
+    printf("%-12s %zu rules, %zu packets, %zu compressed, %zu differ\n", set->name, set->nb_rules,
+           (size_t) NB_PACKETS, compressed, diffs);
+    schc_engine_free(&eng);
+    return diffs;
+}
+
+/* The service's own fast and SDK paths with the built-in rule */
+static size_t check_service(void) {
+    size_t diffs = 0;
+    for (size_t p = 0; p < NB_PACKETS; p++) {
+        const size_t len = make_packet();
+        const schc_status_t st = schc_service_check_fast_path(pkt, len);
+        if (st != SCHC_OK && diffs++ < 5) printf("built-in     packet %zu (%zu bytes): %d\n", p, len, st);
+    }
+    printf("%-12s 1 rule, %zu packets, %zu differ\n", "built-in", (size_t) NB_PACKETS, diffs);
+    return diffs;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+    rng_seed(&rng, 0x5c4c);
+
+    memcpy(dev_ip, schc_service_dev_ip(), 16);
+    memcpy(app_ip, schc_service_app_ip(), 16);
+    dev_port[0] = (uint8_t) (schc_service_dev_port() >> 8);
+    dev_port[1] = (uint8_t) schc_service_dev_port();
+    app_port[0] = (uint8_t) (schc_service_app_port() >> 8);
+    app_port[1] = (uint8_t) schc_service_app_port();
+
+    size_t diffs = check_service();
+
+    static rule_set_desc_t sets[4];
+    size_t nb_sets = 0;
+    make_sets(sets, &nb_sets);
+    for (size_t i = 0; i < nb_sets; i++) diffs += check_engine(&sets[i]);
+
+    printf("packets where the fast path and the SDK differ: %zu\n", diffs);
+    logger_fini();
+    return diffs ? EXIT_FAILURE : EXIT_SUCCESS;
+}
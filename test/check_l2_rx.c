@@ -0,0 +1,249 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/l2/l2_rx.h"
+
+/*
+ * Downlink parser on a synthetic ahoi serial stream with a known content:
+ * stuffed frames with and without footer, line noise between them, frames
+ * cut short by a new DLE STX or by an invalid escape, frames shorter than
+ * their header says and frames longer than L2_RX_MAX_FRAME. The stream is
+ * written to a pipe in random 1..97 byte chunks, so frames and DLE pairs
+ * straddle reads, and then fed from memory in one call; it is many times the
+ * ring, so frames also straddle the ring boundary. Every dispatched frame is
+ * compared with the one encoded, and every kind of damage with the count
+ * injected. Runs once with random payloads and once with DLE-only payloads.
+ * Exits non-zero on any difference.
+ */
+
+#define NB_FRAMES 5000
+#define FOOTER_SIZE 5
+#define RING_SIZE 4096
+#define MAX_CHUNK 97
+
+typedef enum {
+    FRAME_OK, FRAME_ABORT_STX, FRAME_ABORT_ESCAPE, FRAME_MALFORMED, FRAME_OVERSIZE, NB_FRAME_KINDS
+} frame_kind_t;
+
+typedef struct {
+    uint8_t hdr[L2_RX_HDR_SIZE];
+    uint8_t footer_len;
+    uint8_t body[255 + FOOTER_SIZE];
+} ref_frame_t;
+
+typedef struct {
+    size_t frames;
+    size_t aborted;
+    size_t malformed;
+    size_t oversize;
+    size_t wrapped;         // frames crossing the end of the ring
+} expected_t;
+
+static ref_frame_t* refs;
+static uint8_t* stream;
+static size_t stream_len;
+static size_t ring_cap;
+static expected_t expected;
+
+static size_t next_ref;
+static size_t mismatches;
+
+static uint32_t rng = 12345;
+static uint32_t rnd(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Never DLE, so it cannot open or close anything
+static uint8_t noise(void) {
+    return (uint8_t) (0x20 + rnd() % 0x60);
+}
+
+static void put_stuffed(const uint8_t b) {
+    if (b == 0x10) stream[stream_len++] = 0x10;
+    stream[stream_len++] = b;
+}
+
+static void put_noise(const uint32_t max) {
+    for (uint32_t n = rnd() % max; n; n--) stream[stream_len++] = noise();
+}
+
+// Where the l2_rx ring puts stream byte off: it reads from offset 0 and never drops bytes here
+static void note_wrap(const size_t start, const size_t end) {
+    if (start / ring_cap != (end - 1) / ring_cap) expected.wrapped++;
+}
+
+static frame_kind_t pick_kind(const size_t i) {
+    if (i % 11 == 3) return FRAME_ABORT_STX;
+    if (i % 13 == 5) return FRAME_ABORT_ESCAPE;
+    if (i % 17 == 7) return FRAME_MALFORMED;
+    if (i % 19 == 9) return FRAME_OVERSIZE;
+    return FRAME_OK;
+}
+
+// dle_heavy: every payload byte is DLE, the worst case for stuffing
+static void build_stream(const int dle_heavy) {
+    stream_len = 0;
+    memset(&expected, 0, sizeof(expected));
+
+    for (size_t i = 0; i < NB_FRAMES; i++) {
+        put_noise(8);
+        const size_t start = stream_len;
+        stream[stream_len++] = 0x10;
+        stream[stream_len++] = 0x02;
+
+        const frame_kind_t kind = pick_kind(i);
+        if (kind == FRAME_ABORT_STX) {
+            // The next frame's DLE STX cuts this one short
+            for (uint32_t n = 1 + rnd() % 20; n; n--) put_stuffed(dle_heavy ? 0x10 : noise());
+            expected.aborted++;
+            continue;
+        }
+        if (kind == FRAME_ABORT_ESCAPE) {
+            for (uint32_t n = rnd() % 20; n; n--) put_stuffed(dle_heavy ? 0x10 : noise());
+            stream[stream_len++] = 0x10;
+            stream[stream_len++] = 'A';
+            put_noise(20);
+            expected.aborted++;
+            continue;
+        }
+        if (kind == FRAME_OVERSIZE) {
+            // Without a DLE STX inside once unstuffed, so nothing after the drop looks like a frame
+            for (size_t n = L2_RX_MAX_FRAME + 1 + rnd() % 64; n; n--) put_stuffed(dle_heavy ? 0x10 : noise());
+            stream[stream_len++] = 0x10;
+            stream[stream_len++] = 0x03;
+            expected.oversize++;
+            continue;
+        }
+
+        ref_frame_t* r = &refs[expected.frames];
+        const uint8_t len = (uint8_t) (rnd() % 129);
+        r->hdr[0] = (uint8_t) rnd();
+        r->hdr[1] = (uint8_t) (i % 3 ? rnd() : 0x10);
+        r->hdr[2] = (uint8_t) rnd();
+        r->hdr[3] = (uint8_t) rnd();
+        r->hdr[4] = (uint8_t) i;
+        r->hdr[5] = len;
+        r->footer_len = i % 2 ? FOOTER_SIZE : 0;
+        for (size_t k = 0; k < len + r->footer_len; k++) {
+            r->body[k] = dle_heavy ? 0x10 : (uint8_t) (rnd() % 4 ? rnd() : 0x10);
+        }
+
+        if (kind == FRAME_MALFORMED) {
+            // The header announces more payload than there is
+            r->hdr[5] = (uint8_t) (len + 1 + rnd() % 64);
+            r->footer_len = 0;
+            expected.malformed++;
+        }
+        for (size_t k = 0; k < L2_RX_HDR_SIZE; k++) put_stuffed(r->hdr[k]);
+        for (size_t k = 0; k < len + r->footer_len; k++) put_stuffed(r->body[k]);
+        stream[stream_len++] = 0x10;
+        stream[stream_len++] = 0x03;
+
+        if (kind == FRAME_OK) {
+            note_wrap(start, stream_len);
+            expected.frames++;
+        }
+    }
+}
+
+static void check_frame(const l2_rx_frame_t* f, void* ctx) {
+    (void) ctx;
+    if (next_ref >= expected.frames) {
+        mismatches++;
+        return;
+    }
+    const ref_frame_t* r = &refs[next_ref++];
+    if (f->meta.src != r->hdr[0] || f->meta.dst != r->hdr[1] || f->meta.type != r->hdr[2] ||
+        f->meta.flags != r->hdr[3] || f->meta.seq != r->hdr[4] || f->len != r->hdr[5] ||
+        f->footer_len != r->footer_len || f->footer != f->payload + f->len ||
+        memcmp(f->payload, r->body, f->len + f->footer_len) != 0) {
+        mismatches++;
+    }
+}
+
+static int check_stats(const char* how, const l2_rx_stats_t* st) {
+    const int ok = !mismatches && next_ref == expected.frames && st->frames == expected.frames &&
+                   st->aborted == expected.aborted && st->malformed == expected.malformed &&
+                   st->oversize == expected.oversize && !st->overflows && st->bytes == stream_len;
+    printf("  %-22s %llu/%zu frames, %zu mismatches, aborted %llu/%zu, malformed %llu/%zu, "
+           "oversize %llu/%zu -> %s\n",
+           how, (unsigned long long) st->frames, expected.frames, mismatches,
+           (unsigned long long) st->aborted, expected.aborted, (unsigned long long) st->malformed,
+           expected.malformed, (unsigned long long) st->oversize, expected.oversize, ok ? "OK" : "FAILED");
+    return ok ? 0 : -1;
+}
+
+static int check_through_pipe(void) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    next_ref = 0;
+    mismatches = 0;
+    if (l2_rx_init(RING_SIZE, check_frame, NULL) != L2_RX_OK) return -1;
+
+    for (size_t off = 0; off < stream_len;) {
+        size_t n = 1 + rnd() % MAX_CHUNK;
+        if (n > stream_len - off) n = stream_len - off;
+        if (write(fds[1], stream + off, n) != (ssize_t) n) return -1;
+        if (l2_rx_poll(fds[0]) != L2_RX_OK) return -1;
+        off += n;
+    }
+    // Nothing left: the read must report EAGAIN, not an error
+    const l2_rx_status drained = l2_rx_poll(fds[0]);
+
+    l2_rx_stats_t st;
+    l2_rx_get_stats(&st);
+    l2_rx_fini();
+    close(fds[0]);
+    close(fds[1]);
+    const int rc = check_stats("reads of 1..97 bytes", &st);
+    return drained == L2_RX_OK ? rc : -1;
+}
+
+static int check_feed(void) {
+    next_ref = 0;
+    mismatches = 0;
+    if (l2_rx_init(RING_SIZE, check_frame, NULL) != L2_RX_OK) return -1;
+    const size_t fed = l2_rx_feed(stream, stream_len);
+
+    l2_rx_stats_t st;
+    l2_rx_get_stats(&st);
+    l2_rx_fini();
+    const int rc = check_stats("fed in one call", &st);
+    return fed == stream_len ? rc : -1;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+
+    // Same rounding as l2_rx_init()
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    ring_cap = page;
+    while (ring_cap < RING_SIZE || ring_cap < 2 * (L2_RX_MAX_FRAME + 2)) ring_cap <<= 1;
+
+    refs = malloc(NB_FRAMES * sizeof(*refs));
+    stream = malloc((size_t) NB_FRAMES * (2 * (L2_RX_HDR_SIZE + L2_RX_MAX_FRAME + 64) + 64));
+    if (!refs || !stream) return EXIT_FAILURE;
+
+    int rc = EXIT_SUCCESS;
+    for (int dle_heavy = 0; dle_heavy < 2; dle_heavy++) {
+        build_stream(dle_heavy);
+        printf("%s: %zu bytes, %zu frames across the %zu byte ring's end\n",
+               dle_heavy ? "DLE-only payloads" : "random payloads, 25% DLE bytes", stream_len,
+               expected.wrapped, ring_cap);
+        if (!expected.wrapped || check_through_pipe() != 0 || check_feed() != 0) rc = EXIT_FAILURE;
+    }
+
+    free(refs);
+    free(stream);
+    logger_fini();
+    return rc;
+}
@@ -0,0 +1,232 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <schc_sdk/schccomp.h>
+
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_rule_engine.h"
+#include "schc_demo_app/services/schc_service.h"
+
+/*
+ * Rule reloads while other threads compress, bounded version of
+ * bench/bench_reload.c.
+ * Two rule sets cover the same NB_RULES flows: A matches every field and
+ * uses rule IDs from 30, B sends the device port as residue and uses rule
+ * IDs from 160. COMPRESSORS threads compress the packets in a loop with
+ * schc_service_compress() and schc_service_compress_pkt() while the main
+ * thread swaps A and B in NB_RELOADS times, alternating
+ * schc_service_reload_rules() with an image and schc_service_set_rules().
+ * Every output must be exactly what A or B alone produce for that packet;
+ * anything else means a compressor saw a half-built or freed set. The
+ * per-thread counters must add up to the packets compressed. Best run
+ * under a sanitizer as well.
+ */
+
+#define NB_RULES 16
+#define NB_FIELDS SCHC_NB_HDR_FIELDS
+#define NB_PACKETS 256
+#define PKT_CAP 128
+#define COMPRESSORS 4
+#define NB_RELOADS 400
+#define DEFAULT_RULE_ID 150
+
+static const uint8_t ipv6_version = 0x60;
+static const uint8_t ipv6_tc = 0;
+static const uint8_t ipv6_fl[] = {0, 0, 0};
+static const uint8_t ipv6_nh = 17;
+static const uint8_t ipv6_hl = 255;
+
+static uint8_t dev_ips[NB_RULES][16];
+static uint8_t app_ips[NB_RULES][16];
+static uint8_t dev_ports[NB_RULES][2];
+static uint8_t app_ports[NB_RULES][2];
+static schc_field_desc_t fields[2][NB_RULES][NB_FIELDS];
+static schc_rule_desc_t rules[2][NB_RULES];
+
+static uint8_t packets[NB_PACKETS][PKT_CAP];
+static size_t packet_lens[NB_PACKETS];
+static uint8_t expected[2][NB_PACKETS][PKT_CAP];
+static size_t expected_lens[2][NB_PACKETS];
+
+static atomic_bool stop = false;
+static _Atomic uint64_t mismatches = 0;
+
+typedef struct {
+    pthread_t thread;
+    size_t first;           // packet the thread starts at
+    uint64_t packets;
+    uint64_t seen[2];
+} compressor_t;
+
+static void make_rules(const size_t set) {
+    for (size_t i = 0; i < NB_RULES; i++) {
+        memcpy(dev_ips[i], schc_service_dev_ip(), 16);
+        dev_ips[i][15] = (uint8_t) (i + 1);
+        memcpy(app_ips[i], schc_service_app_ip(), 16);
+        app_ips[i][15] = (uint8_t) (2 + i % 8);
+        const uint16_t aport = (uint16_t) (schc_service_app_port() + i % 16);
+        dev_ports[i][0] = (uint8_t) (schc_service_dev_port() >> 8);
+        dev_ports[i][1] = (uint8_t) schc_service_dev_port();
+        app_ports[i][0] = (uint8_t) (aport >> 8);
+        app_ports[i][1] = (uint8_t) aport;
+
+        const schc_field_desc_t f[NB_FIELDS] = {
+            { FID_IPV6_VERSION,        4,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_version, 0 },
+            { FID_IPV6_TRAFFIC_CLASS,  8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_tc, 0 },
+            { FID_IPV6_FLOW_LABEL,     20, MO_IGNORE, CDA_NOT_SENT,         ipv6_fl, 0 },
+            { FID_IPV6_PAYLOAD_LENGTH, 16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+            { FID_IPV6_NEXT_HEADER,    8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_nh, 0 },
+            { FID_IPV6_HOP_LIMIT,      8,  MO_IGNORE, CDA_NOT_SENT,         &ipv6_hl, 0 },
+            { FID_IPV6_PREFIX_DEV,     64, MO_EQUAL,  CDA_NOT_SENT,         dev_ips[i], 0 },
+            { FID_IPV6_IID_DEV,        64, MO_EQUAL,  CDA_NOT_SENT,         dev_ips[i] + 8, 0 },
+            { FID_IPV6_PREFIX_APP,     64, MO_EQUAL,  CDA_NOT_SENT,         app_ips[i], 0 },
+            { FID_IPV6_IID_APP,        64, MO_EQUAL,  CDA_NOT_SENT,         app_ips[i] + 8, 0 },
+            set ? (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 }
+                : (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_EQUAL, CDA_NOT_SENT, dev_ports[i], 0 },
+            { FID_UDP_PORT_APP,        16, MO_EQUAL,  CDA_NOT_SENT,         app_ports[i], 0 },
+            { FID_UDP_LENGTH,          16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+            { FID_UDP_CHECKSUM,        16, MO_IGNORE, CDA_COMPUTE_CHECKSUM, NULL, 0 },
+        };
+        memcpy(fields[set][i], f, sizeof(f));
+        rules[set][i] = (schc_rule_desc_t){ (uint16_t) ((set ? 160 : 30) + i), NB_FIELDS, fields[set][i] };
+    }
+}
+
+static void make_packets(void) {
+    for (size_t p = 0; p < NB_PACKETS; p++) {
+        const size_t i = p * 37 % NB_RULES;
+        ipv6_udp_cfg_t cfg = {0};
+        memcpy(cfg.src_ip, dev_ips[i], 16);
+        memcpy(cfg.dst_ip, app_ips[i], 16);
+        cfg.src_port = (uint16_t) (dev_ports[i][0] << 8 | dev_ports[i][1]);
+        cfg.dst_port = (uint16_t) (app_ports[i][0] << 8 | app_ports[i][1]);
+        cfg.next_header = 17;
+        cfg.hop_limit = 255;
+        // One packet in eight is from an unknown device: the no-compression rule, same in A and B
+        if (p % 8 == 7) cfg.src_ip[8] ^= 0x40;
+        const uint8_t payload[6] = { (uint8_t) p, (uint8_t) (p >> 8), 1, 2, 3, 4 };
+        if (build_ipv6_udp_packet(&cfg, 0, payload, sizeof(payload), packets[p], PKT_CAP, &packet_lens[p]) != 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static int matches(const size_t p, const uint8_t* out, const size_t len, compressor_t* c) {
+    for (size_t s = 0; s < 2; s++) {
+        if (len == expected_lens[s][p] && memcmp(out, expected[s][p], len) == 0) {
+            c->seen[s]++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* compressor(void* arg) {
+    compressor_t* c = arg;
+    uint8_t out[PKT_CAP];
+    uint8_t storage[PKTBUF_HEADROOM + PKT_CAP];
+    size_t p = c->first;
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        for (int k = 0; k < 16; k++, p = (p + 1) % NB_PACKETS) {
+            size_t len;
+            if (k & 1) {
+                pktbuf_t pb;
+                pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+                memcpy(pktbuf_put(&pb, packet_lens[p]), packets[p], packet_lens[p]);
+                if (schc_service_compress_pkt(&pb) != SCHC_OK || !matches(p, pktbuf_data(&pb), pb.len, c)) {
+                    atomic_fetch_add(&mismatches, 1);
+                }
+            } else if (schc_service_compress(packets[p], packet_lens[p], out, sizeof(out), &len) != SCHC_OK ||
+                       !matches(p, out, len, c)) {
+                atomic_fetch_add(&mismatches, 1);
+            }
+            c->packets++;
+        }
+    }
+    return NULL;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    char image_a[] = "/tmp/check-reload-a-XXXXXX";
+    char image_b[] = "/tmp/check-reload-b-XXXXXX";
+    const int fa = mkstemp(image_a), fb = mkstemp(image_b);
+    if (fa < 0 || fb < 0) return EXIT_FAILURE;
+    close(fa);
+    close(fb);
+    const char* images[2] = { image_a, image_b };
+
+    make_rules(0);
+    make_packets();
+    make_rules(1);
+    for (size_t s = 0; s < 2; s++) {
+        schc_engine_t eng;
+        if (schc_engine_compile(&eng, rules[s], NB_RULES, 8, DEFAULT_RULE_ID) != SCHC_ENGINE_OK ||
+            schc_engine_save(&eng, images[s]) != SCHC_ENGINE_OK) {
+            return EXIT_FAILURE;
+        }
+        schc_engine_free(&eng);
+
+        // Reference outputs, one set at a time
+        if (schc_service_reload_rules(images[s]) != SCHC_OK) return EXIT_FAILURE;
+        for (size_t p = 0; p < NB_PACKETS; p++) {
+            if (schc_service_compress(packets[p], packet_lens[p], expected[s][p], PKT_CAP,
+                                      &expected_lens[s][p]) != SCHC_OK) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    schc_service_stats_t before;
+    schc_service_get_stats(&before);
+
+    compressor_t cs[COMPRESSORS];
+    memset(cs, 0, sizeof(cs));
+    for (size_t t = 0; t < COMPRESSORS; t++) {
+        cs[t].first = t * NB_PACKETS / COMPRESSORS;
+        if (pthread_create(&cs[t].thread, NULL, compressor, &cs[t]) != 0) return EXIT_FAILURE;
+    }
+
+    size_t failed_reloads = 0;
+    for (size_t r = 0; r < NB_RELOADS; r++) {
+        const size_t s = r & 1;
+        const schc_status_t st = r & 2 ? schc_service_set_rules(rules[s], NB_RULES, 8, DEFAULT_RULE_ID)
+                                       : schc_service_reload_rules(images[s]);
+        if (st != SCHC_OK) failed_reloads++;
+        // Let the compressors start on every set on a single CPU too
+        if (r % 16 == 0) usleep(100);
+    }
+    atomic_store(&stop, true);
+
+    uint64_t packets_done = 0, seen[2] = {0, 0};
+    for (size_t t = 0; t < COMPRESSORS; t++) {
+        pthread_join(cs[t].thread, NULL);
+        packets_done += cs[t].packets;
+        seen[0] += cs[t].seen[0];
+        seen[1] += cs[t].seen[1];
+    }
+
+    schc_service_stats_t after;
+    schc_service_get_stats(&after);
+    const uint64_t counted = after.compressed + after.failed - before.compressed - before.failed;
+
+    schc_service_set_rule_file(NULL);
+    unlink(image_a);
+    unlink(image_b);
+
+    const uint64_t bad = atomic_load(&mismatches);
+    printf("%d reloads (%zu failed), %d compressor threads: %llu packets, %llu counted, "
+           "%llu / %llu from set A / B, %llu matching neither\n",
+           NB_RELOADS, failed_reloads, COMPRESSORS, (unsigned long long) packets_done, (unsigned long long) counted,
+           (unsigned long long) seen[0], (unsigned long long) seen[1], (unsigned long long) bad);
+    logger_fini();
+    return bad || failed_reloads || counted != packets_done || !seen[0] || !seen[1] ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,306 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schc_demo_app/rng.h"
+#include "schc_demo_app/services/sensor_service.h"
+
+/*
+ * Statistical checks of rng.h, against the rand()-based code it replaced,
+ * kept below as reference:
+ *  - normal deviates of the ziggurat and of the Box-Muller reference:
+ *    moments, Kolmogorov-Smirnov against the normal CDF, tail frequencies,
+ *    and a two-sample KS test of one against the other;
+ *  - measure() against the reference readings, field by field (two-sample KS);
+ *  - rng_below(): chi-square over n cells; rng_uniform(): moments;
+ *  - bulk fills give what single draws give, seeds and streams replay.
+ * Tests are at the 0.001 level with fixed seeds, so a run is reproducible.
+ * The cost per draw is measured by bench/bench_rng.c.
+ * Exits non-zero if any check fails.
+ */
+
+#define NB_NORMAL (1u << 22)
+#define NB_READINGS (1u << 20)
+#define NB_CELLS_DRAWS (1u << 24)
+#define FILL_BLOCK 1024
+
+#define KS_C 1.949          // Kolmogorov-Smirnov critical value, 0.001 level
+#define Z_C 3.09            // one-sided normal quantile, 0.001 level
+#define MAX_SE 5.0          // moments and frequencies: within 5 standard errors
+
+static size_t failures;
+
+static void check(const int ok, const char* what, const double value, const double bound) {
+    printf("  %-52s %12.6f  (bound %.6f)%s\n", what, value, bound, ok ? "" : "  FAIL");
+    if (!ok) failures++;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Before rng.h: gaussian_random() and measure() on rand()                  */
+/* ------------------------------------------------------------------------ */
+
+static double ref_gaussian(const double mean, const double stddev) {
+    double u1, u2;
+    do {
+        u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+        u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    } while (u1 <= 0.0 || u2 <= 0.0);
+    const double mag = sqrt(-2.0 * log(u1));
+    return mean + mag * cos(2.0 * M_PI * u2) * stddev;
+}
+
+static void ref_measure(sensor_data_t* data) {
+    data->temp = 5.0f + (float) rand() / (float) RAND_MAX * 10.0f;
+    if ((rand() % 100) < 95) {
+        data->pH = 6.5f + (float) rand() / (float) RAND_MAX * 2.0f;
+    } else {
+        data->pH = (float) rand() / (float) RAND_MAX * 14.0f;
+    }
+    data->bat = (uint8_t) (rand() % 101);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Statistics                                                               */
+/* ------------------------------------------------------------------------ */
+
+static int cmp_double(const void* a, const void* b) {
+    const double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static double normal_cdf(const double x) {
+    return 0.5 * erfc(-x / M_SQRT2);
+}
+
+// Largest distance between the empirical CDF of sorted x and the normal CDF
+static double ks_normal(const double* x, const size_t n) {
+    double d = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const double f = normal_cdf(x[i]);
+        const double lo = f - (double) i / (double) n, hi = (double) (i + 1) / (double) n - f;
+        if (lo > d) d = lo;
+        if (hi > d) d = hi;
+    }
+    return d;
+}
+
+// Largest distance between the empirical CDFs of sorted a and b
+static double ks_two(const double* a, const size_t na, const double* b, const size_t nb) {
+    size_t i = 0, j = 0;
+    double d = 0.0;
+    while (i < na && j < nb) {
+        const double v = a[i] < b[j] ? a[i] : b[j];
+        while (i < na && a[i] <= v) i++;
+        while (j < nb && b[j] <= v) j++;
+        const double diff = fabs((double) i / (double) na - (double) j / (double) nb);
+        if (diff > d) d = diff;
+    }
+    return d;
+}
+
+static double ks_two_bound(const size_t na, const size_t nb) {
+    return KS_C * sqrt((double) (na + nb) / ((double) na * (double) nb));
+}
+
+static void normal_checks(const char* name, double* x, const size_t n) {
+    double m1 = 0.0, m2 = 0.0, m3 = 0.0, m4 = 0.0;
+    for (size_t i = 0; i < n; i++) m1 += x[i];
+    m1 /= (double) n;
+    for (size_t i = 0; i < n; i++) {
+        const double d = x[i] - m1, d2 = d * d;
+        m2 += d2;
+        m3 += d2 * d;
+        m4 += d2 * d2;
+    }
+    m2 /= (double) n;
+    m3 /= (double) n;
+    m4 /= (double) n;
+    const double nn = (double) n;
+    char what[64];
+
+    printf("%s, %zu deviates\n", name, n);
+    check(fabs(m1) < MAX_SE / sqrt(nn), "mean", m1, MAX_SE / sqrt(nn));
+    check(fabs(m2 - 1.0) < MAX_SE * sqrt(2.0 / nn), "variance - 1", m2 - 1.0, MAX_SE * sqrt(2.0 / nn));
+    const double skew = m3 / pow(m2, 1.5), kurt = m4 / (m2 * m2) - 3.0;
+    check(fabs(skew) < MAX_SE * sqrt(6.0 / nn), "skewness", skew, MAX_SE * sqrt(6.0 / nn));
+    check(fabs(kurt) < MAX_SE * sqrt(24.0 / nn), "excess kurtosis", kurt, MAX_SE * sqrt(24.0 / nn));
+
+    // The ziggurat switches to its tail sampler at 3.44
+    static const double tails[] = { 1.0, 2.0, 3.442619855899, 4.0, 4.5 };
+    for (size_t t = 0; t < sizeof(tails) / sizeof(tails[0]); t++) {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++) count += fabs(x[i]) > tails[t];
+        const double p = erfc(tails[t] / M_SQRT2);
+        const double se = sqrt(nn * p * (1.0 - p));
+        snprintf(what, sizeof(what), "|x| > %.2f: count - expected (%.0f)", tails[t], nn * p);
+        check(fabs((double) count - nn * p) < MAX_SE * se, what, (double) count - nn * p, MAX_SE * se);
+    }
+
+    qsort(x, n, sizeof(*x), cmp_double);
+    const double d = ks_normal(x, n);
+    check(d < KS_C / sqrt(nn), "Kolmogorov-Smirnov distance to N(0, 1)", d, KS_C / sqrt(nn));
+}
+
+// Pearson chi-square of rng_below(cells) against the uniform law
+static void cells_check(rng_t* rng, const uint32_t cells) {
+    uint32_t* count = calloc(cells, sizeof(*count));
+    if (!count) return;
+    for (uint32_t i = 0; i < NB_CELLS_DRAWS; i++) count[rng_below(rng, cells)]++;
+    const double expected = (double) NB_CELLS_DRAWS / cells;
+    double chi2 = 0.0;
+    for (uint32_t c = 0; c < cells; c++) chi2 += (count[c] - expected) * (count[c] - expected) / expected;
+    free(count);
+
+    // Wilson-Hilferty approximation of the chi-square quantile
+    const double df = cells - 1.0, h = 2.0 / (9.0 * df);
+    const double bound = df * pow(1.0 - h + Z_C * sqrt(h), 3.0);
+    char what[64];
+    snprintf(what, sizeof(what), "rng_below(%u): chi-square, %u df", cells, cells - 1);
+    check(chi2 < bound, what, chi2, bound);
+}
+
+static void uniform_checks(void) {
+    rng_t rng;
+    rng_seed(&rng, 1);
+    printf("uniform draws\n");
+    cells_check(&rng, 100);
+    cells_check(&rng, 101);
+    cells_check(&rng, 256);
+
+    double m1 = 0.0, m2 = 0.0;
+    for (uint32_t i = 0; i < NB_CELLS_DRAWS; i++) {
+        const double u = rng_uniform(&rng);
+        m1 += u;
+        m2 += u * u;
+    }
+    const double n = NB_CELLS_DRAWS;
+    m1 /= n;
+    m2 = m2 / n - m1 * m1;
+    // Uniform on [0, 1): mean 1/2, variance 1/12, fourth central moment 1/80
+    check(fabs(m1 - 0.5) < MAX_SE * sqrt(1.0 / 12.0 / n), "rng_uniform(): mean - 1/2", m1 - 0.5,
+          MAX_SE * sqrt(1.0 / 12.0 / n));
+    const double var_se = sqrt((1.0 / 80.0 - 1.0 / 144.0) / n);
+    check(fabs(m2 - 1.0 / 12.0) < MAX_SE * var_se, "rng_uniform(): variance - 1/12", m2 - 1.0 / 12.0,
+          MAX_SE * var_se);
+}
+
+static void readings_check(void) {
+    double* a = malloc(NB_READINGS * sizeof(*a));
+    double* b = malloc(NB_READINGS * sizeof(*b));
+    sensor_data_t* before = malloc(NB_READINGS * sizeof(*before));
+    sensor_data_t* after = malloc(NB_READINGS * sizeof(*after));
+    if (!a || !b || !before || !after) {
+        failures++;
+        goto out;
+    }
+
+    srand(42);
+    rng_set_seed(42);
+    for (size_t i = 0; i < NB_READINGS; i++) {
+        ref_measure(&before[i]);
+        measure(&after[i]);
+    }
+
+    printf("measure() against the rand() version, %u readings each\n", NB_READINGS);
+    static const char* const names[] = { "temp", "pH", "bat" };
+    for (int f = 0; f < 3; f++) {
+        double ma = 0.0, mb = 0.0;
+        for (size_t i = 0; i < NB_READINGS; i++) {
+            a[i] = f == 0 ? before[i].temp : f == 1 ? before[i].pH : before[i].bat;
+            b[i] = f == 0 ? after[i].temp : f == 1 ? after[i].pH : after[i].bat;
+            ma += a[i];
+            mb += b[i];
+        }
+        qsort(a, NB_READINGS, sizeof(*a), cmp_double);
+        qsort(b, NB_READINGS, sizeof(*b), cmp_double);
+        const double d = ks_two(a, NB_READINGS, b, NB_READINGS);
+        char what[64];
+        snprintf(what, sizeof(what), "%s: two-sample KS (means %.3f, %.3f)", names[f], ma / NB_READINGS,
+                 mb / NB_READINGS);
+        check(d < ks_two_bound(NB_READINGS, NB_READINGS), what, d, ks_two_bound(NB_READINGS, NB_READINGS));
+    }
+
+out:
+    free(a);
+    free(b);
+    free(before);
+    free(after);
+}
+
+static void* draw_local(void* arg) {
+    *(uint64_t*) arg = rng_next(rng_local());
+    return NULL;
+}
+
+static void replay_checks(void) {
+    printf("seeding and bulk fills\n");
+    rng_t a, b;
+    static double fill[FILL_BLOCK];
+    static uint64_t fill_u[FILL_BLOCK];
+
+    rng_seed(&a, 7);
+    rng_seed(&b, 7);
+    rng_fill_normal(&a, fill, FILL_BLOCK, 2.0, 3.0);
+    size_t diff = 0;
+    for (size_t i = 0; i < FILL_BLOCK; i++) diff += fill[i] != 2.0 + 3.0 * rng_normal(&b);
+    rng_fill_uniform(&a, fill, FILL_BLOCK);
+    for (size_t i = 0; i < FILL_BLOCK; i++) diff += fill[i] != rng_uniform(&b);
+    rng_fill_u64(&a, fill_u, FILL_BLOCK);
+    for (size_t i = 0; i < FILL_BLOCK; i++) diff += fill_u[i] != rng_next(&b);
+    diff += memcmp(&a, &b, sizeof(a)) != 0;
+    check(diff == 0, "bulk fills against single draws: differences", (double) diff, 0.0);
+
+    // Same seed, same sequence; the first other thread to draw gets stream 1
+    rng_set_seed(42);
+    const uint64_t first = rng_next(rng_local());
+    uint64_t other = 0;
+    pthread_t t;
+    pthread_create(&t, NULL, draw_local, &other);
+    pthread_join(t, NULL);
+    rng_set_seed(42);
+    rng_seed_stream(&a, 42, 1);
+    const int same = rng_next(rng_local()) == first && rng_next(&a) == other && other != first;
+    check(same, "rng_set_seed(): replayed, other thread on stream 1", same, 1.0);
+
+    // Streams of one seed and seeds of one stream start apart
+    size_t equal = 0;
+    for (uint64_t s = 0; s < 64; s++) {
+        rng_seed_stream(&a, 1, s);
+        rng_seed_stream(&b, 1, s + 1);
+        equal += rng_next(&a) == rng_next(&b);
+        rng_seed_stream(&a, s, 1);
+        rng_seed_stream(&b, s + 1, 1);
+        equal += rng_next(&a) == rng_next(&b);
+    }
+    check(equal == 0, "adjacent streams and seeds: equal first draws", (double) equal, 0.0);
+}
+
+int main(void) {
+    double* x = malloc(NB_NORMAL * sizeof(*x));
+    if (!x) return EXIT_FAILURE;
+
+    rng_t rng;
+    rng_seed(&rng, 42);
+    rng_fill_normal(&rng, x, NB_NORMAL, 0.0, 1.0);
+    normal_checks("ziggurat", x, NB_NORMAL);
+
+    double* y = malloc(NB_NORMAL * sizeof(*y));
+    if (!y) return EXIT_FAILURE;
+    srand(42);
+    for (size_t i = 0; i < NB_NORMAL; i++) y[i] = ref_gaussian(0.0, 1.0);
+    normal_checks("Box-Muller on rand()", y, NB_NORMAL);
+
+    printf("ziggurat against Box-Muller\n");
+    const double d = ks_two(x, NB_NORMAL, y, NB_NORMAL);
+    check(d < ks_two_bound(NB_NORMAL, NB_NORMAL), "two-sample KS distance", d, ks_two_bound(NB_NORMAL, NB_NORMAL));
+    free(x);
+    free(y);
+
+    readings_check();
+    uniform_checks();
+    replay_checks();
+    printf("failed checks: %zu\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
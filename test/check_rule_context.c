@@ -0,0 +1,205 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <schc_sdk/schccomp.h>
+
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_rule_engine.h"
+#include "schc_demo_app/services/schc_service.h"
+
+/*
+ * The addresses and ports the service hands to the application
+ * (schc_service_dev_ip() and the other getters) must follow the rules in
+ * use, and never leak into the built-in rule.
+ * Reloads rule image A, then B, then goes back to the built-in rule; each
+ * time a packet built from the getters must compress with the rule just
+ * loaded, not with the no-compression rule. Image B sends the device port,
+ * so the getter keeps the built-in one for it. Back on the built-in rule the
+ * getters must be what they were at start, and a device context must still
+ * compress its own packets with the built-in rule.
+ */
+
+#define NB_FIELDS SCHC_NB_HDR_FIELDS
+#define BUILTIN_RULE_ID 28
+#define DEFAULT_RULE_ID 150
+#define PAYLOAD_LEN 24
+
+static const uint8_t ipv6_version = 0x60;
+static const uint8_t ipv6_tc = 0;
+static const uint8_t ipv6_fl[] = {0, 0, 0};
+static const uint8_t ipv6_nh = 17;
+static const uint8_t ipv6_hl = 255;
+
+typedef struct {
+    uint16_t rule_id;
+    bool sends_dev_port;
+    uint8_t dev_ip[16];
+    uint8_t app_ip[16];
+    uint8_t dev_port[2];
+    uint8_t app_port[2];
+} image_desc_t;
+
+static const image_desc_t image_descs[2] = {
+    { 40, false,
+      { 0x20,0x01,0x0d,0xb8, 0x00,0x0a,0x00,0x01, 0,0,0,0, 0,0,0,0x0a },
+      { 0x20,0x01,0x0d,0xb8, 0x00,0x0a,0x00,0x02, 0,0,0,0, 0,0,0,0x0b },
+      { 0xa0, 0x01 }, { 0xa0, 0x02 } },
+    { 60, true,
+      { 0xfd,0x00,0x00,0x00, 0x00,0x0b,0x00,0x01, 0,0,0,0, 0,0,0,0x1a },
+      { 0xfd,0x00,0x00,0x00, 0x00,0x0b,0x00,0x02, 0,0,0,0, 0,0,0,0x1b },
+      { 0, 0 }, { 0xb0, 0x02 } },
+};
+
+static uint8_t builtin_dev_ip[16];
+static uint8_t builtin_app_ip[16];
+static uint16_t builtin_dev_port;
+static uint16_t builtin_app_port;
+
+static int make_image(const image_desc_t* d, const char* path) {
+    const schc_field_desc_t f[NB_FIELDS] = {
+        { FID_IPV6_VERSION,        4,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_version, 0 },
+        { FID_IPV6_TRAFFIC_CLASS,  8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_tc, 0 },
+        { FID_IPV6_FLOW_LABEL,     20, MO_IGNORE, CDA_NOT_SENT,         ipv6_fl, 0 },
+        { FID_IPV6_PAYLOAD_LENGTH, 16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+        { FID_IPV6_NEXT_HEADER,    8,  MO_EQUAL,  CDA_NOT_SENT,         &ipv6_nh, 0 },
+        { FID_IPV6_HOP_LIMIT,      8,  MO_IGNORE, CDA_NOT_SENT,         &ipv6_hl, 0 },
+        { FID_IPV6_PREFIX_DEV,     64, MO_EQUAL,  CDA_NOT_SENT,         d->dev_ip, 0 },
+        { FID_IPV6_IID_DEV,        64, MO_EQUAL,  CDA_NOT_SENT,         d->dev_ip + 8, 0 },
+        { FID_IPV6_PREFIX_APP,     64, MO_EQUAL,  CDA_NOT_SENT,         d->app_ip, 0 },
+        { FID_IPV6_IID_APP,        64, MO_EQUAL,  CDA_NOT_SENT,         d->app_ip + 8, 0 },
+        d->sends_dev_port ? (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_IGNORE, CDA_VALUE_SENT, NULL, 0 }
+                          : (schc_field_desc_t){ FID_UDP_PORT_DEV, 16, MO_EQUAL, CDA_NOT_SENT, d->dev_port, 0 },
+        { FID_UDP_PORT_APP,        16, MO_EQUAL,  CDA_NOT_SENT,         d->app_port, 0 },
+        { FID_UDP_LENGTH,          16, MO_IGNORE, CDA_COMPUTE_LENGTH,   NULL, 0 },
+        { FID_UDP_CHECKSUM,        16, MO_IGNORE, CDA_COMPUTE_CHECKSUM, NULL, 0 },
+    };
+    const schc_rule_desc_t rule = { d->rule_id, NB_FIELDS, f };
+
+    schc_engine_t eng;
+    if (schc_engine_compile(&eng, &rule, 1, 8, DEFAULT_RULE_ID) != SCHC_ENGINE_OK) return -1;
+    const int rc = schc_engine_save(&eng, path) == SCHC_ENGINE_OK ? 0 : -1;
+    schc_engine_free(&eng);
+    return rc;
+}
+
+/* Rule ID a packet of the application's flow compresses with, -1 on error */
+static int compress_app_packet(void) {
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, schc_service_dev_ip(), 16);
+    memcpy(cfg.dst_ip, schc_service_app_ip(), 16);
+    cfg.src_port = schc_service_dev_port();
+    cfg.dst_port = schc_service_app_port();
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+
+    uint8_t payload[PAYLOAD_LEN];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t) i;
+    uint8_t pkt[SCHC_HDR_LEN + PAYLOAD_LEN];
+    uint8_t out[sizeof(pkt) + 2];
+    size_t len = 0, out_len = 0;
+    if (build_ipv6_udp_packet(&cfg, schc_service_flow_label(), payload, sizeof(payload),
+                              pkt, sizeof(pkt), &len) != 0 ||
+        schc_service_compress(pkt, len, out, sizeof(out), &out_len) != SCHC_OK || !out_len) {
+        return -1;
+    }
+    return out[0];
+}
+
+static int check_getters(const char* label, const uint8_t dev_ip[16], const uint8_t app_ip[16],
+                         uint16_t dev_port, uint16_t app_port) {
+    const bool ok = memcmp(schc_service_dev_ip(), dev_ip, 16) == 0 &&
+                    memcmp(schc_service_app_ip(), app_ip, 16) == 0 &&
+                    schc_service_dev_port() == dev_port && schc_service_app_port() == app_port;
+    if (!ok) printf("%-10s addresses or ports not those of the rules\n", label);
+    return ok ? 0 : 1;
+}
+
+static int check_rule_id(const char* label, int expected) {
+    const int rule_id = compress_app_packet();
+    printf("%-10s application packet compressed with rule %d, expected %d\n", label, rule_id, expected);
+    return rule_id == expected ? 0 : 1;
+}
+
+/* A device context derives from the built-in rule whatever was loaded before */
+static int check_dev_ctx(void) {
+    const uint8_t iid[8] = { 0, 0, 0, 0, 0, 0, 0x12, 0x34 };
+    schc_dev_ctx_t* ctx = schc_service_dev_ctx_new(iid);
+    if (!ctx) {
+        printf("device context not created\n");
+        return 1;
+    }
+
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, schc_service_dev_ctx_ip(ctx), 16);
+    memcpy(cfg.dst_ip, builtin_app_ip, 16);
+    cfg.src_port = builtin_dev_port;
+    cfg.dst_port = builtin_app_port;
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+
+    uint8_t storage[PKTBUF_HEADROOM + SCHC_HDR_LEN + PAYLOAD_LEN];
+    pktbuf_t pb;
+    pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+    memset(pktbuf_put(&pb, PAYLOAD_LEN), 0x5a, PAYLOAD_LEN);
+    ipv6_udp_tpl_t tpl;
+    int bad = memcmp(schc_service_dev_ctx_ip(ctx), builtin_dev_ip, 8) != 0;
+    if (ipv6_udp_tpl_init(&tpl, &cfg, schc_service_flow_label()) != 0 || ipv6_udp_tpl_push(&tpl, &pb) != 0 ||
+        schc_service_compress_pkt_dev(ctx, &pb) != SCHC_OK || pktbuf_data(&pb)[0] != BUILTIN_RULE_ID) {
+        bad = 1;
+    }
+    printf("%-10s device packet %s\n", "device", bad ? "not compressed with the built-in rule" : "ok");
+    schc_service_dev_ctx_free(ctx);
+    return bad;
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    memcpy(builtin_dev_ip, schc_service_dev_ip(), 16);
+    memcpy(builtin_app_ip, schc_service_app_ip(), 16);
+    builtin_dev_port = schc_service_dev_port();
+    builtin_app_port = schc_service_app_port();
+
+    char image_a[] = "/tmp/check-rule-context-a-XXXXXX";
+    char image_b[] = "/tmp/check-rule-context-b-XXXXXX";
+    const int fa = mkstemp(image_a), fb = mkstemp(image_b);
+    if (fa < 0 || fb < 0) return EXIT_FAILURE;
+    close(fa);
+    close(fb);
+    const char* images[2] = { image_a, image_b };
+
+    int failures = check_rule_id("built-in", BUILTIN_RULE_ID);
+    for (size_t i = 0; i < 2; i++) {
+        const image_desc_t* d = &image_descs[i];
+        const char* label = i ? "image B" : "image A";
+        if (make_image(d, images[i]) != 0 || schc_service_reload_rules(images[i]) != SCHC_OK) {
+            printf("%-10s not loaded\n", label);
+            failures++;
+            continue;
+        }
+        const uint16_t dev_port = d->sends_dev_port ? builtin_dev_port
+                                                    : (uint16_t) (d->dev_port[0] << 8 | d->dev_port[1]);
+        failures += check_getters(label, d->dev_ip, d->app_ip, dev_port,
+                                  (uint16_t) (d->app_port[0] << 8 | d->app_port[1]));
+        failures += check_rule_id(label, d->rule_id);
+    }
+
+    if (schc_service_set_rule_file(NULL) != SCHC_OK || schc_service_reload_rules(NULL) != SCHC_OK) {
+        failures++;
+    } else {
+        failures += check_getters("built-in", builtin_dev_ip, builtin_app_ip, builtin_dev_port, builtin_app_port);
+        failures += check_rule_id("built-in", BUILTIN_RULE_ID);
+        failures += check_dev_ctx();
+    }
+
+    unlink(image_a);
+    unlink(image_b);
+    printf("failed checks: %d\n", failures);
+    logger_fini();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schc_demo_app/services/sensor_codec.h"
+
+/*
+ * Bit-packed sensor codec against its contract: a sample must take at
+ * least 40% less than the raw struct, every code of every field must
+ * survive dequantize/quantize unchanged, random values inside the range
+ * must decode within step / 2, values outside it (NaN and infinities too)
+ * must clamp to the nearest end, and random code sequences of every length
+ * must pack and unpack bit-exact, with zero padding and exact buffer sizes.
+ * Fixed seed. Exits non-zero if any check fails.
+ */
+
+#define RANDOM_VALUES 200000
+#define MAX_BATCH 40
+
+static size_t failures;
+
+static uint64_t rng = 0x853c49e6748fea9bull;
+static uint64_t rnd(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static double uniform(void) {
+    return (double) (rnd() >> 11) * 0x1.0p-53;
+}
+
+static double field_max(const sensor_field_t* f) {
+    return f->min + (double) ((1u << f->bits) - 1) * f->step;
+}
+
+static double get(const sensor_data_t* d, const sensor_field_t* f) {
+    const uint8_t* p = (const uint8_t*) d + f->offset;
+    if (f->type == SENSOR_FIELD_U8) return *p;
+    float v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void set(sensor_data_t* d, const sensor_field_t* f, const double v) {
+    uint8_t* p = (uint8_t*) d + f->offset;
+    if (f->type == SENSOR_FIELD_U8) {
+        *p = (uint8_t) v;
+        return;
+    }
+    const float fv = (float) v;
+    memcpy(p, &fv, sizeof(fv));
+}
+
+static void check(const int ok, const char* what, const char* field, const double value) {
+    if (ok) return;
+    if (failures++ < 10) printf("  FAIL %s: %s %.6f\n", what, field, value);
+}
+
+static void size_check(void) {
+    const size_t raw = sizeof(sensor_data_t);
+    const size_t packed = SENSOR_CODEC_SIZE(1);
+    printf("%-6s %10s %10s %6s %5s\n", "field", "min", "max", "step", "bits");
+    for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+        const sensor_field_t* f = &sensor_codec_fields[i];
+        printf("%-6s %10.2f %10.2f %6.2f %5u\n", f->name, f->min, field_max(f), f->step, f->bits);
+    }
+    printf("%d bits per sample: %zu bytes vs %zu raw (-%.0f%%), 16 samples: %zu bytes vs %zu\n", SENSOR_CODEC_BITS,
+           packed, raw, 100.0 * (1.0 - (double) packed / (double) raw), SENSOR_CODEC_SIZE(16), 16 * raw);
+    check(packed * 10 <= raw * 6, "less than 40% smaller", "sample", (double) packed);
+}
+
+/* Every representable value is a fixed point of dequantize/quantize */
+static void grid_check(void) {
+    for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+        const sensor_field_t* f = &sensor_codec_fields[i];
+        for (uint32_t c = 0; c < 1u << f->bits; c++) {
+            sensor_code_t code = {{0}}, back;
+            sensor_data_t d;
+            code.v[i] = c;
+            sensor_codec_dequantize(&code, &d);
+            sensor_codec_quantize(&d, &back);
+            check(back.v[i] == c, "grid", f->name, (double) c);
+        }
+    }
+}
+
+static void bound_check(void) {
+    double worst[SENSOR_CODEC_NB_FIELDS] = {0};
+    for (int r = 0; r < RANDOM_VALUES; r++) {
+        sensor_data_t in = {0}, out;
+        for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+            const sensor_field_t* f = &sensor_codec_fields[i];
+            const double v = f->type == SENSOR_FIELD_U8 ? (double) (rnd() % 101) : f->min + uniform() * (field_max(f) - f->min);
+            set(&in, f, v);
+        }
+        uint8_t buf[SENSOR_CODEC_SIZE(1)];
+        if (sensor_codec_encode(&in, 1, buf, sizeof(buf)) != sizeof(buf) ||
+            sensor_codec_decode(buf, sizeof(buf), &out, 1) != SENSOR_CODEC_OK) {
+            check(0, "encode/decode", "sample", r);
+            continue;
+        }
+        for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+            const sensor_field_t* f = &sensor_codec_fields[i];
+            const double err = fabs(get(&out, f) - get(&in, f));
+            if (err > worst[i]) worst[i] = err;
+            // float rounding of values up to ~100 adds at most a few 1e-6
+            check(err <= f->step / 2 + 1e-5, "bound", f->name, get(&in, f));
+        }
+    }
+    printf("worst error over %d random samples:", RANDOM_VALUES);
+    for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+        printf(" %s %.6f (bound %.4f)", sensor_codec_fields[i].name, worst[i], sensor_codec_fields[i].step / 2);
+    }
+    printf("\n");
+}
+
+static void clamp_check(void) {
+    for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+        const sensor_field_t* f = &sensor_codec_fields[i];
+        if (f->type == SENSOR_FIELD_U8) continue;
+        const double probes[] = { f->min - 100.0, field_max(f) + 100.0, NAN, -INFINITY, INFINITY };
+        const double expect[] = { f->min, field_max(f), f->min, f->min, field_max(f) };
+        for (size_t p = 0; p < sizeof(probes) / sizeof(probes[0]); p++) {
+            sensor_data_t in = {0}, out;
+            set(&in, f, probes[p]);
+            uint8_t buf[SENSOR_CODEC_SIZE(1)];
+            sensor_codec_encode(&in, 1, buf, sizeof(buf));
+            sensor_codec_decode(buf, sizeof(buf), &out, 1);
+            check(fabs(get(&out, f) - expect[p]) <= 1e-5, "clamp", f->name, probes[p]);
+        }
+    }
+}
+
+static void pack_check(void) {
+    for (size_t n = 1; n <= MAX_BATCH; n++) {
+        for (int r = 0; r < 100; r++) {
+            sensor_code_t codes[MAX_BATCH], back[MAX_BATCH];
+            for (size_t s = 0; s < n; s++) {
+                for (size_t i = 0; i < SENSOR_CODEC_NB_FIELDS; i++) {
+                    codes[s].v[i] = (uint32_t) rnd() & ((1u << sensor_codec_fields[i].bits) - 1);
+                }
+            }
+            uint8_t buf[SENSOR_CODEC_SIZE(MAX_BATCH)];
+            const size_t len = sensor_codec_pack(codes, n, buf, sizeof(buf));
+            check(len == SENSOR_CODEC_SIZE(n), "pack length", "batch", (double) n);
+            const unsigned pad = (unsigned) (len * 8 - n * SENSOR_CODEC_BITS);
+            check((buf[len - 1] & ((1u << pad) - 1)) == 0, "padding", "batch", (double) n);
+            check(sensor_codec_unpack(buf, len, back, n) == SENSOR_CODEC_OK &&
+                  memcmp(codes, back, n * sizeof(codes[0])) == 0, "pack/unpack", "batch", (double) n);
+        }
+        sensor_data_t out[MAX_BATCH];
+        uint8_t buf[SENSOR_CODEC_SIZE(MAX_BATCH)];
+        check(sensor_codec_encode(out, n, buf, SENSOR_CODEC_SIZE(n) - 1) == 0, "short buffer", "batch", (double) n);
+        check(sensor_codec_decode(buf, SENSOR_CODEC_SIZE(n) + 1, out, n) == SENSOR_CODEC_KO, "long input", "batch",
+              (double) n);
+    }
+}
+
+int main(void) {
+    size_check();
+    grid_check();
+    bound_check();
+    clamp_check();
+    pack_check();
+    printf("failed checks: %zu\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/net/ipv6_udp_builder.h"
+#include "schc_demo_app/services/schc_service.h"
+#include "schc_demo_app/services/sensor_agg.h"
+#include "schc_demo_app/services/sensor_codec.h"
+#include "schc_demo_app/services/sensor_service.h"
+
+/*
+ * The uplink pipeline never copies a payload: the measurement is written
+ * once into the packet buffer, the IPv6/UDP header goes in front of it
+ * and the packet is compressed in place (see schc-demo-app -r).
+ * Runs the round-trip corpus through that pipeline with every payload the
+ * application sends: the raw struct, one packed measurement, and batches.
+ * It also runs it for a sender unknown to the rules, which gets the
+ * no-compression rule, and for a device context. Every packet must
+ * decompress to what build_ipv6_udp_packet() produces for the same payload,
+ * and pktbuf_t.copies must still be zero at the end.
+ */
+
+#define NB_PACKETS 2000
+#define BATCH 8
+#define PKT_CAP 256
+
+typedef enum {
+    PAYLOAD_RAW, PAYLOAD_PACKED, PAYLOAD_BATCH, NB_PAYLOADS
+} payload_kind_t;
+
+static const char* const payload_names[NB_PAYLOADS] = { "raw struct", "packed", "batch" };
+
+typedef struct {
+    const char* name;
+    const schc_dev_ctx_t* dev;  // NULL: the application's own rules
+    int foreign;                // sender address the rules do not know
+} flow_t;
+
+typedef struct {
+    uint32_t packets;
+    uint32_t mismatches;
+    uint32_t copies;
+    uint32_t failures;
+} result_t;
+
+static ipv6_udp_cfg_t flow_cfg(const flow_t* f) {
+    ipv6_udp_cfg_t cfg = {0};
+    memcpy(cfg.src_ip, f->dev ? schc_service_dev_ctx_ip(f->dev) : schc_service_dev_ip(), 16);
+    memcpy(cfg.dst_ip, schc_service_app_ip(), 16);
+    cfg.src_port = schc_service_dev_port();
+    cfg.dst_port = schc_service_app_port();
+    cfg.next_header = 17;
+    cfg.hop_limit = schc_service_hop_limit();
+    if (f->foreign) cfg.src_ip[8] ^= 0x40;
+    return cfg;
+}
+
+// The payload, written straight into pb the way main.c does it
+static int put_payload(const payload_kind_t kind, sensor_agg_t* agg, pktbuf_t* pb) {
+    sensor_data_t sample;
+    switch (kind) {
+    case PAYLOAD_RAW:
+        return measure((sensor_data_t*) pktbuf_put(pb, sizeof(sensor_data_t))) == measure_status_ok ? 0 : -1;
+    case PAYLOAD_PACKED:
+        if (measure(&sample) != measure_status_ok) return -1;
+        sensor_codec_encode(&sample, 1, pktbuf_put(pb, SENSOR_CODEC_SIZE(1)), SENSOR_CODEC_SIZE(1));
+        return 0;
+    default:
+        for (uint64_t t = 0; t < BATCH; t++) {
+            if (measure(&sample) != measure_status_ok) return -1;
+            const sensor_agg_status st = sensor_agg_add(agg, &sample, t);
+            if (st != SENSOR_AGG_OK && st != SENSOR_AGG_READY) return -1;
+        }
+        return sensor_agg_flush(agg, pb) == SENSOR_AGG_OK ? 0 : -1;
+    }
+}
+
+static void run(const flow_t* f, const payload_kind_t kind, result_t* r) {
+    const ipv6_udp_cfg_t cfg = flow_cfg(f);
+    ipv6_udp_tpl_t tpl;
+    if (ipv6_udp_tpl_init(&tpl, &cfg, schc_service_flow_label()) != 0) {
+        r->failures++;
+        return;
+    }
+    sensor_agg_t agg;
+    sensor_agg_init(&agg, BATCH, PKT_CAP / 2);
+
+    static uint8_t storage[PKT_CAP];
+    static uint8_t expected[PKT_CAP];
+    static uint8_t rebuilt[PKT_CAP];
+    for (uint32_t i = 0; i < NB_PACKETS; i++) {
+        pktbuf_t pb;
+        pktbuf_init(&pb, storage, sizeof(storage), PKTBUF_HEADROOM);
+        size_t expected_len = 0, rebuilt_len = 0;
+        if (put_payload(kind, &agg, &pb) != 0 ||
+            build_ipv6_udp_packet(&cfg, schc_service_flow_label(), pktbuf_data(&pb), pb.len,
+                                  expected, sizeof(expected), &expected_len) != 0 ||
+            ipv6_udp_tpl_push(&tpl, &pb) != 0 ||
+            (f->dev ? schc_service_compress_pkt_dev(f->dev, &pb) : schc_service_compress_pkt(&pb)) != SCHC_OK ||
+            (f->dev ? schc_service_decompress_dev(f->dev, pktbuf_data(&pb), pb.len, rebuilt, sizeof(rebuilt),
+                                                  &rebuilt_len)
+                    : schc_service_decompress(pktbuf_data(&pb), pb.len, rebuilt, sizeof(rebuilt),
+                                              &rebuilt_len)) != SCHC_OK) {
+            r->failures++;
+            continue;
+        }
+        r->packets++;
+        r->copies += pb.copies;
+        if (rebuilt_len != expected_len || memcmp(rebuilt, expected, expected_len) != 0) r->mismatches++;
+    }
+}
+
+int main(void) {
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if (schc_service_init() != SCHC_OK) return EXIT_FAILURE;
+
+    const uint8_t iid[8] = { 0, 0, 0, 0, 0, 0, 0x0c, 0x01 };
+    schc_dev_ctx_t* dev = schc_service_dev_ctx_new(iid);
+    if (!dev) return EXIT_FAILURE;
+
+    const flow_t flows[] = {
+        { "application", NULL, 0 },
+        { "unknown sender", NULL, 1 },
+        { "device context", dev, 0 },
+    };
+
+    int rc = EXIT_SUCCESS;
+    for (size_t f = 0; f < sizeof(flows) / sizeof(flows[0]); f++) {
+        for (payload_kind_t kind = 0; kind < NB_PAYLOADS; kind++) {
+            result_t r = {0};
+            run(&flows[f], kind, &r);
+            const int ok = r.packets == NB_PACKETS && !r.mismatches && !r.copies && !r.failures;
+            printf("%-15s %-10s %u packets, %u mismatches, %u payload copies, %u failures -> %s\n",
+                   flows[f].name, payload_names[kind], r.packets, r.mismatches, r.copies, r.failures,
+                   ok ? "OK" : "FAILED");
+            if (!ok) rc = EXIT_FAILURE;
+        }
+    }
+
+    schc_service_dev_ctx_free(dev);
+    logger_fini();
+    return rc;
+}
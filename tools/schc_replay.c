@@ -0,0 +1,434 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "schc_demo_app/logger_helper.h"
+#include "schc_demo_app/services/schc_service.h"
+#include "schc_demo_app/utils.h"
+
+/*
+ * Offline replay of a capture through the SCHC compressor, for throughput
+ * numbers on real traffic and compression ratios.
+ *
+ *   schc-replay [-n passes] [-S rules.bin] [-m derived.json] <capture>
+ *
+ * The capture (classic pcap or pcapng, as written by schc-demo-app -P) is
+ * mapped read-only and indexed once: every complete IPv6/UDP packet is
+ * kept, in place, whatever the link type (raw IP, Ethernet, Linux cooked,
+ * BSD loopback); everything else, including the SCHC stages of our own
+ * captures, is skipped. A first pass compresses and decompresses every
+ * packet and checks the round trip; then the packets are compressed, and
+ * the SCHC packets decompressed, passes times over. Best and median pass
+ * are reported, so that runs on the same capture compare.
+ *
+ * Compression goes through schc_service_compress_batch(): the same
+ * compressor as schc_service_compress(), without its per-packet logging of
+ * no-compression fallbacks, which would dominate on foreign traffic.
+ *
+ * With -m, the misses of the first pass are profiled (see schc_profiler.h)
+ * and the rules plus the derived candidates written as a JSON rule set:
+ *
+ *   schc-replay -m derived.json cap.pcapng
+ *   schc-rulec derived.json derived.bin
+ *   schc-replay -S derived.bin cap.pcapng
+ */
+
+#define DEFAULT_PASSES 10
+#define MAX_PASSES 1000
+#define BATCH 32
+#define MAX_PKT 1500
+#define SCHC_SLACK 16           // no-compression rule ID and padding
+
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LOOP 108
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV6 229
+#define LINKTYPE_LINUX_SLL2 276
+
+#define ETHERTYPE_IPV6 0x86DD
+#define IPV6_HDR_LEN 40
+#define UDP_HDR_LEN 8
+#define IPPROTO_UDP_NH 17
+
+#define MAX_IFACES 64
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+    size_t skipped;
+    size_t* packets;            // offset of each IPv6 packet in data
+    uint16_t* lens;
+    size_t nb_packets;
+    size_t cap;
+    uint64_t ipv6_bytes;
+} capture_t;
+
+static uint16_t rd16(const uint8_t* p, const bool swap) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return swap ? __builtin_bswap16(v) : v;
+}
+
+static uint32_t rd32(const uint8_t* p, const bool swap) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t be16(const uint8_t* p) {
+    return (uint16_t) (p[0] << 8 | p[1]);
+}
+
+// Where the IPv6 header starts in a frame of this link type, -1: not IPv6
+static long ipv6_offset(const uint32_t linktype, const uint8_t* f, const size_t len) {
+    switch (linktype) {
+        case LINKTYPE_RAW:
+        case LINKTYPE_IPV6:
+            return 0;
+        case LINKTYPE_ETHERNET: {
+            if (len < 14) return -1;
+            size_t off = 12;
+            uint16_t type = be16(f + off);
+            if ((type == 0x8100 || type == 0x88A8) && len >= 18) {
+                off += 4;
+                type = be16(f + off);
+            }
+            return type == ETHERTYPE_IPV6 ? (long) off + 2 : -1;
+        }
+        case LINKTYPE_LINUX_SLL:
+            return len >= 16 && be16(f + 14) == ETHERTYPE_IPV6 ? 16 : -1;
+        case LINKTYPE_LINUX_SLL2:
+            return len >= 20 && be16(f) == ETHERTYPE_IPV6 ? 20 : -1;
+        case LINKTYPE_NULL:
+        case LINKTYPE_LOOP: {
+            // Address family in the byte order of the capturing host: AF_INET6 differs across BSDs
+            if (len < 4) return -1;
+            const uint32_t fam = rd32(f, false);
+            const uint32_t sw = __builtin_bswap32(fam);
+            const bool v6 = fam == 10 || fam == 24 || fam == 28 || fam == 30 ||
+                            sw == 10 || sw == 24 || sw == 28 || sw == 30;
+            return v6 ? 4 : -1;
+        }
+        default:
+            return -1;
+    }
+}
+
+static int add_packet(capture_t* cap, const uint32_t linktype, const uint8_t* f, const size_t len) {
+    const long off = ipv6_offset(linktype, f, len);
+    const uint8_t* ip = f + off;
+    const size_t avail = off < 0 ? 0 : len - (size_t) off;
+    // Complete UDP datagrams only: the compressor needs the whole header and the UDP length
+    if (off < 0 || avail < IPV6_HDR_LEN + UDP_HDR_LEN || ip[0] >> 4 != 6 || ip[6] != IPPROTO_UDP_NH ||
+        IPV6_HDR_LEN + (size_t) be16(ip + 4) > avail || IPV6_HDR_LEN + (size_t) be16(ip + 4) > MAX_PKT) {
+        cap->skipped++;
+        return 0;
+    }
+
+    if (cap->nb_packets == cap->cap) {
+        const size_t n = cap->cap ? cap->cap * 2 : 4096;
+        size_t* p = realloc(cap->packets, n * sizeof(*p));
+        if (p) cap->packets = p;
+        uint16_t* l = realloc(cap->lens, n * sizeof(*l));
+        if (l) cap->lens = l;
+        if (!p || !l) return -1;
+        cap->cap = n;
+    }
+    cap->packets[cap->nb_packets] = (size_t) (ip - cap->data);
+    cap->lens[cap->nb_packets] = (uint16_t) (IPV6_HDR_LEN + be16(ip + 4));
+    cap->ipv6_bytes += cap->lens[cap->nb_packets];
+    cap->nb_packets++;
+    return 0;
+}
+
+static int index_pcap(capture_t* cap) {
+    const uint8_t* d = cap->data;
+    const uint32_t magic = rd32(d, false);
+    const bool swap = magic == 0xD4C3B2A1u || magic == 0x4D3CB2A1u;
+    if (cap->len < 24) return -1;
+    const uint32_t linktype = rd32(d + 20, swap) & 0xFFFF;
+
+    size_t off = 24;
+    while (off + 16 <= cap->len) {
+        const uint32_t caplen = rd32(d + off + 8, swap);
+        if (caplen > cap->len - off - 16) {
+            fprintf(stderr, "truncated record at offset %zu\n", off);
+            break;
+        }
+        if (add_packet(cap, linktype, d + off + 16, caplen) != 0) return -1;
+        off += 16 + caplen;
+    }
+    return 0;
+}
+
+static int index_pcapng(capture_t* cap) {
+    const uint8_t* d = cap->data;
+    bool swap = false;
+    uint32_t linktypes[MAX_IFACES];
+    size_t nb_ifaces = 0;
+
+    size_t off = 0;
+    while (off + 12 <= cap->len) {
+        const uint8_t* b = d + off;
+        uint32_t type = rd32(b, swap);
+        if (type == 0x0A0D0D0Au) {
+            // Every section sets its own byte order and interfaces
+            if (off + 28 > cap->len) break;
+            swap = rd32(b + 8, false) != 0x1A2B3C4Du;
+            nb_ifaces = 0;
+        }
+        const uint32_t total = rd32(b + 4, swap);
+        if (total < 12 || total % 4 != 0 || total > cap->len - off) {
+            fprintf(stderr, "bad block at offset %zu\n", off);
+            break;
+        }
+
+        if (type == 0x00000001u && total >= 20) {
+            if (nb_ifaces < MAX_IFACES) linktypes[nb_ifaces++] = rd16(b + 8, swap);
+        } else if (type == 0x00000006u && total >= 32) {
+            const uint32_t iface = rd32(b + 8, swap);
+            const uint32_t caplen = rd32(b + 20, swap);
+            if (iface < nb_ifaces && caplen <= total - 32) {
+                if (add_packet(cap, linktypes[iface], b + 28, caplen) != 0) return -1;
+            } else {
+                cap->skipped++;
+            }
+        } else if (type == 0x00000003u && total >= 16) {
+            // Simple packet block: interface 0, captured length implied by the block size
+            const uint32_t orig = rd32(b + 8, swap);
+            const size_t caplen = orig < total - 16 ? orig : total - 16;
+            if (nb_ifaces > 0) {
+                if (add_packet(cap, linktypes[0], b + 12, caplen) != 0) return -1;
+            } else {
+                cap->skipped++;
+            }
+        }
+        off += total;
+    }
+    return 0;
+}
+
+static int map_capture(const char* path, capture_t* cap) {
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) != 0 || st.st_size < 12) {
+        if (fd != -1) close(fd);
+        fprintf(stderr, "%s: cannot read\n", path);
+        return -1;
+    }
+    void* m = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map\n", path);
+        return -1;
+    }
+    madvise(m, (size_t) st.st_size, MADV_SEQUENTIAL);
+    cap->data = m;
+    cap->len = (size_t) st.st_size;
+
+    const uint32_t magic = rd32(cap->data, false);
+    int rc;
+    if (magic == 0x0A0D0D0Au) {
+        rc = index_pcapng(cap);
+    } else if (magic == 0xA1B2C3D4u || magic == 0xD4C3B2A1u || magic == 0xA1B23C4Du || magic == 0x4D3CB2A1u) {
+        rc = index_pcap(cap);
+    } else {
+        fprintf(stderr, "%s: not a pcap or pcapng file\n", path);
+        rc = -1;
+    }
+    if (rc != 0) munmap(m, cap->len);
+    return rc;
+}
+
+typedef struct {
+    uint8_t* data;              // SCHC packets, MAX_PKT + SCHC_SLACK bytes apart
+    uint16_t* lens;
+    uint64_t bytes;
+    size_t failed;
+} schc_out_t;
+
+// Compress every packet, BATCH at a time; into out if given, else into scratch
+static void compress_all(const capture_t* cap, schc_out_t* out) {
+    static uint8_t scratch[BATCH][MAX_PKT + SCHC_SLACK];
+    schc_cspan_t in[BATCH];
+    schc_span_t res[BATCH];
+    schc_status_t status[BATCH];
+    size_t bits[BATCH];
+
+    for (size_t first = 0; first < cap->nb_packets; first += BATCH) {
+        const size_t n = cap->nb_packets - first < BATCH ? cap->nb_packets - first : BATCH;
+        for (size_t i = 0; i < n; i++) {
+            in[i].data = cap->data + cap->packets[first + i];
+            in[i].len = cap->lens[first + i];
+            res[i].data = out ? out->data + (first + i) * (MAX_PKT + SCHC_SLACK) : scratch[i];
+            res[i].len = MAX_PKT + SCHC_SLACK;
+        }
+        schc_service_compress_batch(in, res, n, status, bits);
+        if (!out) continue;
+        for (size_t i = 0; i < n; i++) {
+            const uint16_t len = status[i] == SCHC_OK ? (uint16_t) ((bits[i] + 7) / 8) : 0;
+            out->lens[first + i] = len;
+            out->bytes += len;
+            out->failed += status[i] != SCHC_OK;
+        }
+    }
+}
+
+// Decompress every SCHC packet; with check, compare with the original. Returns the mismatches
+static size_t decompress_all(const capture_t* cap, const schc_out_t* schc, const bool check,
+                             schc_status_t* st_out) {
+    static uint8_t rebuilt[MAX_PKT + SCHC_SLACK];
+    size_t mismatches = 0;
+    *st_out = SCHC_OK;
+    for (size_t i = 0; i < cap->nb_packets; i++) {
+        if (!schc->lens[i]) continue;
+        size_t len = 0;
+        const schc_status_t st = schc_service_decompress(schc->data + i * (MAX_PKT + SCHC_SLACK), schc->lens[i],
+                                                         rebuilt, sizeof(rebuilt), &len);
+        if (st == SCHC_MODE_NOT_AVAILABLE) {
+            *st_out = st;
+            return 0;
+        }
+        if (check && (st != SCHC_OK || len != cap->lens[i] ||
+                      memcmp(rebuilt, cap->data + cap->packets[i], len) != 0)) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    const uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char* what, uint64_t* pass_ns, const int passes, const size_t nb_packets,
+                   const uint64_t bytes) {
+    qsort(pass_ns, (size_t) passes, sizeof(*pass_ns), cmp_u64);
+    const double best = (double) pass_ns[0], median = (double) pass_ns[passes / 2];
+    printf("%-11s best %7.1f ns/pkt %11.0f pkt/s %8.1f MB/s   median %7.1f ns/pkt\n", what,
+           best / (double) nb_packets, (double) nb_packets * 1e9 / best, (double) bytes * 1e3 / best,
+           median / (double) nb_packets);
+}
+
+int main(int argc, char* argv[]) {
+    int passes = DEFAULT_PASSES;
+    const char* rules = NULL;
+    const char* derived = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:S:m:")) != -1) {
+        switch (opt) {
+            case 'n':
+                passes = atoi(optarg);
+                break;
+            case 'S':
+                rules = optarg;
+                break;
+            case 'm':
+                derived = optarg;
+                break;
+            default:
+                passes = 0;
+        }
+    }
+    if (optind != argc - 1 || passes < 1 || passes > MAX_PASSES) {
+        fprintf(stderr, "usage: %s [-n passes] [-S rules.bin] [-m derived.json] <capture.pcap|.pcapng>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (logger_init() != LOGGER_INIT_OK) return EXIT_FAILURE;
+    if ((rules && schc_service_set_rule_file(rules) != SCHC_OK) || schc_service_init() != SCHC_OK) {
+        fprintf(stderr, "SCHC init failed\n");
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+
+    capture_t cap = {0};
+    if (map_capture(argv[optind], &cap) != 0) {
+        logger_fini();
+        return EXIT_FAILURE;
+    }
+    printf("%s: %zu IPv6/UDP packets, %llu bytes, %zu other records skipped\n", argv[optind], cap.nb_packets,
+           (unsigned long long) cap.ipv6_bytes, cap.skipped);
+
+    schc_out_t schc = {0};
+    uint64_t* pass_ns = malloc((size_t) passes * sizeof(*pass_ns));
+    if (cap.nb_packets) {
+        schc.data = malloc(cap.nb_packets * (MAX_PKT + SCHC_SLACK));
+        schc.lens = calloc(cap.nb_packets, sizeof(*schc.lens));
+    }
+    int rc = EXIT_SUCCESS;
+    if (!cap.nb_packets || !schc.data || !schc.lens || !pass_ns) {
+        if (cap.nb_packets) fprintf(stderr, "out of memory\n");
+        rc = cap.nb_packets ? EXIT_FAILURE : EXIT_SUCCESS;
+        goto out;
+    }
+
+    // Reference pass: keeps every SCHC packet, checks the round trip, warms the mapping
+    schc_service_stats_t before, after;
+    schc_service_get_stats(&before);
+    if (derived) schc_service_profile_misses(1);
+    compress_all(&cap, &schc);
+    if (derived) schc_service_profile_misses(0);
+    schc_service_get_stats(&after);
+    schc_status_t dst;
+    const size_t mismatches = decompress_all(&cap, &schc, true, &dst);
+
+    const size_t nb_ok = cap.nb_packets - schc.failed;
+    printf("compressed  %zu packets, %llu with the no-compression rule, %zu failed\n", nb_ok,
+           (unsigned long long) (after.no_comp - before.no_comp), schc.failed);
+    printf("ratio       %llu -> %llu bytes, %.3f (%.1f bytes saved per packet)\n",
+           (unsigned long long) cap.ipv6_bytes, (unsigned long long) schc.bytes,
+           (double) schc.bytes / (double) cap.ipv6_bytes,
+           nb_ok ? (double) ((int64_t) cap.ipv6_bytes - (int64_t) schc.bytes) / (double) nb_ok : 0.0);
+    if (dst == SCHC_MODE_NOT_AVAILABLE) {
+        printf("round trip  decompression not available, not checked\n");
+    } else {
+        printf("round trip  %zu of %zu packets rebuilt identical\n", nb_ok - mismatches, nb_ok);
+    }
+    if (schc.failed || mismatches) rc = EXIT_FAILURE;
+    if (derived) {
+        if (schc_service_profile_report(derived) == SCHC_OK) {
+            printf("derived     rule set written to %s\n", derived);
+        } else {
+            fprintf(stderr, "derived rule set %s not written\n", derived);
+            rc = EXIT_FAILURE;
+        }
+    }
+
+    for (int p = 0; p < passes; p++) {
+        const uint64_t t0 = monotonic_now_ns();
+        compress_all(&cap, NULL);
+        pass_ns[p] = monotonic_now_ns() - t0;
+    }
+    report("compress", pass_ns, passes, cap.nb_packets, cap.ipv6_bytes);
+
+    if (dst != SCHC_MODE_NOT_AVAILABLE && nb_ok) {
+        for (int p = 0; p < passes; p++) {
+            const uint64_t t0 = monotonic_now_ns();
+            decompress_all(&cap, &schc, false, &dst);
+            pass_ns[p] = monotonic_now_ns() - t0;
+        }
+        report("decompress", pass_ns, passes, nb_ok, cap.ipv6_bytes);
+    }
+
+out:
+    free(pass_ns);
+    free(schc.data);
+    free(schc.lens);
+    free(cap.packets);
+    free(cap.lens);
+    munmap((void*) cap.data, cap.len);
+    logger_fini();
+    return rc;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schc_demo_app/services/schc_frag.h"
+#include "schc_demo_app/services/schc_rule_engine.h"
+#include "schc_demo_app/services/schc_rule_json.h"
+
+/*
+ * Offline rule compiler: reads a rule set in the RFC 9363 JSON encoding,
+ * compiles it and writes the rule image the application maps at startup
+ * (schc-demo-app -S <image>). Changing the rules only needs a new image.
+ */
+
+static char* read_file(const char* path, size_t* len) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    char* buf = NULL;
+    long size;
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0 &&
+        (buf = malloc((size_t) size + 1)) != NULL) {
+        *len = fread(buf, 1, (size_t) size, f);
+        if (*len != (size_t) size) {
+            free(buf);
+            buf = NULL;
+        }
+    }
+    fclose(f);
+    return buf;
+}
+
+static int is_frag_rule_id(const uint16_t rule_id, const uint8_t rule_id_bits) {
+    const uint8_t first = (uint8_t)(rule_id >> (rule_id_bits - 8));
+    return first == SCHC_FRAG_NOACK_RULE_ID || first == SCHC_FRAG_ACK_RULE_ID;
+}
+
+static int compile(const schc_rule_set_t* set, const char* in, const char* out) {
+    for (size_t i = 0; i <= set->nb_rules; i++) {
+        const uint16_t id = i < set->nb_rules ? set->rules[i].rule_id : set->default_rule_id;
+        if (is_frag_rule_id(id, set->rule_id_bits)) {
+            fprintf(stderr, "%s: rule ID %u collides with the fragmentation rules\n", in, id);
+            return -1;
+        }
+    }
+
+    schc_engine_t eng;
+    const schc_engine_status est = schc_engine_compile(&eng, set->rules, set->nb_rules, set->rule_id_bits,
+                                                       set->default_rule_id);
+    if (est != SCHC_ENGINE_OK) {
+        fprintf(stderr, "%s: %s\n", in, est == SCHC_ENGINE_UNSUPPORTED
+                ? "a rule uses a field, MO or CDA the compressor does not support"
+                : "invalid rule set (duplicate rule ID, or a target value missing)");
+        return -1;
+    }
+    const schc_engine_status sst = schc_engine_save(&eng, out);
+    if (sst != SCHC_ENGINE_OK) {
+        fprintf(stderr, "%s: cannot write\n", out);
+    } else {
+        printf("%s: %zu rules, %zu distinct masks, %u-bit rule IDs, no-compression rule %u\n",
+               out, eng.nb_rules, eng.nb_groups, eng.rule_id_bits, eng.default_rule_id);
+    }
+    schc_engine_free(&eng);
+    return sst == SCHC_ENGINE_OK ? 0 : -1;
+}
+
+int main(const int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <rules.json> <rules.bin>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t len;
+    char* json = read_file(argv[1], &len);
+    if (!json) {
+        fprintf(stderr, "%s: cannot read\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    schc_rule_set_t set;
+    size_t line = 0;
+    char msg[160];
+    const schc_rule_json_status jst = schc_rule_json_parse(json, len, &set, &line, msg, sizeof(msg));
+    free(json);
+    if (jst != SCHC_RULE_JSON_OK) {
+        fprintf(stderr, "%s:%zu: %s\n", argv[1], line, msg[0] ? msg : "out of memory");
+        return EXIT_FAILURE;
+    }
+
+    const int rc = compile(&set, argv[1], argv[2]);
+    schc_rule_set_free(&set);
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}